@@ -4,46 +4,13 @@
 #include "dx_exception.h"
 #include <Windows.h>
 #include <cstdint>
-#include "../DirectXTK/Inc/WICTextureLoader.h"
 #include "../DirectXTK/Inc/CommonStates.h"
+#include "AssetTypes.h"
 
 using namespace DirectX;
 using namespace Microsoft::WRL;
 using namespace std::chrono;
 
-struct Buffer {
-	std::unique_ptr<std::uint8_t[]> data;
-	std::uint32_t size;
-};
-
-class SafeHandle {
-private:
-	HANDLE _handle;
-public:
-	HANDLE get()const { return _handle; }
-	explicit SafeHandle(HANDLE h) : _handle(h) {
-		if (h == INVALID_HANDLE_VALUE) {
-			throw std::bad_alloc();
-		}
-
-	}
-	~SafeHandle() {
-		CloseHandle(_handle);
-	}
-};
-
-Buffer readFileToMemory(const wchar_t* filePath) {
-	SafeHandle file(CreateFile(filePath, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr));
-	LARGE_INTEGER size;
-	GetFileSizeEx(file.get(), &size);
-	std::unique_ptr<std::uint8_t[]> data(new std::uint8_t[size.QuadPart]);
-	DWORD read;
-	if (!ReadFile(file.get(), data.get(), size.QuadPart, &read, nullptr)) {
-		throw std::exception("cannot read file");
-	}
-	return Buffer{ std::move(data), (uint32_t)size.QuadPart };
-}
-
 struct QuadVertex {
 	DirectX::XMFLOAT2 pos;
 	DirectX::XMFLOAT2 uv;
@@ -58,15 +25,18 @@ struct QuadVertex {
 class AnimatedText::Resources {
 public:
 	ComPtr<ID3D11Buffer> _quadVertices;
-	ComPtr<ID3D11VertexShader> _vertexShader;
 	ComPtr<ID3D11InputLayout> _inputLayout;
 	ComPtr<ID3D11Buffer> _transformsBuffer;
 
-	ComPtr<ID3D11PixelShader> _pixelShader;
-	ComPtr<ID3D11Resource> _texture;
-	ComPtr<ID3D11ShaderResourceView> _textureRV;
+	std::shared_ptr<VertexShaderAsset> _vertexShader;
+	std::shared_ptr<PixelShaderAsset> _pixelShader;
+	std::shared_ptr<TextureAsset> _texture;
 	ComPtr<ID3D11DepthStencilState> _depthStencilState;
 	ComPtr<ID3D11BlendState> _blendState;
+	// set once the streamed assets are available
+	bool _ready = false;
+	// NoPromise coroutines drop exceptions: a failed load is kept here, and rethrown on the game loop by the next update
+	std::exception_ptr _loadError;
 public:
 	void reset(ID3D11Device* device) {
 		QuadVertex quad[] = {
@@ -84,29 +54,38 @@ public:
 		vertexData.SysMemSlicePitch = 0;
 		throwIfFailed(device->CreateBuffer(&CD3D11_BUFFER_DESC(sizeof(quad), D3D11_BIND_VERTEX_BUFFER, D3D11_USAGE_IMMUTABLE), &vertexData, &_quadVertices));
 
-
-		Buffer b = readFileToMemory(L"DrawQuadVS.cso");
-		throwIfFailed(device->CreateVertexShader(b.data.get(), b.size, nullptr, &_vertexShader));
-		D3D11_INPUT_ELEMENT_DESC inputDesc[]{
-			{"POSITION", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 0, D3D11_INPUT_CLASSIFICATION::D3D11_INPUT_PER_VERTEX_DATA, 0},
-			{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, sizeof(XMFLOAT2), D3D11_INPUT_CLASSIFICATION::D3D11_INPUT_PER_VERTEX_DATA, 0 }
-		};
-		throwIfFailed(device->CreateInputLayout(inputDesc, ARRAYSIZE(inputDesc), b.data.get(), b.size, &_inputLayout));
-
 		throwIfFailed(device->CreateBuffer(&CD3D11_BUFFER_DESC(sizeof(XMFLOAT4X4), D3D11_BIND_CONSTANT_BUFFER, D3D11_USAGE_DYNAMIC, D3D11_CPU_ACCESS_WRITE), nullptr, &_transformsBuffer));
 
-		b = readFileToMemory(L"DrawQuadPS.cso");
-		throwIfFailed(device->CreatePixelShader(b.data.get(), b.size, nullptr, &_pixelShader));
-
-		b = readFileToMemory(L"Texture.png");
-		throwIfFailed(DirectX::CreateWICTextureFromMemory(device, b.data.get(), b.size, &_texture, &_textureRV));
-
 		_depthStencilState = DirectX::CommonStates(device).DepthNone();
 		_blendState = DirectX::CommonStates(device).Additive();
 	}
+
+	// shaders and texture are streamed by the asset manager (the 3 loads run concurrently).
+	// the resources are kept alive by the coroutine, even if the scene object goes away in the meantime
+	static NoPromise loadAssets(std::shared_ptr<Resources> self, ComPtr<ID3D11Device> device, AssetManager* assets) {
+		try {
+			auto vertexShaderLoad = assets->load<VertexShaderAsset>(L"DrawQuadVS.cso", AssetPriority::High);
+			auto pixelShaderLoad = assets->load<PixelShaderAsset>(L"DrawQuadPS.cso", AssetPriority::High);
+			auto textureLoad = assets->load<TextureAsset>(L"Texture.png");
+
+			auto vertexShader = __await vertexShaderLoad;
+			D3D11_INPUT_ELEMENT_DESC inputDesc[]{
+				{"POSITION", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 0, D3D11_INPUT_CLASSIFICATION::D3D11_INPUT_PER_VERTEX_DATA, 0},
+				{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, sizeof(XMFLOAT2), D3D11_INPUT_CLASSIFICATION::D3D11_INPUT_PER_VERTEX_DATA, 0 }
+			};
+			throwIfFailed(device->CreateInputLayout(inputDesc, ARRAYSIZE(inputDesc), vertexShader->bytecode.data(), vertexShader->bytecode.size(), &self->_inputLayout));
+			self->_vertexShader = vertexShader;
+			self->_pixelShader = __await pixelShaderLoad;
+			self->_texture = __await textureLoad;
+			self->_ready = true;
+		}
+		catch (...) {
+			self->_loadError = std::current_exception();
+		}
+	}
 };
 
-AnimatedText::AnimatedText() : _resources(std::make_unique<Resources>()), _opacity(0)
+AnimatedText::AnimatedText() : _resources(std::make_shared<Resources>()), _opacity(0)
 {
 	XMStoreFloat4x4(&_transform, XMMatrixScaling(0, 0, 1.0f));
 }
@@ -116,13 +95,19 @@ AnimatedText::~AnimatedText()
 {
 }
 
-void AnimatedText::loadDeviceDependentResources(ID3D11Device * device)
+void AnimatedText::loadDeviceDependentResources(ID3D11Device * device, AssetManager& assets)
 {
 	_resources->reset(device);
+	Resources::loadAssets(_resources, device, &assets);
 }
 
 void AnimatedText::updateState(const GameClock & clock)
 {
+	if (_resources->_loadError) {
+		auto error = _resources->_loadError;
+		_resources->_loadError = nullptr;
+		std::rethrow_exception(error);
+	}
 	if (_opacityAnim) {
 		bool animEnded;
 		_opacity = _opacityAnim->update(clock.lastFrameDuration(), animEnded);
@@ -133,30 +118,30 @@ void AnimatedText::updateState(const GameClock & clock)
 	}
 }
 
-void AnimatedText::draw(ID3D11DeviceContext * deviceContext, ID3D11RenderTargetView * rtv)
+void AnimatedText::draw(DrawCommandRecorder& recorder) const
 {
-	D3D11_MAPPED_SUBRESOURCE transformsMappedResource;
-	throwIfFailed(deviceContext->Map(_resources->_transformsBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &transformsMappedResource));
-	XMFLOAT4X4* pOut = reinterpret_cast<XMFLOAT4X4*>(transformsMappedResource.pData);
-	*pOut = _transform;
-	pOut->_41 = _opacity;
-	deviceContext->Unmap(_resources->_transformsBuffer.Get(), 0);
-
-	UINT stride = sizeof(QuadVertex);
-	UINT offset = 0;
-	deviceContext->IASetVertexBuffers(0, 1, _resources->_quadVertices.GetAddressOf(), &stride, &offset);
-	deviceContext->IASetInputLayout(_resources->_inputLayout.Get());
-	deviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-	deviceContext->VSSetShader(_resources->_vertexShader.Get(), nullptr, 0);
-	deviceContext->VSSetConstantBuffers(0, 1, _resources->_transformsBuffer.GetAddressOf());
-
-	deviceContext->PSSetShader(_resources->_pixelShader.Get(), nullptr, 0);
-	deviceContext->PSSetShaderResources(0, 1, _resources->_textureRV.GetAddressOf());
-
-	deviceContext->OMSetBlendState(_resources->_blendState.Get(), nullptr, 0xffffffff);
-	deviceContext->OMSetDepthStencilState(_resources->_depthStencilState.Get(), 0);
-
-	deviceContext->Draw(6, 0);
+	if (!_resources->_ready) {
+		return;
+	}
+	XMFLOAT4X4 transform = _transform;
+	transform._41 = _opacity;
+
+	recorder.beginPacket();
+	recorder.updateBuffer(_resources->_transformsBuffer.Get(), &transform, sizeof(transform));
+
+	recorder.setVertexBuffer(0, _resources->_quadVertices.Get(), sizeof(QuadVertex), 0);
+	recorder.setInputLayout(_resources->_inputLayout.Get());
+	recorder.setPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	recorder.setVertexShader(_resources->_vertexShader->shader.Get());
+	recorder.setVSConstantBuffer(0, _resources->_transformsBuffer.Get());
+
+	recorder.setPixelShader(_resources->_pixelShader->shader.Get());
+	recorder.setPSShaderResource(0, _resources->_texture->view.Get());
+
+	recorder.setBlendState(_resources->_blendState.Get());
+	recorder.setDepthStencilState(_resources->_depthStencilState.Get(), 0);
+
+	recorder.draw(6, 0);
 }
 
 GameAwaitableUniquePromise<void>* AnimatedText::fadeIn()
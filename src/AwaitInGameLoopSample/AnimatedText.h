@@ -12,7 +12,7 @@ class AnimatedText :
 {
 private:
 	class Resources;
-	std::unique_ptr<Resources> _resources;
+	std::shared_ptr<Resources> _resources;
 	DirectX::XMFLOAT4X4 _transform;
 	float _opacity;
 	std::unique_ptr<Animation<float>> _opacityAnim;
@@ -22,9 +22,9 @@ public:
 	virtual ~AnimatedText();
 
 	// Inherited via SceneObject
-	virtual void loadDeviceDependentResources(ID3D11Device * device) override;
+	virtual void loadDeviceDependentResources(ID3D11Device * device, AssetManager& assets) override;
 	virtual void updateState(const GameClock & clock) override;
-	virtual void draw(ID3D11DeviceContext * deviceContext, ID3D11RenderTargetView * rtv) override;
+	virtual void draw(DrawCommandRecorder& recorder) const override;
 
 	// animations can be considered as coroutines that will eventually complete
 	GameAwaitableUniquePromise<void>* fadeIn();
@@ -0,0 +1,218 @@
+#include "stdafx.h"
+#include "AssetManager.h"
+#include <algorithm>
+#include <ppltasks.h>
+
+using namespace details;
+
+class SafeHandle {
+private:
+	HANDLE _handle;
+public:
+	HANDLE get()const { return _handle; }
+	explicit SafeHandle(HANDLE h) : _handle(h) {
+		if (h == INVALID_HANDLE_VALUE) {
+			throw std::bad_alloc();
+		}
+
+	}
+	~SafeHandle() {
+		CloseHandle(_handle);
+	}
+};
+
+std::vector<std::uint8_t> readFileToMemory(const wchar_t* filePath) {
+	SafeHandle file(CreateFile(filePath, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr));
+	LARGE_INTEGER size;
+	GetFileSizeEx(file.get(), &size);
+	std::vector<std::uint8_t> data((size_t)size.QuadPart);
+	DWORD read;
+	if (!ReadFile(file.get(), data.data(), (DWORD)size.QuadPart, &read, nullptr)) {
+		throw std::exception("cannot read file");
+	}
+	return data;
+}
+
+bool AssetAwaiterBase::ready() const
+{
+	return _entry->state == AssetEntry::State::Loaded || _entry->state == AssetEntry::State::Failed;
+}
+
+void AssetAwaiterBase::suspend(std::experimental::resumable_handle<> resumeCB)
+{
+	_resumeCB = resumeCB;
+	_next = _entry->waiters;
+	_entry->waiters = this;
+}
+
+std::shared_ptr<void> AssetAwaiterBase::result() const
+{
+	if (_entry->state == AssetEntry::State::Failed) {
+		std::rethrow_exception(_entry->error);
+	}
+	return _entry->asset;
+}
+
+// results of the worker threads, consumed by the game loop thread
+struct AssetManager::Completion {
+	struct Result {
+		std::shared_ptr<AssetEntry> entry;
+		std::shared_ptr<void> asset;
+		std::size_t size;
+		std::exception_ptr error;
+	};
+	std::mutex mutex;
+	std::vector<Result> results;
+};
+
+AssetManager::AssetManager(ID3D11Device * device, std::size_t memoryBudget, std::size_t maxInFlightLoads) : _device(device),
+	_completion(std::make_shared<Completion>()), _maxInFlightLoads(maxInFlightLoads), _inFlightLoads(0),
+	_memoryBudget(memoryBudget), _memoryUsage(0), _requestCounter(0)
+{
+	_reader = [](const AssetId& id) {
+		return readFileToMemory(id.c_str());
+	};
+}
+
+AssetManager::~AssetManager()
+{
+	// coroutines still waiting for an asset are resumed, and throw coroutine_abandoned
+	for (auto& e : _entries) {
+		auto& entry = *e.second;
+		if (entry.state == AssetEntry::State::Queued || entry.state == AssetEntry::State::Loading) {
+			entry.state = AssetEntry::State::Failed;
+			entry.error = std::make_exception_ptr(coroutine_abandoned());
+			complete(entry);
+		}
+	}
+}
+
+void AssetManager::setReader(const std::function<std::vector<std::uint8_t>(const AssetId&)>& reader)
+{
+	_reader = reader;
+}
+
+void AssetManager::setMemoryBudget(std::size_t memoryBudget)
+{
+	_memoryBudget = memoryBudget;
+	evict();
+}
+
+std::shared_ptr<AssetEntry> AssetManager::request(const AssetId & id, std::type_index type, AssetPriority priority,
+	const std::function<std::shared_ptr<void>(ID3D11Device*, std::vector<std::uint8_t>&, std::size_t&)>& decode)
+{
+	Key key(type, id);
+	auto it = _entries.find(key);
+	if (it != _entries.end() && it->second->state != AssetEntry::State::Failed) {
+		auto& entry = it->second;
+		if (entry->state == AssetEntry::State::Loaded) {
+			_lru.splice(_lru.begin(), _lru, entry->lruPosition);
+		}
+		else if (entry->state == AssetEntry::State::Queued && priority > entry->priority) {
+			entry->priority = priority;
+		}
+		return entry;
+	}
+	// new asset, or retry of a failed load
+	auto entry = std::make_shared<AssetEntry>(id, type);
+	entry->priority = priority;
+	entry->requestOrder = _requestCounter++;
+	entry->decode = decode;
+	_entries[key] = entry;
+	_queued.push_back(entry);
+	startLoads();
+	return entry;
+}
+
+void AssetManager::startLoads()
+{
+	while (_inFlightLoads < _maxInFlightLoads && !_queued.empty()) {
+		// highest priority first, then first requested
+		auto next = std::min_element(_queued.begin(), _queued.end(), [](const std::shared_ptr<AssetEntry>& l, const std::shared_ptr<AssetEntry>& r) {
+			if (l->priority != r->priority) {
+				return l->priority > r->priority;
+			}
+			return l->requestOrder < r->requestOrder;
+		});
+		auto entry = *next;
+		_queued.erase(next);
+		entry->state = AssetEntry::State::Loading;
+		++_inFlightLoads;
+
+		// the worker only touches its own copies, and hands the result over through the completion queue
+		auto completion = _completion;
+		auto reader = _reader;
+		auto device = _device;
+		auto decode = entry->decode;
+		auto id = entry->id;
+		concurrency::create_task([completion, reader, device, decode, id, entry]() {
+			Completion::Result result{ entry, nullptr, 0, nullptr };
+			try {
+				auto data = reader(id);
+				result.asset = decode(device.Get(), data, result.size);
+			}
+			catch (...) {
+				result.error = std::current_exception();
+			}
+			std::lock_guard<std::mutex> lock(completion->mutex);
+			completion->results.push_back(std::move(result));
+		});
+	}
+}
+
+void AssetManager::complete(AssetEntry & entry)
+{
+	auto waiter = entry.waiters;
+	entry.waiters = nullptr;
+	while (waiter) {
+		auto next = waiter->_next;
+		waiter->_next = nullptr;
+		// resuming may request other assets, or destroy the awaiter
+		waiter->_resumeCB();
+		waiter = next;
+	}
+}
+
+void AssetManager::evict()
+{
+	auto it = _lru.end();
+	while (_memoryUsage > _memoryBudget && it != _lru.begin()) {
+		--it;
+		auto entry = *it;
+		// still used by a scene object
+		if (entry->asset.use_count() > 1) {
+			continue;
+		}
+		_memoryUsage -= entry->size;
+		it = _lru.erase(it);
+		_entries.erase(Key(entry->type, entry->id));
+	}
+}
+
+void AssetManager::update()
+{
+	std::vector<Completion::Result> results;
+	{
+		std::lock_guard<std::mutex> lock(_completion->mutex);
+		results.swap(_completion->results);
+	}
+	for (auto& result : results) {
+		--_inFlightLoads;
+		auto& entry = *result.entry;
+		if (result.error) {
+			entry.state = AssetEntry::State::Failed;
+			entry.error = result.error;
+		}
+		else {
+			entry.state = AssetEntry::State::Loaded;
+			entry.asset = std::move(result.asset);
+			entry.size = result.size;
+			_memoryUsage += entry.size;
+			_lru.push_front(&entry);
+			entry.lruPosition = _lru.begin();
+		}
+		complete(entry);
+	}
+	startLoads();
+	evict();
+}
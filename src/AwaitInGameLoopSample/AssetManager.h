@@ -0,0 +1,148 @@
+#pragma once
+#include <d3d11_2.h>
+#include <wrl.h>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <typeindex>
+#include <vector>
+#include <experimental\resumable>
+#include "GameAwaitablePromise.h"
+
+typedef std::wstring AssetId;
+
+enum class AssetPriority {
+	Low,
+	Normal,
+	High,
+	Critical
+};
+
+// specialized for each asset type:
+// - static std::shared_ptr<T> decode(ID3D11Device* device, std::vector<std::uint8_t>& data) (called on a worker thread, device may be null in a headless engine)
+// - static std::size_t size(const T& asset) (memory accounted against the budget)
+template<typename T>
+struct AssetTraits;
+
+class AssetManager;
+
+namespace details {
+	// shared by all the requests of the same asset
+	struct AssetEntry;
+
+	class AssetAwaiterBase {
+		friend class ::AssetManager;
+	protected:
+		std::shared_ptr<AssetEntry> _entry;
+		std::experimental::resumable_handle<> _resumeCB;
+		AssetAwaiterBase* _next;
+		explicit AssetAwaiterBase(const std::shared_ptr<AssetEntry>& entry) : _entry(entry), _resumeCB(nullptr), _next(nullptr) {}
+		bool ready() const;
+		void suspend(std::experimental::resumable_handle<> resumeCB);
+		// rethrows the load error, if any
+		std::shared_ptr<void> result() const;
+	};
+
+	struct AssetEntry {
+		enum class State { Queued, Loading, Loaded, Failed };
+		AssetId id;
+		std::type_index type;
+		State state;
+		AssetPriority priority;
+		std::uint64_t requestOrder;
+		std::shared_ptr<void> asset;
+		std::size_t size;
+		std::exception_ptr error;
+		std::function<std::shared_ptr<void>(ID3D11Device*, std::vector<std::uint8_t>&, std::size_t&)> decode;
+		AssetAwaiterBase* waiters;
+		std::list<AssetEntry*>::iterator lruPosition;
+		AssetEntry(const AssetId& id_, std::type_index type_) : id(id_), type(type_), state(State::Queued), priority(AssetPriority::Low), requestOrder(0), size(0), waiters(nullptr) {}
+	};
+}
+
+// awaitable returned by AssetManager::load. completes with the loaded asset, or rethrows the load error
+template<typename T>
+class AssetAwaiter : private details::AssetAwaiterBase {
+	friend class AssetManager;
+private:
+	explicit AssetAwaiter(const std::shared_ptr<details::AssetEntry>& entry) : AssetAwaiterBase(entry) {}
+public:
+	// only valid before the awaiter has been suspended
+	AssetAwaiter(AssetAwaiter&& other) : AssetAwaiterBase(other._entry) {}
+	AssetAwaiter(const AssetAwaiter&) = delete;
+	AssetAwaiter& operator=(const AssetAwaiter&) = delete;
+
+	bool await_ready() {
+		return ready();
+	}
+	void await_suspend(std::experimental::resumable_handle<> _ResumeCb) {
+		suspend(_ResumeCb);
+	}
+	std::shared_ptr<T> await_resume() {
+		return std::static_pointer_cast<T>(result());
+	}
+};
+
+// asynchronous asset loading:
+// - concurrent requests of the same asset are merged
+// - at most maxInFlightLoads are read and decoded at the same time, on worker threads, by decreasing priority
+// - loaded assets are kept in memory while the total size fits in the memory budget; above it, the least recently requested assets
+//   that are not used anymore (only referenced by the manager) are evicted
+// waiting coroutines are resumed on the game loop thread, when update() is called
+class AssetManager
+{
+private:
+	struct Completion;
+	typedef std::pair<std::type_index, AssetId> Key;
+	Microsoft::WRL::ComPtr<ID3D11Device> _device;
+	std::map<Key, std::shared_ptr<details::AssetEntry>> _entries;
+	std::vector<std::shared_ptr<details::AssetEntry>> _queued;
+	std::list<details::AssetEntry*> _lru;
+	std::shared_ptr<Completion> _completion;
+	std::function<std::vector<std::uint8_t>(const AssetId&)> _reader;
+	std::size_t _maxInFlightLoads;
+	std::size_t _inFlightLoads;
+	std::size_t _memoryBudget;
+	std::size_t _memoryUsage;
+	std::uint64_t _requestCounter;
+
+	std::shared_ptr<details::AssetEntry> request(const AssetId& id, std::type_index type, AssetPriority priority,
+		const std::function<std::shared_ptr<void>(ID3D11Device*, std::vector<std::uint8_t>&, std::size_t&)>& decode);
+	void startLoads();
+	void complete(details::AssetEntry& entry);
+	void evict();
+public:
+	// device may be null (headless engine): only CPU-side asset types can be loaded then
+	AssetManager(ID3D11Device* device, std::size_t memoryBudget, std::size_t maxInFlightLoads);
+	~AssetManager();
+	AssetManager(const AssetManager&) = delete;
+	AssetManager& operator=(const AssetManager&) = delete;
+
+	// by default, asset ids are file paths. the reader is called on worker threads
+	void setReader(const std::function<std::vector<std::uint8_t>(const AssetId&)>& reader);
+	void setMemoryBudget(std::size_t memoryBudget);
+	std::size_t memoryUsage() const { return _memoryUsage; }
+
+	// usage: std::shared_ptr<TextureAsset> texture = __await assets.load<TextureAsset>(L"Texture.png", AssetPriority::High);
+	template<typename T>
+	AssetAwaiter<T> load(const AssetId& id, AssetPriority priority = AssetPriority::Normal) {
+		return AssetAwaiter<T>(request(id, std::type_index(typeid(T)), priority,
+			[](ID3D11Device* device, std::vector<std::uint8_t>& data, std::size_t& size) -> std::shared_ptr<void> {
+			auto asset = AssetTraits<T>::decode(device, data);
+			size = AssetTraits<T>::size(*asset);
+			return asset;
+		}));
+	}
+
+	// called once per frame on the game loop thread: resumes the coroutines waiting for completed loads, starts new loads
+	// and evicts assets over the memory budget
+	void update();
+};
+
+// reads a whole file
+std::vector<std::uint8_t> readFileToMemory(const wchar_t* filePath);
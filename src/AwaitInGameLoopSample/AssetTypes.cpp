@@ -0,0 +1,77 @@
+#include "stdafx.h"
+#include "AssetTypes.h"
+#include "dx_exception.h"
+#include "../DirectXTK/Inc/WICTextureLoader.h"
+
+// the device is free threaded: resources are created directly on the loading worker thread
+static ID3D11Device* requireDevice(ID3D11Device* device)
+{
+	if (!device) {
+		throw dx_exception(E_POINTER);
+	}
+	return device;
+}
+
+// WIC needs COM on the calling thread, and the PPL worker threads decoding assets do not initialize it.
+// the initialization is undone before the worker goes back to the pool
+class ComInitializer {
+private:
+	HRESULT _hr;
+public:
+	ComInitializer() : _hr(CoInitializeEx(nullptr, COINIT_MULTITHREADED)) {
+		// a thread already initialized in another apartment can still use WIC
+		if (_hr != RPC_E_CHANGED_MODE) {
+			throwIfFailed(_hr);
+		}
+	}
+	~ComInitializer() {
+		if (SUCCEEDED(_hr)) {
+			CoUninitialize();
+		}
+	}
+	ComInitializer(const ComInitializer&) = delete;
+	ComInitializer& operator=(const ComInitializer&) = delete;
+};
+
+std::shared_ptr<TextureAsset> AssetTraits<TextureAsset>::decode(ID3D11Device * device, std::vector<std::uint8_t>& data)
+{
+	ComInitializer com;
+	auto asset = std::make_shared<TextureAsset>();
+	throwIfFailed(DirectX::CreateWICTextureFromMemory(requireDevice(device), data.data(), data.size(), &asset->texture, &asset->view));
+	asset->byteSize = 0;
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> texture2D;
+	if (SUCCEEDED(asset->texture.As(&texture2D))) {
+		D3D11_TEXTURE2D_DESC desc;
+		texture2D->GetDesc(&desc);
+		// WIC textures are 32 bits per pixel at most
+		asset->byteSize = (std::size_t)desc.Width * desc.Height * 4;
+	}
+	return asset;
+}
+
+std::shared_ptr<VertexShaderAsset> AssetTraits<VertexShaderAsset>::decode(ID3D11Device * device, std::vector<std::uint8_t>& data)
+{
+	auto asset = std::make_shared<VertexShaderAsset>();
+	throwIfFailed(requireDevice(device)->CreateVertexShader(data.data(), data.size(), nullptr, &asset->shader));
+	asset->bytecode = std::move(data);
+	return asset;
+}
+
+std::shared_ptr<PixelShaderAsset> AssetTraits<PixelShaderAsset>::decode(ID3D11Device * device, std::vector<std::uint8_t>& data)
+{
+	auto asset = std::make_shared<PixelShaderAsset>();
+	throwIfFailed(requireDevice(device)->CreatePixelShader(data.data(), data.size(), nullptr, &asset->shader));
+	asset->byteSize = data.size();
+	return asset;
+}
+
+std::shared_ptr<SoundAsset> AssetTraits<SoundAsset>::decode(ID3D11Device *, std::vector<std::uint8_t>& data)
+{
+	// a RIFF/WAVE header is enough for the audio engine to take it from there
+	if (data.size() < 12 || memcmp(data.data(), "RIFF", 4) != 0 || memcmp(data.data() + 8, "WAVE", 4) != 0) {
+		throw std::exception("not a wave file");
+	}
+	auto asset = std::make_shared<SoundAsset>();
+	asset->wavData = std::move(data);
+	return asset;
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include "AssetManager.h"
+
+// texture decoded with WIC (png, jpg, bmp...)
+struct TextureAsset {
+	Microsoft::WRL::ComPtr<ID3D11Resource> texture;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> view;
+	std::size_t byteSize;
+};
+
+// compiled vertex shader. the bytecode is kept to create matching input layouts
+struct VertexShaderAsset {
+	Microsoft::WRL::ComPtr<ID3D11VertexShader> shader;
+	std::vector<std::uint8_t> bytecode;
+};
+
+struct PixelShaderAsset {
+	Microsoft::WRL::ComPtr<ID3D11PixelShader> shader;
+	std::size_t byteSize;
+};
+
+// wave file kept in memory, ready to be handed to an audio engine (does not need a device)
+struct SoundAsset {
+	std::vector<std::uint8_t> wavData;
+};
+
+template<>
+struct AssetTraits<TextureAsset> {
+	static std::shared_ptr<TextureAsset> decode(ID3D11Device* device, std::vector<std::uint8_t>& data);
+	static std::size_t size(const TextureAsset& asset) { return asset.byteSize; }
+};
+
+template<>
+struct AssetTraits<VertexShaderAsset> {
+	static std::shared_ptr<VertexShaderAsset> decode(ID3D11Device* device, std::vector<std::uint8_t>& data);
+	static std::size_t size(const VertexShaderAsset& asset) { return asset.bytecode.size(); }
+};
+
+template<>
+struct AssetTraits<PixelShaderAsset> {
+	static std::shared_ptr<PixelShaderAsset> decode(ID3D11Device* device, std::vector<std::uint8_t>& data);
+	static std::size_t size(const PixelShaderAsset& asset) { return asset.byteSize; }
+};
+
+template<>
+struct AssetTraits<SoundAsset> {
+	static std::shared_ptr<SoundAsset> decode(ID3D11Device* device, std::vector<std::uint8_t>& data);
+	static std::size_t size(const SoundAsset& asset) { return asset.wavData.size(); }
+};
@@ -12,6 +12,7 @@
 #include <chrono>
 #include "GameAwaitablePromise.h"
 #include <pplawait.h>
+#include <shellapi.h>
 
 
 using namespace std::chrono;
@@ -20,7 +21,7 @@ using namespace std::chrono;
 NoPromise gameLogic(Engine* engine) {
 	auto animatedText = std::make_shared<AnimatedText>();
 	engine->addSceneObject(animatedText);
-	std::default_random_engine re((unsigned int)(std::chrono::steady_clock::now().time_since_epoch().count()));
+	std::default_random_engine re((unsigned int)engine->randomSeed());
 	std::uniform_real_distribution<float> dist(0.0f, 0.7f);
 	while (true) {
 		__await animatedText->fadeIn();
@@ -38,6 +39,28 @@ NoPromise gameLogic(Engine* engine) {
 
 #define MAX_LOADSTRING 100
 
+// command line: [-record <log file> | -replay <log file>]
+// a replay runs headless (no window, no device) as fast as possible, and exits at the end of the log
+SessionOptions parseSessionOptions()
+{
+	SessionOptions options;
+	int argc;
+	LPWSTR* argv = CommandLineToArgvW(GetCommandLineW(), &argc);
+	if (!argv) {
+		return options;
+	}
+	for (int i = 1; i + 1 < argc; ++i) {
+		if (wcscmp(argv[i], L"-record") == 0) {
+			options = SessionOptions(SessionMode::Record, argv[++i]);
+		}
+		else if (wcscmp(argv[i], L"-replay") == 0) {
+			options = SessionOptions(SessionMode::Replay, argv[++i]);
+		}
+	}
+	LocalFree(argv);
+	return options;
+}
+
 // Global Variables:
 HINSTANCE hInst;								// current instance
 
@@ -59,6 +82,17 @@ int APIENTRY _tWinMain(_In_ HINSTANCE hInstance,
 	MSG msg;
 	HACCEL hAccelTable;
 
+	SessionOptions session = parseSessionOptions();
+	if (session.mode == SessionMode::Replay) {
+		Engine engine(nullptr, [](Engine* e) {
+			gameLogic(e);
+		}, session);
+		while (!engine.replayFinished()) {
+			engine.run();
+		}
+		return 0;
+	}
+
 	MyRegisterClass(hInstance);
 
 	HWND window = InitInstance(hInstance, nCmdShow);
@@ -71,7 +105,8 @@ int APIENTRY _tWinMain(_In_ HINSTANCE hInstance,
 	// instanciation of the engine (and registering the gameLogic function as the startup callback)
 	Engine engine(window, [](Engine* e) {
 		gameLogic(e);
-	});
+	}, session);
+	GamePadInputSource gamePad;
 	// Main message loop (if there is a message to process, process it, else, make the engine run):
 	while (true) {
 		if (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE))
@@ -79,15 +114,17 @@ int APIENTRY _tWinMain(_In_ HINSTANCE hInstance,
 			TranslateMessage(&msg);
 			DispatchMessage(&msg);
 
+			InputEvent inputEvent;
 			if (msg.message == WM_QUIT) {
 				break;
 			}
-			else if (msg.message == WM_LBUTTONDOWN) {
-				engine.onClick();
+			else if (translateWindowMessage(msg, inputEvent)) {
+				engine.input().push(inputEvent);
 			}
 		}
 		else {
 			// game loop
+			gamePad.poll(engine.input());
 			engine.run();
 		}
 	}
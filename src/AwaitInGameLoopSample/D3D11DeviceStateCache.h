@@ -0,0 +1,29 @@
+#pragma once
+#include <d3d11_2.h>
+#include <cstring>
+#include "DeviceStateCache.h"
+#include "dx_exception.h"
+
+// Direct3D 11 types used by the state cache and the draw command lists
+struct D3D11StateTypes {
+	typedef ID3D11DeviceContext Context;
+	typedef ID3D11Buffer Buffer;
+	typedef ID3D11InputLayout InputLayout;
+	typedef ID3D11VertexShader VertexShader;
+	typedef ID3D11PixelShader PixelShader;
+	typedef ID3D11ShaderResourceView ShaderResourceView;
+	typedef ID3D11RenderTargetView RenderTargetView;
+	typedef ID3D11DepthStencilView DepthStencilView;
+	typedef ID3D11BlendState BlendState;
+	typedef ID3D11DepthStencilState DepthStencilState;
+	typedef D3D11_PRIMITIVE_TOPOLOGY PrimitiveTopology;
+
+	static void writeDiscard(ID3D11DeviceContext* context, ID3D11Buffer* buffer, const void* data, size_t size) {
+		D3D11_MAPPED_SUBRESOURCE mapped;
+		throwIfFailed(context->Map(buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped));
+		std::memcpy(mapped.pData, data, size);
+		context->Unmap(buffer, 0);
+	}
+};
+
+typedef BasicDeviceStateCache<D3D11StateTypes> DeviceStateCache;
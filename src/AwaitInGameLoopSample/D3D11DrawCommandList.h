@@ -0,0 +1,6 @@
+#pragma once
+#include "D3D11DeviceStateCache.h"
+#include "DrawCommandList.h"
+
+typedef BasicDrawCommandRecorder<D3D11StateTypes> DrawCommandRecorder;
+typedef BasicDrawCommandQueue<D3D11StateTypes> DrawCommandQueue;
@@ -0,0 +1,318 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+
+// per-frame counters of the state cache
+struct DeviceStateCacheStats {
+	std::uint32_t requestedBinds;
+	std::uint32_t issuedCalls;
+	std::uint32_t drawCalls;
+	DeviceStateCacheStats() : requestedBinds(0), issuedCalls(0), drawCalls(0) {}
+	// number of requested binds that did not reach the device context
+	std::uint32_t elidedBinds() const { return requestedBinds > issuedCalls ? requestedBinds - issuedCalls : 0; }
+};
+
+// redundant state filtering layer in front of a device context.
+// set* calls only record the requested state; the actual binds are issued lazily when a draw is submitted,
+// skipping any state that is already bound and merging contiguous dirty slots into a single call.
+// TApi only provides the types (see D3D11DeviceStateCache.h), so the filtering logic can be exercised against a mock context.
+template<typename TApi>
+class BasicDeviceStateCache {
+public:
+	typedef typename TApi::Context Context;
+	typedef typename TApi::Buffer Buffer;
+	typedef typename TApi::InputLayout InputLayout;
+	typedef typename TApi::VertexShader VertexShader;
+	typedef typename TApi::PixelShader PixelShader;
+	typedef typename TApi::ShaderResourceView ShaderResourceView;
+	typedef typename TApi::RenderTargetView RenderTargetView;
+	typedef typename TApi::DepthStencilView DepthStencilView;
+	typedef typename TApi::BlendState BlendState;
+	typedef typename TApi::DepthStencilState DepthStencilState;
+	typedef typename TApi::PrimitiveTopology PrimitiveTopology;
+
+	static const unsigned MaxVertexBuffers = 4;
+	static const unsigned MaxConstantBuffers = 4;
+	static const unsigned MaxShaderResources = 8;
+
+private:
+	enum DirtyFlags : std::uint32_t {
+		Dirty_RenderTarget = 1 << 0,
+		Dirty_InputLayout = 1 << 1,
+		Dirty_Topology = 1 << 2,
+		Dirty_VertexShader = 1 << 3,
+		Dirty_PixelShader = 1 << 4,
+		Dirty_BlendState = 1 << 5,
+		Dirty_DepthStencilState = 1 << 6,
+		Dirty_All = 0x7f
+	};
+
+	// a bank of slots (constant buffers, shader resources...) with a dirty bit per slot
+	template<typename T, unsigned N>
+	struct SlotBank {
+		T pending[N];
+		T bound[N];
+		std::uint32_t dirtyMask;
+		std::uint32_t unknownMask;
+		SlotBank() : dirtyMask(0), unknownMask((1u << N) - 1) {
+			for (unsigned i = 0; i < N; ++i) {
+				pending[i] = bound[i] = nullptr;
+			}
+		}
+		bool set(unsigned slot, T value) {
+			pending[slot] = value;
+			std::uint32_t bit = 1u << slot;
+			if (value != bound[slot] || (unknownMask & bit)) {
+				dirtyMask |= bit;
+				return true;
+			}
+			dirtyMask &= ~bit;
+			return false;
+		}
+		// calls emit(first, count) for each run of contiguous dirty slots
+		template<typename TEmit>
+		void flush(TEmit emit) {
+			std::uint32_t mask = dirtyMask;
+			unsigned slot = 0;
+			while (mask) {
+				while (!(mask & 1)) {
+					mask >>= 1;
+					++slot;
+				}
+				unsigned first = slot;
+				while (mask & 1) {
+					bound[slot] = pending[slot];
+					mask >>= 1;
+					++slot;
+				}
+				emit(first, slot - first);
+			}
+			unknownMask &= ~dirtyMask;
+			dirtyMask = 0;
+		}
+		void invalidate() {
+			unknownMask = (1u << N) - 1;
+			dirtyMask = 0;
+			for (unsigned i = 0; i < N; ++i) {
+				if (pending[i]) {
+					dirtyMask |= 1u << i;
+				}
+			}
+		}
+	};
+
+	struct State {
+		RenderTargetView* rtv;
+		DepthStencilView* dsv;
+		InputLayout* inputLayout;
+		PrimitiveTopology topology;
+		VertexShader* vertexShader;
+		PixelShader* pixelShader;
+		BlendState* blendState;
+		float blendFactor[4];
+		unsigned sampleMask;
+		DepthStencilState* depthStencilState;
+		unsigned stencilRef;
+		State() : rtv(nullptr), dsv(nullptr), inputLayout(nullptr), topology(), vertexShader(nullptr), pixelShader(nullptr),
+			blendState(nullptr), sampleMask(0xffffffff), depthStencilState(nullptr), stencilRef(0) {
+			blendFactor[0] = blendFactor[1] = blendFactor[2] = blendFactor[3] = 1.0f;
+		}
+	};
+
+	Context* _ctx;
+	State _pending;
+	State _bound;
+	std::uint32_t _dirty;
+	std::uint32_t _unknown;
+	SlotBank<Buffer*, MaxVertexBuffers> _vertexBuffers;
+	unsigned _vbStrides[MaxVertexBuffers];
+	unsigned _vbOffsets[MaxVertexBuffers];
+	unsigned _boundVbStrides[MaxVertexBuffers];
+	unsigned _boundVbOffsets[MaxVertexBuffers];
+	SlotBank<Buffer*, MaxConstantBuffers> _vsConstants;
+	SlotBank<Buffer*, MaxConstantBuffers> _psConstants;
+	SlotBank<ShaderResourceView*, MaxShaderResources> _psResources;
+	DeviceStateCacheStats _current;
+	DeviceStateCacheStats _lastFrame;
+
+	template<typename T>
+	void setState(T& pending, const T& bound, T value, std::uint32_t flag) {
+		++_current.requestedBinds;
+		pending = value;
+		if (value != bound || (_unknown & flag)) {
+			_dirty |= flag;
+		}
+		else {
+			_dirty &= ~flag;
+		}
+	}
+public:
+	explicit BasicDeviceStateCache(Context* ctx) : _ctx(ctx), _dirty(0), _unknown(Dirty_All) {
+		for (unsigned i = 0; i < MaxVertexBuffers; ++i) {
+			_vbStrides[i] = _vbOffsets[i] = _boundVbStrides[i] = _boundVbOffsets[i] = 0;
+		}
+	}
+	BasicDeviceStateCache(const BasicDeviceStateCache&) = delete;
+	BasicDeviceStateCache& operator=(const BasicDeviceStateCache&) = delete;
+
+	// raw context, for calls that do not touch the pipeline bindings (Map/Unmap, Clear...)
+	Context* context() const { return _ctx; }
+
+	void setRenderTarget(RenderTargetView* rtv, DepthStencilView* dsv) {
+		++_current.requestedBinds;
+		_pending.rtv = rtv;
+		_pending.dsv = dsv;
+		if (rtv != _bound.rtv || dsv != _bound.dsv || (_unknown & Dirty_RenderTarget)) {
+			_dirty |= Dirty_RenderTarget;
+		}
+		else {
+			_dirty &= ~Dirty_RenderTarget;
+		}
+	}
+	void setInputLayout(InputLayout* layout) {
+		setState(_pending.inputLayout, _bound.inputLayout, layout, Dirty_InputLayout);
+	}
+	void setPrimitiveTopology(PrimitiveTopology topology) {
+		setState(_pending.topology, _bound.topology, topology, Dirty_Topology);
+	}
+	void setVertexShader(VertexShader* shader) {
+		setState(_pending.vertexShader, _bound.vertexShader, shader, Dirty_VertexShader);
+	}
+	void setPixelShader(PixelShader* shader) {
+		setState(_pending.pixelShader, _bound.pixelShader, shader, Dirty_PixelShader);
+	}
+	void setBlendState(BlendState* state, const float* blendFactor = nullptr, unsigned sampleMask = 0xffffffff) {
+		++_current.requestedBinds;
+		static const float defaultFactor[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+		const float* factor = blendFactor ? blendFactor : defaultFactor;
+		_pending.blendState = state;
+		std::memcpy(_pending.blendFactor, factor, sizeof(_pending.blendFactor));
+		_pending.sampleMask = sampleMask;
+		if (state != _bound.blendState || sampleMask != _bound.sampleMask
+			|| std::memcmp(_pending.blendFactor, _bound.blendFactor, sizeof(_pending.blendFactor)) != 0
+			|| (_unknown & Dirty_BlendState)) {
+			_dirty |= Dirty_BlendState;
+		}
+		else {
+			_dirty &= ~Dirty_BlendState;
+		}
+	}
+	void setDepthStencilState(DepthStencilState* state, unsigned stencilRef) {
+		++_current.requestedBinds;
+		_pending.depthStencilState = state;
+		_pending.stencilRef = stencilRef;
+		if (state != _bound.depthStencilState || stencilRef != _bound.stencilRef || (_unknown & Dirty_DepthStencilState)) {
+			_dirty |= Dirty_DepthStencilState;
+		}
+		else {
+			_dirty &= ~Dirty_DepthStencilState;
+		}
+	}
+	void setVertexBuffer(unsigned slot, Buffer* buffer, unsigned stride, unsigned offset) {
+		++_current.requestedBinds;
+		_vbStrides[slot] = stride;
+		_vbOffsets[slot] = offset;
+		if (!_vertexBuffers.set(slot, buffer) && (stride != _boundVbStrides[slot] || offset != _boundVbOffsets[slot])) {
+			_vertexBuffers.dirtyMask |= 1u << slot;
+		}
+	}
+	void setVSConstantBuffer(unsigned slot, Buffer* buffer) {
+		++_current.requestedBinds;
+		_vsConstants.set(slot, buffer);
+	}
+	void setPSConstantBuffer(unsigned slot, Buffer* buffer) {
+		++_current.requestedBinds;
+		_psConstants.set(slot, buffer);
+	}
+	void setPSShaderResource(unsigned slot, ShaderResourceView* srv) {
+		++_current.requestedBinds;
+		_psResources.set(slot, srv);
+	}
+
+	// issues the pending binds that actually change the pipeline state
+	void flush() {
+		if (_dirty & Dirty_RenderTarget) {
+			_ctx->OMSetRenderTargets(1, &_pending.rtv, _pending.dsv);
+			++_current.issuedCalls;
+		}
+		if (_dirty & Dirty_InputLayout) {
+			_ctx->IASetInputLayout(_pending.inputLayout);
+			++_current.issuedCalls;
+		}
+		if (_dirty & Dirty_Topology) {
+			_ctx->IASetPrimitiveTopology(_pending.topology);
+			++_current.issuedCalls;
+		}
+		if (_vertexBuffers.dirtyMask) {
+			_vertexBuffers.flush([this](unsigned first, unsigned count) {
+				_ctx->IASetVertexBuffers(first, count, &_vertexBuffers.pending[first], &_vbStrides[first], &_vbOffsets[first]);
+				for (unsigned i = first; i < first + count; ++i) {
+					_boundVbStrides[i] = _vbStrides[i];
+					_boundVbOffsets[i] = _vbOffsets[i];
+				}
+				++_current.issuedCalls;
+			});
+		}
+		if (_dirty & Dirty_VertexShader) {
+			_ctx->VSSetShader(_pending.vertexShader, nullptr, 0);
+			++_current.issuedCalls;
+		}
+		if (_vsConstants.dirtyMask) {
+			_vsConstants.flush([this](unsigned first, unsigned count) {
+				_ctx->VSSetConstantBuffers(first, count, &_vsConstants.pending[first]);
+				++_current.issuedCalls;
+			});
+		}
+		if (_dirty & Dirty_PixelShader) {
+			_ctx->PSSetShader(_pending.pixelShader, nullptr, 0);
+			++_current.issuedCalls;
+		}
+		if (_psConstants.dirtyMask) {
+			_psConstants.flush([this](unsigned first, unsigned count) {
+				_ctx->PSSetConstantBuffers(first, count, &_psConstants.pending[first]);
+				++_current.issuedCalls;
+			});
+		}
+		if (_psResources.dirtyMask) {
+			_psResources.flush([this](unsigned first, unsigned count) {
+				_ctx->PSSetShaderResources(first, count, &_psResources.pending[first]);
+				++_current.issuedCalls;
+			});
+		}
+		if (_dirty & Dirty_BlendState) {
+			_ctx->OMSetBlendState(_pending.blendState, _pending.blendFactor, _pending.sampleMask);
+			++_current.issuedCalls;
+		}
+		if (_dirty & Dirty_DepthStencilState) {
+			_ctx->OMSetDepthStencilState(_pending.depthStencilState, _pending.stencilRef);
+			++_current.issuedCalls;
+		}
+		_unknown &= ~_dirty;
+		_dirty = 0;
+		_bound = _pending;
+	}
+
+	void draw(unsigned vertexCount, unsigned startVertex) {
+		flush();
+		_ctx->Draw(vertexCount, startVertex);
+		++_current.drawCalls;
+	}
+
+	// must be called when something else (DirectXTK helpers, ClearState...) changed the context bindings behind our back
+	void invalidate() {
+		_unknown = Dirty_All;
+		_dirty = Dirty_All;
+		_vertexBuffers.invalidate();
+		_vsConstants.invalidate();
+		_psConstants.invalidate();
+		_psResources.invalidate();
+	}
+
+	// starts a new frame of statistics
+	void beginFrame() {
+		_lastFrame = _current;
+		_current = DeviceStateCacheStats();
+	}
+	const DeviceStateCacheStats& lastFrameStats() const { return _lastFrame; }
+	const DeviceStateCacheStats& currentFrameStats() const { return _current; }
+};
@@ -0,0 +1,261 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include "DeviceStateCache.h"
+
+// recorded draw commands.
+// scene objects do not talk to the device context directly: they record their draws into a recorder
+// (one per worker thread), and the recorded packets are replayed on the immediate context in a stable order.
+// like the state cache, everything is templated on the API types so that it can run against a null backend
+// (TApi must additionally provide a static writeDiscard(Context*, Buffer*, const void* data, size_t size)).
+enum class DrawCommandType : std::uint8_t {
+	SetVertexBuffer,
+	SetInputLayout,
+	SetPrimitiveTopology,
+	SetVertexShader,
+	SetVSConstantBuffer,
+	SetPixelShader,
+	SetPSConstantBuffer,
+	SetPSShaderResource,
+	SetBlendState,
+	SetDepthStencilState,
+	UpdateBuffer,
+	Draw
+};
+
+template<typename TApi>
+struct BasicDrawCommand {
+	DrawCommandType type;
+	union {
+		typename TApi::Buffer* buffer;
+		typename TApi::InputLayout* inputLayout;
+		typename TApi::VertexShader* vertexShader;
+		typename TApi::PixelShader* pixelShader;
+		typename TApi::ShaderResourceView* shaderResource;
+		typename TApi::BlendState* blendState;
+		typename TApi::DepthStencilState* depthStencilState;
+	};
+	typename TApi::PrimitiveTopology topology;
+	// meaning depends on the command: slot / stride / offset, stencil ref, payload offset / size, vertex count / start
+	std::uint32_t args[3];
+};
+
+// a packet groups the commands of one draw; packets are the unit of sorting
+struct DrawPacket {
+	std::uint64_t sortKey;
+	std::uint32_t source;
+	std::uint32_t sequence;
+	std::uint32_t firstCommand;
+	std::uint32_t commandCount;
+};
+
+template<typename TApi>
+class BasicDrawCommandRecorder {
+public:
+	typedef BasicDrawCommand<TApi> Command;
+private:
+	std::vector<Command> _commands;
+	std::vector<std::uint8_t> _payload;
+	std::vector<DrawPacket> _packets;
+	std::uint32_t _source;
+	std::uint32_t _sequence;
+
+	Command& push(DrawCommandType type) {
+		// commands recorded without a beginPacket() get a packet of their own, so that replay does not drop them
+		if (_packets.empty()) {
+			beginPacket();
+		}
+		_commands.emplace_back();
+		Command& cmd = _commands.back();
+		std::memset(&cmd, 0, sizeof(cmd));
+		cmd.type = type;
+		++_packets.back().commandCount;
+		return cmd;
+	}
+public:
+	BasicDrawCommandRecorder() : _source(0), _sequence(0) {}
+
+	// buffers are kept between frames so that steady-state recording does not allocate
+	void reset() {
+		_commands.clear();
+		_payload.clear();
+		_packets.clear();
+	}
+
+	// the recorded packets coming from the same source (a scene object) keep their recording order
+	void setSource(std::uint32_t source) {
+		_source = source;
+		_sequence = 0;
+	}
+
+	// starts a new draw packet. packets are replayed by increasing sort key, then by source and recording order
+	void beginPacket(std::uint64_t sortKey = 0) {
+		DrawPacket packet;
+		packet.sortKey = sortKey;
+		packet.source = _source;
+		packet.sequence = _sequence++;
+		packet.firstCommand = (std::uint32_t)_commands.size();
+		packet.commandCount = 0;
+		_packets.push_back(packet);
+	}
+
+	void setVertexBuffer(unsigned slot, typename TApi::Buffer* buffer, unsigned stride, unsigned offset) {
+		auto& cmd = push(DrawCommandType::SetVertexBuffer);
+		cmd.buffer = buffer;
+		cmd.args[0] = slot;
+		cmd.args[1] = stride;
+		cmd.args[2] = offset;
+	}
+	void setInputLayout(typename TApi::InputLayout* layout) {
+		push(DrawCommandType::SetInputLayout).inputLayout = layout;
+	}
+	void setPrimitiveTopology(typename TApi::PrimitiveTopology topology) {
+		push(DrawCommandType::SetPrimitiveTopology).topology = topology;
+	}
+	void setVertexShader(typename TApi::VertexShader* shader) {
+		push(DrawCommandType::SetVertexShader).vertexShader = shader;
+	}
+	void setVSConstantBuffer(unsigned slot, typename TApi::Buffer* buffer) {
+		auto& cmd = push(DrawCommandType::SetVSConstantBuffer);
+		cmd.buffer = buffer;
+		cmd.args[0] = slot;
+	}
+	void setPixelShader(typename TApi::PixelShader* shader) {
+		push(DrawCommandType::SetPixelShader).pixelShader = shader;
+	}
+	void setPSConstantBuffer(unsigned slot, typename TApi::Buffer* buffer) {
+		auto& cmd = push(DrawCommandType::SetPSConstantBuffer);
+		cmd.buffer = buffer;
+		cmd.args[0] = slot;
+	}
+	void setPSShaderResource(unsigned slot, typename TApi::ShaderResourceView* srv) {
+		auto& cmd = push(DrawCommandType::SetPSShaderResource);
+		cmd.shaderResource = srv;
+		cmd.args[0] = slot;
+	}
+	void setBlendState(typename TApi::BlendState* state, unsigned sampleMask = 0xffffffff) {
+		auto& cmd = push(DrawCommandType::SetBlendState);
+		cmd.blendState = state;
+		cmd.args[0] = sampleMask;
+	}
+	void setDepthStencilState(typename TApi::DepthStencilState* state, unsigned stencilRef) {
+		auto& cmd = push(DrawCommandType::SetDepthStencilState);
+		cmd.depthStencilState = state;
+		cmd.args[0] = stencilRef;
+	}
+	// dynamic buffer update (map with discard on replay). the data is copied into the recorder
+	void updateBuffer(typename TApi::Buffer* buffer, const void* data, std::uint32_t size) {
+		auto offset = (std::uint32_t)_payload.size();
+		_payload.resize(offset + size);
+		std::memcpy(_payload.data() + offset, data, size);
+		auto& cmd = push(DrawCommandType::UpdateBuffer);
+		cmd.buffer = buffer;
+		cmd.args[0] = offset;
+		cmd.args[1] = size;
+	}
+	void draw(unsigned vertexCount, unsigned startVertex) {
+		auto& cmd = push(DrawCommandType::Draw);
+		cmd.args[0] = vertexCount;
+		cmd.args[1] = startVertex;
+	}
+
+	const std::vector<Command>& commands() const { return _commands; }
+	const std::vector<std::uint8_t>& payload() const { return _payload; }
+	const std::vector<DrawPacket>& packets() const { return _packets; }
+};
+
+// gathers the packets of several recorders and replays them in a stable order
+template<typename TApi>
+class BasicDrawCommandQueue {
+public:
+	typedef BasicDrawCommandRecorder<TApi> Recorder;
+private:
+	struct Entry {
+		DrawPacket packet;
+		const Recorder* recorder;
+	};
+	std::vector<Entry> _entries;
+public:
+	void clear() {
+		_entries.clear();
+	}
+
+	void submit(const Recorder& recorder) {
+		for (auto& packet : recorder.packets()) {
+			_entries.push_back(Entry{ packet, &recorder });
+		}
+	}
+
+	// the order only depends on what was recorded, not on which thread recorded it
+	void sort() {
+		std::sort(_entries.begin(), _entries.end(), [](const Entry& l, const Entry& r) {
+			if (l.packet.sortKey != r.packet.sortKey) {
+				return l.packet.sortKey < r.packet.sortKey;
+			}
+			if (l.packet.source != r.packet.source) {
+				return l.packet.source < r.packet.source;
+			}
+			return l.packet.sequence < r.packet.sequence;
+		});
+	}
+
+	// calls visitor(packet) in replay order
+	template<typename TVisitor>
+	void forEachPacket(TVisitor visitor) const {
+		for (auto& entry : _entries) {
+			visitor(entry.packet);
+		}
+	}
+
+	void replay(BasicDeviceStateCache<TApi>& state) const {
+		for (auto& entry : _entries) {
+			auto& commands = entry.recorder->commands();
+			auto payload = entry.recorder->payload().data();
+			for (std::uint32_t i = 0; i < entry.packet.commandCount; ++i) {
+				auto& cmd = commands[entry.packet.firstCommand + i];
+				switch (cmd.type) {
+				case DrawCommandType::SetVertexBuffer:
+					state.setVertexBuffer(cmd.args[0], cmd.buffer, cmd.args[1], cmd.args[2]);
+					break;
+				case DrawCommandType::SetInputLayout:
+					state.setInputLayout(cmd.inputLayout);
+					break;
+				case DrawCommandType::SetPrimitiveTopology:
+					state.setPrimitiveTopology(cmd.topology);
+					break;
+				case DrawCommandType::SetVertexShader:
+					state.setVertexShader(cmd.vertexShader);
+					break;
+				case DrawCommandType::SetVSConstantBuffer:
+					state.setVSConstantBuffer(cmd.args[0], cmd.buffer);
+					break;
+				case DrawCommandType::SetPixelShader:
+					state.setPixelShader(cmd.pixelShader);
+					break;
+				case DrawCommandType::SetPSConstantBuffer:
+					state.setPSConstantBuffer(cmd.args[0], cmd.buffer);
+					break;
+				case DrawCommandType::SetPSShaderResource:
+					state.setPSShaderResource(cmd.args[0], cmd.shaderResource);
+					break;
+				case DrawCommandType::SetBlendState:
+					state.setBlendState(cmd.blendState, nullptr, cmd.args[0]);
+					break;
+				case DrawCommandType::SetDepthStencilState:
+					state.setDepthStencilState(cmd.depthStencilState, cmd.args[0]);
+					break;
+				case DrawCommandType::UpdateBuffer:
+					TApi::writeDiscard(state.context(), cmd.buffer, payload + cmd.args[0], cmd.args[1]);
+					break;
+				case DrawCommandType::Draw:
+					state.draw(cmd.args[0], cmd.args[1]);
+					break;
+				}
+			}
+		}
+	}
+
+	std::size_t packetCount() const { return _entries.size(); }
+};
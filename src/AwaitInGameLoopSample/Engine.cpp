@@ -6,13 +6,28 @@
 #include <DirectXColors.h>
 #include <vector>
 #include <list>
+#include <thread>
+#include <ppl.h>
 #include "Timer.h"
 #include "AnimatedText.h"
 #include "dx_exception.h"
+#include "D3D11DrawCommandList.h"
+#include "FramePacer.h"
+#include "SessionLog.h"
+#include "FrameBudget.h"
+#include "AssetTypes.h"
 using namespace std;
 using namespace std::chrono;
 using namespace Microsoft::WRL;
 
+// default CPU time per frame for coroutines calling yieldIfOverBudget
+static const steady_clock::duration DefaultFrameBudget = duration_cast<steady_clock::duration>(4ms);
+static const size_t DefaultAssetMemoryBudget = 256 * 1024 * 1024;
+static const size_t MaxInFlightAssetLoads = 4;
+
+// below this number of objects per recording task, scene draws are recorded on the render thread
+static const size_t MinObjectsPerRecordingTask = 32;
+
 
 
 
@@ -24,14 +39,27 @@ private:
 	ComPtr<ID3D11DeviceContext> _ctx;
 	ComPtr<IDXGISwapChain> _swapchain;
 	ComPtr<ID3D11RenderTargetView> _rtv;
+	unique_ptr<DeviceStateCache> _deviceState;
+	// one command recorder per recording task, reused from frame to frame
+	vector<unique_ptr<DrawCommandRecorder>> _recorders;
+	DrawCommandQueue _drawQueue;
 	D3D_FEATURE_LEVEL _featureLevel;
 	GameClock _clock;
+	FramePacer _pacer;
 	DirectX::XMFLOAT4 _bgColor;
 	list<Timer> _activeTimers;
-	list<GameAwaitableUniquePromise<void>> _clickAwaiters;
+	InputSystem _input;
+	FrameBudget _frameBudget;
+	unique_ptr<AssetManager> _assets;
 	vector<shared_ptr<SceneObject>> _sceneObjects;
-public:
-	impl(HWND hwnd) : _hwnd(hwnd), _bgColor(.0f, .0f, .0f, 1.0f) {
+	uint64_t _randomSeed;
+	unique_ptr<SessionLogWriter> _sessionWriter;
+	unique_ptr<SessionLogReader> _sessionReader;
+	vector<InputEvent> _frameEvents;
+	vector<uint32_t> _frameYields;
+	bool _replayFinished;
+
+	void createDeviceResources(HWND hwnd) {
 		D3D_FEATURE_LEVEL featureLevels[] = {
 			D3D_FEATURE_LEVEL_11_1,
 			D3D_FEATURE_LEVEL_11_0,
@@ -82,9 +110,40 @@ public:
 		throwIfFailed(_swapchain->GetBuffer(0, __uuidof(ID3D11Texture2D), &buffer));
 		throwIfFailed(_device->CreateRenderTargetView(buffer.Get(), nullptr, &_rtv));
 
-		_ctx->OMSetRenderTargets(1, _rtv.GetAddressOf(), nullptr);
+		_deviceState = make_unique<DeviceStateCache>(_ctx.Get());
+		unsigned recorderCount = thread::hardware_concurrency();
+		if (recorderCount == 0) {
+			recorderCount = 1;
+		}
+		for (unsigned i = 0; i < recorderCount; ++i) {
+			_recorders.push_back(make_unique<DrawCommandRecorder>());
+		}
 		_ctx->RSSetViewports(1, &CD3D11_VIEWPORT(.0, .0, (float)(windowRect.right - windowRect.left), (float)(windowRect.bottom - windowRect.top)));
 	}
+public:
+	// a null hwnd creates a headless engine (no device): scene objects are updated but not drawn
+	impl(HWND hwnd, const SessionOptions& session) : _hwnd(hwnd), _bgColor(.0f, .0f, .0f, 1.0f), _frameBudget(DefaultFrameBudget), _replayFinished(false) {
+		if (hwnd) {
+			createDeviceResources(hwnd);
+		}
+		_assets = make_unique<AssetManager>(_device.Get(), DefaultAssetMemoryBudget, MaxInFlightAssetLoads);
+		switch (session.mode) {
+		case SessionMode::Replay:
+			_sessionReader = make_unique<SessionLogReader>(session.logPath);
+			_randomSeed = _sessionReader->randomSeed();
+			break;
+		case SessionMode::Record:
+			_randomSeed = (uint64_t)steady_clock::now().time_since_epoch().count();
+			_sessionWriter = make_unique<SessionLogWriter>(session.logPath, _randomSeed);
+			_input.setObserver([this](const InputEvent& e) {
+				_frameEvents.push_back(e);
+			});
+			break;
+		default:
+			_randomSeed = (uint64_t)steady_clock::now().time_since_epoch().count();
+			break;
+		}
+	}
 	void changeBackground(const DirectX::XMFLOAT4 & color) {
 		_bgColor = color;
 	}
@@ -92,8 +151,40 @@ public:
 		_activeTimers.emplace_front(_clock.currentFrameTime() + duration);
 		return &_activeTimers.begin()->getPromise();
 	}
-	void run() {
-		_clock.onBeginNewFrame();
+	// scene objects are split in contiguous ranges, each range being recorded by its own recorder (in parallel for large scenes)
+	void recordScene() {
+		size_t objectCount = _sceneObjects.size();
+		size_t taskCount = objectCount / MinObjectsPerRecordingTask;
+		if (taskCount > _recorders.size()) {
+			taskCount = _recorders.size();
+		}
+		if (taskCount == 0) {
+			taskCount = 1;
+		}
+		auto recordRange = [this, objectCount, taskCount](size_t task) {
+			auto& recorder = *_recorders[task];
+			recorder.reset();
+			size_t begin = objectCount * task / taskCount;
+			size_t end = objectCount * (task + 1) / taskCount;
+			for (size_t i = begin; i < end; ++i) {
+				recorder.setSource((uint32_t)i);
+				_sceneObjects[i]->draw(recorder);
+			}
+		};
+		if (taskCount == 1) {
+			recordRange(0);
+		}
+		else {
+			concurrency::parallel_for(size_t(0), taskCount, recordRange);
+		}
+		_drawQueue.clear();
+		for (size_t task = 0; task < taskCount; ++task) {
+			_drawQueue.submit(*_recorders[task]);
+		}
+		_drawQueue.sort();
+	}
+	void updateFrame() {
+		_assets->update();
 		for (auto it = _activeTimers.begin(); it != _activeTimers.end(); ) {
 			auto next = it;
 			++next;
@@ -106,37 +197,88 @@ public:
 		for (auto& obj : _sceneObjects) {
 			obj->updateState(_clock);
 		}
+	}
+	void renderFrame() {
+		recordScene();
+		_deviceState->beginFrame();
 		_ctx->ClearRenderTargetView(_rtv.Get(), (float*)&_bgColor);
-		_ctx->OMSetRenderTargets(1, _rtv.GetAddressOf(), nullptr);
-		UINT vpCount = 1;
-		D3D11_VIEWPORT vp;
-		_ctx->RSGetViewports(&vpCount, &vp);
-		//_ctx->RSSetViewports(1, &CD3D11_VIEWPORT(.0, .0, (float)(windowRect.right - windowRect.left), (float)(windowRect.bottom - windowRect.top)));
-		for (auto& obj : _sceneObjects) {
-			obj->draw(_ctx.Get(), _rtv.Get());
+		_deviceState->setRenderTarget(_rtv.Get(), nullptr);
+		_drawQueue.replay(*_deviceState);
+		_pacer.onFramePresented(_swapchain->Present(_pacer.presentSyncInterval(), 0));
+	}
+	// replayed frames run back to back: the frame times come from the log, not from the wall clock
+	void runReplayFrame() {
+		steady_clock::duration frameTime;
+		if (!_sessionReader->readFrame(frameTime, _frameEvents, _frameYields, _clock.startTime())) {
+			_replayFinished = true;
+			return;
+		}
+		_clock.onBeginNewFrame(_clock.startTime() + frameTime);
+		// which checkpoints yield comes from the log. the usage telemetry is still CPU time, measured on the wall clock
+		_frameBudget.beginReplayedFrame(steady_clock::now(), _frameYields);
+		for (auto& e : _frameEvents) {
+			_input.dispatch(e);
+		}
+		updateFrame();
+		if (_device) {
+			renderFrame();
 		}
-		_swapchain->Present(0, 0);
 	}
-	void onClick() {
-		
-		std::list<GameAwaitableUniquePromise<void>> toResume(std::move(_clickAwaiters));
-		_clickAwaiters.clear();
-		for (auto& i : toResume) {
-			i.setResult();
+	void run() {
+		if (_sessionReader) {
+			runReplayFrame();
+			return;
+		}
+		if (!_pacer.waitForNextFrame()) {
+			// let the message loop dispatch pending input first
+			return;
+		}
+		_clock.onBeginNewFrame();
+		_pacer.onFrameStarted(_clock.lastFrameDuration());
+		// the budget starts before input dispatch, so that coroutines resumed by input reach their checkpoints in this frame
+		_frameBudget.beginFrame(_clock.currentFrameTime());
+		_input.dispatch();
+		updateFrame();
+		if (_device) {
+			renderFrame();
+		}
+		// the frame is logged once it is over, with the checkpoints that yielded during it
+		if (_sessionWriter) {
+			_sessionWriter->writeFrame(_clock.currentFrameTime() - _clock.startTime(), _frameEvents, _frameBudget.yieldingCheckpoints(), _clock.startTime());
+			_frameEvents.clear();
 		}
 	}
+	bool replayFinished() const {
+		return _replayFinished;
+	}
+	uint64_t randomSeed() const {
+		return _randomSeed;
+	}
+	InputSystem& input() {
+		return _input;
+	}
 	const GameClock& getClock() const {
 		return _clock;
 	}
-
-
-	GameAwaitableUniquePromise<void>* waitForMouseClick() {
-		_clickAwaiters.emplace_front();
-		return &_clickAwaiters.front();
+	AssetManager& assets() {
+		return *_assets;
+	}
+	FrameBudget& frameBudget() {
+		return _frameBudget;
+	}
+	FramePacer& pacer() {
+		return _pacer;
 	}
+	const DeviceStateCacheStats& renderStateStats() const {
+		static const DeviceStateCacheStats headlessStats;
+		return _deviceState ? _deviceState->lastFrameStats() : headlessStats;
+	}
+
 
 	void addSceneObject(const std::shared_ptr<SceneObject>& object) {
-		object->loadDeviceDependentResources(_device.Get());
+		if (_device) {
+			object->loadDeviceDependentResources(_device.Get(), *_assets);
+		}
 		_sceneObjects.push_back(object);
 	}
 	void removeSceneObject(const std::shared_ptr<SceneObject>& object) {
@@ -144,7 +286,7 @@ public:
 	}
 };
 
-Engine::Engine(HWND hwnd,const std::function<void(Engine* engine)>& onStart) : _(std::make_unique<impl>(hwnd))
+Engine::Engine(HWND hwnd,const std::function<void(Engine* engine)>& onStart, const SessionOptions& session) : _(std::make_unique<impl>(hwnd, session))
 {
 
 	onStart(this);
@@ -160,9 +302,24 @@ void Engine::run()
 	_->run();
 }
 
-void Engine::onClick()
+bool Engine::replayFinished() const
+{
+	return _->replayFinished();
+}
+
+std::uint64_t Engine::randomSeed() const
 {
-	_->onClick();
+	return _->randomSeed();
+}
+
+AssetManager & Engine::assets()
+{
+	return _->assets();
+}
+
+InputSystem & Engine::input()
+{
+	return _->input();
 }
 
 void Engine::changeBackground(const DirectX::XMFLOAT4 & color)
@@ -180,11 +337,42 @@ void Engine::removeSceneObject(const std::shared_ptr<SceneObject>& object)
 	_->removeSceneObject(object);
 }
 
+void Engine::setFramePacing(FramePacingMode mode, double targetFrameRate)
+{
+	_->pacer().setMode(mode);
+	_->pacer().setTargetFrameRate(targetFrameRate);
+}
+
+FrameTimeStats Engine::frameTimeStats() const
+{
+	return _->pacer().frameTimeStats();
+}
+
+BudgetYieldAwaiter Engine::yieldIfOverBudget(const char * name)
+{
+	return _->frameBudget().yieldIfOverBudget(name);
+}
+
+void Engine::setFrameBudget(std::chrono::steady_clock::duration budget)
+{
+	_->frameBudget().setBudget(budget);
+}
+
+const std::vector<BudgetUsage>& Engine::frameBudgetUsage() const
+{
+	return _->frameBudget().lastFrameUsage();
+}
+
+const DeviceStateCacheStats& Engine::renderStateStats() const
+{
+	return _->renderStateStats();
+}
+
 GameAwaitableUniquePromise<void>* Engine::waitFor(std::chrono::steady_clock::duration duration) {
 	return _->waitFor(duration);
 }
 
 
-GameAwaitableUniquePromise<void>* Engine::waitForMouseClick() {
-	return _->waitForMouseClick();
+InputAwaiter Engine::waitForMouseClick() {
+	return _->input().next(MouseDown{ Button::Left });
 }
@@ -4,29 +4,54 @@
 #include <DirectXMath.h>
 #include "GameAwaitablePromise.h"
 #include "SceneObject.h"
+#include "DeviceStateCache.h"
+#include "FramePacer.h"
+#include "InputQueue.h"
+#include "SessionLog.h"
+#include "FrameBudget.h"
 #include <chrono>
 #include <functional>
 
 // main engine
-// handles the main game loop (run function is called in the windows message loop on idle)
+// handles the main game loop (run function is called in the windows message loop on idle, and sleeps until the next frame is due)
 class Engine
 {
 private:
 	class impl;
 	std::unique_ptr<impl> _;
 public:
-	Engine(HWND hwnd, const std::function<void(Engine* engine)>& onStart);
+	// hwnd can be null for a headless engine (typically to replay a recorded session)
+	Engine(HWND hwnd, const std::function<void(Engine* engine)>& onStart, const SessionOptions& session = SessionOptions());
 	~Engine();
 	void run();
-	void onClick();
+	// in replay mode, true once all the recorded frames have been run
+	bool replayFinished() const;
+	// game logic must seed its random generators with this value, so that recorded sessions can be replayed
+	std::uint64_t randomSeed() const;
+	// input events are pushed by the platform layer and dispatched to the awaiting coroutines at the beginning of each frame
+	InputSystem& input();
+	// asynchronous asset loading (coroutines waiting for assets are resumed at the beginning of the frame update)
+	AssetManager& assets();
 	void changeBackground(const DirectX::XMFLOAT4& color);
 	void addSceneObject(const std::shared_ptr<SceneObject>& object);
 	void removeSceneObject(const std::shared_ptr<SceneObject>& object);
+	// targetFrameRate is only used by FramePacingMode::WaitableTimer
+	void setFramePacing(FramePacingMode mode, double targetFrameRate);
+	// frame time percentiles over the last FramePacer::FrameTimeHistorySize frames
+	FrameTimeStats frameTimeStats() const;
+	// continues immediately if the frame has CPU budget left, else at the beginning of next frame
+	// usage: __await engine->yieldIfOverBudget("levelGeneration");
+	BudgetYieldAwaiter yieldIfOverBudget(const char* name = "anonymous");
+	void setFrameBudget(std::chrono::steady_clock::duration budget);
+	// time consumed between checkpoints, per coroutine name, during the last frame
+	const std::vector<BudgetUsage>& frameBudgetUsage() const;
+	// binds requested / issued / elided by the device state cache during the last completed frame
+	const DeviceStateCacheStats& renderStateStats() const;
 	// the timers are implemented as simple state machines (updated at each run call) 
 	// and exposed as awaitable coroutines
 	GameAwaitableUniquePromise<void>* waitFor(std::chrono::steady_clock::duration duration);
 	// user input can also be exposed as an awaitable coroutine
-	GameAwaitableUniquePromise<void>* waitForMouseClick();
+	InputAwaiter waitForMouseClick();
 };
 
 
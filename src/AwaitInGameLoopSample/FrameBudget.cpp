@@ -0,0 +1,107 @@
+#include "stdafx.h"
+#include "FrameBudget.h"
+
+using namespace std::chrono;
+
+void BudgetYieldAwaiter::await_suspend(std::experimental::resumable_handle<> _ResumeCb)
+{
+	_resumeCB = _ResumeCb;
+	if (_owner->_yieldedTail) {
+		_owner->_yieldedTail->_next = this;
+	}
+	else {
+		_owner->_yielded = this;
+	}
+	_owner->_yieldedTail = this;
+}
+
+FrameBudget::FrameBudget(steady_clock::duration budget) : _budget(budget), _frameStart(steady_clock::now()), _lastCheckpoint(_frameStart),
+	_yielded(nullptr), _yieldedTail(nullptr), _checkpointCount(0), _nextReplayedYield(0), _replaying(false)
+{
+}
+
+FrameBudget::~FrameBudget()
+{
+	// abandoned coroutines are resumed, and throw coroutine_abandoned
+	while (_yielded) {
+		auto awaiter = _yielded;
+		_yielded = awaiter->_next;
+		awaiter->_resumeCB();
+	}
+}
+
+BudgetUsage & FrameBudget::usage(const char * name)
+{
+	for (auto& u : _currentUsage) {
+		if (u.name == name) {
+			return u;
+		}
+	}
+	_currentUsage.push_back(BudgetUsage{ name, steady_clock::duration(0), 0, 0 });
+	return _currentUsage.back();
+}
+
+void FrameBudget::beginFrame(steady_clock::time_point frameStart)
+{
+	_replaying = false;
+	_yieldingCheckpoints.clear();
+	startFrame(frameStart);
+}
+
+void FrameBudget::beginReplayedFrame(steady_clock::time_point frameStart, const std::vector<std::uint32_t>& yieldingCheckpoints)
+{
+	_replaying = true;
+	_yieldingCheckpoints = yieldingCheckpoints;
+	_nextReplayedYield = 0;
+	startFrame(frameStart);
+}
+
+void FrameBudget::startFrame(steady_clock::time_point frameStart)
+{
+	_lastFrameUsage.swap(_currentUsage);
+	_currentUsage.clear();
+	_frameStart = frameStart;
+	_lastCheckpoint = frameStart;
+	_checkpointCount = 0;
+
+	// coroutines yielding again while being resumed go to the list of the next frame
+	auto awaiter = _yielded;
+	_yielded = _yieldedTail = nullptr;
+	while (awaiter) {
+		auto next = awaiter->_next;
+		awaiter->_next = nullptr;
+		awaiter->_ranToCompletion = true;
+		_lastCheckpoint = steady_clock::now();
+		awaiter->_resumeCB();
+		awaiter = next;
+	}
+}
+
+BudgetYieldAwaiter FrameBudget::yieldIfOverBudget(const char * name)
+{
+	auto now = steady_clock::now();
+	auto& u = usage(name);
+	u.consumed += now - _lastCheckpoint;
+	++u.checkpoints;
+	_lastCheckpoint = now;
+	auto checkpoint = _checkpointCount++;
+	bool yield;
+	if (_replaying) {
+		yield = _nextReplayedYield < _yieldingCheckpoints.size() && _yieldingCheckpoints[_nextReplayedYield] == checkpoint;
+		if (yield) {
+			++_nextReplayedYield;
+		}
+	}
+	else {
+		yield = now - _frameStart >= _budget;
+		if (yield) {
+			_yieldingCheckpoints.push_back(checkpoint);
+		}
+	}
+	if (!yield) {
+		// ready awaiter: no suspension
+		return BudgetYieldAwaiter(nullptr);
+	}
+	++u.yields;
+	return BudgetYieldAwaiter(this);
+}
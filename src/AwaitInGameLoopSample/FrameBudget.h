@@ -0,0 +1,89 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <vector>
+#include <experimental\resumable>
+#include "GameAwaitablePromise.h"
+
+class FrameBudget;
+
+// awaitable returned by FrameBudget::yieldIfOverBudget.
+// when there is budget left, await_ready returns true and the coroutine continues without suspending.
+// otherwise it is linked (intrusively, no allocation) in the list of coroutines resumed at the beginning of the next frame
+class BudgetYieldAwaiter {
+	friend class FrameBudget;
+private:
+	FrameBudget* _owner;
+	std::experimental::resumable_handle<> _resumeCB;
+	BudgetYieldAwaiter* _next;
+	bool _ranToCompletion;
+public:
+	explicit BudgetYieldAwaiter(FrameBudget* owner) : _owner(owner), _resumeCB(nullptr), _next(nullptr), _ranToCompletion(false) {}
+	// only valid before the awaiter has been suspended
+	BudgetYieldAwaiter(BudgetYieldAwaiter&& other) : _owner(other._owner), _resumeCB(nullptr), _next(nullptr), _ranToCompletion(false) {}
+	BudgetYieldAwaiter(const BudgetYieldAwaiter&) = delete;
+	BudgetYieldAwaiter& operator=(const BudgetYieldAwaiter&) = delete;
+
+	bool await_ready() {
+		return _owner == nullptr;
+	}
+	void await_suspend(std::experimental::resumable_handle<> _ResumeCb);
+	void await_resume() {
+		if (_owner && !_ranToCompletion) {
+			throw coroutine_abandoned();
+		}
+	}
+};
+
+// time consumed by a named coroutine during a frame
+struct BudgetUsage {
+	const char* name;
+	std::chrono::steady_clock::duration consumed;
+	unsigned checkpoints;
+	unsigned yields;
+};
+
+// per-frame CPU budget for long running coroutines (level generation, path finding...).
+// such coroutines regularly call yieldIfOverBudget; when the frame has consumed its budget they are continued next frame.
+// the time between two checkpoints is accounted to the coroutine reaching the second one, which gives a per-coroutine view of who consumed the budget.
+// the checkpoints that yielded in a frame can be recorded, and imposed when replaying a session so that coroutines resume on the same frames
+class FrameBudget
+{
+	friend class BudgetYieldAwaiter;
+private:
+	std::chrono::steady_clock::duration _budget;
+	std::chrono::steady_clock::time_point _frameStart;
+	std::chrono::steady_clock::time_point _lastCheckpoint;
+	BudgetYieldAwaiter* _yielded;
+	BudgetYieldAwaiter* _yieldedTail;
+	std::vector<BudgetUsage> _currentUsage;
+	std::vector<BudgetUsage> _lastFrameUsage;
+	// indices, in the frame's checkpoint order, of the checkpoints that yielded (or must yield, when replaying)
+	std::vector<std::uint32_t> _yieldingCheckpoints;
+	std::uint32_t _checkpointCount;
+	std::size_t _nextReplayedYield;
+	bool _replaying;
+
+	BudgetUsage& usage(const char* name);
+	void startFrame(std::chrono::steady_clock::time_point frameStart);
+public:
+	explicit FrameBudget(std::chrono::steady_clock::duration budget);
+	~FrameBudget();
+	FrameBudget(const FrameBudget&) = delete;
+	FrameBudget& operator=(const FrameBudget&) = delete;
+
+	void setBudget(std::chrono::steady_clock::duration budget) { _budget = budget; }
+	std::chrono::steady_clock::duration budget() const { return _budget; }
+
+	// starts a new frame, and resumes the coroutines that yielded during the previous one
+	void beginFrame(std::chrono::steady_clock::time_point frameStart);
+	// same, but the checkpoints that yield are the recorded ones instead of being decided on the clock
+	void beginReplayedFrame(std::chrono::steady_clock::time_point frameStart, const std::vector<std::uint32_t>& yieldingCheckpoints);
+	// checkpoints that yielded so far during the current frame
+	const std::vector<std::uint32_t>& yieldingCheckpoints() const { return _yieldingCheckpoints; }
+
+	// name must be a string literal (it is compared by address)
+	BudgetYieldAwaiter yieldIfOverBudget(const char* name);
+
+	const std::vector<BudgetUsage>& lastFrameUsage() const { return _lastFrameUsage; }
+};
@@ -0,0 +1,131 @@
+#include "stdafx.h"
+#include "FramePacer.h"
+#include <algorithm>
+#include <dxgi.h>
+
+using namespace std::chrono;
+
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+// frame interval used while the window is occluded
+static const steady_clock::duration OccludedFrameDuration = duration_cast<steady_clock::duration>(100ms);
+
+FramePacer::FramePacer() : _mode(FramePacingMode::VSync), _targetFrameDuration(duration_cast<steady_clock::duration>(1s) / 60),
+	_nextFrameTime(steady_clock::now()), _occluded(false), _frameTimes(FrameTimeHistorySize), _nextSample(0), _historyFull(false)
+{
+	// high resolution timers are only available on recent versions of windows
+	_timer = CreateWaitableTimerEx(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+	if (!_timer) {
+		_timer = CreateWaitableTimerEx(nullptr, nullptr, 0, TIMER_ALL_ACCESS);
+	}
+}
+
+FramePacer::~FramePacer()
+{
+	if (_timer) {
+		CloseHandle(_timer);
+	}
+}
+
+void FramePacer::setMode(FramePacingMode mode)
+{
+	_mode = mode;
+	_nextFrameTime = steady_clock::now();
+}
+
+void FramePacer::setTargetFrameRate(double framesPerSecond)
+{
+	if (framesPerSecond > 0) {
+		_targetFrameDuration = duration_cast<steady_clock::duration>(duration<double>(1.0 / framesPerSecond));
+	}
+	_nextFrameTime = steady_clock::now();
+}
+
+bool FramePacer::waitUntil(steady_clock::time_point deadline)
+{
+	auto now = steady_clock::now();
+	if (deadline > now && _timer) {
+		// relative due time, in 100ns units
+		LARGE_INTEGER dueTime;
+		dueTime.QuadPart = -(LONGLONG)(duration_cast<nanoseconds>(deadline - now).count() / 100);
+		if (dueTime.QuadPart < 0 && SetWaitableTimer(_timer, &dueTime, 0, nullptr, nullptr, FALSE)) {
+			auto result = MsgWaitForMultipleObjectsEx(1, &_timer, INFINITE, QS_ALLINPUT, MWMO_INPUTAVAILABLE);
+			if (result != WAIT_OBJECT_0) {
+				CancelWaitableTimer(_timer);
+				return false;
+			}
+		}
+	}
+	// input that arrived while we were sleeping is dispatched before the frame starts
+	return (GetQueueStatus(QS_INPUT) >> 16) == 0;
+}
+
+bool FramePacer::waitForNextFrame()
+{
+	if (_occluded) {
+		if (!waitUntil(_nextFrameTime)) {
+			return false;
+		}
+		_nextFrameTime = steady_clock::now() + OccludedFrameDuration;
+		return true;
+	}
+	if (_mode != FramePacingMode::WaitableTimer) {
+		return true;
+	}
+	if (!waitUntil(_nextFrameTime)) {
+		return false;
+	}
+	auto now = steady_clock::now();
+	_nextFrameTime += _targetFrameDuration;
+	// when more than a frame late, don't try to catch up with a burst of frames
+	if (_nextFrameTime < now) {
+		_nextFrameTime = now + _targetFrameDuration;
+	}
+	return true;
+}
+
+void FramePacer::onFrameStarted(steady_clock::duration lastFrameDuration)
+{
+	if (lastFrameDuration.count() <= 0) {
+		return;
+	}
+	_frameTimes[_nextSample] = lastFrameDuration;
+	if (++_nextSample == _frameTimes.size()) {
+		_nextSample = 0;
+		_historyFull = true;
+	}
+}
+
+void FramePacer::onFramePresented(HRESULT presentResult)
+{
+	bool occluded = presentResult == DXGI_STATUS_OCCLUDED;
+	if (occluded && !_occluded) {
+		_nextFrameTime = steady_clock::now() + OccludedFrameDuration;
+	}
+	else if (!occluded && _occluded) {
+		_nextFrameTime = steady_clock::now();
+	}
+	_occluded = occluded;
+}
+
+FrameTimeStats FramePacer::frameTimeStats() const
+{
+	FrameTimeStats stats;
+	std::size_t count = _historyFull ? _frameTimes.size() : _nextSample;
+	if (count == 0) {
+		return stats;
+	}
+	std::vector<steady_clock::duration> samples(_frameTimes.begin(), _frameTimes.begin() + count);
+	auto percentile = [&samples, count](std::size_t percent) {
+		auto nth = samples.begin() + (count - 1) * percent / 100;
+		std::nth_element(samples.begin(), nth, samples.end());
+		return *nth;
+	};
+	stats.p50 = percentile(50);
+	stats.p99 = percentile(99);
+	stats.maximum = *std::max_element(samples.begin(), samples.end());
+	stats.sampleCount = count;
+	return stats;
+}
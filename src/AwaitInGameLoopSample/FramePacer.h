@@ -0,0 +1,64 @@
+#pragma once
+#include <Windows.h>
+#include <chrono>
+#include <vector>
+#include <cstddef>
+
+enum class FramePacingMode {
+	// render as fast as possible (previous behavior)
+	Unthrottled,
+	// let Present block on the vertical blank
+	VSync,
+	// sleep on a waitable timer until the next frame deadline derived from the target frame rate
+	WaitableTimer
+};
+
+// frame time distribution over the last frames
+struct FrameTimeStats {
+	std::chrono::steady_clock::duration p50;
+	std::chrono::steady_clock::duration p99;
+	std::chrono::steady_clock::duration maximum;
+	std::size_t sampleCount;
+	FrameTimeStats() : p50(0), p99(0), maximum(0), sampleCount(0) {}
+};
+
+// decides when the next frame should start.
+// waiting is done with MsgWaitForMultipleObjects, so that pending window messages (user input) interrupt the wait:
+// the message loop then dispatches them before the frame starts, which keeps input sampling as late as possible
+class FramePacer
+{
+private:
+	FramePacingMode _mode;
+	std::chrono::steady_clock::duration _targetFrameDuration;
+	std::chrono::steady_clock::time_point _nextFrameTime;
+	HANDLE _timer;
+	bool _occluded;
+	std::vector<std::chrono::steady_clock::duration> _frameTimes;
+	std::size_t _nextSample;
+	bool _historyFull;
+
+	bool waitUntil(std::chrono::steady_clock::time_point deadline);
+public:
+	static const std::size_t FrameTimeHistorySize = 512;
+
+	FramePacer();
+	~FramePacer();
+	FramePacer(const FramePacer&) = delete;
+	FramePacer& operator=(const FramePacer&) = delete;
+
+	void setMode(FramePacingMode mode);
+	FramePacingMode mode() const { return _mode; }
+	// target frame rate of the WaitableTimer mode
+	void setTargetFrameRate(double framesPerSecond);
+
+	// returns true when the frame should be produced now, false when input is pending and must be dispatched first
+	bool waitForNextFrame();
+	// sync interval to pass to Present
+	UINT presentSyncInterval() const { return _mode == FramePacingMode::VSync ? 1 : 0; }
+	// records the duration of the frame that just started
+	void onFrameStarted(std::chrono::steady_clock::duration lastFrameDuration);
+	// an occluded (minimized, hidden) window does not need more than a few frames per second
+	void onFramePresented(HRESULT presentResult);
+
+	FrameTimeStats frameTimeStats() const;
+};
@@ -19,8 +19,12 @@ public:
 	std::chrono::steady_clock::duration lastFrameDuration() const { return _lastFrameDuration; }
 
 	void onBeginNewFrame() {
+		onBeginNewFrame(std::chrono::steady_clock::now());
+	}
+	// used when replaying a recorded session: frame times come from the log instead of the system clock
+	void onBeginNewFrame(const std::chrono::steady_clock::time_point& frameTime) {
 		_lastFramePoint = _currentFramePoint;
-		_currentFramePoint = std::chrono::steady_clock::now();
+		_currentFramePoint = frameTime;
 		_lastFrameDuration = _currentFramePoint - _lastFramePoint;
 	}
 };
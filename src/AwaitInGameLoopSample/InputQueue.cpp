@@ -0,0 +1,169 @@
+#include "stdafx.h"
+#include "InputQueue.h"
+#include <windowsx.h>
+#include <Xinput.h>
+
+using namespace std::chrono;
+
+void InputAwaiter::await_suspend(std::experimental::resumable_handle<> _ResumeCb)
+{
+	_resumeCB = _ResumeCb;
+	_next = _owner->_waiters;
+	_owner->_waiters = this;
+}
+
+InputSystem::InputSystem() : _waiters(nullptr), _droppedEvents(0)
+{
+}
+
+InputSystem::~InputSystem()
+{
+	// abandoned waiters are resumed, and throw coroutine_abandoned (same as GameAwaitableUniquePromise)
+	while (_waiters) {
+		auto waiter = _waiters;
+		_waiters = waiter->_next;
+		waiter->_next = nullptr;
+		waiter->_resumeCB();
+	}
+}
+
+void InputSystem::push(const InputEvent & e)
+{
+	if (!_events.push(e)) {
+		_droppedEvents.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+void InputSystem::dispatch()
+{
+	InputEvent e;
+	while (_events.pop(e)) {
+		if (_observer) {
+			_observer(e);
+		}
+		dispatch(e);
+	}
+}
+
+void InputSystem::dispatch(const InputEvent& e)
+{
+	// waiters registered while resuming (a coroutine awaiting the next input) only see the following events
+	InputAwaiter* pending = _waiters;
+	_waiters = nullptr;
+	InputAwaiter* matched = nullptr;
+	InputAwaiter* matchedTail = nullptr;
+	InputAwaiter* remaining = nullptr;
+	InputAwaiter* remainingTail = nullptr;
+	auto append = [](InputAwaiter*& head, InputAwaiter*& tail, InputAwaiter* waiter) {
+		if (tail) {
+			tail->_next = waiter;
+		}
+		else {
+			head = waiter;
+		}
+		tail = waiter;
+	};
+	while (pending) {
+		auto waiter = pending;
+		pending = waiter->_next;
+		waiter->_next = nullptr;
+		if (waiter->_filter.matches(e)) {
+			append(matched, matchedTail, waiter);
+		}
+		else {
+			append(remaining, remainingTail, waiter);
+		}
+	}
+	if (remainingTail) {
+		remainingTail->_next = _waiters;
+		_waiters = remaining;
+	}
+	while (matched) {
+		auto waiter = matched;
+		matched = waiter->_next;
+		waiter->_next = nullptr;
+		waiter->_result = e;
+		waiter->_ranToCompletion = true;
+		// resuming may register new waiters, or destroy this one
+		waiter->_resumeCB();
+	}
+}
+
+static InputEvent makeMouseEvent(InputEventType type, Button button, const MSG& msg)
+{
+	InputEvent e;
+	e.type = type;
+	e.player = 0;
+	e.code = (std::uint32_t)button;
+	e.x = GET_X_LPARAM(msg.lParam);
+	e.y = GET_Y_LPARAM(msg.lParam);
+	e.timestamp = steady_clock::now();
+	return e;
+}
+
+bool translateWindowMessage(const MSG & msg, InputEvent & e)
+{
+	switch (msg.message) {
+	case WM_LBUTTONDOWN:
+		e = makeMouseEvent(InputEventType::MouseDown, Button::Left, msg);
+		return true;
+	case WM_LBUTTONUP:
+		e = makeMouseEvent(InputEventType::MouseUp, Button::Left, msg);
+		return true;
+	case WM_RBUTTONDOWN:
+		e = makeMouseEvent(InputEventType::MouseDown, Button::Right, msg);
+		return true;
+	case WM_RBUTTONUP:
+		e = makeMouseEvent(InputEventType::MouseUp, Button::Right, msg);
+		return true;
+	case WM_MBUTTONDOWN:
+		e = makeMouseEvent(InputEventType::MouseDown, Button::Middle, msg);
+		return true;
+	case WM_MBUTTONUP:
+		e = makeMouseEvent(InputEventType::MouseUp, Button::Middle, msg);
+		return true;
+	case WM_MOUSEMOVE:
+		e = makeMouseEvent(InputEventType::MouseMove, Button::Any, msg);
+		return true;
+	case WM_KEYDOWN:
+	case WM_KEYUP:
+		e.type = msg.message == WM_KEYDOWN ? InputEventType::KeyDown : InputEventType::KeyUp;
+		e.player = 0;
+		e.code = (std::uint32_t)msg.wParam;
+		e.x = e.y = 0;
+		e.timestamp = steady_clock::now();
+		return true;
+	default:
+		return false;
+	}
+}
+
+GamePadInputSource::GamePadInputSource() : _connected(false), _lastButtons(0), _nextConnectionCheck(steady_clock::now())
+{
+}
+
+void GamePadInputSource::poll(InputSystem & input)
+{
+	auto now = steady_clock::now();
+	// XInputGetState is slow on a disconnected controller, so only look for a new one from time to time
+	if (!_connected && now < _nextConnectionCheck) {
+		return;
+	}
+	XINPUT_STATE state;
+	if (XInputGetState(0, &state) != ERROR_SUCCESS) {
+		_connected = false;
+		_lastButtons = 0;
+		_nextConnectionCheck = now + seconds(1);
+		return;
+	}
+	_connected = true;
+	std::uint32_t buttons = state.Gamepad.wButtons;
+	std::uint32_t changed = buttons ^ _lastButtons;
+	_lastButtons = buttons;
+	if (changed & buttons) {
+		input.push(InputEvent{ InputEventType::GamePadButtonDown, 0, changed & buttons, 0, 0, now });
+	}
+	if (changed & ~buttons) {
+		input.push(InputEvent{ InputEventType::GamePadButtonUp, 0, changed & ~buttons, 0, 0, now });
+	}
+}
@@ -0,0 +1,193 @@
+#pragma once
+#include <Windows.h>
+#include <atomic>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <experimental\resumable>
+#include "GameAwaitablePromise.h"
+
+enum class InputEventType : std::uint8_t {
+	MouseDown,
+	MouseUp,
+	MouseMove,
+	KeyDown,
+	KeyUp,
+	GamePadButtonDown,
+	GamePadButtonUp
+};
+
+enum class Button : std::uint8_t {
+	Left,
+	Right,
+	Middle,
+	Any = 0xff
+};
+
+// timestamped input event, filled by the platform layer
+struct InputEvent {
+	InputEventType type;
+	// player index for game pad events
+	std::uint8_t player;
+	// mouse button, virtual key code or game pad button mask, depending on the type
+	std::uint32_t code;
+	// mouse position in client coordinates
+	std::int32_t x;
+	std::int32_t y;
+	std::chrono::steady_clock::time_point timestamp;
+};
+
+// filters passed to InputSystem::next
+struct InputFilter {
+	static const std::uint32_t AnyCode = 0xffffffff;
+	InputEventType type;
+	std::uint32_t code;
+	bool matches(const InputEvent& e) const {
+		return e.type == type && (code == AnyCode || (type >= InputEventType::GamePadButtonDown ? (e.code & code) != 0 : e.code == code));
+	}
+};
+struct MouseDown {
+	Button button;
+	operator InputFilter() const { return InputFilter{ InputEventType::MouseDown, button == Button::Any ? InputFilter::AnyCode : (std::uint32_t)button }; }
+};
+struct MouseUp {
+	Button button;
+	operator InputFilter() const { return InputFilter{ InputEventType::MouseUp, button == Button::Any ? InputFilter::AnyCode : (std::uint32_t)button }; }
+};
+struct MouseMove {
+	operator InputFilter() const { return InputFilter{ InputEventType::MouseMove, InputFilter::AnyCode }; }
+};
+struct KeyDown {
+	// virtual key code, or InputFilter::AnyCode
+	std::uint32_t key;
+	operator InputFilter() const { return InputFilter{ InputEventType::KeyDown, key }; }
+};
+struct KeyUp {
+	std::uint32_t key;
+	operator InputFilter() const { return InputFilter{ InputEventType::KeyUp, key }; }
+};
+struct GamePadButtonDown {
+	// mask of XINPUT_GAMEPAD_* buttons, or InputFilter::AnyCode
+	std::uint32_t buttons;
+	operator InputFilter() const { return InputFilter{ InputEventType::GamePadButtonDown, buttons }; }
+};
+struct GamePadButtonUp {
+	std::uint32_t buttons;
+	operator InputFilter() const { return InputFilter{ InputEventType::GamePadButtonUp, buttons }; }
+};
+
+// lock-free single producer / single consumer ring buffer.
+// the producer is the platform layer (message loop), the consumer is the engine frame
+template<typename T, std::size_t Capacity>
+class SpscRingBuffer {
+	static_assert((Capacity & (Capacity - 1)) == 0, "capacity must be a power of 2");
+private:
+	std::array<T, Capacity> _items;
+	// written by the consumer only
+	alignas(64) std::atomic<std::size_t> _head;
+	// written by the producer only
+	alignas(64) std::atomic<std::size_t> _tail;
+public:
+	SpscRingBuffer() : _head(0), _tail(0) {}
+
+	// returns false if the buffer is full (the item is dropped)
+	bool push(const T& item) {
+		auto tail = _tail.load(std::memory_order_relaxed);
+		if (tail - _head.load(std::memory_order_acquire) == Capacity) {
+			return false;
+		}
+		_items[tail & (Capacity - 1)] = item;
+		_tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+	bool pop(T& item) {
+		auto head = _head.load(std::memory_order_relaxed);
+		if (head == _tail.load(std::memory_order_acquire)) {
+			return false;
+		}
+		item = _items[head & (Capacity - 1)];
+		_head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+};
+
+class InputSystem;
+
+// awaitable returned by InputSystem::next. it lives in the awaiting coroutine frame while suspended,
+// and is linked in an intrusive list of the input system (so waiting for an input does not allocate)
+class InputAwaiter {
+	friend class InputSystem;
+private:
+	InputSystem* _owner;
+	InputFilter _filter;
+	InputEvent _result;
+	bool _ranToCompletion;
+	std::experimental::resumable_handle<> _resumeCB;
+	InputAwaiter* _next;
+public:
+	InputAwaiter(InputSystem* owner, const InputFilter& filter) : _owner(owner), _filter(filter), _ranToCompletion(false), _resumeCB(nullptr), _next(nullptr) {}
+	// only valid before the awaiter has been suspended
+	InputAwaiter(InputAwaiter&& other) : _owner(other._owner), _filter(other._filter), _ranToCompletion(false), _resumeCB(nullptr), _next(nullptr) {}
+	InputAwaiter(const InputAwaiter&) = delete;
+	InputAwaiter& operator=(const InputAwaiter&) = delete;
+
+	bool await_ready() {
+		return false;
+	}
+	void await_suspend(std::experimental::resumable_handle<> _ResumeCb);
+	InputEvent await_resume() {
+		if (!_ranToCompletion) {
+			throw coroutine_abandoned();
+		}
+		return _result;
+	}
+};
+
+// input events queue, and dispatch of the events to the awaiting coroutines
+class InputSystem
+{
+	friend class InputAwaiter;
+private:
+	SpscRingBuffer<InputEvent, 1024> _events;
+	InputAwaiter* _waiters;
+	std::atomic<std::uint32_t> _droppedEvents;
+	std::function<void(const InputEvent&)> _observer;
+public:
+	InputSystem();
+	~InputSystem();
+	InputSystem(const InputSystem&) = delete;
+	InputSystem& operator=(const InputSystem&) = delete;
+
+	// producer side (platform layer)
+	void push(const InputEvent& e);
+	// number of events dropped because the queue was full
+	std::uint32_t droppedEvents() const { return _droppedEvents.load(std::memory_order_relaxed); }
+
+	// consumer side: dispatches all the queued events to the waiting coroutines, in one pass (called once per frame)
+	void dispatch();
+	// dispatches a single event directly, bypassing the queue (session replay)
+	void dispatch(const InputEvent& e);
+	// called for each event taken from the queue, before it is dispatched (session recording)
+	void setObserver(const std::function<void(const InputEvent&)>& observer) { _observer = observer; }
+
+	// awaitable that completes with the next event matching the filter
+	// usage: InputEvent e = __await engine->input().next(MouseDown{ Button::Left });
+	InputAwaiter next(const InputFilter& filter) {
+		return InputAwaiter(this, filter);
+	}
+};
+
+// converts a window message into an input event. returns false if the message is not an input message
+bool translateWindowMessage(const MSG& msg, InputEvent& e);
+
+// polls the first game pad and produces button events. must be polled from the producer thread (the message loop)
+class GamePadInputSource {
+private:
+	bool _connected;
+	std::uint32_t _lastButtons;
+	std::chrono::steady_clock::time_point _nextConnectionCheck;
+public:
+	GamePadInputSource();
+	void poll(InputSystem& input);
+};
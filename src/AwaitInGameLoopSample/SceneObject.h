@@ -1,6 +1,7 @@
 #pragma once
 #include "GameClock.h"
-#include <d3d11_2.h>
+#include "D3D11DrawCommandList.h"
+#include "AssetManager.h"
 
 // scene object that must be updated and drawn at each frame
 class SceneObject
@@ -8,8 +9,11 @@ class SceneObject
 public:
 	SceneObject();
 	virtual ~SceneObject() = default;
-	virtual void loadDeviceDependentResources(ID3D11Device* device) = 0;
+	// long loads (textures, shaders...) should go through the asset manager instead of blocking the game loop
+	virtual void loadDeviceDependentResources(ID3D11Device* device, AssetManager& assets) = 0;
 	virtual void updateState(const GameClock& clock) = 0;
-	virtual void draw(ID3D11DeviceContext* deviceContext, ID3D11RenderTargetView* rtv) = 0;
+	// draws are recorded (possibly on a worker thread, concurrently with other objects) and replayed later on the render thread.
+	// implementations must not touch the device context, nor modify shared state
+	virtual void draw(DrawCommandRecorder& recorder) const = 0;
 };
 
@@ -0,0 +1,144 @@
+#include "stdafx.h"
+#include "SessionLog.h"
+#include <stdexcept>
+
+using namespace std::chrono;
+
+static const std::uint32_t SessionLogMagic = 0x52474c41;
+static const std::uint32_t SessionLogVersion = 2;
+
+static void writeVarint(std::vector<std::uint8_t>& out, std::uint64_t value)
+{
+	while (value >= 0x80) {
+		out.push_back((std::uint8_t)(value | 0x80));
+		value >>= 7;
+	}
+	out.push_back((std::uint8_t)value);
+}
+
+static void writeSignedVarint(std::vector<std::uint8_t>& out, std::int64_t value)
+{
+	// zigzag encoding, so that small negative values stay small
+	writeVarint(out, ((std::uint64_t)value << 1) ^ (std::uint64_t)(value >> 63));
+}
+
+static std::uint64_t readVarint(const std::vector<std::uint8_t>& in, std::size_t& position)
+{
+	std::uint64_t value = 0;
+	for (unsigned shift = 0; shift < 64; shift += 7) {
+		if (position >= in.size()) {
+			throw std::runtime_error("truncated session log");
+		}
+		auto byte = in[position++];
+		value |= (std::uint64_t)(byte & 0x7f) << shift;
+		if (!(byte & 0x80)) {
+			return value;
+		}
+	}
+	throw std::runtime_error("corrupted session log");
+}
+
+static std::int64_t readSignedVarint(const std::vector<std::uint8_t>& in, std::size_t& position)
+{
+	auto value = readVarint(in, position);
+	return (std::int64_t)(value >> 1) ^ -(std::int64_t)(value & 1);
+}
+
+SessionLogWriter::SessionLogWriter(const std::wstring & path, std::uint64_t randomSeed) : _file(path, std::ios::binary | std::ios::trunc), _lastFrameTime(0)
+{
+	if (!_file) {
+		throw std::runtime_error("cannot create session log");
+	}
+	writeVarint(_buffer, SessionLogMagic);
+	writeVarint(_buffer, SessionLogVersion);
+	writeVarint(_buffer, randomSeed);
+	flush();
+}
+
+SessionLogWriter::~SessionLogWriter()
+{
+	flush();
+}
+
+void SessionLogWriter::flush()
+{
+	_file.write(reinterpret_cast<const char*>(_buffer.data()), _buffer.size());
+	_file.flush();
+	_buffer.clear();
+}
+
+void SessionLogWriter::writeFrame(steady_clock::duration frameTime, const std::vector<InputEvent>& events, const std::vector<std::uint32_t>& yieldingCheckpoints,
+	steady_clock::time_point sessionStart)
+{
+	writeVarint(_buffer, duration_cast<nanoseconds>(frameTime - _lastFrameTime).count());
+	_lastFrameTime = frameTime;
+	writeVarint(_buffer, events.size());
+	auto frameTimePoint = sessionStart + frameTime;
+	for (auto& e : events) {
+		_buffer.push_back((std::uint8_t)e.type);
+		_buffer.push_back(e.player);
+		writeVarint(_buffer, e.code);
+		writeSignedVarint(_buffer, e.x);
+		writeSignedVarint(_buffer, e.y);
+		// events happened shortly before the frame that dispatched them
+		writeSignedVarint(_buffer, duration_cast<nanoseconds>(frameTimePoint - e.timestamp).count());
+	}
+	// checkpoint indices are increasing, and stored as deltas
+	writeVarint(_buffer, yieldingCheckpoints.size());
+	std::uint32_t previous = 0;
+	for (auto checkpoint : yieldingCheckpoints) {
+		writeVarint(_buffer, checkpoint - previous);
+		previous = checkpoint;
+	}
+	// a crash in the session should not lose more than a second or so of input
+	if (_buffer.size() >= 4096) {
+		flush();
+	}
+}
+
+SessionLogReader::SessionLogReader(const std::wstring & path) : _position(0), _lastFrameTime(0)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file) {
+		throw std::runtime_error("cannot open session log");
+	}
+	_data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	if (readVarint(_data, _position) != SessionLogMagic || readVarint(_data, _position) != SessionLogVersion) {
+		throw std::runtime_error("not a session log, or unsupported version");
+	}
+	_randomSeed = readVarint(_data, _position);
+}
+
+bool SessionLogReader::readFrame(steady_clock::duration & frameTime, std::vector<InputEvent>& events, std::vector<std::uint32_t>& yieldingCheckpoints,
+	steady_clock::time_point sessionStart)
+{
+	events.clear();
+	yieldingCheckpoints.clear();
+	if (_position >= _data.size()) {
+		return false;
+	}
+	_lastFrameTime += duration_cast<steady_clock::duration>(nanoseconds(readVarint(_data, _position)));
+	frameTime = _lastFrameTime;
+	auto frameTimePoint = sessionStart + frameTime;
+	auto count = readVarint(_data, _position);
+	for (std::uint64_t i = 0; i < count; ++i) {
+		if (_position + 2 > _data.size()) {
+			throw std::runtime_error("truncated session log");
+		}
+		InputEvent e;
+		e.type = (InputEventType)_data[_position++];
+		e.player = _data[_position++];
+		e.code = (std::uint32_t)readVarint(_data, _position);
+		e.x = (std::int32_t)readSignedVarint(_data, _position);
+		e.y = (std::int32_t)readSignedVarint(_data, _position);
+		e.timestamp = frameTimePoint - duration_cast<steady_clock::duration>(nanoseconds(readSignedVarint(_data, _position)));
+		events.push_back(e);
+	}
+	auto yieldCount = readVarint(_data, _position);
+	std::uint32_t checkpoint = 0;
+	for (std::uint64_t i = 0; i < yieldCount; ++i) {
+		checkpoint += (std::uint32_t)readVarint(_data, _position);
+		yieldingCheckpoints.push_back(checkpoint);
+	}
+	return true;
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "InputQueue.h"
+
+// compact binary log of a game session: the random seed, then for each frame its time (GameClock sample),
+// the input events dispatched during that frame and the frame budget checkpoints that yielded (they depend on the CPU time
+// of the recording machine, so they cannot be decided again when replaying).
+// integers are stored as LEB128 varints and times as deltas in nanoseconds, so an idle frame costs about 6 bytes
+// (a 4 byte delta at 60Hz, the event count and the yield count).
+// replaying a log in a headless engine reproduces the session deterministically, faster than real time
+
+enum class SessionMode {
+	// normal interactive session
+	Live,
+	// interactive session, written to a log
+	Record,
+	// headless replay of a log
+	Replay
+};
+
+struct SessionOptions {
+	SessionMode mode;
+	std::wstring logPath;
+	SessionOptions() : mode(SessionMode::Live) {}
+	SessionOptions(SessionMode mode_, const std::wstring& logPath_) : mode(mode_), logPath(logPath_) {}
+};
+
+class SessionLogWriter
+{
+private:
+	std::ofstream _file;
+	std::vector<std::uint8_t> _buffer;
+	std::chrono::steady_clock::duration _lastFrameTime;
+	void flush();
+public:
+	SessionLogWriter(const std::wstring& path, std::uint64_t randomSeed);
+	~SessionLogWriter();
+	SessionLogWriter(const SessionLogWriter&) = delete;
+	SessionLogWriter& operator=(const SessionLogWriter&) = delete;
+
+	// frameTime and event timestamps are relative to the session start
+	void writeFrame(std::chrono::steady_clock::duration frameTime, const std::vector<InputEvent>& events, const std::vector<std::uint32_t>& yieldingCheckpoints,
+		std::chrono::steady_clock::time_point sessionStart);
+};
+
+class SessionLogReader
+{
+private:
+	std::vector<std::uint8_t> _data;
+	std::size_t _position;
+	std::uint64_t _randomSeed;
+	std::chrono::steady_clock::duration _lastFrameTime;
+public:
+	explicit SessionLogReader(const std::wstring& path);
+	SessionLogReader(const SessionLogReader&) = delete;
+	SessionLogReader& operator=(const SessionLogReader&) = delete;
+
+	std::uint64_t randomSeed() const { return _randomSeed; }
+	// returns false at the end of the log. event timestamps are rebased on sessionStart
+	bool readFrame(std::chrono::steady_clock::duration& frameTime, std::vector<InputEvent>& events, std::vector<std::uint32_t>& yieldingCheckpoints,
+		std::chrono::steady_clock::time_point sessionStart);
+};
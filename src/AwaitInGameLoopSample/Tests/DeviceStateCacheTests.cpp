@@ -0,0 +1,210 @@
+#include "NullApi.h"
+#include "../DeviceStateCache.h"
+
+typedef BasicDeviceStateCache<NullApi> NullStateCache;
+
+namespace {
+	struct Objects {
+		NullBuffer vertexBuffer;
+		NullBuffer constants[4];
+		NullInputLayout layout;
+		NullVertexShader vertexShader[2];
+		NullPixelShader pixelShader[2];
+		NullShaderResourceView textures[4];
+		NullBlendState blendState[2];
+	};
+
+	// the binds of a typical textured draw
+	void bindTexturedQuad(NullStateCache& state, Objects& objects, unsigned pixelShader) {
+		state.setInputLayout(&objects.layout);
+		state.setPrimitiveTopology(4);
+		state.setVertexBuffer(0, &objects.vertexBuffer, 16, 0);
+		state.setVertexShader(&objects.vertexShader[0]);
+		state.setVSConstantBuffer(0, &objects.constants[0]);
+		state.setPixelShader(&objects.pixelShader[pixelShader]);
+		state.setPSShaderResource(0, &objects.textures[0]);
+	}
+
+	void repeatedBindsAreElided() {
+		NullContext context;
+		NullStateCache state(&context);
+		Objects objects;
+
+		bindTexturedQuad(state, objects, 0);
+		state.draw(6, 0);
+		CHECK(state.currentFrameStats().requestedBinds == 7);
+		CHECK(state.currentFrameStats().issuedCalls == 7);
+		CHECK(context.bindCount() == 7);
+
+		// the same binds again only reach the context as the draw
+		for (int i = 0; i < 3; ++i) {
+			bindTexturedQuad(state, objects, 0);
+			state.draw(6, 0);
+		}
+		CHECK(state.currentFrameStats().requestedBinds == 28);
+		CHECK(state.currentFrameStats().issuedCalls == 7);
+		CHECK(state.currentFrameStats().elidedBinds() == 21);
+		CHECK(state.currentFrameStats().drawCalls == 4);
+		CHECK(context.bindCount() == 7);
+		CHECK(context.count("Draw") == 4);
+	}
+
+	void changedBindsAreIssued() {
+		NullContext context;
+		NullStateCache state(&context);
+		Objects objects;
+
+		bindTexturedQuad(state, objects, 0);
+		state.draw(6, 0);
+		context.clear();
+
+		// only the pixel shader differs
+		bindTexturedQuad(state, objects, 1);
+		state.draw(6, 0);
+		CHECK(context.bindCount() == 1);
+		CHECK(context.count("PSSetShader") == 1);
+		CHECK(state.currentFrameStats().issuedCalls == 8);
+
+		// same buffer with another stride still rebinds the vertex buffer
+		context.clear();
+		state.setVertexBuffer(0, &objects.vertexBuffer, 32, 0);
+		state.draw(6, 0);
+		CHECK(context.bindCount() == 1);
+		CHECK(context.count("IASetVertexBuffers") == 1);
+
+		// so does another blend factor with the same blend state
+		state.setBlendState(&objects.blendState[0]);
+		state.draw(6, 0);
+		context.clear();
+		const float factor[4] = { 0.5f, 0.5f, 0.5f, 1.0f };
+		state.setBlendState(&objects.blendState[0], factor);
+		state.draw(6, 0);
+		CHECK(context.bindCount() == 1);
+		CHECK(context.count("OMSetBlendState") == 1);
+	}
+
+	void interleavedBindsOnlyIssueTheLastValue() {
+		NullContext context;
+		NullStateCache state(&context);
+		Objects objects;
+
+		bindTexturedQuad(state, objects, 0);
+		state.draw(6, 0);
+		context.clear();
+
+		// switching away and back before the draw cancels out
+		state.setVertexShader(&objects.vertexShader[1]);
+		state.setPixelShader(&objects.pixelShader[1]);
+		state.setVertexShader(&objects.vertexShader[0]);
+		state.setPixelShader(&objects.pixelShader[0]);
+		state.draw(6, 0);
+		CHECK(context.bindCount() == 0);
+		CHECK(state.currentFrameStats().requestedBinds == 11);
+		CHECK(state.currentFrameStats().issuedCalls == 7);
+
+		// alternating between draws binds every time
+		for (unsigned i = 0; i < 4; ++i) {
+			state.setPixelShader(&objects.pixelShader[(i + 1) & 1]);
+			state.setVertexShader(&objects.vertexShader[0]);
+			state.draw(6, 0);
+		}
+		CHECK(context.bindCount() == 4);
+		CHECK(context.count("PSSetShader") == 4);
+		CHECK(context.count("VSSetShader") == 0);
+		CHECK(state.currentFrameStats().elidedBinds() == 8);
+	}
+
+	void contiguousSlotsAreMerged() {
+		NullContext context;
+		NullStateCache state(&context);
+		Objects objects;
+
+		state.setPSShaderResource(0, &objects.textures[0]);
+		state.setPSShaderResource(1, &objects.textures[1]);
+		state.setPSShaderResource(3, &objects.textures[3]);
+		state.setVSConstantBuffer(2, &objects.constants[2]);
+		state.setVSConstantBuffer(1, &objects.constants[1]);
+		state.draw(3, 0);
+
+		CHECK(context.count("PSSetShaderResources") == 2);
+		CHECK(context.count("VSSetConstantBuffers") == 1);
+		for (auto& call : context.calls) {
+			if (call.method == "PSSetShaderResources") {
+				CHECK((call.first == 0 && call.count == 2) || (call.first == 3 && call.count == 1));
+			}
+			if (call.method == "VSSetConstantBuffers") {
+				CHECK(call.first == 1 && call.count == 2);
+			}
+		}
+		CHECK(state.currentFrameStats().requestedBinds == 5);
+		CHECK(state.currentFrameStats().issuedCalls == 3);
+
+		// rebinding one slot of a run only sends that slot
+		context.clear();
+		state.setPSShaderResource(0, &objects.textures[0]);
+		state.setPSShaderResource(1, &objects.textures[2]);
+		state.draw(3, 0);
+		CHECK(context.bindCount() == 1);
+		CHECK(context.calls[0].first == 1 && context.calls[0].count == 1);
+	}
+
+	void invalidateRebindsEverything() {
+		NullContext context;
+		NullStateCache state(&context);
+		Objects objects;
+
+		bindTexturedQuad(state, objects, 0);
+		state.draw(6, 0);
+		context.clear();
+
+		// after invalidate, the pending state is sent again even though it did not change:
+		// the 7 pipeline states (including the render target, blend and depth stencil ones that were never set)
+		// plus the vertex buffer, constant buffer and shader resource that have a pending value
+		state.invalidate();
+		bindTexturedQuad(state, objects, 0);
+		state.draw(6, 0);
+		CHECK(context.bindCount() == 10);
+		CHECK(context.count("OMSetRenderTargets") == 1);
+		CHECK(context.count("PSSetConstantBuffers") == 0);
+
+		context.clear();
+		bindTexturedQuad(state, objects, 0);
+		state.draw(6, 0);
+		CHECK(context.bindCount() == 0);
+	}
+
+	void statsRollOverAtBeginFrame() {
+		NullContext context;
+		NullStateCache state(&context);
+		Objects objects;
+
+		bindTexturedQuad(state, objects, 0);
+		state.draw(6, 0);
+		bindTexturedQuad(state, objects, 0);
+		state.draw(6, 0);
+		state.beginFrame();
+
+		CHECK(state.lastFrameStats().requestedBinds == 14);
+		CHECK(state.lastFrameStats().issuedCalls == 7);
+		CHECK(state.lastFrameStats().elidedBinds() == 7);
+		CHECK(state.lastFrameStats().drawCalls == 2);
+		CHECK(state.currentFrameStats().requestedBinds == 0);
+		CHECK(state.currentFrameStats().issuedCalls == 0);
+
+		// the bound state survives the frame boundary
+		bindTexturedQuad(state, objects, 0);
+		state.draw(6, 0);
+		CHECK(state.currentFrameStats().issuedCalls == 0);
+		CHECK(state.currentFrameStats().elidedBinds() == 7);
+	}
+}
+
+int main() {
+	repeatedBindsAreElided();
+	changedBindsAreIssued();
+	interleavedBindsOnlyIssueTheLastValue();
+	contiguousSlotsAreMerged();
+	invalidateRebindsEverything();
+	statsRollOverAtBeginFrame();
+	return testResult("DeviceStateCacheTests");
+}
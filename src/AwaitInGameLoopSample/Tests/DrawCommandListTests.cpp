@@ -0,0 +1,177 @@
+#include <algorithm>
+#include <random>
+#include <tuple>
+#include "NullApi.h"
+#include "../DrawCommandList.h"
+
+typedef BasicDeviceStateCache<NullApi> NullStateCache;
+typedef BasicDrawCommandRecorder<NullApi> NullRecorder;
+typedef BasicDrawCommandQueue<NullApi> NullQueue;
+
+namespace {
+	const unsigned ObjectCount = 12;
+	const unsigned PacketsPerObject = 3;
+	const unsigned RecorderCount = 4;
+
+	// sort key of a packet: a few distinct keys, so that most keys are shared between several objects
+	std::uint64_t packetKey(unsigned object, unsigned packet) {
+		return (object * 7 + packet * 3) % 4;
+	}
+	// every draw has a unique vertex count, which identifies the packet in the replayed draws
+	unsigned packetId(unsigned object, unsigned packet) {
+		return 1 + object * PacketsPerObject + packet;
+	}
+
+	// the order the queue must produce: sort key, then source object, then recording order
+	std::vector<unsigned> expectedOrder() {
+		std::vector<std::tuple<std::uint64_t, unsigned, unsigned>> packets;
+		for (unsigned object = 0; object < ObjectCount; ++object) {
+			for (unsigned packet = 0; packet < PacketsPerObject; ++packet) {
+				packets.push_back(std::make_tuple(packetKey(object, packet), object, packet));
+			}
+		}
+		std::sort(packets.begin(), packets.end());
+		std::vector<unsigned> order;
+		for (auto& packet : packets) {
+			order.push_back(packetId(std::get<1>(packet), std::get<2>(packet)));
+		}
+		return order;
+	}
+
+	// records every object into one of the recorders, as the worker threads would, with the objects
+	// spread over the recorders and visited in an order that depends on the seed; then submits the
+	// recorders in a shuffled order too. returns the vertex counts of the replayed draws
+	std::vector<unsigned> recordAndReplay(unsigned seed) {
+		std::mt19937 random(seed);
+		NullBuffer constants;
+		NullPixelShader pixelShader;
+
+		std::vector<unsigned> objects;
+		for (unsigned object = 0; object < ObjectCount; ++object) {
+			objects.push_back(object);
+		}
+		std::shuffle(objects.begin(), objects.end(), random);
+
+		NullRecorder recorders[RecorderCount];
+		for (auto object : objects) {
+			auto& recorder = recorders[random() % RecorderCount];
+			recorder.setSource(object);
+			for (unsigned packet = 0; packet < PacketsPerObject; ++packet) {
+				recorder.beginPacket(packetKey(object, packet));
+				std::uint8_t data = (std::uint8_t)packetId(object, packet);
+				recorder.updateBuffer(&constants, &data, sizeof(data));
+				recorder.setPixelShader(&pixelShader);
+				recorder.draw(packetId(object, packet), 0);
+			}
+		}
+
+		unsigned submitOrder[RecorderCount];
+		for (unsigned i = 0; i < RecorderCount; ++i) {
+			submitOrder[i] = i;
+		}
+		std::shuffle(submitOrder, submitOrder + RecorderCount, random);
+
+		NullQueue queue;
+		for (auto i : submitOrder) {
+			queue.submit(recorders[i]);
+		}
+		queue.sort();
+		CHECK(queue.packetCount() == ObjectCount * PacketsPerObject);
+
+		// forEachPacket visits the packets in the order replay uses
+		std::uint64_t lastKey = 0;
+		std::uint32_t lastSource = 0;
+		std::uint32_t lastSequence = 0;
+		bool first = true;
+		queue.forEachPacket([&](const DrawPacket& packet) {
+			if (!first) {
+				CHECK(std::make_tuple(lastKey, lastSource, lastSequence) < std::make_tuple(packet.sortKey, packet.source, packet.sequence));
+			}
+			first = false;
+			lastKey = packet.sortKey;
+			lastSource = packet.source;
+			lastSequence = packet.sequence;
+			CHECK(packet.commandCount == 3);
+		});
+
+		NullContext context;
+		NullStateCache state(&context);
+		queue.replay(state);
+
+		// each packet's buffer update is replayed right before its own draw
+		CHECK(context.updates.size() == context.draws.size());
+		for (std::size_t i = 0; i < context.updates.size() && i < context.draws.size(); ++i) {
+			CHECK(context.updates[i] == context.draws[i]);
+		}
+		// the pixel shader is the same in every packet, so the state cache binds it once
+		CHECK(context.count("PSSetShader") == 1);
+		return context.draws;
+	}
+
+	void replayOrderIsDeterministic() {
+		auto expected = expectedOrder();
+		for (unsigned seed = 1; seed <= 20; ++seed) {
+			CHECK(recordAndReplay(seed) == expected);
+		}
+	}
+
+	void commandsBeforeBeginPacketAreReplayed() {
+		NullVertexShader vertexShader;
+		NullRecorder recorder;
+		recorder.setSource(3);
+		recorder.setVertexShader(&vertexShader);
+		recorder.draw(10, 0);
+
+		// the commands got an implicit packet, with the default sort key
+		CHECK(recorder.packets().size() == 1);
+		CHECK(recorder.packets()[0].sortKey == 0);
+		CHECK(recorder.packets()[0].commandCount == 2);
+
+		// a later packet of the same source follows it
+		recorder.beginPacket(0);
+		recorder.draw(11, 0);
+		CHECK(recorder.packets().size() == 2);
+		CHECK(recorder.packets()[1].firstCommand == 2);
+
+		NullRecorder other;
+		other.setSource(1);
+		other.beginPacket(0);
+		other.draw(12, 0);
+
+		NullQueue queue;
+		queue.submit(recorder);
+		queue.submit(other);
+		queue.sort();
+
+		NullContext context;
+		NullStateCache state(&context);
+		queue.replay(state);
+		std::vector<unsigned> expected = { 12, 10, 11 };
+		CHECK(context.draws == expected);
+		CHECK(context.count("VSSetShader") == 1);
+	}
+
+	void resetKeepsNothing() {
+		NullRecorder recorder;
+		std::uint8_t data = 1;
+		NullBuffer buffer;
+		recorder.beginPacket(5);
+		recorder.updateBuffer(&buffer, &data, sizeof(data));
+		recorder.draw(1, 0);
+		recorder.reset();
+		CHECK(recorder.packets().empty());
+		CHECK(recorder.commands().empty());
+		CHECK(recorder.payload().empty());
+
+		NullQueue queue;
+		queue.submit(recorder);
+		CHECK(queue.packetCount() == 0);
+	}
+}
+
+int main() {
+	replayOrderIsDeterministic();
+	commandsBeforeBeginPacketAreReplayed();
+	resetKeepsNothing();
+	return testResult("DrawCommandListTests");
+}
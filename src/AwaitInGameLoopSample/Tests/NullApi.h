@@ -0,0 +1,116 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// minimal test harness: CHECK() reports the failing expression and keeps going, so one run shows every failure
+inline int& testFailures() {
+	static int failures = 0;
+	return failures;
+}
+
+inline void checkCondition(bool condition, const char* expression, const char* file, int line) {
+	if (!condition) {
+		std::printf("%s(%d): check failed: %s\n", file, line, expression);
+		++testFailures();
+	}
+}
+
+#define CHECK(condition) checkCondition((condition), #condition, __FILE__, __LINE__)
+
+inline int testResult(const char* name) {
+	if (testFailures()) {
+		std::printf("%s: %d check(s) failed\n", name, testFailures());
+		return 1;
+	}
+	std::printf("%s: passed\n", name);
+	return 0;
+}
+
+// null backend for the templated state cache and draw command lists: the objects are empty tags,
+// and the context only records the calls that reach it
+struct NullBuffer {};
+struct NullInputLayout {};
+struct NullVertexShader {};
+struct NullPixelShader {};
+struct NullShaderResourceView {};
+struct NullRenderTargetView {};
+struct NullDepthStencilView {};
+struct NullBlendState {};
+struct NullDepthStencilState {};
+
+// one call that reached the context: the method name and the slot range (or draw arguments)
+struct NullCall {
+	std::string method;
+	unsigned first;
+	unsigned count;
+};
+
+class NullContext {
+public:
+	std::vector<NullCall> calls;
+	// vertex counts of the draws, in submission order
+	std::vector<unsigned> draws;
+	// first byte of each buffer update, in submission order
+	std::vector<std::uint8_t> updates;
+
+	void clear() {
+		calls.clear();
+		draws.clear();
+		updates.clear();
+	}
+	// number of calls to a method
+	std::size_t count(const char* method) const {
+		std::size_t n = 0;
+		for (auto& call : calls) {
+			if (call.method == method) {
+				++n;
+			}
+		}
+		return n;
+	}
+	// number of calls, not counting the draws
+	std::size_t bindCount() const {
+		return calls.size() - count("Draw");
+	}
+
+	void OMSetRenderTargets(unsigned count, NullRenderTargetView* const*, NullDepthStencilView*) { record("OMSetRenderTargets", 0, count); }
+	void IASetInputLayout(NullInputLayout*) { record("IASetInputLayout", 0, 1); }
+	void IASetPrimitiveTopology(int) { record("IASetPrimitiveTopology", 0, 1); }
+	void IASetVertexBuffers(unsigned first, unsigned count, NullBuffer* const*, const unsigned*, const unsigned*) { record("IASetVertexBuffers", first, count); }
+	void VSSetShader(NullVertexShader*, void*, unsigned) { record("VSSetShader", 0, 1); }
+	void VSSetConstantBuffers(unsigned first, unsigned count, NullBuffer* const*) { record("VSSetConstantBuffers", first, count); }
+	void PSSetShader(NullPixelShader*, void*, unsigned) { record("PSSetShader", 0, 1); }
+	void PSSetConstantBuffers(unsigned first, unsigned count, NullBuffer* const*) { record("PSSetConstantBuffers", first, count); }
+	void PSSetShaderResources(unsigned first, unsigned count, NullShaderResourceView* const*) { record("PSSetShaderResources", first, count); }
+	void OMSetBlendState(NullBlendState*, const float*, unsigned) { record("OMSetBlendState", 0, 1); }
+	void OMSetDepthStencilState(NullDepthStencilState*, unsigned) { record("OMSetDepthStencilState", 0, 1); }
+	void Draw(unsigned vertexCount, unsigned startVertex) {
+		record("Draw", startVertex, vertexCount);
+		draws.push_back(vertexCount);
+	}
+private:
+	void record(const char* method, unsigned first, unsigned count) {
+		NullCall call = { method, first, count };
+		calls.push_back(call);
+	}
+};
+
+struct NullApi {
+	typedef NullContext Context;
+	typedef NullBuffer Buffer;
+	typedef NullInputLayout InputLayout;
+	typedef NullVertexShader VertexShader;
+	typedef NullPixelShader PixelShader;
+	typedef NullShaderResourceView ShaderResourceView;
+	typedef NullRenderTargetView RenderTargetView;
+	typedef NullDepthStencilView DepthStencilView;
+	typedef NullBlendState BlendState;
+	typedef NullDepthStencilState DepthStencilState;
+	typedef int PrimitiveTopology;
+
+	static void writeDiscard(NullContext* context, NullBuffer*, const void* data, size_t size) {
+		context->updates.push_back(size ? *static_cast<const std::uint8_t*>(data) : 0);
+	}
+};
@@ -0,0 +1,1054 @@
+//--------------------------------------------------------------------------------------
+// File: DirectXTKBench.cpp
+//
+// Command-line microbenchmarks for the DirectX Tool Kit. Run with no arguments to time
+// every section, or name the sections to run:
+//
+//     DirectXTKBench sort
+//
+// Times are the fastest of several runs, in milliseconds. Build the Release
+// configuration before comparing numbers. Sections that draw use a WARP device and a
+// deferred context, so they time the CPU side of the work, not the GPU.
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// http://go.microsoft.com/fwlink/?LinkId=248929
+//--------------------------------------------------------------------------------------
+
+#include <d3d11_1.h>
+#include <psapi.h>
+#include <wrl/client.h>
+#include <concrt.h>
+
+#include <float.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "GeometricPrimitive.h"
+#include "SpriteBatch.h"
+#include "SpriteFont.h"
+#include "TextureAtlas.h"
+
+#include "PlatformHelpers.h"
+#include "SpriteSort.h"
+
+using namespace DirectX;
+using Microsoft::WRL::ComPtr;
+
+
+namespace
+{
+    const size_t DefaultRuns = 10;
+
+    typedef std::chrono::high_resolution_clock Clock;
+
+
+    inline double ElapsedMs(Clock::time_point start, Clock::time_point end)
+    {
+        return std::chrono::duration<double, std::milli>(end - start).count();
+    }
+
+
+    // Runs a function several times, returning the fastest run in milliseconds.
+    template<typename TFunc>
+    double TimeBest(size_t runs, TFunc func)
+    {
+        double best = DBL_MAX;
+
+        for (size_t i = 0; i < runs; i++)
+        {
+            auto start = Clock::now();
+
+            func();
+
+            best = std::min(best, ElapsedMs(start, Clock::now()));
+        }
+
+        return best;
+    }
+
+
+    // Creates a WARP device, so that results do not depend on the GPU or driver.
+    ComPtr<ID3D11Device> CreateWarpDevice()
+    {
+        ComPtr<ID3D11Device> device;
+
+        ThrowIfFailed(
+            D3D11CreateDevice(nullptr, D3D_DRIVER_TYPE_WARP, nullptr, 0, nullptr, 0, D3D11_SDK_VERSION, &device, nullptr, nullptr)
+        );
+
+        return device;
+    }
+
+
+    // Creates a deferred context, whose recorded commands are thrown away rather than executed.
+    ComPtr<ID3D11DeviceContext> CreateDeferredContext(_In_ ID3D11Device* device)
+    {
+        ComPtr<ID3D11DeviceContext> context;
+
+        ThrowIfFailed(
+            device->CreateDeferredContext(0, &context)
+        );
+
+        return context;
+    }
+
+
+    // Discards the commands recorded so far, so a deferred context does not keep growing between runs.
+    void DiscardCommands(_In_ ID3D11DeviceContext* context)
+    {
+        ComPtr<ID3D11CommandList> commandList;
+
+        ThrowIfFailed(
+            context->FinishCommandList(FALSE, &commandList)
+        );
+    }
+
+
+    // Creates a white RGBA texture.
+    ComPtr<ID3D11ShaderResourceView> CreateTestTexture(_In_ ID3D11Device* device, UINT width, UINT height)
+    {
+        std::vector<uint32_t> pixels(width * height, 0xFFFFFFFF);
+
+        D3D11_TEXTURE2D_DESC desc = { 0 };
+
+        desc.Width = width;
+        desc.Height = height;
+        desc.MipLevels = 1;
+        desc.ArraySize = 1;
+        desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+        desc.SampleDesc.Count = 1;
+        desc.Usage = D3D11_USAGE_IMMUTABLE;
+        desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+        D3D11_SUBRESOURCE_DATA initData = { pixels.data(), static_cast<UINT>(width * sizeof(uint32_t)), 0 };
+
+        ComPtr<ID3D11Texture2D> texture;
+
+        ThrowIfFailed(
+            device->CreateTexture2D(&desc, &initData, &texture)
+        );
+
+        ComPtr<ID3D11ShaderResourceView> textureView;
+
+        ThrowIfFailed(
+            device->CreateShaderResourceView(texture.Get(), nullptr, &textureView)
+        );
+
+        return textureView;
+    }
+
+
+    // Limits the ConcRT work that the calling thread starts, such as SpriteBatch's parallel_for, to a number of cores.
+    class ScopedConcurrencyLimit
+    {
+    public:
+        explicit ScopedConcurrencyLimit(unsigned int maxConcurrency)
+        {
+            Concurrency::CurrentScheduler::Create(Concurrency::SchedulerPolicy(2, Concurrency::MinConcurrency, 1,
+                                                                                  Concurrency::MaxConcurrency, maxConcurrency));
+        }
+
+        ~ScopedConcurrencyLimit()
+        {
+            Concurrency::CurrentScheduler::Detach();
+        }
+
+    private:
+        ScopedConcurrencyLimit(ScopedConcurrencyLimit const&);
+        ScopedConcurrencyLimit& operator= (ScopedConcurrencyLimit const&);
+    };
+
+
+    //----------------------------------------------------------------------------------
+    // SpriteBatch sorting: the comparison sorts SpriteBatch used to run over its sprite
+    // pointers, against the packed keys and radix sort it uses now.
+    //----------------------------------------------------------------------------------
+
+    // Stands in for SpriteBatch::Impl::SpriteInfo, which is 80 bytes.
+    struct BenchSprite
+    {
+        float fields[15];
+        float depth;
+        void const* texture;
+    };
+
+
+    struct BenchSortEntry
+    {
+        uint64_t key;
+        uint32_t index;
+    };
+
+
+    void BenchSort()
+    {
+        static const size_t spriteCounts[] = { 1000, 10000, 100000 };
+        static const size_t textureCount = 16;
+
+        static char const textures[textureCount] = {};
+
+        printf("%10s  %-14s %12s %12s %8s\n", "sprites", "mode", "std::sort", "radix", "speedup");
+
+        for (size_t c = 0; c < _countof(spriteCounts); c++)
+        {
+            size_t count = spriteCounts[c];
+
+            std::mt19937 random(12345);
+            std::uniform_real_distribution<float> depthDistribution(0, 1);
+
+            std::vector<BenchSprite> sprites(count);
+
+            for (size_t i = 0; i < count; i++)
+            {
+                memset(&sprites[i], 0, sizeof(BenchSprite));
+
+                sprites[i].depth = depthDistribution(random);
+                sprites[i].texture = &textures[random() % textureCount];
+            }
+
+            std::vector<BenchSprite const*> sorted(count);
+            std::vector<BenchSortEntry> entries(count);
+            std::vector<BenchSortEntry> scratch(count);
+            DenseIdTable textureIds;
+
+            for (int mode = 0; mode < 2; mode++)
+            {
+                bool byTexture = (mode == 0);
+
+                // Before: sort pointers to the queued sprites with a comparison on the sprite fields.
+                double comparisonTime = TimeBest(DefaultRuns, [&]
+                {
+                    for (size_t i = 0; i < count; i++)
+                    {
+                        sorted[i] = &sprites[i];
+                    }
+
+                    if (byTexture)
+                    {
+                        std::sort(sorted.begin(), sorted.end(), [](BenchSprite const* x, BenchSprite const* y)
+                        {
+                            return x->texture < y->texture;
+                        });
+                    }
+                    else
+                    {
+                        std::sort(sorted.begin(), sorted.end(), [](BenchSprite const* x, BenchSprite const* y)
+                        {
+                            return x->depth > y->depth;
+                        });
+                    }
+                });
+
+                // After: build 64-bit keys as SpriteBatch::Impl::FillSortKeys does, then radix sort them.
+                double radixTime = TimeBest(DefaultRuns, [&]
+                {
+                    textureIds.Reset();
+
+                    for (size_t i = 0; i < count; i++)
+                    {
+                        uint64_t textureId = textureIds.GetId(sprites[i].texture);
+
+                        entries[i].key = byTexture ? textureId : (uint64_t(~SortableFloatBits(sprites[i].depth)) << 32) | textureId;
+                        entries[i].index = static_cast<uint32_t>(i);
+                    }
+
+                    BenchSortEntry const* result = RadixSortByKey(entries.data(), scratch.data(), count);
+
+                    for (size_t i = 0; i < count; i++)
+                    {
+                        sorted[i] = &sprites[result[i].index];
+                    }
+                });
+
+                printf("%10zu  %-14s %10.3fms %10.3fms %7.2fx\n", count, byTexture ? "Texture" : "BackToFront", comparisonTime, radixTime, comparisonTime / radixTime);
+            }
+        }
+    }
+
+
+    //----------------------------------------------------------------------------------
+    // SpriteBatch vertex generation: the cost of End for one large deferred batch, which
+    // is dominated by RenderSprites. Run on a single core, so the parallel split of large
+    // batches does not hide the per-sprite cost.
+    //----------------------------------------------------------------------------------
+
+    struct BenchSpriteParams
+    {
+        XMFLOAT2 position;
+        RECT sourceRectangle;
+        XMFLOAT4 color;
+        float rotation;
+        SpriteEffects effects;
+    };
+
+
+    enum SpriteMix
+    {
+        SpriteMix_Plain,    // Whole texture, no rotation or flips.
+        SpriteMix_Rotated,  // Rotated around the center, scaled.
+        SpriteMix_Mixed,    // Source rectangles, rotation, flips and colors all vary.
+    };
+
+
+    std::vector<BenchSpriteParams> CreateSpriteParams(size_t count, SpriteMix mix)
+    {
+        std::mt19937 random(54321);
+        std::uniform_real_distribution<float> unit(0, 1);
+
+        std::vector<BenchSpriteParams> params(count);
+
+        for (size_t i = 0; i < count; i++)
+        {
+            BenchSpriteParams& p = params[i];
+
+            p.position = XMFLOAT2(unit(random) * 1920, unit(random) * 1080);
+            p.color = XMFLOAT4(1, 1, 1, 1);
+            p.rotation = (mix == SpriteMix_Plain) ? 0 : unit(random) * XM_2PI;
+            p.effects = SpriteEffects_None;
+
+            RECT whole = { 0, 0, 256, 256 };
+
+            p.sourceRectangle = whole;
+
+            if (mix == SpriteMix_Mixed)
+            {
+                LONG x = static_cast<LONG>(random() % 192);
+                LONG y = static_cast<LONG>(random() % 192);
+
+                RECT source = { x, y, x + 64, y + 64 };
+
+                p.sourceRectangle = source;
+                p.color = XMFLOAT4(unit(random), unit(random), unit(random), 1);
+                p.effects = static_cast<SpriteEffects>(random() % 4);
+            }
+        }
+
+        return params;
+    }
+
+
+    // Queues the sprites, then times only End, which generates the vertices and submits the draws.
+    double TimeSpriteBatchEnd(SpriteBatch& spriteBatch, _In_ ID3D11DeviceContext* context, _In_ ID3D11ShaderResourceView* texture, std::vector<BenchSpriteParams> const& params)
+    {
+        const XMFLOAT2 origin(128, 128);
+
+        double best = DBL_MAX;
+
+        for (size_t run = 0; run < DefaultRuns; run++)
+        {
+            spriteBatch.Begin();
+
+            for (auto it = params.begin(); it != params.end(); ++it)
+            {
+                spriteBatch.Draw(texture, it->position, &it->sourceRectangle, XMLoadFloat4(&it->color), it->rotation, origin, 0.25f, it->effects);
+            }
+
+            auto start = Clock::now();
+
+            spriteBatch.End();
+
+            best = std::min(best, ElapsedMs(start, Clock::now()));
+
+            DiscardCommands(context);
+        }
+
+        return best;
+    }
+
+
+    void BenchVertices()
+    {
+        static const size_t spriteCount = 100000;
+
+        static const struct { SpriteMix mix; char const* name; } mixes[] =
+        {
+            { SpriteMix_Plain,   "plain" },
+            { SpriteMix_Rotated, "rotated" },
+            { SpriteMix_Mixed,   "mixed" },
+        };
+
+        auto device = CreateWarpDevice();
+        auto context = CreateDeferredContext(device.Get());
+        auto texture = CreateTestTexture(device.Get(), 256, 256);
+
+        // A batch size that fits every sprite in one Map.
+        SpriteBatch spriteBatch(context.Get(), 128 * 1024);
+
+        D3D11_VIEWPORT viewport = { 0, 0, 1920, 1080, 0, 1 };
+
+        spriteBatch.SetViewport(viewport);
+
+        ScopedConcurrencyLimit singleCore(1);
+
+        printf("%10s  %-10s %12s %12s\n", "sprites", "mix", "End", "per sprite");
+
+        for (size_t m = 0; m < _countof(mixes); m++)
+        {
+            auto params = CreateSpriteParams(spriteCount, mixes[m].mix);
+
+            double time = TimeSpriteBatchEnd(spriteBatch, context.Get(), texture.Get(), params);
+
+            printf("%10zu  %-10s %10.3fms %10.2fns\n", spriteCount, mixes[m].name, time, time * 1e6 / spriteCount);
+        }
+    }
+
+
+    //----------------------------------------------------------------------------------
+    // SpriteBatch parallel preparation: End on one core against all cores. Runs below
+    // 1024 sprites per Map stay serial either way.
+    //----------------------------------------------------------------------------------
+
+    void BenchParallel()
+    {
+        static const size_t spriteCounts[] = { 1000, 4000, 16000, 100000 };
+
+        auto device = CreateWarpDevice();
+        auto context = CreateDeferredContext(device.Get());
+        auto texture = CreateTestTexture(device.Get(), 256, 256);
+
+        SpriteBatch spriteBatch(context.Get(), 128 * 1024);
+
+        D3D11_VIEWPORT viewport = { 0, 0, 1920, 1080, 0, 1 };
+
+        spriteBatch.SetViewport(viewport);
+
+        printf("%u hardware threads\n\n", std::thread::hardware_concurrency());
+        printf("%10s %12s %12s %8s\n", "sprites", "1 core", "all cores", "speedup");
+
+        for (size_t c = 0; c < _countof(spriteCounts); c++)
+        {
+            auto params = CreateSpriteParams(spriteCounts[c], SpriteMix_Rotated);
+
+            double serialTime;
+
+            {
+                ScopedConcurrencyLimit singleCore(1);
+
+                serialTime = TimeSpriteBatchEnd(spriteBatch, context.Get(), texture.Get(), params);
+            }
+
+            double parallelTime = TimeSpriteBatchEnd(spriteBatch, context.Get(), texture.Get(), params);
+
+            printf("%10zu %10.3fms %10.3fms %7.2fx\n", spriteCounts[c], serialTime, parallelTime, serialTime / parallelTime);
+        }
+    }
+
+
+    //----------------------------------------------------------------------------------
+    // TextureAtlas packing: skyline packer time and page occupancy for random icon sizes.
+    //----------------------------------------------------------------------------------
+
+    void BenchAtlas()
+    {
+        static const size_t imageCounts[] = { 256, 1024, 4096 };
+
+        static const UINT maxImageSize = 128;
+
+        std::vector<uint32_t> pixels(maxImageSize * maxImageSize);
+
+        printf("%10s %8s %10s %12s\n", "images", "pages", "occupancy", "Pack");
+
+        for (size_t c = 0; c < _countof(imageCounts); c++)
+        {
+            std::mt19937 random(777);
+            std::uniform_int_distribution<UINT> sizeDistribution(8, maxImageSize);
+
+            TextureAtlas atlas(2048, 2048, 1);
+
+            for (size_t i = 0; i < imageCounts[c]; i++)
+            {
+                UINT width = sizeDistribution(random);
+                UINT height = sizeDistribution(random);
+
+                atlas.AddImage(width, height, pixels.data(), maxImageSize * sizeof(uint32_t));
+            }
+
+            double time = TimeBest(DefaultRuns, [&]
+            {
+                atlas.Pack();
+            });
+
+            printf("%10zu %8zu %9.1f%% %10.3fms\n", imageCounts[c], atlas.GetPageCount(), atlas.GetOccupancy() * 100, time);
+        }
+    }
+
+
+    //----------------------------------------------------------------------------------
+    // SpriteFont glyph lookup, for a Latin font and for one that also has the 20992 CJK
+    // Unified Ideographs. std::binary_search over the same glyphs stands in for the
+    // search FindGlyph used to do.
+    //----------------------------------------------------------------------------------
+
+    const wchar_t FirstCjkCharacter = 0x4E00;
+    const wchar_t LastCjkCharacter = 0x9FFF;
+
+
+    // Synthesizes glyphs for printable ASCII, and optionally the CJK Unified Ideographs block.
+    std::vector<SpriteFont::Glyph> CreateTestGlyphs(bool includeCjk)
+    {
+        std::vector<SpriteFont::Glyph> glyphs;
+
+        for (uint32_t character = 32; character <= LastCjkCharacter; character++)
+        {
+            bool isCjk = (character >= FirstCjkCharacter);
+
+            if (character > 126 && !(includeCjk && isCjk))
+                continue;
+
+            SpriteFont::Glyph glyph;
+
+            glyph.Character = character;
+            glyph.Subrect.left = 0;
+            glyph.Subrect.top = 0;
+            glyph.Subrect.right = isCjk ? 16 : 8;
+            glyph.Subrect.bottom = 16;
+            glyph.XOffset = 0;
+            glyph.YOffset = 0;
+            glyph.XAdvance = isCjk ? 16.0f : 8.0f;
+
+            glyphs.push_back(glyph);
+        }
+
+        return glyphs;
+    }
+
+
+    // Creates a font from synthesized glyphs. Measuring and wrapping never touch the texture, so there is none.
+    std::unique_ptr<SpriteFont> CreateTestFont(std::vector<SpriteFont::Glyph> const& glyphs)
+    {
+        std::unique_ptr<SpriteFont> font(new SpriteFont(nullptr, glyphs.data(), glyphs.size(), 20));
+
+        font->SetDefaultCharacter(L'?');
+
+        return font;
+    }
+
+
+    // Builds a null terminated paragraph of space separated words, either Latin or CJK.
+    std::vector<wchar_t> CreateTestText(size_t length, bool cjk)
+    {
+        std::mt19937 random(2468);
+
+        std::vector<wchar_t> text;
+
+        while (text.size() < length)
+        {
+            size_t wordLength = cjk ? 4 + random() % 20 : 2 + random() % 8;
+
+            for (size_t i = 0; i < wordLength && text.size() < length; i++)
+            {
+                if (cjk)
+                {
+                    text.push_back(static_cast<wchar_t>(FirstCjkCharacter + random() % (LastCjkCharacter - FirstCjkCharacter + 1)));
+                }
+                else
+                {
+                    text.push_back(static_cast<wchar_t>(L'a' + random() % 26));
+                }
+            }
+
+            if (text.size() < length)
+            {
+                text.push_back(L' ');
+            }
+        }
+
+        text.push_back(0);
+
+        return text;
+    }
+
+
+    void BenchGlyphs()
+    {
+        static const size_t textLength = 10000;
+
+        static const struct { bool cjk; char const* name; } fonts[] =
+        {
+            { false, "Latin" },
+            { true,  "CJK" },
+        };
+
+        printf("%8s %8s %16s %16s %16s\n", "font", "glyphs", "binary_search", "ContainsChar", "MeasureString");
+
+        for (size_t f = 0; f < _countof(fonts); f++)
+        {
+            auto glyphs = CreateTestGlyphs(fonts[f].cjk);
+            auto font = CreateTestFont(glyphs);
+            auto text = CreateTestText(textLength, fonts[f].cjk);
+
+            size_t searchFound = 0;
+            size_t tableFound = 0;
+
+            double searchTime = TimeBest(DefaultRuns, [&]
+            {
+                searchFound = 0;
+
+                for (size_t i = 0; i < textLength; i++)
+                {
+                    SpriteFont::Glyph key;
+
+                    key.Character = text[i];
+
+                    searchFound += std::binary_search(glyphs.begin(), glyphs.end(), key, [](SpriteFont::Glyph const& x, SpriteFont::Glyph const& y)
+                    {
+                        return x.Character < y.Character;
+                    });
+                }
+            });
+
+            double tableTime = TimeBest(DefaultRuns, [&]
+            {
+                tableFound = 0;
+
+                for (size_t i = 0; i < textLength; i++)
+                {
+                    tableFound += font->ContainsCharacter(text[i]);
+                }
+            });
+
+            XMFLOAT2 size;
+
+            double measureTime = TimeBest(DefaultRuns, [&]
+            {
+                XMStoreFloat2(&size, font->MeasureString(text.data()));
+            });
+
+            if (searchFound != tableFound)
+                throw std::exception("Glyph lookups disagree");
+
+            printf("%8s %8zu %12.2fns/ch %12.2fns/ch %12.2fns/ch\n", fonts[f].name, glyphs.size(),
+                   searchTime * 1e6 / textLength, tableTime * 1e6 / textLength, measureTime * 1e6 / textLength);
+        }
+    }
+
+
+    //----------------------------------------------------------------------------------
+    // SpriteFont word wrapping of 10k character paragraphs at two widths.
+    //----------------------------------------------------------------------------------
+
+    void BenchWrap()
+    {
+        static const size_t textLength = 10000;
+
+        static const float widths[] = { 320, 1280 };
+
+        static const struct { bool cjk; char const* name; } fonts[] =
+        {
+            { false, "Latin" },
+            { true,  "CJK" },
+        };
+
+        printf("%8s %8s %8s %12s %12s\n", "font", "width", "lines", "WrapString", "per char");
+
+        for (size_t f = 0; f < _countof(fonts); f++)
+        {
+            auto glyphs = CreateTestGlyphs(fonts[f].cjk);
+            auto font = CreateTestFont(glyphs);
+            auto text = CreateTestText(textLength, fonts[f].cjk);
+
+            for (size_t w = 0; w < _countof(widths); w++)
+            {
+                std::vector<SpriteFont::TextLine> lines(font->WrapString(text.data(), widths[w], nullptr, 0));
+
+                double time = TimeBest(DefaultRuns, [&]
+                {
+                    font->WrapString(text.data(), widths[w], lines.data(), lines.size());
+                });
+
+                printf("%8s %8.0f %8zu %10.3fms %10.2fns\n", fonts[f].name, widths[w], lines.size(), time, time * 1e6 / textLength);
+            }
+        }
+    }
+
+
+    //----------------------------------------------------------------------------------
+    // GeometricPrimitive vertex cache efficiency of every built in shape, before and after
+    // OptimizeForVertexCache, at the default sizes and tessellations.
+    //----------------------------------------------------------------------------------
+
+    typedef GeometricPrimitive::VertexType ShapeVertex;
+
+    struct Shape
+    {
+        char const* name;
+        void (*compute)(std::vector<ShapeVertex>& vertices, std::vector<uint32_t>& indices);
+    };
+
+    const Shape shapes[] =
+    {
+        { "cube",         [](std::vector<ShapeVertex>& v, std::vector<uint32_t>& i) { GeometricPrimitive::ComputeCube(v, i); } },
+        { "sphere",       [](std::vector<ShapeVertex>& v, std::vector<uint32_t>& i) { GeometricPrimitive::ComputeSphere(v, i); } },
+        { "geosphere",    [](std::vector<ShapeVertex>& v, std::vector<uint32_t>& i) { GeometricPrimitive::ComputeGeoSphere(v, i); } },
+        { "cylinder",     [](std::vector<ShapeVertex>& v, std::vector<uint32_t>& i) { GeometricPrimitive::ComputeCylinder(v, i); } },
+        { "cone",         [](std::vector<ShapeVertex>& v, std::vector<uint32_t>& i) { GeometricPrimitive::ComputeCone(v, i); } },
+        { "torus",        [](std::vector<ShapeVertex>& v, std::vector<uint32_t>& i) { GeometricPrimitive::ComputeTorus(v, i); } },
+        { "tetrahedron",  [](std::vector<ShapeVertex>& v, std::vector<uint32_t>& i) { GeometricPrimitive::ComputeTetrahedron(v, i); } },
+        { "octahedron",   [](std::vector<ShapeVertex>& v, std::vector<uint32_t>& i) { GeometricPrimitive::ComputeOctahedron(v, i); } },
+        { "dodecahedron", [](std::vector<ShapeVertex>& v, std::vector<uint32_t>& i) { GeometricPrimitive::ComputeDodecahedron(v, i); } },
+        { "icosahedron",  [](std::vector<ShapeVertex>& v, std::vector<uint32_t>& i) { GeometricPrimitive::ComputeIcosahedron(v, i); } },
+        { "teapot",       [](std::vector<ShapeVertex>& v, std::vector<uint32_t>& i) { GeometricPrimitive::ComputeTeapot(v, i); } },
+    };
+
+
+    void BenchAcmr()
+    {
+        printf("%14s %10s %10s %10s %10s %12s\n", "shape", "vertices", "triangles", "ACMR", "optimized", "optimize");
+
+        for (size_t s = 0; s < _countof(shapes); s++)
+        {
+            std::vector<ShapeVertex> vertices;
+            std::vector<uint32_t> indices;
+
+            shapes[s].compute(vertices, indices);
+
+            float before = GeometricPrimitive::ComputeACMR(indices);
+
+            std::vector<ShapeVertex> optimizedVertices;
+            std::vector<uint32_t> optimizedIndices;
+
+            double time = TimeBest(DefaultRuns, [&]
+            {
+                optimizedVertices = vertices;
+                optimizedIndices = indices;
+
+                GeometricPrimitive::OptimizeForVertexCache(optimizedVertices, optimizedIndices);
+            });
+
+            float after = GeometricPrimitive::ComputeACMR(optimizedIndices);
+
+            printf("%14s %10zu %10zu %10.3f %10.3f %10.3fms\n", shapes[s].name, vertices.size(), indices.size() / 3, before, after, time);
+        }
+    }
+
+
+    //----------------------------------------------------------------------------------
+    // GeometricPrimitive geodesic sphere generation at tessellations 1 to 8, which is
+    // dominated by looking up the midpoints of shared edges while subdividing.
+    //----------------------------------------------------------------------------------
+
+    void BenchGeoSphere()
+    {
+        printf("%14s %10s %10s %12s %12s\n", "tessellation", "vertices", "triangles", "ComputeGeoSphere", "per tri");
+
+        std::vector<ShapeVertex> vertices;
+        std::vector<uint32_t> indices;
+
+        for (size_t tessellation = 1; tessellation <= 8; tessellation++)
+        {
+            size_t runs = (tessellation < 7) ? DefaultRuns : 3;
+
+            double time = TimeBest(runs, [&]
+            {
+                GeometricPrimitive::ComputeGeoSphere(vertices, indices, 1, tessellation);
+            });
+
+            size_t triangles = indices.size() / 3;
+
+            printf("%14zu %10zu %10zu %14.3fms %10.1fns\n", tessellation, vertices.size(), triangles, time, time * 1e6 / triangles);
+        }
+    }
+
+
+    //----------------------------------------------------------------------------------
+    // GeometricPrimitive teapot generation, which evaluates 32 bezier patches, up to
+    // tessellation 64.
+    //----------------------------------------------------------------------------------
+
+    void BenchTeapot()
+    {
+        static const size_t tessellations[] = { 8, 16, 32, 64 };
+
+        printf("%14s %10s %10s %16s %12s\n", "tessellation", "vertices", "triangles", "ComputeTeapot", "per vertex");
+
+        std::vector<ShapeVertex> vertices;
+        std::vector<uint32_t> indices;
+
+        for (size_t t = 0; t < _countof(tessellations); t++)
+        {
+            double time = TimeBest(DefaultRuns, [&]
+            {
+                GeometricPrimitive::ComputeTeapot(vertices, indices, 1, tessellations[t]);
+            });
+
+            printf("%14zu %10zu %10zu %14.3fms %10.1fns\n", tessellations[t], vertices.size(), indices.size() / 3, time, time * 1e6 / vertices.size());
+        }
+    }
+
+
+    //----------------------------------------------------------------------------------
+    // GeometricPrimitive level of detail generation for finely tessellated shapes, with
+    // the triangle count and error of every level.
+    //----------------------------------------------------------------------------------
+
+    void BenchLods()
+    {
+        static const Shape lodShapes[] =
+        {
+            { "sphere 64",    [](std::vector<ShapeVertex>& v, std::vector<uint32_t>& i) { GeometricPrimitive::ComputeSphere(v, i, 1, 64); } },
+            { "geosphere 5",  [](std::vector<ShapeVertex>& v, std::vector<uint32_t>& i) { GeometricPrimitive::ComputeGeoSphere(v, i, 1, 5); } },
+            { "torus 64",     [](std::vector<ShapeVertex>& v, std::vector<uint32_t>& i) { GeometricPrimitive::ComputeTorus(v, i, 1, 0.333f, 64); } },
+            { "teapot 16",    [](std::vector<ShapeVertex>& v, std::vector<uint32_t>& i) { GeometricPrimitive::ComputeTeapot(v, i, 1, 16); } },
+        };
+
+        printf("%14s %10s %12s %16s %s\n", "shape", "triangles", "ComputeLods", "throughput", "level triangles (error)");
+
+        for (size_t s = 0; s < _countof(lodShapes); s++)
+        {
+            std::vector<ShapeVertex> vertices;
+            std::vector<uint32_t> indices;
+
+            lodShapes[s].compute(vertices, indices);
+
+            // Every level shares the vertices, so optimize them once up front as a caller would.
+            GeometricPrimitive::OptimizeForVertexCache(vertices, indices);
+
+            std::vector<uint32_t> lodIndices;
+            std::vector<GeometricPrimitive::LodLevel> lods;
+
+            double time = TimeBest(DefaultRuns, [&]
+            {
+                lodIndices = indices;
+
+                GeometricPrimitive::ComputeLods(vertices, lodIndices, lods);
+            });
+
+            size_t triangles = indices.size() / 3;
+
+            printf("%14s %10zu %10.3fms %10.2fMtri/s ", lodShapes[s].name, triangles, time, triangles / (time * 1000));
+
+            for (auto it = lods.begin(); it != lods.end(); ++it)
+            {
+                printf(" %u (%.4f)", it->indexCount / 3, it->error);
+            }
+
+            printf("\n");
+        }
+    }
+
+
+    //----------------------------------------------------------------------------------
+    // SpriteFont loading of a .spritefont file holding 21k glyphs, Latin plus every CJK
+    // Unified Ideograph, with a 4096x2048 BC2 texture. Peak working set only grows, so it
+    // is only meaningful when this section runs on its own.
+    //----------------------------------------------------------------------------------
+
+    const char fontFileName[] = "DirectXTKBench.spritefont";
+    const wchar_t fontFileNameW[] = L"DirectXTKBench.spritefont";
+
+
+    template<typename T>
+    void WriteValue(std::ofstream& file, T const& value)
+    {
+        file.write(reinterpret_cast<char const*>(&value), sizeof(T));
+    }
+
+
+    // Writes the test glyphs in the MakeSpriteFont binary format, laid out in a grid on the texture. The texture is
+    // written a row of blocks at a time, so creating the file doesn't raise the peak working set.
+    size_t WriteTestFontFile(_In_z_ char const* fileName)
+    {
+        static const UINT textureWidth = 4096;
+        static const UINT textureHeight = 2048;
+        static const LONG cellSize = 18;
+
+        auto glyphs = CreateTestGlyphs(true);
+
+        LONG cellsPerRow = textureWidth / cellSize;
+
+        for (size_t i = 0; i < glyphs.size(); i++)
+        {
+            auto& rect = glyphs[i].Subrect;
+
+            LONG width = rect.right - rect.left;
+            LONG height = rect.bottom - rect.top;
+
+            rect.left = static_cast<LONG>(i % cellsPerRow) * cellSize;
+            rect.top = static_cast<LONG>(i / cellsPerRow) * cellSize;
+            rect.right = rect.left + width;
+            rect.bottom = rect.top + height;
+        }
+
+        if (glyphs.back().Subrect.bottom > static_cast<LONG>(textureHeight))
+            throw std::exception("Test glyphs do not fit the font texture");
+
+        // BC2 stores 4x4 pixel blocks of 16 bytes.
+        UINT textureStride = (textureWidth / 4) * 16;
+        UINT textureRows = textureHeight / 4;
+
+        std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+
+        file.write("DXTKfont", 8);
+
+        WriteValue(file, static_cast<uint32_t>(glyphs.size()));
+        file.write(reinterpret_cast<char const*>(glyphs.data()), glyphs.size() * sizeof(SpriteFont::Glyph));
+
+        WriteValue(file, 20.0f);
+        WriteValue(file, static_cast<uint32_t>(L'?'));
+
+        WriteValue(file, textureWidth);
+        WriteValue(file, textureHeight);
+        WriteValue(file, static_cast<uint32_t>(DXGI_FORMAT_BC2_UNORM));
+        WriteValue(file, textureStride);
+        WriteValue(file, textureRows);
+
+        std::vector<char> row(textureStride, 0x55);
+
+        for (UINT i = 0; i < textureRows; i++)
+        {
+            file.write(row.data(), row.size());
+        }
+
+        if (!file)
+            throw std::exception("Failed to write the test font");
+
+        return glyphs.size();
+    }
+
+
+    // Returns the working set of the process, now and at its highest so far, in bytes.
+    void GetWorkingSet(_Out_ size_t* current, _Out_ size_t* peak)
+    {
+        PROCESS_MEMORY_COUNTERS counters = { 0 };
+
+        if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+            throw std::exception("GetProcessMemoryInfo");
+
+        *current = counters.WorkingSetSize;
+        *peak = counters.PeakWorkingSetSize;
+    }
+
+
+    void BenchFontLoad()
+    {
+        static const double MB = 1024 * 1024;
+
+        auto device = CreateWarpDevice();
+
+        size_t glyphCount = WriteTestFontFile(fontFileName);
+
+        size_t baseline, peak;
+
+        GetWorkingSet(&baseline, &peak);
+
+        // The first load is the one a game sees, though the file is already in the OS cache from being written.
+        auto start = Clock::now();
+
+        std::unique_ptr<SpriteFont> font(new SpriteFont(device.Get(), fontFileNameW));
+
+        double firstTime = ElapsedMs(start, Clock::now());
+
+        size_t loaded;
+
+        GetWorkingSet(&loaded, &peak);
+
+        double time = TimeBest(DefaultRuns, [&]
+        {
+            font.reset(new SpriteFont(device.Get(), fontFileNameW));
+        });
+
+        // The font is still alive, so this only succeeds if loading let go of the file.
+        bool removable = (remove(fontFileName) == 0);
+
+        font.reset();
+
+        if (!removable)
+            remove(fontFileName);
+
+        printf("%8s %12s %12s %14s %14s %18s\n", "glyphs", "first load", "best load", "working set", "peak growth", "file removable");
+
+        printf("%8zu %10.3fms %10.3fms %12.1fMB %12.1fMB %18s\n", glyphCount, firstTime, time,
+               (double(loaded) - double(baseline)) / MB, (double(peak) - double(baseline)) / MB, removable ? "yes" : "no");
+    }
+
+
+    struct Section
+    {
+        char const* name;
+        char const* description;
+        void (*run)();
+    };
+
+    const Section sections[] =
+    {
+        { "sort",      "SpriteBatch sprite sorting at 1k, 10k and 100k sprites", BenchSort },
+        { "vertices",  "SpriteBatch vertex generation for 100k sprites on one core", BenchVertices },
+        { "parallel",  "SpriteBatch End on one core against all cores", BenchParallel },
+        { "atlas",     "TextureAtlas packing of 256, 1024 and 4096 random images", BenchAtlas },
+        { "glyphs",    "SpriteFont glyph lookup over 10k characters", BenchGlyphs },
+        { "wrap",      "SpriteFont word wrapping of 10k character paragraphs", BenchWrap },
+        { "fontload",  "SpriteFont loading of a 21k glyph CJK font file, with working set growth", BenchFontLoad },
+        { "acmr",      "GeometricPrimitive vertex cache miss ratio of every shape, before and after optimizing", BenchAcmr },
+        { "geosphere", "GeometricPrimitive geodesic sphere generation at tessellations 1 to 8", BenchGeoSphere },
+        { "teapot",    "GeometricPrimitive teapot generation at tessellations 8 to 64", BenchTeapot },
+        { "lods",      "GeometricPrimitive level of detail generation and triangle reduction", BenchLods },
+    };
+}
+
+
+int __cdecl main(int argc, char* argv[])
+{
+    for (int i = 1; i < argc; i++)
+    {
+        bool found = false;
+
+        for (size_t j = 0; j < _countof(sections); j++)
+        {
+            found |= (strcmp(argv[i], sections[j].name) == 0);
+        }
+
+        if (!found)
+        {
+            printf("Unknown section '%s'. Sections are:\n", argv[i]);
+
+            for (size_t j = 0; j < _countof(sections); j++)
+            {
+                printf("  %-10s %s\n", sections[j].name, sections[j].description);
+            }
+
+            return 1;
+        }
+    }
+
+    for (size_t j = 0; j < _countof(sections); j++)
+    {
+        bool selected = (argc == 1);
+
+        for (int i = 1; i < argc; i++)
+        {
+            selected |= (strcmp(argv[i], sections[j].name) == 0);
+        }
+
+        if (selected)
+        {
+            printf("\n== %s: %s\n\n", sections[j].name, sections[j].description);
+
+            try
+            {
+                sections[j].run();
+            }
+            catch (std::exception const& e)
+            {
+                printf("Section failed: %s\n", e.what());
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
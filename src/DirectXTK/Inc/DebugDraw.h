@@ -0,0 +1,76 @@
+//--------------------------------------------------------------------------------------
+// File: DebugDraw.h
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// http://go.microsoft.com/fwlink/?LinkId=248929
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#if defined(_XBOX_ONE) && defined(_TITLE)
+#include <d3d11_x.h>
+#else
+#include <d3d11_1.h>
+#endif
+
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+#include <memory>
+
+
+namespace DirectX
+{
+    #if (DIRECTX_MATH_VERSION < 305) && !defined(XM_CALLCONV)
+    #define XM_CALLCONV __fastcall
+    typedef const XMVECTOR& HXMVECTOR;
+    typedef const XMMATRIX& FXMMATRIX;
+    #endif
+
+    // Collects wireframe debug shapes over the course of a frame, then expands them to line list
+    // vertices straight into the mapped PrimitiveBatch vertex buffer when drawing.
+    class DebugDraw
+    {
+    public:
+        explicit DebugDraw(_In_ ID3D11DeviceContext* deviceContext);
+        DebugDraw(DebugDraw&& moveFrom);
+        DebugDraw& operator= (DebugDraw&& moveFrom);
+        virtual ~DebugDraw();
+
+        // Shapes are drawn by the next call to Draw. If duration is positive, they keep being drawn until that
+        // many seconds have been passed to Update. Shapes without depth testing are drawn on top of everything.
+        void XM_CALLCONV AddLine(FXMVECTOR from, FXMVECTOR to, FXMVECTOR color, float duration = 0, bool depthTest = true);
+        void XM_CALLCONV AddBox(BoundingBox const& box, FXMVECTOR color, float duration = 0, bool depthTest = true);
+        void XM_CALLCONV AddBox(BoundingOrientedBox const& box, FXMVECTOR color, float duration = 0, bool depthTest = true);
+        void XM_CALLCONV AddSphere(BoundingSphere const& sphere, FXMVECTOR color, float duration = 0, bool depthTest = true);
+        void XM_CALLCONV AddFrustum(BoundingFrustum const& frustum, FXMVECTOR color, float duration = 0, bool depthTest = true);
+
+        // The grid is centered on origin, spanning from -axis to +axis in each direction.
+        void XM_CALLCONV AddGrid(FXMVECTOR xAxis, FXMVECTOR yAxis, FXMVECTOR origin, size_t xDivisions, size_t yDivisions, GXMVECTOR color, float duration = 0, bool depthTest = true);
+
+        // Counts down the remaining time of shapes that have a duration.
+        void __cdecl Update(float elapsedSeconds);
+
+        // Draws every shape, then discards those whose time is up.
+        void XM_CALLCONV Draw(FXMMATRIX view, CXMMATRIX projection);
+
+        void __cdecl Clear();
+
+        size_t __cdecl GetShapeCount() const;
+
+    private:
+        // Private implementation.
+        class Impl;
+
+        std::unique_ptr<Impl> pImpl;
+
+        // Prevent copying.
+        DebugDraw(DebugDraw const&);
+        DebugDraw& operator= (DebugDraw const&);
+    };
+}
@@ -23,6 +23,9 @@
 #include <DirectXColors.h>
 #include <functional>
 #include <memory>
+#include <vector>
+
+#include "VertexTypes.h"
 
 // VS 2010 doesn't support explicit calling convention for std::function
 #ifndef DIRECTX_STD_CALLCONV
@@ -61,11 +64,67 @@ namespace DirectX
         static std::unique_ptr<GeometricPrimitive> __cdecl CreateIcosahedron  (_In_ ID3D11DeviceContext* deviceContext, float size = 1, bool rhcoords = true);
         static std::unique_ptr<GeometricPrimitive> __cdecl CreateTeapot       (_In_ ID3D11DeviceContext* deviceContext, float size = 1, size_t tessellation = 8, bool rhcoords = true);
 
+        // Creates a primitive from geometry computed by the caller. Primitives with 65535 or more vertices
+        // use a 32-bit index buffer, which requires Feature Level 9.2 or later.
+        static std::unique_ptr<GeometricPrimitive> __cdecl CreateCustom(_In_ ID3D11DeviceContext* deviceContext, std::vector<VertexPositionNormalTexture> const& vertices, std::vector<uint32_t> const& indices);
+        static std::unique_ptr<GeometricPrimitive> __cdecl CreateCustom(_In_ ID3D11DeviceContext* deviceContext, std::vector<VertexPositionNormalTexture> const& vertices, std::vector<uint16_t> const& indices);
+
+        // Geometry generators, which fill in the caller's collections without touching the device.
+        // These can run on any thread, and reuse the capacity of the collections passed in.
+        typedef VertexPositionNormalTexture VertexType;
+
+        static void __cdecl ComputeCube         (std::vector<VertexType>& vertices, std::vector<uint32_t>& indices, float size = 1, bool rhcoords = true);
+        static void __cdecl ComputeSphere       (std::vector<VertexType>& vertices, std::vector<uint32_t>& indices, float diameter = 1, size_t tessellation = 16, bool rhcoords = true);
+        static void __cdecl ComputeGeoSphere    (std::vector<VertexType>& vertices, std::vector<uint32_t>& indices, float diameter = 1, size_t tessellation = 3, bool rhcoords = true);
+        static void __cdecl ComputeCylinder     (std::vector<VertexType>& vertices, std::vector<uint32_t>& indices, float height = 1, float diameter = 1, size_t tessellation = 32, bool rhcoords = true);
+        static void __cdecl ComputeCone         (std::vector<VertexType>& vertices, std::vector<uint32_t>& indices, float diameter = 1, float height = 1, size_t tessellation = 32, bool rhcoords = true);
+        static void __cdecl ComputeTorus        (std::vector<VertexType>& vertices, std::vector<uint32_t>& indices, float diameter = 1, float thickness = 0.333f, size_t tessellation = 32, bool rhcoords = true);
+        static void __cdecl ComputeTetrahedron  (std::vector<VertexType>& vertices, std::vector<uint32_t>& indices, float size = 1, bool rhcoords = true);
+        static void __cdecl ComputeOctahedron   (std::vector<VertexType>& vertices, std::vector<uint32_t>& indices, float size = 1, bool rhcoords = true);
+        static void __cdecl ComputeDodecahedron (std::vector<VertexType>& vertices, std::vector<uint32_t>& indices, float size = 1, bool rhcoords = true);
+        static void __cdecl ComputeIcosahedron  (std::vector<VertexType>& vertices, std::vector<uint32_t>& indices, float size = 1, bool rhcoords = true);
+        static void __cdecl ComputeTeapot       (std::vector<VertexType>& vertices, std::vector<uint32_t>& indices, float size = 1, size_t tessellation = 8, bool rhcoords = true);
+
+        // Reorders triangles for the post-transform vertex cache, then vertices into the order they are first used.
+        // The Create methods do this automatically; the Compute methods leave the geometry in generation order.
+        static void __cdecl OptimizeForVertexCache(std::vector<VertexType>& vertices, std::vector<uint32_t>& indices);
+
+        // Average cache miss ratio (vertices transformed per triangle) for a FIFO vertex cache of the specified size.
+        static float __cdecl ComputeACMR(std::vector<uint32_t> const& indices, size_t cacheSize = 16);
+
+        // One level of detail: a range of the index collection, drawn from the same vertices as every other level.
+        struct LodLevel
+        {
+            uint32_t startIndex;
+            uint32_t indexCount;
+            float    error;         // Largest object space distance of a full detail vertex from this level
+        };
+
+        // Appends progressively simplified copies of the mesh to the index collection, and describes every level,
+        // starting with the original, in lods. Stops early if the mesh can't be simplified much further.
+        static void __cdecl ComputeLods(std::vector<VertexType> const& vertices, std::vector<uint32_t>& indices, std::vector<LodLevel>& lods, size_t lodCount = 4);
+
+        // Creates a primitive with several levels of detail, eg. computed by ComputeLods. The Create methods for the
+        // built in shapes only have full detail, so levels of detail are opt in: Compute the shape, ComputeLods, then
+        // CreateCustom and SetLodThreshold.
+        static std::unique_ptr<GeometricPrimitive> __cdecl CreateCustom(_In_ ID3D11DeviceContext* deviceContext, std::vector<VertexType> const& vertices, std::vector<uint32_t> const& indices, std::vector<LodLevel> const& lods);
+
+        // Drawing with the built in effect uses the coarsest level of detail whose error covers no more than
+        // this many pixels on screen. Zero, the default, always draws at full detail.
+        void __cdecl SetLodThreshold(float pixels);
+
+        size_t __cdecl GetLodCount() const;
+
+        // The Create methods cache computed geometry by shape and parameters, so creating the same primitive again
+        // only uploads it. The cache is limited to 16MB, dropping the least recently created geometry first.
+        // This releases all the cached copies.
+        static void __cdecl ClearGeometryCache();
+
         // Draw the primitive.
         void XM_CALLCONV Draw(FXMMATRIX world, CXMMATRIX view, CXMMATRIX projection, FXMVECTOR color = Colors::White, _In_opt_ ID3D11ShaderResourceView* texture = nullptr, bool wireframe = false,
                               _In_opt_ std::function<void DIRECTX_STD_CALLCONV()> setCustomState = nullptr );
 
-        // Draw the primitive using a custom effect.
+        // Draw the primitive using a custom effect. This always draws at full detail.
         void __cdecl Draw( _In_ IEffect* effect, _In_ ID3D11InputLayout* inputLayout, bool alpha = false, bool wireframe = false,
                            _In_opt_ std::function<void DIRECTX_STD_CALLCONV()> setCustomState = nullptr );
 
@@ -64,6 +64,14 @@ namespace DirectX
     public:
         ModelMeshPart();
 
+        // A simplified version of the part, drawn from the same index and vertex buffers
+        struct Lod
+        {
+            uint32_t    indexCount;
+            uint32_t    startIndex;
+            float       error;          // Largest object space distance of a full detail vertex from this level
+        };
+
         uint32_t                                                indexCount;
         uint32_t                                                startIndex;
         uint32_t                                                vertexOffset;
@@ -76,12 +84,13 @@ namespace DirectX
         std::shared_ptr<IEffect>                                effect;
         std::shared_ptr<std::vector<D3D11_INPUT_ELEMENT_DESC>>  vbDecl;
         bool                                                    isAlpha;
+        std::vector<Lod>                                        lods;       // Coarser levels, in order of increasing error
 
         typedef std::vector<std::unique_ptr<ModelMeshPart>> Collection;
 
-        // Draw mesh part with custom effect
+        // Draw mesh part with custom effect (lod 0 is full detail, otherwise draws lods[lod - 1])
         void __cdecl Draw( _In_ ID3D11DeviceContext* deviceContext, _In_ IEffect* ieffect, _In_ ID3D11InputLayout* iinputLayout,
-                           _In_opt_ std::function<void DIRECTX_STD_CALLCONV()> setCustomState = nullptr ) const;
+                           _In_opt_ std::function<void DIRECTX_STD_CALLCONV()> setCustomState = nullptr, size_t lod = 0 ) const;
 
         // Create input layout for drawing with a custom effect.
         void __cdecl CreateInputLayout( _In_ ID3D11Device* d3dDevice, _In_ IEffect* ieffect, _Outptr_ ID3D11InputLayout** iinputLayout );
@@ -103,6 +112,7 @@ namespace DirectX
         std::wstring                name;
         bool                        ccw;
         bool                        pmalpha;
+        float                       lodThreshold;   // Largest error in pixels allowed when choosing a part's level of detail (0 disables)
 
         typedef std::vector<std::shared_ptr<ModelMesh>> Collection;
 
@@ -132,6 +142,10 @@ namespace DirectX
         // Update all effects used by the model
         void __cdecl UpdateEffects( _In_ std::function<void DIRECTX_STD_CALLCONV(IEffect*)> setEffect );
 
+        // Simplify every triangle list mesh part into up to lodCount levels of detail (including the original), sharing its
+        // vertex buffer. Reads the buffers back from the GPU, and gives each simplified part its own index buffer.
+        void __cdecl GenerateLods( _In_ ID3D11DeviceContext* deviceContext, size_t lodCount = 4 );
+
         // Loads a model from a Visual Studio Starter Kit .CMO file
         static std::unique_ptr<Model> __cdecl CreateFromCMO( _In_ ID3D11Device* d3dDevice, _In_reads_bytes_(dataSize) const uint8_t* meshData, size_t dataSize,
                                                              _In_ IEffectFactory& fxFactory, bool ccw = true, bool pmalpha = false );
@@ -36,7 +36,7 @@ namespace DirectX
         class PrimitiveBatchBase
         {
         protected:
-            PrimitiveBatchBase(_In_ ID3D11DeviceContext* deviceContext, size_t maxIndices, size_t maxVertices, size_t vertexSize);
+            PrimitiveBatchBase(_In_ ID3D11DeviceContext* deviceContext, size_t maxIndices, size_t maxVertices, size_t vertexSize, bool persistentMap);
             PrimitiveBatchBase(PrimitiveBatchBase&& moveFrom);
             PrimitiveBatchBase& operator= (PrimitiveBatchBase&& moveFrom);
             virtual ~PrimitiveBatchBase();
@@ -46,9 +46,22 @@ namespace DirectX
             void __cdecl Begin();
             void __cdecl End();
 
+            // Submission counters, accumulated until ResetRenderStats is called (eg. once per frame).
+            struct RenderStats
+            {
+                size_t maps;
+                size_t draws;
+                size_t wraps;
+                size_t vertices;
+            };
+
+            RenderStats __cdecl GetRenderStats() const;
+            void __cdecl ResetRenderStats();
+
         protected:
-            // Internal, untyped drawing method.
+            // Internal, untyped drawing methods.
             void __cdecl Draw(D3D11_PRIMITIVE_TOPOLOGY topology, bool isIndexed, _In_opt_count_(indexCount) uint16_t const* indices, size_t indexCount, size_t vertexCount, _Out_ void** pMappedVertices);
+            void __cdecl Draw(D3D11_PRIMITIVE_TOPOLOGY topology, _In_reads_(indexCount) uint32_t const* indices, size_t indexCount, size_t vertexCount, _Out_ void** pMappedVertices);
 
         private:
             // Private implementation.
@@ -64,14 +77,18 @@ namespace DirectX
 
 
     // Template makes the API typesafe, eg. PrimitiveBatch<VertexPositionColor>.
+    // If maxVertices is more than 65536, the index buffer uses 32 bit indices.
+    // With persistentMap set, the buffers are mapped once per Begin/End (or buffer wrap) and all draws are
+    // submitted at End, instead of flushing whenever the topology changes. This suits large numbers of mixed
+    // draws, but means state changes made between Begin and End apply to everything drawn in the batch.
     template<typename TVertex>
     class PrimitiveBatch : public Internal::PrimitiveBatchBase
     {
         static const size_t DefaultBatchSize = 2048;
 
     public:
-        PrimitiveBatch(_In_ ID3D11DeviceContext* deviceContext, size_t maxIndices = DefaultBatchSize * 3, size_t maxVertices = DefaultBatchSize)
-          : PrimitiveBatchBase(deviceContext, maxIndices, maxVertices, sizeof(TVertex))
+        PrimitiveBatch(_In_ ID3D11DeviceContext* deviceContext, size_t maxIndices = DefaultBatchSize * 3, size_t maxVertices = DefaultBatchSize, bool persistentMap = false)
+          : PrimitiveBatchBase(deviceContext, maxIndices, maxVertices, sizeof(TVertex), persistentMap)
         { }
 
         PrimitiveBatch(PrimitiveBatch&& moveFrom)
@@ -107,6 +124,16 @@ namespace DirectX
         }
 
 
+        void __cdecl DrawIndexed(D3D11_PRIMITIVE_TOPOLOGY topology, _In_reads_(indexCount) uint32_t const* indices, size_t indexCount, _In_reads_(vertexCount) TVertex const* vertices, size_t vertexCount)
+        {
+            void* mappedVertices;
+
+            PrimitiveBatchBase::Draw(topology, indices, indexCount, vertexCount, &mappedVertices);
+
+            memcpy(mappedVertices, vertices, vertexCount * sizeof(TVertex));
+        }
+
+
         void __cdecl DrawLine(TVertex const& v1, TVertex const& v2)
         {
             TVertex* mappedVertices;
@@ -41,6 +41,10 @@ namespace DirectX
     typedef const XMMATRIX& FXMMATRIX;
     #endif
 
+    class TextureAtlas;
+    class SpriteLayer;
+
+
     enum SpriteSortMode
     {
         SpriteSortMode_Deferred,
@@ -63,7 +67,11 @@ namespace DirectX
     class SpriteBatch
     {
     public:
-        explicit SpriteBatch(_In_ ID3D11DeviceContext* deviceContext);
+        // maxBatchSize is how many sprites fit in the dynamic vertex buffer before it wraps. Larger sizes mean
+        // fewer Map and DrawIndexed calls for very large batches, and switch to 32-bit indices past 16384 sprites.
+        static const size_t DefaultBatchSize = 2048;
+
+        explicit SpriteBatch(_In_ ID3D11DeviceContext* deviceContext, size_t maxBatchSize = DefaultBatchSize);
         SpriteBatch(SpriteBatch&& moveFrom);
         SpriteBatch& operator= (SpriteBatch&& moveFrom);
         virtual ~SpriteBatch();
@@ -87,6 +95,49 @@ namespace DirectX
         void XM_CALLCONV Draw(_In_ ID3D11ShaderResourceView* texture, RECT const& destinationRectangle, FXMVECTOR color = Colors::White);
         void XM_CALLCONV Draw(_In_ ID3D11ShaderResourceView* texture, RECT const& destinationRectangle, _In_opt_ RECT const* sourceRectangle, FXMVECTOR color = Colors::White, float rotation = 0, XMFLOAT2 const& origin = Float2Zero, SpriteEffects effects = SpriteEffects_None, float layerDepth = 0);
 
+        // Draw overloads for images packed into a TextureAtlas. Images on the same atlas page share a texture, so they batch together.
+        void XM_CALLCONV Draw(TextureAtlas const& atlas, uint32_t handle, XMFLOAT2 const& position, FXMVECTOR color = Colors::White);
+        void XM_CALLCONV Draw(TextureAtlas const& atlas, uint32_t handle, XMFLOAT2 const& position, FXMVECTOR color, float rotation, XMFLOAT2 const& origin = Float2Zero, float scale = 1, SpriteEffects effects = SpriteEffects_None, float layerDepth = 0);
+        void XM_CALLCONV Draw(TextureAtlas const& atlas, uint32_t handle, RECT const& destinationRectangle, FXMVECTOR color = Colors::White, float rotation = 0, XMFLOAT2 const& origin = Float2Zero, SpriteEffects effects = SpriteEffects_None, float layerDepth = 0);
+
+        // One sprite of a run drawn with DrawRun, eg. a glyph of a TextLayout. The origin is added to the origin of the run.
+        struct SpriteRunItem
+        {
+            XMFLOAT2 origin;
+            RECT sourceRectangle;
+        };
+
+        // Queues a run of sprites that share a texture and transform, differing only in source rectangle and origin.
+        void XM_CALLCONV DrawRun(_In_ ID3D11ShaderResourceView* texture, _In_reads_(count) SpriteRunItem const* items, size_t count, FXMVECTOR position, FXMVECTOR color, float rotation, FXMVECTOR origin, GXMVECTOR scale, SpriteEffects effects = SpriteEffects_None, float layerDepth = 0);
+
+        // Draws a retained SpriteLayer. Sprites queued so far are flushed first, so the layer appears after them.
+        void __cdecl Draw(SpriteLayer& layer);
+
+        // Texture sizes are cached between Begin and End. Call this before releasing a texture
+        // that was drawn with SpriteSortMode_Immediate, if the batch is still in progress.
+        void __cdecl InvalidateTextureSize(_In_ ID3D11ShaderResourceView* texture);
+
+        // Texture size cache statistics, counted since the SpriteBatch was created.
+        struct TextureSizeCacheStats
+        {
+            size_t hits;
+            size_t misses;
+        };
+
+        TextureSizeCacheStats __cdecl GetTextureSizeCacheStats() const;
+
+        // Submission counters, accumulated until ResetRenderStats is called (eg. once per frame).
+        struct RenderStats
+        {
+            size_t maps;
+            size_t draws;
+            size_t wraps;
+            size_t sprites;
+        };
+
+        RenderStats __cdecl GetRenderStats() const;
+        void __cdecl ResetRenderStats();
+
         // Rotation mode to be applied to the sprite transformation
         void __cdecl SetRotation( DXGI_MODE_ROTATION mode );
         DXGI_MODE_ROTATION __cdecl GetRotation() const;
@@ -103,8 +154,50 @@ namespace DirectX
         static const XMMATRIX MatrixIdentity;
         static const XMFLOAT2 Float2Zero;
 
+        friend class SpriteLayer;
+
         // Prevent copying.
         SpriteBatch(SpriteBatch const&);
         SpriteBatch& operator= (SpriteBatch const&);
     };
+
+
+    // A retained set of sprites sharing one texture, eg. a static HUD drawn from an atlas page.
+    // Vertices are generated into a static buffer, and only sprites changed since the last draw
+    // are regenerated and uploaded, so drawing an unchanged layer is a single DrawIndexed call.
+    class SpriteLayer
+    {
+    public:
+        SpriteLayer(_In_ ID3D11Device* device, _In_ ID3D11ShaderResourceView* texture, size_t capacity);
+        SpriteLayer(SpriteLayer&& moveFrom);
+        SpriteLayer& operator= (SpriteLayer&& moveFrom);
+        virtual ~SpriteLayer();
+
+        // Adds a sprite, returning its index for later updates.
+        size_t XM_CALLCONV Add(XMFLOAT2 const& position, _In_opt_ RECT const* sourceRectangle = nullptr, FXMVECTOR color = Colors::White, float rotation = 0, XMFLOAT2 const& origin = Float2Zero, float scale = 1, SpriteEffects effects = SpriteEffects_None, float layerDepth = 0);
+
+        // Replaces a sprite that was previously added.
+        void XM_CALLCONV Set(size_t index, XMFLOAT2 const& position, _In_opt_ RECT const* sourceRectangle = nullptr, FXMVECTOR color = Colors::White, float rotation = 0, XMFLOAT2 const& origin = Float2Zero, float scale = 1, SpriteEffects effects = SpriteEffects_None, float layerDepth = 0);
+
+        // Removes every sprite.
+        void __cdecl Clear();
+
+        size_t __cdecl GetCount() const;
+        size_t __cdecl GetCapacity() const;
+        ID3D11ShaderResourceView* __cdecl GetTexture() const;
+
+    private:
+        // Private implementation.
+        class Impl;
+
+        std::unique_ptr<Impl> pImpl;
+
+        static const XMFLOAT2 Float2Zero;
+
+        friend class SpriteBatch;
+
+        // Prevent copying.
+        SpriteLayer(SpriteLayer const&);
+        SpriteLayer& operator= (SpriteLayer const&);
+    };
 }
@@ -18,10 +18,19 @@
 
 namespace DirectX
 {
+    enum TextAlignment
+    {
+        TextAlignment_Left = 0,
+        TextAlignment_Center = 1,
+        TextAlignment_Right = 2,
+    };
+
+
     class SpriteFont
     {
     public:
         struct Glyph;
+        struct TextLine;
 
         SpriteFont(_In_ ID3D11Device* device, _In_z_ wchar_t const* fileName);
         SpriteFont(_In_ ID3D11Device* device, _In_reads_bytes_(dataSize) uint8_t const* dataBlob, _In_ size_t dataSize);
@@ -38,6 +47,16 @@ namespace DirectX
 
         XMVECTOR XM_CALLCONV MeasureString(_In_z_ wchar_t const* text) const;
 
+        // Word wraps text to fit the specified width, breaking at whitespace where possible. Writes up to maxLines
+        // lines and returns the total number needed, so passing no buffer can be used to size one. Does not allocate.
+        size_t __cdecl WrapString(_In_z_ wchar_t const* text, float maxWidth, _Out_writes_opt_(maxLines) TextLine* lines, size_t maxLines) const;
+
+        // Draws text word wrapped to maxWidth, with each line aligned within that width.
+        void XM_CALLCONV DrawWrappedString(_In_ SpriteBatch* spriteBatch, _In_z_ wchar_t const* text, FXMVECTOR position, float maxWidth, TextAlignment alignment = TextAlignment_Left, FXMVECTOR color = Colors::White, float layerDepth = 0);
+
+        // Size of the wrapped text: the widest line, by line count times line spacing.
+        XMVECTOR XM_CALLCONV MeasureWrappedString(_In_z_ wchar_t const* text, float maxWidth) const;
+
         float __cdecl GetLineSpacing() const;
         void __cdecl SetLineSpacing(float spacing);
 
@@ -58,6 +77,15 @@ namespace DirectX
         };
 
 
+        // Describes a single line of word wrapped text.
+        struct TextLine
+        {
+            size_t Begin;   // Index of the first character.
+            size_t End;     // One past the last character, not including the line break.
+            float Width;
+        };
+
+
     private:
         // Private implementation.
         class Impl;
@@ -69,5 +97,42 @@ namespace DirectX
         // Prevent copying.
         SpriteFont(SpriteFont const&);
         SpriteFont& operator= (SpriteFont const&);
+
+        friend class TextLayout;
+    };
+
+
+    // Caches the glyph positions of a string, so text that rarely changes (labels, scores, etc.)
+    // can be redrawn each frame without repeating the glyph lookup and line breaking work.
+    class TextLayout
+    {
+    public:
+        TextLayout();
+        TextLayout(TextLayout&& moveFrom);
+        TextLayout& operator= (TextLayout&& moveFrom);
+        virtual ~TextLayout();
+
+        // Lays out the string, unless it and the font are unchanged since the previous call.
+        // Returns true if the layout was recomputed. The font must outlive the layout.
+        bool __cdecl SetText(_In_ SpriteFont const* font, _In_z_ wchar_t const* text);
+        bool __cdecl SetText(_In_ SpriteFont const* font, _In_z_ char const* utf8Text);
+
+        // Scale and effects are applied when drawing, so changing them does not require a new layout.
+        void XM_CALLCONV Draw(_In_ SpriteBatch* spriteBatch, FXMVECTOR position, FXMVECTOR color = Colors::White, float rotation = 0, FXMVECTOR origin = g_XMZero, GXMVECTOR scale = g_XMOne, SpriteEffects effects = SpriteEffects_None, float layerDepth = 0);
+
+        // Same result as SpriteFont::MeasureString.
+        XMVECTOR XM_CALLCONV GetSize() const;
+
+        size_t __cdecl GetGlyphCount() const;
+
+    private:
+        // Private implementation.
+        class Impl;
+
+        std::unique_ptr<Impl> pImpl;
+
+        // Prevent copying.
+        TextLayout(TextLayout const&);
+        TextLayout& operator= (TextLayout const&);
     };
 }
@@ -0,0 +1,69 @@
+//--------------------------------------------------------------------------------------
+// File: TextureAtlas.h
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// http://go.microsoft.com/fwlink/?LinkId=248929
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#if defined(_XBOX_ONE) && defined(_TITLE)
+#include <d3d11_x.h>
+#else
+#include <d3d11_1.h>
+#endif
+
+#include <memory>
+#include <stdint.h>
+
+
+namespace DirectX
+{
+    // Packs many small images into a few large texture pages at runtime, so that
+    // SpriteBatch can draw them without breaking the batch at every texture change.
+    class TextureAtlas
+    {
+    public:
+        typedef uint32_t Handle;
+
+        explicit TextureAtlas(UINT pageWidth = 2048, UINT pageHeight = 2048, UINT padding = 1);
+        TextureAtlas(TextureAtlas&& moveFrom);
+        TextureAtlas& operator= (TextureAtlas&& moveFrom);
+        virtual ~TextureAtlas();
+
+        // Adds a DXGI_FORMAT_R8G8B8A8_UNORM image. The pixels are copied, so the caller's memory can be freed straight away.
+        Handle __cdecl AddImage(UINT width, UINT height, _In_reads_bytes_(height * rowPitch) void const* pixels, size_t rowPitch);
+
+        // Places every image added so far. The layout only depends on the images and the order they were added in.
+        void __cdecl Pack();
+
+        // Uploads the packed pages. Pack is called first if needed.
+        void __cdecl CreateTextures(_In_ ID3D11Device* device);
+
+        // Looks up where an image ended up.
+        ID3D11ShaderResourceView* __cdecl GetTexture(Handle handle) const;
+        RECT const& __cdecl GetSourceRectangle(Handle handle) const;
+
+        size_t __cdecl GetImageCount() const;
+        size_t __cdecl GetPageCount() const;
+
+        // Fraction of the allocated page area covered by images.
+        float __cdecl GetOccupancy() const;
+
+    private:
+        // Private implementation.
+        class Impl;
+
+        std::unique_ptr<Impl> pImpl;
+
+        // Prevent copying.
+        TextureAtlas(TextureAtlas const&);
+        TextureAtlas& operator= (TextureAtlas const&);
+    };
+}
@@ -15,6 +15,7 @@
 
 #include <array>
 #include <algorithm>
+#include <vector>
 #include <DirectXMath.h>
 
 
@@ -52,43 +53,107 @@ namespace Bezier
     }
 
 
-    // Creates vertices for a patch that is tessellated at the specified level.
+    // Table of the cubic bernstein weights used by CubicInterpolate, and the weights used by
+    // CubicTangent, at each of the tessellation + 1 evenly spaced sample times. These only depend
+    // on the tessellation level, so one table can be shared by every patch tessellated at that level.
+    class PatchBasis
+    {
+    public:
+        explicit PatchBasis(size_t tessellation)
+          : mTessellation(tessellation),
+            mWeights(tessellation + 1),
+            mTangentWeights(tessellation + 1)
+        {
+            for (size_t i = 0; i <= tessellation; i++)
+            {
+                float t = (float)i / tessellation;
+                float s = 1 - t;
+
+                mWeights[i] = DirectX::XMFLOAT4(s * s * s,
+                                                3 * t * s * s,
+                                                3 * t * t * s,
+                                                t * t * t);
+
+                mTangentWeights[i] = DirectX::XMFLOAT4(-1 + 2 * t - t * t,
+                                                       1 - 4 * t + 3 * t * t,
+                                                       2 * t - 3 * t * t,
+                                                       t * t);
+            }
+        }
+
+        size_t GetTessellation() const { return mTessellation; }
+
+        DirectX::XMVECTOR XM_CALLCONV GetWeights(size_t i) const { return DirectX::XMLoadFloat4(&mWeights[i]); }
+        DirectX::XMVECTOR XM_CALLCONV GetTangentWeights(size_t i) const { return DirectX::XMLoadFloat4(&mTangentWeights[i]); }
+
+    private:
+        size_t mTessellation;
+
+        // Stored unaligned, because std::vector does not guarantee XMVECTOR alignment on all platforms.
+        std::vector<DirectX::XMFLOAT4> mWeights;
+        std::vector<DirectX::XMFLOAT4> mTangentWeights;
+    };
+
+
+    // Sums four points, scaled by the four components of a weights vector from PatchBasis.
+    inline DirectX::XMVECTOR XM_CALLCONV WeightedSum(DirectX::FXMVECTOR weights, _In_reads_(4) DirectX::XMVECTOR const* points)
+    {
+        using namespace DirectX;
+
+        XMVECTOR result = XMVectorMultiply(points[0], XMVectorSplatX(weights));
+
+        result = XMVectorMultiplyAdd(points[1], XMVectorSplatY(weights), result);
+        result = XMVectorMultiplyAdd(points[2], XMVectorSplatZ(weights), result);
+
+        return XMVectorMultiplyAdd(points[3], XMVectorSplatW(weights), result);
+    }
+
+
+    // Creates vertices for a patch that is tessellated at the level of the specified basis table.
     // Calls the specified outputVertex function for each generated vertex,
     // passing the position, normal, and texture coordinate as parameters.
     template<typename TOutputFunc>
-    void CreatePatchVertices(_In_reads_(16) DirectX::XMVECTOR patch[16], size_t tessellation, bool isMirrored, TOutputFunc outputVertex)
+    void CreatePatchVertices(_In_reads_(16) DirectX::XMVECTOR patch[16], PatchBasis const& basis, bool isMirrored, TOutputFunc outputVertex)
     {
         using namespace DirectX;
 
+        size_t tessellation = basis.GetTessellation();
+
         for (size_t i = 0; i <= tessellation; i++)
         {
             float u = (float)i / tessellation;
 
+            XMVECTOR uWeights = basis.GetWeights(i);
+            XMVECTOR uTangentWeights = basis.GetTangentWeights(i);
+
+            // Everything that only depends on u is computed once per row. Perform four horizontal
+            // bezier interpolations between the control points of this patch, along with their tangents.
+            XMVECTOR p[4];
+            XMVECTOR dp[4];
+
+            for (size_t k = 0; k < 4; k++)
+            {
+                p[k] = WeightedSum(uWeights, &patch[k * 4]);
+                dp[k] = WeightedSum(uTangentWeights, &patch[k * 4]);
+            }
+
+            // Compute the texture coordinate.
+            float mirroredU = isMirrored ? 1 - u : u;
+
             for (size_t j = 0; j <= tessellation; j++)
             {
                 float v = (float)j / tessellation;
 
-                // Perform four horizontal bezier interpolations
-                // between the control points of this patch.
-                XMVECTOR p1 = CubicInterpolate(patch[0],  patch[1],  patch[2],  patch[3],  u);
-                XMVECTOR p2 = CubicInterpolate(patch[4],  patch[5],  patch[6],  patch[7],  u);
-                XMVECTOR p3 = CubicInterpolate(patch[8],  patch[9],  patch[10], patch[11], u);
-                XMVECTOR p4 = CubicInterpolate(patch[12], patch[13], patch[14], patch[15], u);
+                XMVECTOR vWeights = basis.GetWeights(j);
 
                 // Perform a vertical interpolation between the results of the
                 // previous horizontal interpolations, to compute the position.
-                XMVECTOR position = CubicInterpolate(p1, p2, p3, p4, v);
+                XMVECTOR position = WeightedSum(vWeights, p);
 
-                // Perform another four bezier interpolations between the control
-                // points, but this time vertically rather than horizontally.
-                XMVECTOR q1 = CubicInterpolate(patch[0], patch[4], patch[8],  patch[12], v);
-                XMVECTOR q2 = CubicInterpolate(patch[1], patch[5], patch[9],  patch[13], v);
-                XMVECTOR q3 = CubicInterpolate(patch[2], patch[6], patch[10], patch[14], v);
-                XMVECTOR q4 = CubicInterpolate(patch[3], patch[7], patch[11], patch[15], v);
-
-                // Compute vertical and horizontal tangent vectors.
-                XMVECTOR tangent1 = CubicTangent(p1, p2, p3, p4, v);
-                XMVECTOR tangent2 = CubicTangent(q1, q2, q3, q4, u);
+                // Compute vertical and horizontal tangent vectors. Interpolating the horizontal
+                // tangents vertically gives the same result as the tangent of the vertical curves.
+                XMVECTOR tangent1 = WeightedSum(basis.GetTangentWeights(j), p);
+                XMVECTOR tangent2 = WeightedSum(vWeights, dp);
 
                 // Cross the two tangent vectors to compute the normal.
                 XMVECTOR normal = XMVector3Cross(tangent1, tangent2);
@@ -120,9 +185,6 @@ namespace Bezier
                     normal = XMVectorSelect(g_XMIdentityR1, g_XMNegIdentityR1, XMVectorLess(position, XMVectorZero()));
                 }
 
-                // Compute the texture coordinate.
-                float mirroredU = isMirrored ? 1 - u : u;
-
                 XMVECTOR textureCoordinate = XMVectorSet(mirroredU, v, 0, 0);
 
                 // Output this vertex.
@@ -131,6 +193,15 @@ namespace Bezier
         }
     }
 
+
+    // Creates vertices for a patch that is tessellated at the specified level.
+    // When tessellating many patches, build one PatchBasis and use the overload above instead.
+    template<typename TOutputFunc>
+    void CreatePatchVertices(_In_reads_(16) DirectX::XMVECTOR patch[16], size_t tessellation, bool isMirrored, TOutputFunc outputVertex)
+    {
+        CreatePatchVertices(patch, PatchBasis(tessellation), isMirrored, outputVertex);
+    }
+
     
     // Creates indices for a patch that is tessellated at the specified level.
     // Calls the specified outputIndex function for each generated index value.
@@ -23,6 +23,14 @@ BinaryReader::BinaryReader(_In_z_ wchar_t const* fileName)
 {
     size_t dataSize;
 
+    // Prefer mapping the file, falling back to a plain read if that fails (eg. for empty files).
+    if ( SUCCEEDED(MapEntireFile(fileName, mMappedData, &dataSize)) )
+    {
+        mPos = mMappedData.get();
+        mEnd = mMappedData.get() + dataSize;
+        return;
+    }
+
     HRESULT hr = ReadEntireFile(fileName, mOwnedData, &dataSize);
     if ( FAILED(hr) )
     {
@@ -97,3 +105,61 @@ HRESULT BinaryReader::ReadEntireFile(_In_z_ wchar_t const* fileName, _Inout_ std
     
     return S_OK;
 }
+
+
+// Maps a file from the filesystem into memory.
+HRESULT BinaryReader::MapEntireFile(_In_z_ wchar_t const* fileName, _Inout_ ScopedMappedView& data, _Out_ size_t* dataSize)
+{
+    // Open the file.
+#if (_WIN32_WINNT >= _WIN32_WINNT_WIN8)
+    ScopedHandle hFile(safe_handle(CreateFile2(fileName, GENERIC_READ, FILE_SHARE_READ, OPEN_EXISTING, nullptr)));
+#else
+    ScopedHandle hFile(safe_handle(CreateFileW(fileName, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr)));
+#endif
+
+    if (!hFile)
+        return HRESULT_FROM_WIN32(GetLastError());
+
+    // Get the file size.
+    LARGE_INTEGER fileSize = { 0 };
+
+#if (_WIN32_WINNT >= _WIN32_WINNT_VISTA)
+    FILE_STANDARD_INFO fileInfo;
+
+    if (!GetFileInformationByHandleEx(hFile.get(), FileStandardInfo, &fileInfo, sizeof(fileInfo)))
+    {
+        return HRESULT_FROM_WIN32(GetLastError());
+    }
+
+    fileSize = fileInfo.EndOfFile;
+#else
+    GetFileSizeEx(hFile.get(), &fileSize);
+#endif
+
+    // File is too big for 32-bit address space, and empty files cannot be mapped.
+    if (fileSize.HighPart > 0 || !fileSize.LowPart)
+        return E_FAIL;
+
+    // Map the whole file. The view keeps the mapping object alive, so its handle can be closed straight away.
+#if defined(WINAPI_FAMILY) && !WINAPI_FAMILY_PARTITION(WINAPI_PARTITION_DESKTOP) && !(defined(_XBOX_ONE) && defined(_TITLE))
+    ScopedHandle hMapping(CreateFileMappingFromApp(hFile.get(), nullptr, PAGE_READONLY, 0, nullptr));
+#else
+    ScopedHandle hMapping(CreateFileMappingW(hFile.get(), nullptr, PAGE_READONLY, 0, 0, nullptr));
+#endif
+
+    if (!hMapping)
+        return HRESULT_FROM_WIN32(GetLastError());
+
+#if defined(WINAPI_FAMILY) && !WINAPI_FAMILY_PARTITION(WINAPI_PARTITION_DESKTOP) && !(defined(_XBOX_ONE) && defined(_TITLE))
+    data.reset(static_cast<uint8_t const*>(MapViewOfFileFromApp(hMapping.get(), FILE_MAP_READ, 0, 0)));
+#else
+    data.reset(static_cast<uint8_t const*>(MapViewOfFile(hMapping.get(), FILE_MAP_READ, 0, 0, 0)));
+#endif
+
+    if (!data)
+        return HRESULT_FROM_WIN32(GetLastError());
+
+    *dataSize = fileSize.LowPart;
+
+    return S_OK;
+}
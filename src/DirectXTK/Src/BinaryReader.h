@@ -23,6 +23,9 @@
 namespace DirectX
 {
     // Helper for reading binary data, either from the filesystem a memory buffer.
+    // Files are memory mapped where possible, so large files are paged in on demand rather than copied.
+    // A mapped file stays open, and can't be deleted or written to, until the reader is destroyed, so
+    // readers should only live as long as the load which needs them.
     class BinaryReader
     {
     public:
@@ -58,6 +61,10 @@ namespace DirectX
         // Lower level helper reads directly from the filesystem into memory.
         static HRESULT ReadEntireFile(_In_z_ wchar_t const* fileName, _Inout_ std::unique_ptr<uint8_t[]>& data, _Out_ size_t* dataSize);
 
+        // Lower level helper maps a whole file read-only into the address space. The file is locked against
+        // writes and deletion for as long as the view is mapped.
+        static HRESULT MapEntireFile(_In_z_ wchar_t const* fileName, _Inout_ ScopedMappedView& data, _Out_ size_t* dataSize);
+
 
     private:
         // The data currently being read.
@@ -65,6 +72,7 @@ namespace DirectX
         uint8_t const* mEnd;
 
         std::unique_ptr<uint8_t[]> mOwnedData;
+        ScopedMappedView mMappedData;
 
 
         // Prevent copying.
@@ -0,0 +1,650 @@
+//--------------------------------------------------------------------------------------
+// File: DebugDraw.cpp
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// http://go.microsoft.com/fwlink/?LinkId=248929
+//--------------------------------------------------------------------------------------
+
+#include "pch.h"
+
+#define NOMINMAX
+#include <algorithm>
+#include <vector>
+
+#include "DebugDraw.h"
+#include "CommonStates.h"
+#include "DirectXHelpers.h"
+#include "Effects.h"
+#include "PrimitiveBatch.h"
+#include "VertexTypes.h"
+#include "PlatformHelpers.h"
+
+using namespace DirectX;
+using namespace Microsoft::WRL;
+
+
+namespace
+{
+    // Size of the PrimitiveBatch vertex buffer. Each draw holds whole shapes, so none is split across a wrap.
+    static const size_t BatchSize = 65536;
+
+    // Spheres are drawn as three axis aligned circles.
+    static const size_t SphereSegments = 32;
+
+    static const size_t VerticesPerLine = 2;
+    static const size_t VerticesPerBox = 24;
+    static const size_t VerticesPerSphere = SphereSegments * 3 * 2;
+
+
+    // Corners 0-3 and 4-7 each form a loop, matching the order used by BoundingBox::GetCorners and BoundingFrustum::GetCorners.
+    static const XMVECTORF32 boxCornerOffsets[8] =
+    {
+        { -1, -1,  1, 0 },
+        {  1, -1,  1, 0 },
+        {  1,  1,  1, 0 },
+        { -1,  1,  1, 0 },
+        { -1, -1, -1, 0 },
+        {  1, -1, -1, 0 },
+        {  1,  1, -1, 0 },
+        { -1,  1, -1, 0 },
+    };
+
+    static const uint8_t hexahedronEdges[VerticesPerBox] =
+    {
+        0, 1,  1, 2,  2, 3,  3, 0,
+        4, 5,  5, 6,  6, 7,  7, 4,
+        0, 4,  1, 5,  2, 6,  3, 7,
+    };
+
+
+    inline void XM_CALLCONV StoreVertex(_Out_ VertexPositionColor* vertex, FXMVECTOR position, FXMVECTOR color)
+    {
+        XMStoreFloat3(&vertex->position, position);
+        XMStoreFloat4(&vertex->color, color);
+    }
+
+
+    // Writes the twelve edges of a box or frustum.
+    inline VertexPositionColor* XM_CALLCONV StoreHexahedron(_Out_writes_(VerticesPerBox) VertexPositionColor* vertices, _In_reads_(8) XMVECTOR const* corners, FXMVECTOR color)
+    {
+        for (size_t i = 0; i < VerticesPerBox; i++)
+        {
+            StoreVertex(vertices++, corners[hexahedronEdges[i]], color);
+        }
+
+        return vertices;
+    }
+
+
+    // PrimitiveBatch only hands out its mapped vertex memory to derived classes. Going through that lets
+    // shapes be expanded straight into the vertex buffer, rather than into a scratch array that is then copied.
+    class LineBatch : public PrimitiveBatch<VertexPositionColor>
+    {
+    public:
+        LineBatch(_In_ ID3D11DeviceContext* deviceContext, size_t maxVertices)
+          : PrimitiveBatch<VertexPositionColor>(deviceContext, 0, maxVertices, true)
+        { }
+
+        // Returns where to write the specified number of line list vertices.
+        VertexPositionColor* DrawLines(size_t vertexCount)
+        {
+            void* mappedVertices;
+
+            PrimitiveBatchBase::Draw(D3D11_PRIMITIVE_TOPOLOGY_LINELIST, false, nullptr, 0, vertexCount, &mappedVertices);
+
+            return static_cast<VertexPositionColor*>(mappedVertices);
+        }
+    };
+
+
+    // Counts down shape lifetimes.
+    template<typename T>
+    void AgeShapes(std::vector<T>& shapes, float elapsedSeconds)
+    {
+        for (auto shape = shapes.begin(); shape != shapes.end(); ++shape)
+        {
+            shape->remaining -= elapsedSeconds;
+        }
+    }
+
+
+    // Drops shapes whose time is up. Order doesn't matter, so this swaps from the end rather than shuffling everything down.
+    template<typename T>
+    void RemoveExpiredShapes(std::vector<T>& shapes)
+    {
+        for (size_t i = 0; i < shapes.size(); )
+        {
+            if (shapes[i].remaining <= 0)
+            {
+                shapes[i] = shapes.back();
+                shapes.pop_back();
+            }
+            else
+            {
+                i++;
+            }
+        }
+    }
+}
+
+
+// Internal DebugDraw implementation class.
+class DebugDraw::Impl
+{
+public:
+    Impl(_In_ ID3D11DeviceContext* deviceContext);
+
+    void XM_CALLCONV Draw(FXMMATRIX view, CXMMATRIX projection);
+
+    void Update(float elapsedSeconds);
+    void Clear();
+    size_t GetShapeCount() const;
+
+
+    // Shapes are stored in a separate array per type, so they can be expanded with tight loops.
+    struct LineShape
+    {
+        XMFLOAT3 from;
+        XMFLOAT3 to;
+        XMFLOAT4 color;
+        float remaining;
+    };
+
+    struct BoxShape
+    {
+        BoundingOrientedBox box;
+        XMFLOAT4 color;
+        float remaining;
+    };
+
+    struct SphereShape
+    {
+        BoundingSphere sphere;
+        XMFLOAT4 color;
+        float remaining;
+    };
+
+    struct FrustumShape
+    {
+        BoundingFrustum frustum;
+        XMFLOAT4 color;
+        float remaining;
+    };
+
+    struct GridShape
+    {
+        XMFLOAT3 xAxis;
+        XMFLOAT3 yAxis;
+        XMFLOAT3 origin;
+        size_t xDivisions;
+        size_t yDivisions;
+        XMFLOAT4 color;
+        float remaining;
+    };
+
+    struct Layer
+    {
+        std::vector<LineShape> lines;
+        std::vector<BoxShape> boxes;
+        std::vector<SphereShape> spheres;
+        std::vector<FrustumShape> frustums;
+        std::vector<GridShape> grids;
+    };
+
+    // Layer 0 is depth tested, layer 1 is drawn on top.
+    Layer mLayers[2];
+
+    Layer& GetLayer(bool depthTest)
+    {
+        return mLayers[depthTest ? 0 : 1];
+    }
+
+private:
+    void DrawLayer(Layer const& layer, _In_ ID3D11DepthStencilState* depthStencilState);
+
+    template<typename T>
+    void DrawShapes(std::vector<T> const& shapes, size_t verticesPerShape, VertexPositionColor* (Impl::*expand)(T const&, VertexPositionColor*) const);
+
+    void DrawGrid(GridShape const& grid);
+
+    VertexPositionColor* ExpandLine(LineShape const& shape, _Out_writes_(VerticesPerLine) VertexPositionColor* output) const;
+    VertexPositionColor* ExpandBox(BoxShape const& shape, _Out_writes_(VerticesPerBox) VertexPositionColor* output) const;
+    VertexPositionColor* ExpandSphere(SphereShape const& shape, _Out_writes_(VerticesPerSphere) VertexPositionColor* output) const;
+    VertexPositionColor* ExpandFrustum(FrustumShape const& shape, _Out_writes_(VerticesPerBox) VertexPositionColor* output) const;
+
+    ComPtr<ID3D11DeviceContext> mDeviceContext;
+    ComPtr<ID3D11InputLayout> mInputLayout;
+
+    std::unique_ptr<BasicEffect> mEffect;
+    std::unique_ptr<CommonStates> mStateObjects;
+    std::unique_ptr<LineBatch> mBatch;
+
+    // Unit circle points for each of the three sphere rings.
+    XMFLOAT3 mSphereDirections[SphereSegments * 3];
+};
+
+
+// Constructor.
+DebugDraw::Impl::Impl(_In_ ID3D11DeviceContext* deviceContext)
+  : mDeviceContext(deviceContext)
+{
+    ComPtr<ID3D11Device> device;
+
+    deviceContext->GetDevice(&device);
+
+    // Create the effect.
+    mEffect.reset(new BasicEffect(device.Get()));
+
+    mEffect->SetVertexColorEnabled(true);
+
+    // Create the input layout.
+    void const* shaderByteCode;
+    size_t byteCodeLength;
+
+    mEffect->GetVertexShaderBytecode(&shaderByteCode, &byteCodeLength);
+
+    ThrowIfFailed(
+        device->CreateInputLayout(VertexPositionColor::InputElements,
+                                  VertexPositionColor::InputElementCount,
+                                  shaderByteCode, byteCodeLength,
+                                  &mInputLayout)
+    );
+
+    SetDebugObjectName(mInputLayout.Get(), "DirectXTK:DebugDraw");
+
+    // Create state objects.
+    mStateObjects.reset(new CommonStates(device.Get()));
+
+    // Everything is drawn as non-indexed line lists, mapping the vertex buffer once per layer.
+    mBatch.reset(new LineBatch(deviceContext, BatchSize));
+
+    // Precompute the sphere rings, in the XY, XZ and YZ planes.
+    for (size_t i = 0; i < SphereSegments; i++)
+    {
+        float sine;
+        float cosine;
+
+        XMScalarSinCos(&sine, &cosine, i * XM_2PI / SphereSegments);
+
+        mSphereDirections[i]                      = XMFLOAT3(cosine, sine, 0);
+        mSphereDirections[i + SphereSegments]     = XMFLOAT3(cosine, 0, sine);
+        mSphereDirections[i + SphereSegments * 2] = XMFLOAT3(0, cosine, sine);
+    }
+}
+
+
+// Draws every shape, then drops those whose time is up.
+void XM_CALLCONV DebugDraw::Impl::Draw(FXMMATRIX view, CXMMATRIX projection)
+{
+    mEffect->SetWorld(XMMatrixIdentity());
+    mEffect->SetView(view);
+    mEffect->SetProjection(projection);
+
+    mDeviceContext->OMSetBlendState(mStateObjects->Opaque(), nullptr, 0xFFFFFFFF);
+    mDeviceContext->RSSetState(mStateObjects->CullNone());
+    mDeviceContext->IASetInputLayout(mInputLayout.Get());
+
+    mEffect->Apply(mDeviceContext.Get());
+
+    DrawLayer(mLayers[0], mStateObjects->DepthDefault());
+    DrawLayer(mLayers[1], mStateObjects->DepthNone());
+
+    for (size_t i = 0; i < 2; i++)
+    {
+        Layer& layer = mLayers[i];
+
+        RemoveExpiredShapes(layer.lines);
+        RemoveExpiredShapes(layer.boxes);
+        RemoveExpiredShapes(layer.spheres);
+        RemoveExpiredShapes(layer.frustums);
+        RemoveExpiredShapes(layer.grids);
+    }
+}
+
+
+// Expands one layer straight into the mapped vertex buffer, one shape type at a time.
+void DebugDraw::Impl::DrawLayer(Layer const& layer, _In_ ID3D11DepthStencilState* depthStencilState)
+{
+    if (layer.lines.empty() && layer.boxes.empty() && layer.spheres.empty() && layer.frustums.empty() && layer.grids.empty())
+        return;
+
+    mDeviceContext->OMSetDepthStencilState(depthStencilState, 0);
+
+    mBatch->Begin();
+
+    DrawShapes(layer.lines, VerticesPerLine, &Impl::ExpandLine);
+    DrawShapes(layer.boxes, VerticesPerBox, &Impl::ExpandBox);
+    DrawShapes(layer.spheres, VerticesPerSphere, &Impl::ExpandSphere);
+    DrawShapes(layer.frustums, VerticesPerBox, &Impl::ExpandFrustum);
+
+    for (auto grid = layer.grids.begin(); grid != layer.grids.end(); ++grid)
+    {
+        DrawGrid(*grid);
+    }
+
+    mBatch->End();
+}
+
+
+// Draws as many shapes at a time as fit in the vertex buffer. Consecutive draws are merged by the batch.
+template<typename T>
+void DebugDraw::Impl::DrawShapes(std::vector<T> const& shapes, size_t verticesPerShape, VertexPositionColor* (Impl::*expand)(T const&, VertexPositionColor*) const)
+{
+    size_t shapesPerDraw = BatchSize / verticesPerShape;
+
+    for (size_t i = 0; i < shapes.size(); i += shapesPerDraw)
+    {
+        size_t count = std::min(shapesPerDraw, shapes.size() - i);
+
+        VertexPositionColor* output = mBatch->DrawLines(count * verticesPerShape);
+
+        for (size_t j = 0; j < count; j++)
+        {
+            output = (this->*expand)(shapes[i + j], output);
+        }
+    }
+}
+
+
+// Grids can have any number of lines, so they are split into buffer sized pieces on line boundaries.
+void DebugDraw::Impl::DrawGrid(GridShape const& grid)
+{
+    XMVECTOR xAxis = XMLoadFloat3(&grid.xAxis);
+    XMVECTOR yAxis = XMLoadFloat3(&grid.yAxis);
+    XMVECTOR origin = XMLoadFloat3(&grid.origin);
+    XMVECTOR color = XMLoadFloat4(&grid.color);
+
+    size_t lineCount = grid.xDivisions + grid.yDivisions + 2;
+    size_t linesPerDraw = BatchSize / VerticesPerLine;
+
+    for (size_t first = 0; first < lineCount; first += linesPerDraw)
+    {
+        size_t count = std::min(linesPerDraw, lineCount - first);
+
+        VertexPositionColor* output = mBatch->DrawLines(count * VerticesPerLine);
+
+        for (size_t i = first; i < first + count; i++)
+        {
+            // Lines spaced along the x axis come first, then those spaced along the y axis.
+            XMVECTOR position;
+            XMVECTOR extent;
+
+            if (i <= grid.xDivisions)
+            {
+                float t = (float)i / (float)grid.xDivisions * 2 - 1;
+
+                position = XMVectorMultiplyAdd(xAxis, XMVectorReplicate(t), origin);
+                extent = yAxis;
+            }
+            else
+            {
+                float t = (float)(i - grid.xDivisions - 1) / (float)grid.yDivisions * 2 - 1;
+
+                position = XMVectorMultiplyAdd(yAxis, XMVectorReplicate(t), origin);
+                extent = xAxis;
+            }
+
+            StoreVertex(output++, position - extent, color);
+            StoreVertex(output++, position + extent, color);
+        }
+    }
+}
+
+
+VertexPositionColor* DebugDraw::Impl::ExpandLine(LineShape const& shape, _Out_writes_(VerticesPerLine) VertexPositionColor* output) const
+{
+    XMVECTOR color = XMLoadFloat4(&shape.color);
+
+    StoreVertex(output++, XMLoadFloat3(&shape.from), color);
+    StoreVertex(output++, XMLoadFloat3(&shape.to), color);
+
+    return output;
+}
+
+
+// Rotates the three scaled axes once, then builds each corner as a signed sum of them.
+VertexPositionColor* DebugDraw::Impl::ExpandBox(BoxShape const& shape, _Out_writes_(VerticesPerBox) VertexPositionColor* output) const
+{
+    XMVECTOR center = XMLoadFloat3(&shape.box.Center);
+    XMVECTOR extents = XMLoadFloat3(&shape.box.Extents);
+    XMVECTOR orientation = XMLoadFloat4(&shape.box.Orientation);
+
+    XMVECTOR axisX = XMVector3Rotate(XMVectorAndInt(extents, g_XMMaskX), orientation);
+    XMVECTOR axisY = XMVector3Rotate(XMVectorAndInt(extents, g_XMMaskY), orientation);
+    XMVECTOR axisZ = XMVector3Rotate(XMVectorAndInt(extents, g_XMMaskZ), orientation);
+
+    XMVECTOR corners[8];
+
+    for (size_t i = 0; i < 8; i++)
+    {
+        XMVECTOR corner = XMVectorMultiplyAdd(XMVectorSplatX(boxCornerOffsets[i]), axisX, center);
+
+        corner = XMVectorMultiplyAdd(XMVectorSplatY(boxCornerOffsets[i]), axisY, corner);
+
+        corners[i] = XMVectorMultiplyAdd(XMVectorSplatZ(boxCornerOffsets[i]), axisZ, corner);
+    }
+
+    return StoreHexahedron(output, corners, XMLoadFloat4(&shape.color));
+}
+
+
+VertexPositionColor* DebugDraw::Impl::ExpandSphere(SphereShape const& shape, _Out_writes_(VerticesPerSphere) VertexPositionColor* output) const
+{
+    XMVECTOR center = XMLoadFloat3(&shape.sphere.Center);
+    XMVECTOR radius = XMVectorReplicate(shape.sphere.Radius);
+    XMVECTOR color = XMLoadFloat4(&shape.color);
+
+    for (size_t ring = 0; ring < 3; ring++)
+    {
+        XMFLOAT3 const* directions = mSphereDirections + ring * SphereSegments;
+
+        XMVECTOR first = XMVectorMultiplyAdd(XMLoadFloat3(&directions[0]), radius, center);
+        XMVECTOR previous = first;
+
+        for (size_t i = 1; i <= SphereSegments; i++)
+        {
+            XMVECTOR current = (i < SphereSegments) ? XMVectorMultiplyAdd(XMLoadFloat3(&directions[i]), radius, center) : first;
+
+            StoreVertex(output++, previous, color);
+            StoreVertex(output++, current, color);
+
+            previous = current;
+        }
+    }
+
+    return output;
+}
+
+
+VertexPositionColor* DebugDraw::Impl::ExpandFrustum(FrustumShape const& shape, _Out_writes_(VerticesPerBox) VertexPositionColor* output) const
+{
+    XMFLOAT3 cornerData[8];
+
+    shape.frustum.GetCorners(cornerData);
+
+    XMVECTOR corners[8];
+
+    for (size_t i = 0; i < 8; i++)
+    {
+        corners[i] = XMLoadFloat3(&cornerData[i]);
+    }
+
+    return StoreHexahedron(output, corners, XMLoadFloat4(&shape.color));
+}
+
+
+void DebugDraw::Impl::Update(float elapsedSeconds)
+{
+    for (size_t i = 0; i < 2; i++)
+    {
+        Layer& layer = mLayers[i];
+
+        AgeShapes(layer.lines, elapsedSeconds);
+        AgeShapes(layer.boxes, elapsedSeconds);
+        AgeShapes(layer.spheres, elapsedSeconds);
+        AgeShapes(layer.frustums, elapsedSeconds);
+        AgeShapes(layer.grids, elapsedSeconds);
+    }
+}
+
+
+void DebugDraw::Impl::Clear()
+{
+    for (size_t i = 0; i < 2; i++)
+    {
+        Layer& layer = mLayers[i];
+
+        layer.lines.clear();
+        layer.boxes.clear();
+        layer.spheres.clear();
+        layer.frustums.clear();
+        layer.grids.clear();
+    }
+}
+
+
+size_t DebugDraw::Impl::GetShapeCount() const
+{
+    size_t count = 0;
+
+    for (size_t i = 0; i < 2; i++)
+    {
+        Layer const& layer = mLayers[i];
+
+        count += layer.lines.size() + layer.boxes.size() + layer.spheres.size() + layer.frustums.size() + layer.grids.size();
+    }
+
+    return count;
+}
+
+
+// Public constructor.
+DebugDraw::DebugDraw(_In_ ID3D11DeviceContext* deviceContext)
+  : pImpl(new Impl(deviceContext))
+{
+}
+
+
+// Move constructor.
+DebugDraw::DebugDraw(DebugDraw&& moveFrom)
+  : pImpl(std::move(moveFrom.pImpl))
+{
+}
+
+
+// Move assignment.
+DebugDraw& DebugDraw::operator= (DebugDraw&& moveFrom)
+{
+    pImpl = std::move(moveFrom.pImpl);
+    return *this;
+}
+
+
+// Public destructor.
+DebugDraw::~DebugDraw()
+{
+}
+
+
+void XM_CALLCONV DebugDraw::AddLine(FXMVECTOR from, FXMVECTOR to, FXMVECTOR color, float duration, bool depthTest)
+{
+    Impl::LineShape shape;
+
+    XMStoreFloat3(&shape.from, from);
+    XMStoreFloat3(&shape.to, to);
+    XMStoreFloat4(&shape.color, color);
+    shape.remaining = duration;
+
+    pImpl->GetLayer(depthTest).lines.push_back(shape);
+}
+
+
+void XM_CALLCONV DebugDraw::AddBox(BoundingBox const& box, FXMVECTOR color, float duration, bool depthTest)
+{
+    AddBox(BoundingOrientedBox(box.Center, box.Extents, XMFLOAT4(0, 0, 0, 1)), color, duration, depthTest);
+}
+
+
+void XM_CALLCONV DebugDraw::AddBox(BoundingOrientedBox const& box, FXMVECTOR color, float duration, bool depthTest)
+{
+    Impl::BoxShape shape;
+
+    shape.box = box;
+    XMStoreFloat4(&shape.color, color);
+    shape.remaining = duration;
+
+    pImpl->GetLayer(depthTest).boxes.push_back(shape);
+}
+
+
+void XM_CALLCONV DebugDraw::AddSphere(BoundingSphere const& sphere, FXMVECTOR color, float duration, bool depthTest)
+{
+    Impl::SphereShape shape;
+
+    shape.sphere = sphere;
+    XMStoreFloat4(&shape.color, color);
+    shape.remaining = duration;
+
+    pImpl->GetLayer(depthTest).spheres.push_back(shape);
+}
+
+
+void XM_CALLCONV DebugDraw::AddFrustum(BoundingFrustum const& frustum, FXMVECTOR color, float duration, bool depthTest)
+{
+    Impl::FrustumShape shape;
+
+    shape.frustum = frustum;
+    XMStoreFloat4(&shape.color, color);
+    shape.remaining = duration;
+
+    pImpl->GetLayer(depthTest).frustums.push_back(shape);
+}
+
+
+void XM_CALLCONV DebugDraw::AddGrid(FXMVECTOR xAxis, FXMVECTOR yAxis, FXMVECTOR origin, size_t xDivisions, size_t yDivisions, GXMVECTOR color, float duration, bool depthTest)
+{
+    if (!xDivisions || !yDivisions)
+        throw std::exception("Grid must have at least one division in each direction");
+
+    Impl::GridShape shape;
+
+    XMStoreFloat3(&shape.xAxis, xAxis);
+    XMStoreFloat3(&shape.yAxis, yAxis);
+    XMStoreFloat3(&shape.origin, origin);
+    shape.xDivisions = xDivisions;
+    shape.yDivisions = yDivisions;
+    XMStoreFloat4(&shape.color, color);
+    shape.remaining = duration;
+
+    pImpl->GetLayer(depthTest).grids.push_back(shape);
+}
+
+
+void DebugDraw::Update(float elapsedSeconds)
+{
+    pImpl->Update(elapsedSeconds);
+}
+
+
+void XM_CALLCONV DebugDraw::Draw(FXMMATRIX view, CXMMATRIX projection)
+{
+    pImpl->Draw(view, projection);
+}
+
+
+void DebugDraw::Clear()
+{
+    pImpl->Clear();
+}
+
+
+size_t DebugDraw::GetShapeCount() const
+{
+    return pImpl->GetShapeCount();
+}
@@ -0,0 +1,139 @@
+//--------------------------------------------------------------------------------------
+// File: DirtyRanges.h
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// http://go.microsoft.com/fwlink/?LinkId=248929
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+
+namespace DirectX
+{
+    // Tracks which elements of a retained buffer need to be uploaded again, as a sorted list of
+    // disjoint half-open [begin, end) ranges. Has no device dependencies, so it can be tested in isolation.
+    class DirtyRanges
+    {
+    public:
+        struct Range
+        {
+            size_t begin;
+            size_t end;
+        };
+
+
+        // Marks [begin, end) as dirty, merging with any ranges it overlaps or touches.
+        void Add(size_t begin, size_t end)
+        {
+            if (begin >= end)
+                return;
+
+            // Fast path for the common case of marking elements in increasing order.
+            if (mRanges.empty() || begin > mRanges.back().end)
+            {
+                Range range = { begin, end };
+                mRanges.push_back(range);
+                return;
+            }
+
+            // Find the first range that ends at or after our start: everything before it is unaffected.
+            auto first = std::lower_bound(mRanges.begin(), mRanges.end(), begin, [](Range const& range, size_t value)
+            {
+                return range.end < value;
+            });
+
+            // Absorb every following range that starts at or before our end.
+            auto last = first;
+
+            while (last != mRanges.end() && last->begin <= end)
+            {
+                begin = std::min(begin, last->begin);
+                end = std::max(end, last->end);
+                ++last;
+            }
+
+            if (first == last)
+            {
+                Range range = { begin, end };
+                mRanges.insert(first, range);
+            }
+            else
+            {
+                first->begin = begin;
+                first->end = end;
+                mRanges.erase(first + 1, last);
+            }
+        }
+
+
+        // Joins ranges separated by at most maxGap clean elements, trading a little
+        // redundant upload bandwidth for fewer update calls.
+        void Coalesce(size_t maxGap)
+        {
+            if (mRanges.size() < 2)
+                return;
+
+            size_t out = 0;
+
+            for (size_t i = 1; i < mRanges.size(); i++)
+            {
+                if (mRanges[i].begin - mRanges[out].end <= maxGap)
+                {
+                    mRanges[out].end = mRanges[i].end;
+                }
+                else
+                {
+                    mRanges[++out] = mRanges[i];
+                }
+            }
+
+            mRanges.resize(out + 1);
+        }
+
+
+        // Drops any dirty elements at or after the specified limit, eg. when the buffer shrinks.
+        void Truncate(size_t limit)
+        {
+            while (!mRanges.empty() && mRanges.back().begin >= limit)
+            {
+                mRanges.pop_back();
+            }
+
+            if (!mRanges.empty() && mRanges.back().end > limit)
+            {
+                mRanges.back().end = limit;
+            }
+        }
+
+
+        void Clear()
+        {
+            mRanges.clear();
+        }
+
+
+        bool Empty() const
+        {
+            return mRanges.empty();
+        }
+
+
+        std::vector<Range> const& Ranges() const
+        {
+            return mRanges;
+        }
+
+
+    private:
+        std::vector<Range> mRanges;
+    };
+}
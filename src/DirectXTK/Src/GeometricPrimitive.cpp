@@ -19,7 +19,10 @@
 #include "VertexTypes.h"
 #include "SharedResourcePool.h"
 #include "Bezier.h"
+#include "VertexCache.h"
+#include "MeshLod.h"
 #include <vector>
+#include <list>
 #include <map>
 
 using namespace DirectX;
@@ -35,26 +38,23 @@ namespace
 
     void CheckIndexOverflow(size_t value)
     {
-        // Use >=, not > comparison, because some D3D level 9_x hardware does not support 0xFFFF index values.
-        if (value >= USHRT_MAX)
+        // Use >=, not > comparison, because 0xFFFFFFFF is the strip cut index.
+        if (value >= UINT32_MAX)
             throw std::exception("Index value out of range: cannot tesselate primitive so finely");
     }
 
 
-    // Temporary collection types used when generating the geometry.
+    // Collection types used when generating the geometry.
     typedef std::vector<VertexPositionNormalTexture> VertexCollection;
-    
-    
-    class IndexCollection : public std::vector<uint16_t>
+    typedef std::vector<uint32_t> IndexCollection;
+
+
+    // Sanity check the range of 32 bit index values.
+    inline void index_push_back(IndexCollection& indices, size_t value)
     {
-    public:
-        // Sanity check the range of 16 bit index values.
-        void push_back(size_t value)
-        {
-            CheckIndexOverflow(value);
-            vector::push_back((uint16_t)value);
-        }
-    };
+        CheckIndexOverflow(value);
+        indices.push_back(static_cast<uint32_t>(value));
+    }
 
 
     // Helper for flipping winding of geometric primitives for LH vs. RH coords
@@ -123,19 +123,30 @@ namespace
 class GeometricPrimitive::Impl
 {
 public:
-    void Initialize(_In_ ID3D11DeviceContext* deviceContext, VertexCollection& vertices, IndexCollection& indices, bool rhcoords );
+    Impl()
+      : mIndexFormat(DXGI_FORMAT_R16_UINT),
+        mLodThreshold(0)
+    {
+    }
+
+    void Initialize(_In_ ID3D11DeviceContext* deviceContext, VertexCollection const& vertices, IndexCollection const& indices, std::vector<LodLevel> const& lods);
 
     void XM_CALLCONV Draw(FXMMATRIX world, CXMMATRIX view, CXMMATRIX projection, FXMVECTOR color, _In_opt_ ID3D11ShaderResourceView* texture, bool wireframe, _In_opt_ std::function<void()> setCustomState);
 
-    void Draw(_In_ IEffect* effect, _In_ ID3D11InputLayout* inputLayout, bool alpha, bool wireframe, _In_opt_ std::function<void()> setCustomState);
+    void Draw(_In_ IEffect* effect, _In_ ID3D11InputLayout* inputLayout, bool alpha, bool wireframe, _In_opt_ std::function<void()> setCustomState, size_t lod);
 
     void CreateInputLayout(_In_ IEffect* effect, _Outptr_ ID3D11InputLayout** inputLayout);
 
+    std::vector<LodLevel> mLods;
+    float mLodThreshold;
+
 private:
     ComPtr<ID3D11Buffer> mVertexBuffer;
     ComPtr<ID3D11Buffer> mIndexBuffer;
 
-    UINT mIndexCount;
+    DXGI_FORMAT mIndexFormat;
+
+    BoundingSphere mBounds;
 
     // Only one of these helpers is allocated per D3D device context, even if there are multiple GeometricPrimitive instances.
     class SharedResources
@@ -227,23 +238,44 @@ void GeometricPrimitive::Impl::SharedResources::PrepareForRendering(bool alpha,
 
 // Initializes a geometric primitive instance that will draw the specified vertex and index data.
 _Use_decl_annotations_
-void GeometricPrimitive::Impl::Initialize(ID3D11DeviceContext* deviceContext, VertexCollection& vertices, IndexCollection& indices, bool rhcoords)
+void GeometricPrimitive::Impl::Initialize(ID3D11DeviceContext* deviceContext, VertexCollection const& vertices, IndexCollection const& indices, std::vector<LodLevel> const& lods)
 {
+    ComPtr<ID3D11Device> device;
+    deviceContext->GetDevice(&device);
+
+    // Use >=, not > comparison, because some D3D level 9_x hardware does not support 0xFFFF index values.
     if ( vertices.size() >= USHRT_MAX )
-        throw std::exception("Too many vertices for 16-bit index buffer");
+    {
+        if ( device->GetFeatureLevel() < D3D_FEATURE_LEVEL_9_2 )
+            throw std::exception("Too many vertices for 16-bit index buffer: 32-bit indices require Feature Level 9.2 or later");
 
-    if ( !rhcoords )
-        ReverseWinding( indices, vertices );
+        CreateBuffer(device.Get(), indices, D3D11_BIND_INDEX_BUFFER, &mIndexBuffer);
 
-    mResources = sharedResourcesPool.DemandCreate(deviceContext);
+        mIndexFormat = DXGI_FORMAT_R32_UINT;
+    }
+    else
+    {
+        // Small primitives use 16-bit indices, which halves the index buffer size.
+        std::vector<uint16_t> shortIndices;
+        shortIndices.reserve(indices.size());
 
-    ComPtr<ID3D11Device> device;
-    deviceContext->GetDevice(&device);
+        for (auto it = indices.begin(); it != indices.end(); ++it)
+        {
+            shortIndices.push_back(static_cast<uint16_t>(*it));
+        }
+
+        CreateBuffer(device.Get(), shortIndices, D3D11_BIND_INDEX_BUFFER, &mIndexBuffer);
+
+        mIndexFormat = DXGI_FORMAT_R16_UINT;
+    }
+
+    mResources = sharedResourcesPool.DemandCreate(deviceContext);
 
     CreateBuffer(device.Get(), vertices, D3D11_BIND_VERTEX_BUFFER, &mVertexBuffer);
-    CreateBuffer(device.Get(), indices, D3D11_BIND_INDEX_BUFFER, &mIndexBuffer);
 
-    mIndexCount = static_cast<UINT>( indices.size() );
+    mLods = lods;
+
+    BoundingSphere::CreateFromPoints(mBounds, vertices.size(), &vertices.front().position, sizeof(VertexPositionNormalTexture));
 }
 
 
@@ -281,13 +313,26 @@ void XM_CALLCONV GeometricPrimitive::Impl::Draw(FXMMATRIX world, CXMMATRIX view,
     effect->SetDiffuseColor(color);
     effect->SetAlpha(alpha);
 
-    Draw( effect, inputLayout, (alpha < 1.f), wireframe, setCustomState );
+    // Pick the coarsest level of detail whose error is too small to see.
+    size_t lod = 0;
+
+    if ( mLods.size() > 1 && mLodThreshold > 0 )
+    {
+        float pixelsPerUnit = MeshLod::PixelsPerUnit(mResources->deviceContext.Get(), world, view, projection, mBounds);
+
+        size_t count = MeshLod::CountLevelsWithin(&mLods.front(), mLods.size(), pixelsPerUnit, mLodThreshold);
+
+        if ( count )
+            lod = count - 1;
+    }
+
+    Draw( effect, inputLayout, (alpha < 1.f), wireframe, setCustomState, lod );
 }
 
 
 // Draw the primitive using a custom effect.
 _Use_decl_annotations_
-void GeometricPrimitive::Impl::Draw(IEffect* effect, ID3D11InputLayout* inputLayout, bool alpha, bool wireframe, std::function<void()> setCustomState )
+void GeometricPrimitive::Impl::Draw(IEffect* effect, ID3D11InputLayout* inputLayout, bool alpha, bool wireframe, std::function<void()> setCustomState, size_t lod )
 {
     assert( mResources != 0 );
     auto deviceContext = mResources->deviceContext.Get();
@@ -311,7 +356,7 @@ void GeometricPrimitive::Impl::Draw(IEffect* effect, ID3D11InputLayout* inputLay
 
     deviceContext->IASetVertexBuffers(0, 1, &vertexBuffer, &vertexStride, &vertexOffset);
 
-    deviceContext->IASetIndexBuffer(mIndexBuffer.Get(), DXGI_FORMAT_R16_UINT, 0);
+    deviceContext->IASetIndexBuffer(mIndexBuffer.Get(), mIndexFormat, 0);
 
     // Hook lets the caller replace our shaders or state settings with whatever else they see fit.
     if (setCustomState)
@@ -322,7 +367,9 @@ void GeometricPrimitive::Impl::Draw(IEffect* effect, ID3D11InputLayout* inputLay
     // Draw the primitive.
     deviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
-    deviceContext->DrawIndexed(mIndexCount, 0, 0);
+    assert( lod < mLods.size() );
+
+    deviceContext->DrawIndexed(mLods[lod].indexCount, mLods[lod].startIndex, 0);
 }
 
 
@@ -372,7 +419,7 @@ void XM_CALLCONV GeometricPrimitive::Draw(FXMMATRIX world, CXMMATRIX view, CXMMA
 _Use_decl_annotations_
 void GeometricPrimitive::Draw(IEffect* effect, ID3D11InputLayout* inputLayout, bool alpha, bool wireframe, std::function<void()> setCustomState )
 {
-    pImpl->Draw(effect, inputLayout, alpha, wireframe, setCustomState);
+    pImpl->Draw(effect, inputLayout, alpha, wireframe, setCustomState, 0);
 }
 
 
@@ -383,12 +430,293 @@ void GeometricPrimitive::CreateInputLayout(IEffect* effect, ID3D11InputLayout**
 }
 
 
+void GeometricPrimitive::SetLodThreshold(float pixels)
+{
+    pImpl->mLodThreshold = pixels;
+}
+
+
+size_t GeometricPrimitive::GetLodCount() const
+{
+    return pImpl->mLods.size();
+}
+
+
+// Sanity check geometry supplied by the caller.
+static void ValidateGeometry(VertexCollection const& vertices, IndexCollection const& indices)
+{
+    if ( vertices.empty() || indices.empty() )
+        throw std::exception("Primitive cannot be empty");
+
+    if ( indices.size() % 3 )
+        throw std::exception("Index count must be a multiple of 3");
+
+    for ( auto it = indices.begin(); it != indices.end(); ++it )
+    {
+        if ( *it >= vertices.size() )
+            throw std::exception("Index not in vertices list");
+    }
+}
+
+
+// Creates a primitive from geometry computed by the caller, eg. with one of the Compute methods.
+std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateCustom(_In_ ID3D11DeviceContext* deviceContext, std::vector<VertexType> const& vertices, std::vector<uint32_t> const& indices, std::vector<LodLevel> const& lods)
+{
+    ValidateGeometry(vertices, indices);
+
+    if ( lods.empty() )
+        throw std::exception("Primitive must have at least one level of detail");
+
+    for ( auto it = lods.begin(); it != lods.end(); ++it )
+    {
+        if ( !it->indexCount || (it->indexCount % 3) || (size_t)it->startIndex + it->indexCount > indices.size() )
+            throw std::exception("Level of detail not in indices list");
+    }
+
+    std::unique_ptr<GeometricPrimitive> primitive(new GeometricPrimitive());
+
+    primitive->pImpl->Initialize(deviceContext, vertices, indices, lods);
+
+    return primitive;
+}
+
+
+std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateCustom(_In_ ID3D11DeviceContext* deviceContext, std::vector<VertexType> const& vertices, std::vector<uint32_t> const& indices)
+{
+    LodLevel full = { 0, static_cast<uint32_t>( indices.size() ), 0 };
+
+    return CreateCustom(deviceContext, vertices, indices, std::vector<LodLevel>(1, full));
+}
+
+
+std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateCustom(_In_ ID3D11DeviceContext* deviceContext, std::vector<VertexType> const& vertices, std::vector<uint16_t> const& indices)
+{
+    return CreateCustom(deviceContext, vertices, IndexCollection(indices.begin(), indices.end()));
+}
+
+
+// Reorders the geometry for the post-transform vertex cache, then for vertex fetch locality.
+void GeometricPrimitive::OptimizeForVertexCache(std::vector<VertexType>& vertices, std::vector<uint32_t>& indices)
+{
+    VertexCache::OptimizeFaces(indices, vertices.size());
+    VertexCache::OptimizeVertices(vertices, indices);
+}
+
+
+float GeometricPrimitive::ComputeACMR(std::vector<uint32_t> const& indices, size_t cacheSize)
+{
+    return VertexCache::ComputeACMR(indices, cacheSize);
+}
+
+
+// Appends simplified versions of the mesh to the index collection, sharing its vertices.
+void GeometricPrimitive::ComputeLods(std::vector<VertexType> const& vertices, std::vector<uint32_t>& indices, std::vector<LodLevel>& lods, size_t lodCount)
+{
+    ValidateGeometry(vertices, indices);
+
+    std::vector<MeshLod::Level> levels;
+
+    MeshLod::GenerateLevels(indices, reinterpret_cast<uint8_t const*>( &vertices.front().position ), sizeof(VertexType), vertices.size(), lodCount, 0.5f, levels);
+
+    lods.clear();
+
+    for ( auto it = levels.begin(); it != levels.end(); ++it )
+    {
+        LodLevel lod = { it->startIndex, it->indexCount, it->error };
+
+        lods.push_back(lod);
+
+        // Simplification scrambles the triangle order, so each new level needs its own pass for the vertex cache.
+        if ( it != levels.begin() )
+        {
+            auto first = indices.begin() + it->startIndex;
+            auto last = first + it->indexCount;
+
+            IndexCollection levelIndices(first, last);
+
+            VertexCache::OptimizeFaces(levelIndices, vertices.size());
+
+            std::copy(levelIndices.begin(), levelIndices.end(), first);
+        }
+    }
+}
+
+
+//--------------------------------------------------------------------------------------
+// Geometry cache
+//--------------------------------------------------------------------------------------
+
+namespace
+{
+    enum GeometryShape
+    {
+        GeometryShape_Cube,
+        GeometryShape_Sphere,
+        GeometryShape_GeoSphere,
+        GeometryShape_Cylinder,
+        GeometryShape_Cone,
+        GeometryShape_Torus,
+        GeometryShape_Tetrahedron,
+        GeometryShape_Octahedron,
+        GeometryShape_Dodecahedron,
+        GeometryShape_Icosahedron,
+        GeometryShape_Teapot,
+    };
+
+
+    // Identifies computed geometry by everything that goes into generating it.
+    struct GeometryKey
+    {
+        GeometryShape shape;
+        float param1;
+        float param2;
+        size_t tessellation;
+        bool rhcoords;
+
+        bool operator< (GeometryKey const& other) const
+        {
+            if (shape != other.shape)               return shape < other.shape;
+            if (param1 != other.param1)             return param1 < other.param1;
+            if (param2 != other.param2)             return param2 < other.param2;
+            if (tessellation != other.tessellation) return tessellation < other.tessellation;
+
+            return rhcoords < other.rhcoords;
+        }
+    };
+
+
+    struct Geometry
+    {
+        VertexCollection vertices;
+        IndexCollection indices;
+    };
+
+
+    // Thread safe store of computed geometry, so creating the same primitive again skips the tessellation work.
+    // The least recently used geometry is dropped once the cache grows past MaxSize, so creating many differently
+    // sized or tessellated primitives doesn't keep every one of them alive.
+    class GeometryCache
+    {
+    public:
+        static const size_t MaxSize = 16 * 1024 * 1024;
+
+        GeometryCache()
+          : mSize(0)
+        { }
+
+        template<typename TCompute>
+        std::shared_ptr<Geometry const> DemandCreate(GeometryKey const& key, TCompute compute)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+
+                auto pos = mGeometry.find(key);
+
+                if (pos != mGeometry.end())
+                    return Touch(pos->second);
+            }
+
+            // Compute outside the lock, so different shapes can be generated on several threads at once.
+            std::shared_ptr<Geometry> geometry(new Geometry());
+
+            compute(*geometry);
+
+            size_t size = geometry->vertices.size() * sizeof(VertexPositionNormalTexture) + geometry->indices.size() * sizeof(uint32_t);
+
+            std::lock_guard<std::mutex> lock(mMutex);
+
+            // If another thread got there first, keep its copy.
+            auto pos = mGeometry.find(key);
+
+            if (pos != mGeometry.end())
+                return Touch(pos->second);
+
+            // Anything too big to ever fit is just handed back.
+            if (size > MaxSize)
+                return geometry;
+
+            mRecent.push_front(key);
+
+            Entry entry = { geometry, size, mRecent.begin() };
+
+            mGeometry.insert(std::make_pair(key, entry));
+            mSize += size;
+
+            while (mSize > MaxSize)
+            {
+                auto oldest = mGeometry.find(mRecent.back());
+
+                mSize -= oldest->second.size;
+                mGeometry.erase(oldest);
+                mRecent.pop_back();
+            }
+
+            return geometry;
+        }
+
+        void Clear()
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+
+            mGeometry.clear();
+            mRecent.clear();
+            mSize = 0;
+        }
+
+    private:
+        struct Entry
+        {
+            std::shared_ptr<Geometry const> geometry;
+            size_t size;
+            std::list<GeometryKey>::iterator recent;
+        };
+
+        // Moves an entry to the front of the recently used list. Must be called with the lock held.
+        std::shared_ptr<Geometry const> Touch(Entry& entry)
+        {
+            mRecent.splice(mRecent.begin(), mRecent, entry.recent);
+
+            return entry.geometry;
+        }
+
+        std::map<GeometryKey, Entry> mGeometry;
+        std::list<GeometryKey> mRecent;
+        size_t mSize;
+        std::mutex mMutex;
+    };
+
+
+    GeometryCache geometryCache;
+
+
+    template<typename TCompute>
+    std::unique_ptr<GeometricPrimitive> CreateFromCache(_In_ ID3D11DeviceContext* deviceContext, GeometryKey const& key, TCompute compute)
+    {
+        auto geometry = geometryCache.DemandCreate(key, [&](Geometry& geometry)
+        {
+            compute(geometry.vertices, geometry.indices);
+
+            // Cached geometry is reused, so this only costs anything the first time each shape is created.
+            GeometricPrimitive::OptimizeForVertexCache(geometry.vertices, geometry.indices);
+        });
+
+        return GeometricPrimitive::CreateCustom(deviceContext, geometry->vertices, geometry->indices);
+    }
+}
+
+
+void GeometricPrimitive::ClearGeometryCache()
+{
+    geometryCache.Clear();
+}
+
+
 //--------------------------------------------------------------------------------------
 // Cube (aka a Hexahedron)
 //--------------------------------------------------------------------------------------
 
-// Creates a cube primitive.
-std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateCube(_In_ ID3D11DeviceContext* deviceContext, float size, bool rhcoords)
+// Computes the geometry of a cube primitive.
+void GeometricPrimitive::ComputeCube(VertexCollection& vertices, IndexCollection& indices, float size, bool rhcoords)
 {
     // A cube has six faces, each one pointing in a different direction.
     const int FaceCount = 6;
@@ -411,8 +739,8 @@ std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateCube(_In_ ID3D11De
         { 0, 0 },
     };
 
-    VertexCollection vertices;
-    IndexCollection indices;
+    vertices.clear();
+    indices.clear();
 
     size /= 2;
 
@@ -429,13 +757,13 @@ std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateCube(_In_ ID3D11De
 
         // Six indices (two triangles) per face.
         size_t vbase = vertices.size();
-        indices.push_back(vbase + 0);
-        indices.push_back(vbase + 1);
-        indices.push_back(vbase + 2);
+        index_push_back(indices, vbase + 0);
+        index_push_back(indices, vbase + 1);
+        index_push_back(indices, vbase + 2);
 
-        indices.push_back(vbase + 0);
-        indices.push_back(vbase + 2);
-        indices.push_back(vbase + 3);
+        index_push_back(indices, vbase + 0);
+        index_push_back(indices, vbase + 2);
+        index_push_back(indices, vbase + 3);
 
         // Four vertices per face.
         vertices.push_back(VertexPositionNormalTexture((normal - side1 - side2) * size, normal, textureCoordinates[0]));
@@ -444,12 +772,19 @@ std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateCube(_In_ ID3D11De
         vertices.push_back(VertexPositionNormalTexture((normal + side1 - side2) * size, normal, textureCoordinates[3]));
     }
 
-    // Create the primitive object.
-    std::unique_ptr<GeometricPrimitive> primitive(new GeometricPrimitive());
-    
-    primitive->pImpl->Initialize(deviceContext, vertices, indices, rhcoords);
+    if (!rhcoords)
+        ReverseWinding(indices, vertices);
+}
 
-    return primitive;
+
+std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateCube(_In_ ID3D11DeviceContext* deviceContext, float size, bool rhcoords)
+{
+    GeometryKey key = { GeometryShape_Cube, size, 0, 0, rhcoords };
+
+    return CreateFromCache(deviceContext, key, [=](VertexCollection& vertices, IndexCollection& indices)
+    {
+        ComputeCube(vertices, indices, size, rhcoords);
+    });
 }
 
 
@@ -458,11 +793,11 @@ std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateCube(_In_ ID3D11De
 // Sphere
 //--------------------------------------------------------------------------------------
 
-// Creates a sphere primitive.
-std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateSphere(_In_ ID3D11DeviceContext* deviceContext, float diameter, size_t tessellation, bool rhcoords)
+// Computes the geometry of a sphere primitive.
+void GeometricPrimitive::ComputeSphere(VertexCollection& vertices, IndexCollection& indices, float diameter, size_t tessellation, bool rhcoords)
 {
-    VertexCollection vertices;
-    IndexCollection indices;
+    vertices.clear();
+    indices.clear();
 
     if (tessellation < 3)
         throw std::out_of_range("tesselation parameter out of range");
@@ -512,22 +847,29 @@ std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateSphere(_In_ ID3D11
             size_t nextI = i + 1;
             size_t nextJ = (j + 1) % stride;
 
-            indices.push_back(i * stride + j);
-            indices.push_back(nextI * stride + j);
-            indices.push_back(i * stride + nextJ);
+            index_push_back(indices, i * stride + j);
+            index_push_back(indices, nextI * stride + j);
+            index_push_back(indices, i * stride + nextJ);
 
-            indices.push_back(i * stride + nextJ);
-            indices.push_back(nextI * stride + j);
-            indices.push_back(nextI * stride + nextJ);
+            index_push_back(indices, i * stride + nextJ);
+            index_push_back(indices, nextI * stride + j);
+            index_push_back(indices, nextI * stride + nextJ);
         }
     }
 
-    // Create the primitive object.
-    std::unique_ptr<GeometricPrimitive> primitive(new GeometricPrimitive());
-    
-    primitive->pImpl->Initialize(deviceContext, vertices, indices, rhcoords);
+    if (!rhcoords)
+        ReverseWinding(indices, vertices);
+}
 
-    return primitive;
+
+std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateSphere(_In_ ID3D11DeviceContext* deviceContext, float diameter, size_t tessellation, bool rhcoords)
+{
+    GeometryKey key = { GeometryShape_Sphere, diameter, 0, tessellation, rhcoords };
+
+    return CreateFromCache(deviceContext, key, [=](VertexCollection& vertices, IndexCollection& indices)
+    {
+        ComputeSphere(vertices, indices, diameter, tessellation, rhcoords);
+    });
 }
 
 
@@ -535,25 +877,81 @@ std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateSphere(_In_ ID3D11
 // Geodesic sphere
 //--------------------------------------------------------------------------------------
 
-// Creates a geosphere primitive.
-std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateGeoSphere(_In_ ID3D11DeviceContext* deviceContext, float diameter, size_t tessellation, bool rhcoords)
+namespace
 {
-    // An undirected edge between two vertices, represented by a pair of indexes into a vertex array.
-    // Becuse this edge is undirected, (a,b) is the same as (b,a).
-    typedef std::pair<uint16_t, uint16_t> UndirectedEdge;
-
-    // Makes an undirected edge. Rather than overloading comparison operators to give us the (a,b)==(b,a) property,
-    // we'll just ensure that the larger of the two goes first. This'll simplify things greatly.
-    auto makeUndirectedEdge = [](uint16_t a, uint16_t b)
+    // Maps an undirected edge to the index of the vertex which lies midway between its two ends.
+    // This is used to avoid duplicating vertices when subdividing triangles along edges. The edge
+    // count is known in advance, so an open addressed table never needs to grow or rehash.
+    class EdgeMidpointTable
     {
-        return std::make_pair(std::max(a, b), std::min(a, b));
+    public:
+        // Empties the table, sizing it to stay under half full with the specified number of edges.
+        void Reset(size_t edgeCount)
+        {
+            size_t capacity = 16;
+            mShift = 60;
+
+            while (capacity < edgeCount * 2)
+            {
+                capacity *= 2;
+                mShift--;
+            }
+
+            Entry empty = { EmptyKey, 0 };
+
+            mEntries.assign(capacity, empty);
+        }
+
+        // Returns the slot for the edge (a,b), which is the same as (b,a). If it is new, the slot is claimed
+        // and isNew is set, so the caller can fill in the midpoint index.
+        uint32_t& Find(uint32_t a, uint32_t b, bool& isNew)
+        {
+            // Put the larger of the two first, which gives us the (a,b)==(b,a) property.
+            uint64_t key = (a > b) ? ((uint64_t)a << 32) | b : ((uint64_t)b << 32) | a;
+
+            // Fibonacci hashing spreads the neighbouring indices found in a subdivided mesh across the table.
+            size_t mask = mEntries.size() - 1;
+            size_t slot = (size_t)((key * 0x9E3779B97F4A7C15ull) >> mShift) & mask;
+
+            for (;;)
+            {
+                Entry& entry = mEntries[slot];
+
+                if (entry.key == key)
+                {
+                    isNew = false;
+                    return entry.midpoint;
+                }
+
+                if (entry.key == EmptyKey)
+                {
+                    entry.key = key;
+                    isNew = true;
+                    return entry.midpoint;
+                }
+
+                slot = (slot + 1) & mask;
+            }
+        }
+
+    private:
+        static const uint64_t EmptyKey = ~0ull;
+
+        struct Entry
+        {
+            uint64_t key;
+            uint32_t midpoint;
+        };
+
+        std::vector<Entry> mEntries;
+        int mShift;
     };
+}
 
-    // Key: an edge
-    // Value: the index of the vertex which lies midway between the two vertices pointed to by the key value
-    // This map is used to avoid duplicating vertices when subdividing triangles along edges.
-    typedef std::map<UndirectedEdge, uint16_t> EdgeSubdivisionMap;
 
+// Computes the geometry of a geosphere primitive.
+void GeometricPrimitive::ComputeGeoSphere(VertexCollection& vertices, IndexCollection& indices, float diameter, size_t tessellation, bool rhcoords)
+{
 
     static const XMFLOAT3 OctahedronVertices[] =
     {
@@ -565,7 +963,7 @@ std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateGeoSphere(_In_ ID3
         XMFLOAT3(-1,  0,  0), // 4 left
         XMFLOAT3( 0, -1,  0), // 5 bottom
     };
-    static const uint16_t OctahedronIndices[] =
+    static const uint32_t OctahedronIndices[] =
     {
         0, 1, 2, // top front-right face
         0, 2, 3, // top back-right face
@@ -578,88 +976,97 @@ std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateGeoSphere(_In_ ID3
     };
 
     const float radius = diameter / 2.0f;
-    
+
+    // Each subdivision splits every edge once, and every triangle into four,
+    // so we know up front how big the final vertex and index collections will be.
+    size_t vertexCount = _countof(OctahedronVertices);
+    size_t edgeCount = 12;
+    size_t triangleCount = _countof(OctahedronIndices) / 3;
+
+    for (size_t iSubdivision = 0; iSubdivision < tessellation; ++iSubdivision)
+    {
+        vertexCount += edgeCount;
+        edgeCount = edgeCount * 2 + triangleCount * 3;
+        triangleCount *= 4;
+    }
+
+    CheckIndexOverflow(vertexCount);
+
     // Start with an octahedron; copy the data into the vertex/index collection.
 
-    std::vector<XMFLOAT3> vertexPositions(std::begin(OctahedronVertices), std::end(OctahedronVertices));
+    std::vector<XMFLOAT3> vertexPositions;
+    vertexPositions.reserve(vertexCount);
+    vertexPositions.assign(std::begin(OctahedronVertices), std::end(OctahedronVertices));
 
-    IndexCollection indices;
-    indices.insert(indices.begin(), std::begin(OctahedronIndices), std::end(OctahedronIndices));
+    indices.reserve(triangleCount * 3);
+    indices.assign(std::begin(OctahedronIndices), std::end(OctahedronIndices));
 
     // We know these values by looking at the above index list for the octahedron. Despite the subdivisions that are
     // about to go on, these values aren't ever going to change because the vertices don't move around in the array.
     // We'll need these values later on to fix the singularities that show up at the poles.
-    const uint16_t northPoleIndex = 0;
-    const uint16_t southPoleIndex = 5;
-    
+    const uint32_t northPoleIndex = 0;
+    const uint32_t southPoleIndex = 5;
+
+    // We use this to keep track of which edges have already been subdivided.
+    EdgeMidpointTable subdividedEdges;
+
+    // The new index collection after subdivision. Swapped with indices after each pass, so neither reallocates.
+    IndexCollection newIndices;
+    newIndices.reserve(triangleCount * 3);
+
+    edgeCount = 12;
+
     for (size_t iSubdivision = 0; iSubdivision < tessellation; ++iSubdivision)
     {
         assert(indices.size() % 3 == 0); // sanity
 
-        // We use this to keep track of which edges have already been subdivided.
-        EdgeSubdivisionMap subdividedEdges;
+        const size_t passTriangleCount = indices.size() / 3;
 
-        // The new index collection after subdivision.
-        IndexCollection newIndices;
+        subdividedEdges.Reset(edgeCount);
+        newIndices.clear();
 
-        const size_t triangleCount = indices.size() / 3;
-        for (size_t iTriangle = 0; iTriangle < triangleCount; ++iTriangle)
+        // Function that, when given the index of two vertices, returns the index of the vertex at their midpoint, creating it if need be.
+        auto divideEdge = [&](uint32_t i0, uint32_t i1) -> uint32_t
+        {
+            bool isNew;
+            uint32_t& midpoint = subdividedEdges.Find(i0, i1, isNew);
+
+            if (isNew)
+            {
+                // Haven't generated this vertex before: so add it now
+
+                // outVertex = (vertices[i0] + vertices[i1]) / 2
+                XMFLOAT3 outVertex;
+
+                XMStoreFloat3(
+                    &outVertex,
+                    XMVectorScale(
+                        XMVectorAdd(XMLoadFloat3(&vertexPositions[i0]), XMLoadFloat3(&vertexPositions[i1])),
+                        0.5f
+                    )
+                );
+
+                midpoint = static_cast<uint32_t>( vertexPositions.size() );
+                vertexPositions.push_back(outVertex);
+            }
+
+            return midpoint;
+        };
+
+        for (size_t iTriangle = 0; iTriangle < passTriangleCount; ++iTriangle)
         {
             // For each edge on this triangle, create a new vertex in the middle of that edge.
             // The winding order of the triangles we output are the same as the winding order of the inputs.
 
             // Indices of the vertices making up this triangle
-            uint16_t iv0 = indices[iTriangle*3+0];
-            uint16_t iv1 = indices[iTriangle*3+1];
-            uint16_t iv2 = indices[iTriangle*3+2];
-            
-            // Get the new vertices
-            XMFLOAT3 v01; // vertex on the midpoint of v0 and v1
-            XMFLOAT3 v12; // ditto v1 and v2
-            XMFLOAT3 v20; // ditto v2 and v0
-            uint16_t iv01; // index of v01
-            uint16_t iv12; // index of v12
-            uint16_t iv20; // index of v20
-
-            // Function that, when given the index of two vertices, creates a new vertex at the midpoint of those vertices.
-            auto divideEdge = [&](uint16_t i0, uint16_t i1, XMFLOAT3& outVertex, uint16_t& outIndex)
-            {
-                const UndirectedEdge edge = makeUndirectedEdge(i0, i1);
-
-                // Check to see if we've already generated this vertex
-                auto it = subdividedEdges.find(edge);
-                if (it != subdividedEdges.end())
-                {
-                    // We've already generated this vertex before
-                    outIndex = it->second; // the index of this vertex
-                    outVertex = vertexPositions[outIndex]; // and the vertex itself
-                }
-                else
-                {
-                    // Haven't generated this vertex before: so add it now
-
-                    // outVertex = (vertices[i0] + vertices[i1]) / 2
-                    XMStoreFloat3(
-                        &outVertex,
-                        XMVectorScale(
-                            XMVectorAdd(XMLoadFloat3(&vertexPositions[i0]), XMLoadFloat3(&vertexPositions[i1])),
-                            0.5f
-                        )
-                    );
-
-                    outIndex = static_cast<uint16_t>( vertexPositions.size() );
-                    CheckIndexOverflow(outIndex);
-                    vertexPositions.push_back(outVertex);
-
-                    // Now add it to the map.
-                    subdividedEdges.insert(std::make_pair(edge, outIndex));
-                }
-            };
+            uint32_t iv0 = indices[iTriangle*3+0];
+            uint32_t iv1 = indices[iTriangle*3+1];
+            uint32_t iv2 = indices[iTriangle*3+2];
 
             // Add/get new vertices and their indices
-            divideEdge(iv0, iv1, v01, iv01);
-            divideEdge(iv1, iv2, v12, iv12);
-            divideEdge(iv0, iv2, v20, iv20);
+            uint32_t iv01 = divideEdge(iv0, iv1); // index of the vertex on the midpoint of v0 and v1
+            uint32_t iv12 = divideEdge(iv1, iv2); // ditto v1 and v2
+            uint32_t iv20 = divideEdge(iv0, iv2); // ditto v2 and v0
 
             // Add the new indices. We have four new triangles from our original one:
             //        v0
@@ -669,7 +1076,7 @@ std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateGeoSphere(_In_ ID3
             //     /b\c/d\
             // v2 o---o---o v1
             //       v12
-            const uint16_t indicesToAdd[] =
+            const uint32_t indicesToAdd[] =
             {
                  iv0, iv01, iv20, // a
                 iv20, iv12,  iv2, // b
@@ -679,11 +1086,16 @@ std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateGeoSphere(_In_ ID3
             newIndices.insert(newIndices.end(), std::begin(indicesToAdd), std::end(indicesToAdd));
         }
 
-        indices = std::move(newIndices);
+        indices.swap(newIndices);
+
+        edgeCount = edgeCount * 2 + passTriangleCount * 3;
     }
 
+    assert(vertexPositions.size() == vertexCount);
+    assert(indices.size() == triangleCount * 3);
+
     // Now that we've completed subdivision, fill in the final vertex collection
-    VertexCollection vertices;
+    vertices.clear();
     vertices.reserve(vertexPositions.size());
     for (auto it = vertexPositions.begin(); it != vertexPositions.end(); ++it)
     {
@@ -717,6 +1129,10 @@ std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateGeoSphere(_In_ ID3
     // y=1 and ending at y=-1, and sweeping across the range of z=0 to z=1. x stays zero. It's along this edge that we
     // need to duplicate our vertices - and provide the correct texture coordinates.
     size_t preFixupVertexCount = vertices.size();
+
+    // Index of the corrected copy of each vertex on the prime meridian, or zero for the rest (no copy can be vertex zero).
+    IndexCollection meridianCopies(preFixupVertexCount, 0);
+
     for (size_t i = 0; i < preFixupVertexCount; ++i)
     {
         // This vertex is on the prime meridian if position.x and texcoord.u are both zero (allowing for small epsilon).
@@ -735,47 +1151,47 @@ std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateGeoSphere(_In_ ID3
             v.textureCoordinate.x = 1.0f;
             vertices.push_back(v);
 
-            // Now find all the triangles which contain this vertex and update them if necessary
-            for (size_t j = 0; j < indices.size(); j += 3)
+            meridianCopies[i] = static_cast<uint32_t>(newIndex);
+        }
+    }
+
+    // Now find all the triangles which contain one of those vertices and update them if necessary. This is a single pass
+    // over the triangles, rather than one per meridian vertex, which made the fixup quadratic in the tessellation.
+    for (size_t j = 0; j < indices.size(); j += 3)
+    {
+        uint32_t* triIndices = &indices[j];
+
+        // Decide every corner against the original texture coordinates before changing any of them. A triangle can have
+        // two corners on the meridian, and both get the corrected copy exactly when the third vertex is across the seam.
+        bool fixCorner[3];
+
+        for (size_t k = 0; k < 3; ++k)
+        {
+            fixCorner[k] = false;
+
+            if (!meridianCopies[triIndices[k]])
             {
-                uint16_t* triIndex0 = &indices[j+0];
-                uint16_t* triIndex1 = &indices[j+1];
-                uint16_t* triIndex2 = &indices[j+2];
+                // this corner doesn't use a vertex we're interested in
+                continue;
+            }
 
-                if (*triIndex0 == i)
-                {
-                    // nothing; just keep going
-                }
-                else if (*triIndex1 == i)
-                {
-                    std::swap(triIndex0, triIndex1); // swap the pointers (not the values)
-                }
-                else if (*triIndex2 == i)
-                {
-                    std::swap(triIndex0, triIndex2); // swap the pointers (not the values)
-                }
-                else
-                {
-                    // this triangle doesn't use the vertex we're interested in
-                    continue;
-                }
+            const VertexPositionNormalTexture& v0 = vertices[triIndices[k]];
+            const VertexPositionNormalTexture& v1 = vertices[triIndices[(k + 1) % 3]];
+            const VertexPositionNormalTexture& v2 = vertices[triIndices[(k + 2) % 3]];
 
-                // If we got to this point then triIndex0 is the pointer to the index to the vertex we're looking at
-                assert(*triIndex0 == i);
-                assert(*triIndex1 != i && *triIndex2 != i); // assume no degenerate triangles
-                
-                const VertexPositionNormalTexture& v0 = vertices[*triIndex0];
-                const VertexPositionNormalTexture& v1 = vertices[*triIndex1];
-                const VertexPositionNormalTexture& v2 = vertices[*triIndex2];
+            assert(triIndices[k] != triIndices[(k + 1) % 3] && triIndices[k] != triIndices[(k + 2) % 3]); // assume no degenerate triangles
 
-                // check the other two vertices to see if we might need to fix this triangle
+            // check the other two vertices to see if we might need to fix this triangle
+            fixCorner[k] = abs(v0.textureCoordinate.x - v1.textureCoordinate.x) > 0.5f ||
+                           abs(v0.textureCoordinate.x - v2.textureCoordinate.x) > 0.5f;
+        }
 
-                if (abs(v0.textureCoordinate.x - v1.textureCoordinate.x) > 0.5f ||
-                    abs(v0.textureCoordinate.x - v2.textureCoordinate.x) > 0.5f)
-                {
-                    // yep; replace the specified index to point to the new, corrected vertex
-                    *triIndex0 = static_cast<uint16_t>(newIndex);
-                }
+        for (size_t k = 0; k < 3; ++k)
+        {
+            if (fixCorner[k])
+            {
+                // yep; replace the specified index to point to the new, corrected vertex
+                triIndices[k] = meridianCopies[triIndices[k]];
             }
         }
     }
@@ -795,9 +1211,9 @@ std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateGeoSphere(_In_ ID3
             // These pointers point to the three indices which make up this triangle. pPoleIndex is the pointer to the
             // entry in the index array which represents the pole index, and the other two pointers point to the other
             // two indices making up this triangle.
-            uint16_t* pPoleIndex;
-            uint16_t* pOtherIndex0;
-            uint16_t* pOtherIndex1;
+            uint32_t* pPoleIndex;
+            uint32_t* pOtherIndex0;
+            uint32_t* pOtherIndex1;
             if (indices[i + 0] == poleIndex)
             {
                 pPoleIndex = &indices[i + 0];
@@ -838,7 +1254,7 @@ std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateGeoSphere(_In_ ID3
             {
                 CheckIndexOverflow(vertices.size());
 
-                *pPoleIndex = static_cast<uint16_t>(vertices.size());
+                *pPoleIndex = static_cast<uint32_t>(vertices.size());
                 vertices.push_back(newPoleVertex);
             }
         }
@@ -847,11 +1263,19 @@ std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateGeoSphere(_In_ ID3
     fixPole(northPoleIndex);
     fixPole(southPoleIndex);
 
-    // Create the primitive object.
-    std::unique_ptr<GeometricPrimitive> primitive(new GeometricPrimitive());
-    
-    primitive->pImpl->Initialize(deviceContext, vertices, indices, rhcoords);
-    return primitive;
+    if (!rhcoords)
+        ReverseWinding(indices, vertices);
+}
+
+
+std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateGeoSphere(_In_ ID3D11DeviceContext* deviceContext, float diameter, size_t tessellation, bool rhcoords)
+{
+    GeometryKey key = { GeometryShape_GeoSphere, diameter, 0, tessellation, rhcoords };
+
+    return CreateFromCache(deviceContext, key, [=](VertexCollection& vertices, IndexCollection& indices)
+    {
+        ComputeGeoSphere(vertices, indices, diameter, tessellation, rhcoords);
+    });
 }
 
 
@@ -898,9 +1322,9 @@ static void CreateCylinderCap(VertexCollection& vertices, IndexCollection& indic
         }
 
         size_t vbase = vertices.size();
-        indices.push_back(vbase);
-        indices.push_back(vbase + i1);
-        indices.push_back(vbase + i2);
+        index_push_back(indices, vbase);
+        index_push_back(indices, vbase + i1);
+        index_push_back(indices, vbase + i2);
     }
 
     // Which end of the cylinder is this?
@@ -927,11 +1351,11 @@ static void CreateCylinderCap(VertexCollection& vertices, IndexCollection& indic
 }
 
 
-// Creates a cylinder primitive.
-std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateCylinder(_In_ ID3D11DeviceContext* deviceContext, float height, float diameter, size_t tessellation, bool rhcoords)
+// Computes the geometry of a cylinder primitive.
+void GeometricPrimitive::ComputeCylinder(VertexCollection& vertices, IndexCollection& indices, float height, float diameter, size_t tessellation, bool rhcoords)
 {
-    VertexCollection vertices;
-    IndexCollection indices;
+    vertices.clear();
+    indices.clear();
 
     if (tessellation < 3)
         throw std::out_of_range("tesselation parameter out of range");
@@ -957,33 +1381,40 @@ std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateCylinder(_In_ ID3D
         vertices.push_back(VertexPositionNormalTexture(sideOffset + topOffset, normal, textureCoordinate));
         vertices.push_back(VertexPositionNormalTexture(sideOffset - topOffset, normal, textureCoordinate + g_XMIdentityR1));
 
-        indices.push_back(i * 2);
-        indices.push_back((i * 2 + 2) % (stride * 2));
-        indices.push_back(i * 2 + 1);
+        index_push_back(indices, i * 2);
+        index_push_back(indices, (i * 2 + 2) % (stride * 2));
+        index_push_back(indices, i * 2 + 1);
 
-        indices.push_back(i * 2 + 1);
-        indices.push_back((i * 2 + 2) % (stride * 2));
-        indices.push_back((i * 2 + 3) % (stride * 2));
+        index_push_back(indices, i * 2 + 1);
+        index_push_back(indices, (i * 2 + 2) % (stride * 2));
+        index_push_back(indices, (i * 2 + 3) % (stride * 2));
     }
 
     // Create flat triangle fan caps to seal the top and bottom.
     CreateCylinderCap(vertices, indices, tessellation, height, radius, true);
     CreateCylinderCap(vertices, indices, tessellation, height, radius, false);
 
-    // Create the primitive object.
-    std::unique_ptr<GeometricPrimitive> primitive(new GeometricPrimitive());
-    
-    primitive->pImpl->Initialize(deviceContext, vertices, indices, rhcoords);
+    if (!rhcoords)
+        ReverseWinding(indices, vertices);
+}
 
-    return primitive;
+
+std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateCylinder(_In_ ID3D11DeviceContext* deviceContext, float height, float diameter, size_t tessellation, bool rhcoords)
+{
+    GeometryKey key = { GeometryShape_Cylinder, height, diameter, tessellation, rhcoords };
+
+    return CreateFromCache(deviceContext, key, [=](VertexCollection& vertices, IndexCollection& indices)
+    {
+        ComputeCylinder(vertices, indices, height, diameter, tessellation, rhcoords);
+    });
 }
 
 
-// Creates a cone primitive.
-std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateCone(_In_ ID3D11DeviceContext* deviceContext, float diameter, float height, size_t tessellation, bool rhcoords)
+// Computes the geometry of a cone primitive.
+void GeometricPrimitive::ComputeCone(VertexCollection& vertices, IndexCollection& indices, float diameter, float height, size_t tessellation, bool rhcoords)
 {
-    VertexCollection vertices;
-    IndexCollection indices;
+    vertices.clear();
+    indices.clear();
 
     if (tessellation < 3)
         throw std::out_of_range("tesselation parameter out of range");
@@ -1015,20 +1446,27 @@ std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateCone(_In_ ID3D11De
         vertices.push_back(VertexPositionNormalTexture(topOffset, normal, g_XMZero));
         vertices.push_back(VertexPositionNormalTexture(pt, normal, textureCoordinate + g_XMIdentityR1 ));
 
-        indices.push_back(i * 2);
-        indices.push_back((i * 2 + 3) % (stride * 2));
-        indices.push_back((i * 2 + 1) % (stride * 2));
+        index_push_back(indices, i * 2);
+        index_push_back(indices, (i * 2 + 3) % (stride * 2));
+        index_push_back(indices, (i * 2 + 1) % (stride * 2));
     }
 
     // Create flat triangle fan caps to seal the bottom.
     CreateCylinderCap(vertices, indices, tessellation, height, radius, false);
 
-    // Create the primitive object.
-    std::unique_ptr<GeometricPrimitive> primitive(new GeometricPrimitive());
-    
-    primitive->pImpl->Initialize(deviceContext, vertices, indices, rhcoords);
+    if (!rhcoords)
+        ReverseWinding(indices, vertices);
+}
 
-    return primitive;
+
+std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateCone(_In_ ID3D11DeviceContext* deviceContext, float diameter, float height, size_t tessellation, bool rhcoords)
+{
+    GeometryKey key = { GeometryShape_Cone, diameter, height, tessellation, rhcoords };
+
+    return CreateFromCache(deviceContext, key, [=](VertexCollection& vertices, IndexCollection& indices)
+    {
+        ComputeCone(vertices, indices, diameter, height, tessellation, rhcoords);
+    });
 }
 
 
@@ -1036,11 +1474,11 @@ std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateCone(_In_ ID3D11De
 // Torus
 //--------------------------------------------------------------------------------------
 
-// Creates a torus primitive.
-std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateTorus(_In_ ID3D11DeviceContext* deviceContext, float diameter, float thickness, size_t tessellation, bool rhcoords)
+// Computes the geometry of a torus primitive.
+void GeometricPrimitive::ComputeTorus(VertexCollection& vertices, IndexCollection& indices, float diameter, float thickness, size_t tessellation, bool rhcoords)
 {
-    VertexCollection vertices;
-    IndexCollection indices;
+    vertices.clear();
+    indices.clear();
 
     if (tessellation < 3)
         throw std::out_of_range("tesselation parameter out of range");
@@ -1082,22 +1520,29 @@ std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateTorus(_In_ ID3D11D
             size_t nextI = (i + 1) % stride;
             size_t nextJ = (j + 1) % stride;
 
-            indices.push_back(i * stride + j);
-            indices.push_back(i * stride + nextJ);
-            indices.push_back(nextI * stride + j);
+            index_push_back(indices, i * stride + j);
+            index_push_back(indices, i * stride + nextJ);
+            index_push_back(indices, nextI * stride + j);
 
-            indices.push_back(i * stride + nextJ);
-            indices.push_back(nextI * stride + nextJ);
-            indices.push_back(nextI * stride + j);
+            index_push_back(indices, i * stride + nextJ);
+            index_push_back(indices, nextI * stride + nextJ);
+            index_push_back(indices, nextI * stride + j);
         }
     }
 
-    // Create the primitive object.
-    std::unique_ptr<GeometricPrimitive> primitive(new GeometricPrimitive());
-    
-    primitive->pImpl->Initialize(deviceContext, vertices, indices, rhcoords);
+    if (!rhcoords)
+        ReverseWinding(indices, vertices);
+}
 
-    return primitive;
+
+std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateTorus(_In_ ID3D11DeviceContext* deviceContext, float diameter, float thickness, size_t tessellation, bool rhcoords)
+{
+    GeometryKey key = { GeometryShape_Torus, diameter, thickness, tessellation, rhcoords };
+
+    return CreateFromCache(deviceContext, key, [=](VertexCollection& vertices, IndexCollection& indices)
+    {
+        ComputeTorus(vertices, indices, diameter, thickness, tessellation, rhcoords);
+    });
 }
 
 
@@ -1105,10 +1550,10 @@ std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateTorus(_In_ ID3D11D
 // Tetrahedron
 //--------------------------------------------------------------------------------------
 
-std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateTetrahedron(_In_ ID3D11DeviceContext* deviceContext, float size, bool rhcoords)
+void GeometricPrimitive::ComputeTetrahedron(VertexCollection& vertices, IndexCollection& indices, float size, bool rhcoords)
 {
-    VertexCollection vertices;
-    IndexCollection indices;
+    vertices.clear();
+    indices.clear();
 
     static const XMVECTORF32 verts[4] =
     {
@@ -1137,9 +1582,9 @@ std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateTetrahedron(_In_ I
         normal = XMVector3Normalize( normal );
 
         size_t base = vertices.size();
-        indices.push_back( base );
-        indices.push_back( base + 1 );
-        indices.push_back( base + 2 );
+        index_push_back(indices, base );
+        index_push_back(indices, base + 1 );
+        index_push_back(indices, base + 2 );
  
         // Duplicate vertices to use face normals
         XMVECTOR position = XMVectorScale( verts[ v0 ], size );
@@ -1155,12 +1600,20 @@ std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateTetrahedron(_In_ I
     assert( vertices.size() == 4*3 );
     assert( indices.size() == 4*3 );
 
-    // Create the primitive object.
-    std::unique_ptr<GeometricPrimitive> primitive(new GeometricPrimitive());
-    
-    primitive->pImpl->Initialize(deviceContext, vertices, indices, !rhcoords);
+    // This shape is built with the opposite winding to the others.
+    if (rhcoords)
+        ReverseWinding(indices, vertices);
+}
 
-    return primitive;
+
+std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateTetrahedron(_In_ ID3D11DeviceContext* deviceContext, float size, bool rhcoords)
+{
+    GeometryKey key = { GeometryShape_Tetrahedron, size, 0, 0, rhcoords };
+
+    return CreateFromCache(deviceContext, key, [=](VertexCollection& vertices, IndexCollection& indices)
+    {
+        ComputeTetrahedron(vertices, indices, size, rhcoords);
+    });
 }
 
 
@@ -1168,10 +1621,10 @@ std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateTetrahedron(_In_ I
 // Octahedron
 //--------------------------------------------------------------------------------------
 
-std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateOctahedron(_In_ ID3D11DeviceContext* deviceContext, float size, bool rhcoords )
+void GeometricPrimitive::ComputeOctahedron(VertexCollection& vertices, IndexCollection& indices, float size, bool rhcoords)
 {
-    VertexCollection vertices;
-    IndexCollection indices;
+    vertices.clear();
+    indices.clear();
 
     static const XMVECTORF32 verts[6] =
     {
@@ -1206,9 +1659,9 @@ std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateOctahedron(_In_ ID
         normal = XMVector3Normalize( normal );
 
         size_t base = vertices.size();
-        indices.push_back( base );
-        indices.push_back( base + 1 );
-        indices.push_back( base + 2 );
+        index_push_back(indices, base );
+        index_push_back(indices, base + 1 );
+        index_push_back(indices, base + 2 );
  
         // Duplicate vertices to use face normals
         XMVECTOR position = XMVectorScale( verts[ v0 ], size );
@@ -1224,12 +1677,20 @@ std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateOctahedron(_In_ ID
     assert( vertices.size() == 8*3 );
     assert( indices.size() == 8*3 );
 
-    // Create the primitive object.
-    std::unique_ptr<GeometricPrimitive> primitive(new GeometricPrimitive());
-    
-    primitive->pImpl->Initialize(deviceContext, vertices, indices, !rhcoords);
+    // This shape is built with the opposite winding to the others.
+    if (rhcoords)
+        ReverseWinding(indices, vertices);
+}
 
-    return primitive;
+
+std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateOctahedron(_In_ ID3D11DeviceContext* deviceContext, float size, bool rhcoords)
+{
+    GeometryKey key = { GeometryShape_Octahedron, size, 0, 0, rhcoords };
+
+    return CreateFromCache(deviceContext, key, [=](VertexCollection& vertices, IndexCollection& indices)
+    {
+        ComputeOctahedron(vertices, indices, size, rhcoords);
+    });
 }
 
 
@@ -1237,10 +1698,10 @@ std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateOctahedron(_In_ ID
 // Dodecahedron
 //--------------------------------------------------------------------------------------
 
-std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateDodecahedron(_In_ ID3D11DeviceContext* deviceContext, float size, bool rhcoords )
+void GeometricPrimitive::ComputeDodecahedron(VertexCollection& vertices, IndexCollection& indices, float size, bool rhcoords)
 {
-    VertexCollection vertices;
-    IndexCollection indices;
+    vertices.clear();
+    indices.clear();
 
     static const float a = 1.f/SQRT3;
     static const float b = 0.356822089773089931942f; // sqrt( ( 3 - sqrt(5) ) / 6 )
@@ -1326,17 +1787,17 @@ std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateDodecahedron(_In_
 
         size_t base = vertices.size();
 
-        indices.push_back( base );
-        indices.push_back( base + 1 );
-        indices.push_back( base + 2 );
+        index_push_back(indices, base );
+        index_push_back(indices, base + 1 );
+        index_push_back(indices, base + 2 );
 
-        indices.push_back( base );
-        indices.push_back( base + 2 );
-        indices.push_back( base + 3 );
+        index_push_back(indices, base );
+        index_push_back(indices, base + 2 );
+        index_push_back(indices, base + 3 );
 
-        indices.push_back( base );
-        indices.push_back( base + 3 );
-        indices.push_back( base + 4 );
+        index_push_back(indices, base );
+        index_push_back(indices, base + 3 );
+        index_push_back(indices, base + 4 );
 
         // Duplicate vertices to use face normals
         XMVECTOR position = XMVectorScale( verts[ v0 ], size );
@@ -1358,12 +1819,20 @@ std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateDodecahedron(_In_
     assert( vertices.size() == 12*5 );
     assert( indices.size() == 12*3*3 );
 
-    // Create the primitive object.
-    std::unique_ptr<GeometricPrimitive> primitive(new GeometricPrimitive());
-    
-    primitive->pImpl->Initialize(deviceContext, vertices, indices, !rhcoords);
+    // This shape is built with the opposite winding to the others.
+    if (rhcoords)
+        ReverseWinding(indices, vertices);
+}
 
-    return primitive;
+
+std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateDodecahedron(_In_ ID3D11DeviceContext* deviceContext, float size, bool rhcoords)
+{
+    GeometryKey key = { GeometryShape_Dodecahedron, size, 0, 0, rhcoords };
+
+    return CreateFromCache(deviceContext, key, [=](VertexCollection& vertices, IndexCollection& indices)
+    {
+        ComputeDodecahedron(vertices, indices, size, rhcoords);
+    });
 }
 
 
@@ -1371,10 +1840,10 @@ std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateDodecahedron(_In_
 // Icosahedron
 //--------------------------------------------------------------------------------------
 
-std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateIcosahedron(_In_ ID3D11DeviceContext* deviceContext, float size, bool rhcoords )
+void GeometricPrimitive::ComputeIcosahedron(VertexCollection& vertices, IndexCollection& indices, float size, bool rhcoords)
 {
-    VertexCollection vertices;
-    IndexCollection indices;
+    vertices.clear();
+    indices.clear();
 
     static const float  t = 1.618033988749894848205f; // (1 + sqrt(5)) / 2
     static const float t2 = 1.519544995837552493271f; // sqrt( 1 + sqr( (1 + sqrt(5)) / 2 ) )
@@ -1430,9 +1899,9 @@ std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateIcosahedron(_In_ I
         normal = XMVector3Normalize( normal );
 
         size_t base = vertices.size();
-        indices.push_back( base );
-        indices.push_back( base + 1 );
-        indices.push_back( base + 2 );
+        index_push_back(indices, base );
+        index_push_back(indices, base + 1 );
+        index_push_back(indices, base + 2 );
  
         // Duplicate vertices to use face normals
         XMVECTOR position = XMVectorScale( verts[ v0 ], size );
@@ -1448,12 +1917,20 @@ std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateIcosahedron(_In_ I
     assert( vertices.size() == 20*3 );
     assert( indices.size() == 20*3 );
 
-    // Create the primitive object.
-    std::unique_ptr<GeometricPrimitive> primitive(new GeometricPrimitive());
-    
-    primitive->pImpl->Initialize(deviceContext, vertices, indices, !rhcoords);
+    // This shape is built with the opposite winding to the others.
+    if (rhcoords)
+        ReverseWinding(indices, vertices);
+}
 
-    return primitive;
+
+std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateIcosahedron(_In_ ID3D11DeviceContext* deviceContext, float size, bool rhcoords)
+{
+    GeometryKey key = { GeometryShape_Icosahedron, size, 0, 0, rhcoords };
+
+    return CreateFromCache(deviceContext, key, [=](VertexCollection& vertices, IndexCollection& indices)
+    {
+        ComputeIcosahedron(vertices, indices, size, rhcoords);
+    });
 }
 
 
@@ -1469,7 +1946,7 @@ namespace
 
 
 // Tessellates the specified bezier patch.
-static void XM_CALLCONV TessellatePatch(VertexCollection& vertices, IndexCollection& indices, TeapotPatch const& patch, size_t tessellation, FXMVECTOR scale, bool isMirrored)
+static void XM_CALLCONV TessellatePatch(VertexCollection& vertices, IndexCollection& indices, TeapotPatch const& patch, Bezier::PatchBasis const& basis, FXMVECTOR scale, bool isMirrored)
 {
     // Look up the 16 control points for this patch.
     XMVECTOR controlPoints[16];
@@ -1481,24 +1958,24 @@ static void XM_CALLCONV TessellatePatch(VertexCollection& vertices, IndexCollect
 
     // Create the index data.
     size_t vbase = vertices.size();
-    Bezier::CreatePatchIndices(tessellation, isMirrored, [&](size_t index)
+    Bezier::CreatePatchIndices(basis.GetTessellation(), isMirrored, [&](size_t index)
     {
-        indices.push_back(vbase + index);
+        index_push_back(indices, vbase + index);
     });
 
     // Create the vertex data.
-    Bezier::CreatePatchVertices(controlPoints, tessellation, isMirrored, [&](FXMVECTOR position, FXMVECTOR normal, FXMVECTOR textureCoordinate)
+    Bezier::CreatePatchVertices(controlPoints, basis, isMirrored, [&](FXMVECTOR position, FXMVECTOR normal, FXMVECTOR textureCoordinate)
     {
         vertices.push_back(VertexPositionNormalTexture(position, normal, textureCoordinate));
     });
 }
 
         
-// Creates a teapot primitive.
-std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateTeapot(_In_ ID3D11DeviceContext* deviceContext, float size, size_t tessellation, bool rhcoords)
+// Computes the geometry of a teapot primitive.
+void GeometricPrimitive::ComputeTeapot(VertexCollection& vertices, IndexCollection& indices, float size, size_t tessellation, bool rhcoords)
 {
-    VertexCollection vertices;
-    IndexCollection indices;
+    vertices.clear();
+    indices.clear();
 
     if (tessellation < 1)
         throw std::out_of_range("tesselation parameter out of range");
@@ -1509,29 +1986,50 @@ std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateTeapot(_In_ ID3D11
     XMVECTOR scaleNegateZ = scaleVector * g_XMNegateZ;
     XMVECTOR scaleNegateXZ = scaleVector * g_XMNegateX * g_XMNegateZ;
 
+    // The bezier weights only depend on the tessellation, so are shared by every patch.
+    Bezier::PatchBasis basis(tessellation);
+
+    // Count the patches so the output can be allocated up front.
+    size_t patchCount = 0;
+
+    for (int i = 0; i < sizeof(TeapotPatches) / sizeof(TeapotPatches[0]); i++)
+    {
+        patchCount += TeapotPatches[i].mirrorZ ? 4 : 2;
+    }
+
+    vertices.reserve(patchCount * (tessellation + 1) * (tessellation + 1));
+    indices.reserve(patchCount * tessellation * tessellation * 6);
+
     for (int i = 0; i < sizeof(TeapotPatches) / sizeof(TeapotPatches[0]); i++)
     {
         TeapotPatch const& patch = TeapotPatches[i];
 
         // Because the teapot is symmetrical from left to right, we only store
         // data for one side, then tessellate each patch twice, mirroring in X.
-        TessellatePatch(vertices, indices, patch, tessellation, scaleVector, false);
-        TessellatePatch(vertices, indices, patch, tessellation, scaleNegateX, true);
+        TessellatePatch(vertices, indices, patch, basis, scaleVector, false);
+        TessellatePatch(vertices, indices, patch, basis, scaleNegateX, true);
 
         if (patch.mirrorZ)
         {
             // Some parts of the teapot (the body, lid, and rim, but not the
             // handle or spout) are also symmetrical from front to back, so
             // we tessellate them four times, mirroring in Z as well as X.
-            TessellatePatch(vertices, indices, patch, tessellation, scaleNegateZ, true);
-            TessellatePatch(vertices, indices, patch, tessellation, scaleNegateXZ, false);
+            TessellatePatch(vertices, indices, patch, basis, scaleNegateZ, true);
+            TessellatePatch(vertices, indices, patch, basis, scaleNegateXZ, false);
         }
     }
 
-    // Create the primitive object.
-    std::unique_ptr<GeometricPrimitive> primitive(new GeometricPrimitive());
-    
-    primitive->pImpl->Initialize(deviceContext, vertices, indices, rhcoords);
+    if (!rhcoords)
+        ReverseWinding(indices, vertices);
+}
 
-    return primitive;
+
+std::unique_ptr<GeometricPrimitive> GeometricPrimitive::CreateTeapot(_In_ ID3D11DeviceContext* deviceContext, float size, size_t tessellation, bool rhcoords)
+{
+    GeometryKey key = { GeometryShape_Teapot, size, 0, tessellation, rhcoords };
+
+    return CreateFromCache(deviceContext, key, [=](VertexCollection& vertices, IndexCollection& indices)
+    {
+        ComputeTeapot(vertices, indices, size, tessellation, rhcoords);
+    });
 }
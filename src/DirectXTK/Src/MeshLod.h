@@ -0,0 +1,640 @@
+//--------------------------------------------------------------------------------------
+// File: MeshLod.h
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// http://go.microsoft.com/fwlink/?LinkId=248929
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include <stdint.h>
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+
+
+namespace MeshLod
+{
+    // One level of detail: a range of a shared index buffer, and the largest distance of any full detail vertex from its surface.
+    struct Level
+    {
+        uint32_t startIndex;
+        uint32_t indexCount;
+        float error;
+    };
+
+
+    // Simplifies triangle lists by quadric error metric edge collapse (Garland & Heckbert). Vertices only ever
+    // move onto one of their neighbours, so every simplified index set still refers to the original vertices.
+    // Vertices on open edges are never moved, which also keeps texture seams and hard edges (where the mesh has
+    // duplicate vertices at the same position) intact. Calls can be chained to build progressively coarser
+    // levels; the quadrics carry over, and each reported error is measured against the original vertices.
+    class Simplifier
+    {
+    public:
+        // Positions are read as three floats at the start of each vertex.
+        Simplifier(_In_reads_bytes_(vertexCount * stride) uint8_t const* positions, size_t stride, size_t vertexCount, std::vector<uint32_t> const& indices)
+          : mPositions(positions),
+            mStride(stride),
+            mVertexCount(vertexCount),
+            mQuadrics(vertexCount),
+            mLocked(vertexCount),
+            mRepresentative(vertexCount),
+            mOriginalIndices(indices),
+            mError(0)
+        {
+            for (size_t i = 0; i < vertexCount; i++)
+            {
+                mRepresentative[i] = static_cast<uint32_t>(i);
+            }
+
+            BuildAdjacency(mOriginalIndices, mOriginalFirstTriangle, mOriginalAdjacency);
+
+            // Each triangle contributes its plane to the quadrics of its vertices, weighted by area.
+            for (size_t i = 0; i + 2 < indices.size(); i += 3)
+            {
+                Vector3 p0 = Position(indices[i]);
+                Vector3 p1 = Position(indices[i + 1]);
+                Vector3 p2 = Position(indices[i + 2]);
+
+                Vector3 normal = Cross(p1 - p0, p2 - p0);
+
+                double length = sqrt(Dot(normal, normal));
+
+                if (length <= 0)
+                    continue;
+
+                normal = normal * (1 / length);
+
+                Quadric q = Quadric::FromPlane(normal, -Dot(normal, p0), length * 0.5);
+
+                for (size_t j = 0; j < 3; j++)
+                {
+                    mQuadrics[indices[i + j]] += q;
+                }
+            }
+
+            // Lock the ends of every edge that isn't shared by exactly two triangles.
+            std::vector<uint64_t> edges;
+            edges.reserve(indices.size());
+
+            for (size_t i = 0; i + 2 < indices.size(); i += 3)
+            {
+                for (size_t j = 0; j < 3; j++)
+                {
+                    edges.push_back(EdgeKey(indices[i + j], indices[i + (j + 1) % 3]));
+                }
+            }
+
+            std::sort(edges.begin(), edges.end());
+
+            for (size_t i = 0; i < edges.size(); )
+            {
+                size_t j = i + 1;
+
+                while (j < edges.size() && edges[j] == edges[i])
+                {
+                    j++;
+                }
+
+                if (j - i != 2)
+                {
+                    mLocked[(uint32_t)(edges[i] >> 32)] = true;
+                    mLocked[(uint32_t)edges[i]] = true;
+                }
+
+                i = j;
+            }
+        }
+
+
+        // Collapses edges, cheapest first, until no more than targetIndexCount indices remain or nothing else can be
+        // collapsed without flipping a triangle. Returns the largest distance of an original vertex from the simplified
+        // surface, or from any of the surfaces returned before, so errors never decrease along a chain.
+        float Simplify(std::vector<uint32_t>& indices, size_t targetIndexCount)
+        {
+            std::vector<uint32_t> remap(mVertexCount);
+            std::vector<bool> touched(mVertexCount);
+            std::vector<Collapse> collapses;
+
+            std::vector<uint32_t> firstTriangle;
+            std::vector<uint32_t> adjacency;
+
+            while (indices.size() > targetIndexCount)
+            {
+                BuildAdjacency(indices, firstTriangle, adjacency);
+
+                // Each interior edge appears once in each direction, giving the cost of moving either end onto the other.
+                collapses.clear();
+
+                for (size_t i = 0; i < indices.size(); i += 3)
+                {
+                    for (size_t j = 0; j < 3; j++)
+                    {
+                        uint32_t from = indices[i + j];
+                        uint32_t to = indices[i + (j + 1) % 3];
+
+                        if (mLocked[from])
+                            continue;
+
+                        Quadric q = mQuadrics[from];
+                        q += mQuadrics[to];
+
+                        Collapse collapse = { from, to, q.Error(Position(to)) };
+                        collapses.push_back(collapse);
+                    }
+                }
+
+                if (collapses.empty())
+                    break;
+
+                std::sort(collapses.begin(), collapses.end(), [](Collapse const& a, Collapse const& b)
+                {
+                    return a.cost < b.cost;
+                });
+
+                // Only the cheaper part of the list is eligible in each pass, so expensive collapses wait until the
+                // cheap ones elsewhere have been done and the costs around them have been updated.
+                double costLimit = collapses[collapses.size() / 4].cost;
+
+                for (size_t i = 0; i < mVertexCount; i++)
+                {
+                    remap[i] = static_cast<uint32_t>(i);
+                }
+
+                std::fill(touched.begin(), touched.end(), false);
+
+                size_t triangleCount = indices.size() / 3;
+                size_t collapseCount = 0;
+
+                for (auto it = collapses.begin(); it != collapses.end() && triangleCount * 3 > targetIndexCount; ++it)
+                {
+                    if (it->cost > costLimit && collapseCount)
+                        break;
+
+                    if (touched[it->from] || touched[it->to])
+                        continue;
+
+                    // Reject collapses that would flip any of the triangles which move.
+                    uint32_t const* begin = &adjacency[firstTriangle[it->from]];
+                    uint32_t const* end = &adjacency[0] + firstTriangle[it->from + 1];
+
+                    if (Flips(indices, begin, end, it->from, it->to))
+                        continue;
+
+                    for (auto t = begin; t != end; ++t)
+                    {
+                        uint32_t const* tri = &indices[*t * 3];
+
+                        if (tri[0] == it->to || tri[1] == it->to || tri[2] == it->to)
+                            triangleCount--;
+
+                        // Neighbouring vertices are locked until the next pass, because they now have stale adjacency.
+                        touched[tri[0]] = true;
+                        touched[tri[1]] = true;
+                        touched[tri[2]] = true;
+                    }
+
+                    remap[it->from] = it->to;
+                    mQuadrics[it->to] += mQuadrics[it->from];
+
+                    collapseCount++;
+                }
+
+                if (!collapseCount)
+                    break;
+
+                // A vertex is never both moved and moved onto in the same pass, so one step of remapping is enough.
+                for (size_t i = 0; i < mVertexCount; i++)
+                {
+                    mRepresentative[i] = remap[mRepresentative[i]];
+                }
+
+                // Apply the collapses, dropping triangles that have become degenerate.
+                size_t out = 0;
+
+                for (size_t i = 0; i < indices.size(); i += 3)
+                {
+                    uint32_t a = remap[indices[i]];
+                    uint32_t b = remap[indices[i + 1]];
+                    uint32_t c = remap[indices[i + 2]];
+
+                    if (a != b && b != c && c != a)
+                    {
+                        indices[out++] = a;
+                        indices[out++] = b;
+                        indices[out++] = c;
+                    }
+                }
+
+                indices.resize(out);
+            }
+
+            mError = std::max(mError, MeasureError(indices));
+
+            return (float)mError;
+        }
+
+
+    private:
+        struct Vector3
+        {
+            double x, y, z;
+
+            Vector3 operator+ (Vector3 const& other) const { Vector3 result = { x + other.x, y + other.y, z + other.z }; return result; }
+            Vector3 operator- (Vector3 const& other) const { Vector3 result = { x - other.x, y - other.y, z - other.z }; return result; }
+            Vector3 operator* (double scale) const         { Vector3 result = { x * scale, y * scale, z * scale }; return result; }
+        };
+
+        static double Dot(Vector3 const& a, Vector3 const& b)
+        {
+            return a.x * b.x + a.y * b.y + a.z * b.z;
+        }
+
+        static Vector3 Cross(Vector3 const& a, Vector3 const& b)
+        {
+            Vector3 result = { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+            return result;
+        }
+
+
+        // Closest distance, squared, from a point to a triangle (Ericson, "Real-Time Collision Detection" 5.1.5).
+        static double DistanceSquared(Vector3 const& p, Vector3 const& a, Vector3 const& b, Vector3 const& c)
+        {
+            Vector3 ab = b - a;
+            Vector3 ac = c - a;
+
+            Vector3 ap = p - a;
+            double d1 = Dot(ab, ap);
+            double d2 = Dot(ac, ap);
+
+            if (d1 <= 0 && d2 <= 0)
+                return Dot(ap, ap);
+
+            Vector3 bp = p - b;
+            double d3 = Dot(ab, bp);
+            double d4 = Dot(ac, bp);
+
+            if (d3 >= 0 && d4 <= d3)
+                return Dot(bp, bp);
+
+            Vector3 cp = p - c;
+            double d5 = Dot(ab, cp);
+            double d6 = Dot(ac, cp);
+
+            if (d6 >= 0 && d5 <= d6)
+                return Dot(cp, cp);
+
+            Vector3 closest;
+
+            double vc = d1 * d4 - d3 * d2;
+            double vb = d5 * d2 - d1 * d6;
+            double va = d3 * d6 - d5 * d4;
+
+            if (vc <= 0 && d1 >= 0 && d3 <= 0)
+            {
+                closest = a + ab * (d1 / (d1 - d3));
+            }
+            else if (vb <= 0 && d2 >= 0 && d6 <= 0)
+            {
+                closest = a + ac * (d2 / (d2 - d6));
+            }
+            else if (va <= 0 && d4 >= d3 && d5 >= d6)
+            {
+                closest = b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+            }
+            else if (va + vb + vc > 0)
+            {
+                double scale = 1 / (va + vb + vc);
+
+                closest = a + ab * (vb * scale) + ac * (vc * scale);
+            }
+            else
+            {
+                // Degenerate triangle, which none of the cases above caught.
+                return std::min(std::min(Dot(ap, ap), Dot(bp, bp)), Dot(cp, cp));
+            }
+
+            Vector3 offset = p - closest;
+
+            return Dot(offset, offset);
+        }
+
+
+        // Symmetric 4x4 matrix measuring the squared distance from a set of planes. The total weight is kept
+        // alongside, so Error returns an area weighted mean rather than growing with the number of planes.
+        // This only ranks collapses; the errors reported for each level are measured by MeasureError.
+        struct Quadric
+        {
+            double a00, a01, a02, a03;
+            double a11, a12, a13;
+            double a22, a23;
+            double a33;
+            double weight;
+
+            Quadric()
+              : a00(0), a01(0), a02(0), a03(0), a11(0), a12(0), a13(0), a22(0), a23(0), a33(0), weight(0)
+            {
+            }
+
+            static Quadric FromPlane(Vector3 const& n, double d, double w)
+            {
+                Quadric q;
+
+                q.a00 = w * n.x * n.x; q.a01 = w * n.x * n.y; q.a02 = w * n.x * n.z; q.a03 = w * n.x * d;
+                q.a11 = w * n.y * n.y; q.a12 = w * n.y * n.z; q.a13 = w * n.y * d;
+                q.a22 = w * n.z * n.z; q.a23 = w * n.z * d;
+                q.a33 = w * d * d;
+                q.weight = w;
+
+                return q;
+            }
+
+            Quadric& operator+= (Quadric const& other)
+            {
+                a00 += other.a00; a01 += other.a01; a02 += other.a02; a03 += other.a03;
+                a11 += other.a11; a12 += other.a12; a13 += other.a13;
+                a22 += other.a22; a23 += other.a23;
+                a33 += other.a33;
+                weight += other.weight;
+
+                return *this;
+            }
+
+            // Mean squared distance of the point from the planes.
+            double Error(Vector3 const& p) const
+            {
+                if (weight <= 0)
+                    return 0;
+
+                double e = a00 * p.x * p.x + a11 * p.y * p.y + a22 * p.z * p.z + a33
+                         + 2 * (a01 * p.x * p.y + a02 * p.x * p.z + a12 * p.y * p.z)
+                         + 2 * (a03 * p.x + a13 * p.y + a23 * p.z);
+
+                return std::max(e, 0.0) / weight;
+            }
+        };
+
+
+        struct Collapse
+        {
+            uint32_t from;
+            uint32_t to;
+            double cost;
+        };
+
+
+        Vector3 Position(uint32_t index) const
+        {
+            float const* p = reinterpret_cast<float const*>(mPositions + index * mStride);
+
+            Vector3 result = { p[0], p[1], p[2] };
+            return result;
+        }
+
+
+        // Builds vertex to triangle adjacency, as offsets into a single list.
+        void BuildAdjacency(std::vector<uint32_t> const& indices, std::vector<uint32_t>& firstTriangle, std::vector<uint32_t>& adjacency) const
+        {
+            firstTriangle.assign(mVertexCount + 1, 0);
+
+            for (auto it = indices.begin(); it != indices.end(); ++it)
+            {
+                firstTriangle[*it + 1]++;
+            }
+
+            for (size_t i = 0; i < mVertexCount; i++)
+            {
+                firstTriangle[i + 1] += firstTriangle[i];
+            }
+
+            adjacency.resize(indices.size());
+
+            std::vector<uint32_t> fill(firstTriangle.begin(), firstTriangle.end() - 1);
+
+            for (size_t i = 0; i < indices.size(); i++)
+            {
+                adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+            }
+        }
+
+
+        // Largest distance of an original vertex from the simplified surface. Only the simplified triangles around
+        // the vertices that replaced it and its original neighbours are searched, so where the nearest point of the
+        // surface is further away this overestimates, but it never underestimates.
+        double MeasureError(std::vector<uint32_t> const& indices) const
+        {
+            std::vector<uint32_t> firstTriangle;
+            std::vector<uint32_t> adjacency;
+
+            BuildAdjacency(indices, firstTriangle, adjacency);
+
+            std::vector<uint32_t> candidates;
+
+            double error = 0;
+
+            for (size_t i = 0; i < mVertexCount; i++)
+            {
+                // Vertices that haven't moved are still on the surface.
+                if (mRepresentative[i] == i)
+                    continue;
+
+                // Neighbouring vertices usually share a few representatives, so each is only searched once.
+                candidates.clear();
+
+                for (uint32_t s = mOriginalFirstTriangle[i]; s < mOriginalFirstTriangle[i + 1]; s++)
+                {
+                    uint32_t const* original = &mOriginalIndices[mOriginalAdjacency[s] * 3];
+
+                    for (size_t j = 0; j < 3; j++)
+                    {
+                        uint32_t representative = mRepresentative[original[j]];
+
+                        if (std::find(candidates.begin(), candidates.end(), representative) == candidates.end())
+                            candidates.push_back(representative);
+                    }
+                }
+
+                Vector3 p = Position(static_cast<uint32_t>(i));
+
+                double nearest = -1;
+
+                for (auto it = candidates.begin(); it != candidates.end(); ++it)
+                {
+                    for (uint32_t t = firstTriangle[*it]; t < firstTriangle[*it + 1]; t++)
+                    {
+                        uint32_t const* tri = &indices[adjacency[t] * 3];
+
+                        double distance = DistanceSquared(p, Position(tri[0]), Position(tri[1]), Position(tri[2]));
+
+                        if (nearest < 0 || distance < nearest)
+                            nearest = distance;
+                    }
+                }
+
+                error = std::max(error, nearest);
+            }
+
+            return sqrt(error);
+        }
+
+
+        static uint64_t EdgeKey(uint32_t a, uint32_t b)
+        {
+            return (a > b) ? ((uint64_t)a << 32) | b : ((uint64_t)b << 32) | a;
+        }
+
+
+        // Checks whether moving vertex from onto vertex to would turn any of its remaining triangles over.
+        bool Flips(std::vector<uint32_t> const& indices, uint32_t const* begin, uint32_t const* end, uint32_t from, uint32_t to) const
+        {
+            Vector3 target = Position(to);
+
+            for (auto t = begin; t != end; ++t)
+            {
+                uint32_t const* tri = &indices[*t * 3];
+
+                // Triangles containing both ends of the edge disappear, so can't flip.
+                if (tri[0] == to || tri[1] == to || tri[2] == to)
+                    continue;
+
+                // Rotate the triangle so that the moving vertex comes first.
+                size_t k = (tri[0] == from) ? 0 : (tri[1] == from) ? 1 : 2;
+
+                Vector3 p0 = Position(tri[k]);
+                Vector3 p1 = Position(tri[(k + 1) % 3]);
+                Vector3 p2 = Position(tri[(k + 2) % 3]);
+
+                Vector3 before = Cross(p1 - p0, p2 - p0);
+                Vector3 after = Cross(p1 - target, p2 - target);
+
+                if (Dot(before, after) <= 0)
+                    return true;
+            }
+
+            return false;
+        }
+
+
+        uint8_t const* mPositions;
+        size_t mStride;
+        size_t mVertexCount;
+
+        std::vector<Quadric> mQuadrics;
+        std::vector<bool> mLocked;
+
+        // The vertex each original vertex has been collapsed onto, or itself.
+        std::vector<uint32_t> mRepresentative;
+
+        // The full detail mesh, with its vertex to triangle adjacency, for measuring errors.
+        std::vector<uint32_t> mOriginalIndices;
+        std::vector<uint32_t> mOriginalFirstTriangle;
+        std::vector<uint32_t> mOriginalAdjacency;
+
+        double mError;
+    };
+
+
+    // Appends progressively simplified copies of the triangle list to the end of indices, each aiming for
+    // reduction times the triangles of the previous one. Stops early once a level no longer saves much.
+    // levels receives the full detail mesh followed by each simplified level.
+    inline void GenerateLevels(std::vector<uint32_t>& indices, _In_reads_bytes_(vertexCount * stride) uint8_t const* positions, size_t stride, size_t vertexCount,
+                               size_t levelCount, float reduction, std::vector<Level>& levels)
+    {
+        levels.clear();
+
+        Level full = { 0, static_cast<uint32_t>(indices.size()), 0 };
+        levels.push_back(full);
+
+        if (indices.empty())
+            return;
+
+        Simplifier simplifier(positions, stride, vertexCount, indices);
+
+        std::vector<uint32_t> current(indices);
+
+        while (levels.size() < levelCount)
+        {
+            size_t previousCount = current.size();
+            size_t target = (size_t)(previousCount / 3 * reduction) * 3;
+
+            float error = simplifier.Simplify(current, target);
+
+            // Not worth the memory, or the draw time spent choosing it.
+            if (current.size() * 10 > previousCount * 9)
+                break;
+
+            Level level = { static_cast<uint32_t>(indices.size()), static_cast<uint32_t>(current.size()), error };
+            levels.push_back(level);
+
+            indices.insert(indices.end(), current.begin(), current.end());
+        }
+    }
+
+
+    // Returns the scale from object space distance to pixels for drawing an object with the specified
+    // bounds, measured at the point of the bounds nearest the camera, or zero if the camera is inside them.
+    inline float XM_CALLCONV PixelsPerUnit(DirectX::FXMMATRIX worldView, DirectX::CXMMATRIX projection, DirectX::BoundingSphere const& bounds, float viewportHeight)
+    {
+        using namespace DirectX;
+
+        // Largest scale the world and view matrices apply to any axis.
+        XMVECTOR scale = XMVectorMax(XMVectorMax(XMVector3LengthSq(worldView.r[0]), XMVector3LengthSq(worldView.r[1])), XMVector3LengthSq(worldView.r[2]));
+
+        float maxScale = sqrtf(XMVectorGetX(scale));
+
+        XMVECTOR center = XMVector3Transform(XMLoadFloat3(&bounds.Center), worldView);
+
+        // Clip space w of the center, less the radius for perspective projections. Orthographic projections have w = 1.
+        XMFLOAT4X4 proj;
+        XMStoreFloat4x4(&proj, projection);
+
+        float w = XMVectorGetX(center) * proj._14 + XMVectorGetY(center) * proj._24 + XMVectorGetZ(center) * proj._34 + proj._44;
+
+        w -= bounds.Radius * maxScale * fabsf(proj._34);
+
+        if (w <= 0)
+            return 0;
+
+        return maxScale * proj._22 * viewportHeight * 0.5f / w;
+    }
+
+
+    // As above, for the first viewport bound to the device context. Returns zero if there isn't one.
+    inline float XM_CALLCONV PixelsPerUnit(_In_ ID3D11DeviceContext* deviceContext, DirectX::FXMMATRIX world, DirectX::CXMMATRIX view, DirectX::CXMMATRIX projection, DirectX::BoundingSphere const& bounds)
+    {
+        D3D11_VIEWPORT viewport = { 0 };
+        UINT viewportCount = 1;
+
+        deviceContext->RSGetViewports(&viewportCount, &viewport);
+
+        if (!viewportCount || viewport.Height <= 0)
+            return 0;
+
+        return PixelsPerUnit(DirectX::XMMatrixMultiply(world, view), projection, bounds, viewport.Height);
+    }
+
+
+    // Returns how many of the levels, whose errors must be in increasing order, stay within thresholdPixels of the full
+    // detail surface on screen. A pixelsPerUnit of zero means the camera is inside the object, so only errors of zero pass.
+    template<typename TLevel>
+    size_t CountLevelsWithin(TLevel const* levels, size_t levelCount, float pixelsPerUnit, float thresholdPixels)
+    {
+        size_t count = 0;
+
+        while (count < levelCount && (levels[count].error <= 0 || (pixelsPerUnit > 0 && levels[count].error * pixelsPerUnit <= thresholdPixels)))
+        {
+            count++;
+        }
+
+        return count;
+    }
+}
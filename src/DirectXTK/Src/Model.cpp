@@ -18,8 +18,12 @@
 #include "DirectXHelpers.h"
 #include "Effects.h"
 #include "PlatformHelpers.h"
+#include "MeshLod.h"
+
+#include <map>
 
 using namespace DirectX;
+using namespace Microsoft::WRL;
 
 #ifndef _CPPRTTI 
 #error Model requires RTTI
@@ -42,7 +46,7 @@ ModelMeshPart::ModelMeshPart() :
 
 
 _Use_decl_annotations_
-void ModelMeshPart::Draw( ID3D11DeviceContext* deviceContext, IEffect* ieffect, ID3D11InputLayout* iinputLayout, std::function<void()> setCustomState ) const
+void ModelMeshPart::Draw( ID3D11DeviceContext* deviceContext, IEffect* ieffect, ID3D11InputLayout* iinputLayout, std::function<void()> setCustomState, size_t lod ) const
 {
     deviceContext->IASetInputLayout( iinputLayout );
 
@@ -66,7 +70,14 @@ void ModelMeshPart::Draw( ID3D11DeviceContext* deviceContext, IEffect* ieffect,
     // Draw the primitive.
     deviceContext->IASetPrimitiveTopology( primitiveType );
 
-    deviceContext->DrawIndexed( indexCount, startIndex, vertexOffset );
+    if ( lod > 0 && lod <= lods.size() )
+    {
+        deviceContext->DrawIndexed( lods[ lod - 1 ].indexCount, lods[ lod - 1 ].startIndex, vertexOffset );
+    }
+    else
+    {
+        deviceContext->DrawIndexed( indexCount, startIndex, vertexOffset );
+    }
 }
 
 
@@ -125,7 +136,8 @@ void ModelMeshPart::ModifyEffect( ID3D11Device* d3dDevice, std::shared_ptr<IEffe
 
 ModelMesh::ModelMesh() :
     ccw(true),
-    pmalpha(true)
+    pmalpha(true),
+    lodThreshold(1)
 {
 }
 
@@ -186,6 +198,9 @@ void XM_CALLCONV ModelMesh::Draw( ID3D11DeviceContext* deviceContext,
 {
     assert( deviceContext != 0 );
 
+    // Only worked out if some part has levels of detail to choose from.
+    float pixelsPerUnit = -1;
+
     for ( auto it = meshParts.cbegin(); it != meshParts.cend(); ++it )
     {
         auto part = (*it).get();
@@ -197,6 +212,17 @@ void XM_CALLCONV ModelMesh::Draw( ID3D11DeviceContext* deviceContext,
             continue;
         }
 
+        // Pick the coarsest level of detail whose error is too small to see.
+        size_t lod = 0;
+
+        if ( !part->lods.empty() && lodThreshold > 0 )
+        {
+            if ( pixelsPerUnit < 0 )
+                pixelsPerUnit = MeshLod::PixelsPerUnit( deviceContext, world, view, projection, boundingSphere );
+
+            lod = MeshLod::CountLevelsWithin( &part->lods.front(), part->lods.size(), pixelsPerUnit, lodThreshold );
+        }
+
         auto imatrices = dynamic_cast<IEffectMatrices*>( part->effect.get() );
         if ( imatrices )
         {
@@ -205,7 +231,7 @@ void XM_CALLCONV ModelMesh::Draw( ID3D11DeviceContext* deviceContext,
             imatrices->SetProjection( projection );
         }
 
-        part->Draw( deviceContext, part->effect.get(), part->inputLayout.Get(), setCustomState );
+        part->Draw( deviceContext, part->effect.get(), part->inputLayout.Get(), setCustomState, lod );
     }
 }
 
@@ -270,3 +296,173 @@ void Model::UpdateEffects( _In_ std::function<void(IEffect*)> setEffect )
         setEffect( *it );
     }
 }
+
+
+namespace
+{
+    // Copies the contents of a buffer back from the GPU.
+    void ReadBuffer( _In_ ID3D11DeviceContext* deviceContext, _In_ ID3D11Buffer* buffer, std::vector<uint8_t>& data )
+    {
+        D3D11_BUFFER_DESC desc;
+        buffer->GetDesc( &desc );
+
+        desc.Usage = D3D11_USAGE_STAGING;
+        desc.BindFlags = 0;
+        desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+        desc.MiscFlags = 0;
+        desc.StructureByteStride = 0;
+
+        ComPtr<ID3D11Device> device;
+        deviceContext->GetDevice( &device );
+
+        ComPtr<ID3D11Buffer> staging;
+        ThrowIfFailed(
+            device->CreateBuffer( &desc, nullptr, &staging )
+        );
+
+        deviceContext->CopyResource( staging.Get(), buffer );
+
+        D3D11_MAPPED_SUBRESOURCE mapped;
+        ThrowIfFailed(
+            deviceContext->Map( staging.Get(), 0, D3D11_MAP_READ, 0, &mapped )
+        );
+
+        auto bytes = static_cast<uint8_t const*>( mapped.pData );
+        data.assign( bytes, bytes + desc.ByteWidth );
+
+        deviceContext->Unmap( staging.Get(), 0 );
+    }
+}
+
+
+_Use_decl_annotations_
+void Model::GenerateLods( ID3D11DeviceContext* deviceContext, size_t lodCount )
+{
+    assert( deviceContext != 0 );
+
+    ComPtr<ID3D11Device> device;
+    deviceContext->GetDevice( &device );
+
+    // Mesh parts often share buffers, so each one is only read back once.
+    std::map<ID3D11Buffer*, std::vector<uint8_t>> bufferData;
+
+    auto readBuffer = [&]( ID3D11Buffer* buffer ) -> std::vector<uint8_t> const&
+    {
+        auto it = bufferData.find( buffer );
+
+        if ( it == bufferData.end() )
+        {
+            it = bufferData.insert( std::make_pair( buffer, std::vector<uint8_t>() ) ).first;
+
+            ReadBuffer( deviceContext, buffer, it->second );
+        }
+
+        return it->second;
+    };
+
+    for( auto mit = meshes.cbegin(); mit != meshes.cend(); ++mit )
+    {
+        auto mesh = mit->get();
+        assert( mesh != 0 );
+
+        for ( auto it = mesh->meshParts.cbegin(); it != mesh->meshParts.cend(); ++it )
+        {
+            auto part = it->get();
+            assert( part != 0 );
+
+            // Only triangle lists that start each vertex with a float3 position can be simplified.
+            if ( part->primitiveType != D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST || !part->indexCount || !part->vertexBuffer || !part->indexBuffer || !part->vbDecl || part->vbDecl->empty() )
+                continue;
+
+            auto const& position = part->vbDecl->front();
+
+            if ( _stricmp( position.SemanticName, "SV_Position" ) != 0
+                 || ( position.Format != DXGI_FORMAT_R32G32B32_FLOAT && position.Format != DXGI_FORMAT_R32G32B32A32_FLOAT )
+                 || ( position.AlignedByteOffset != 0 && position.AlignedByteOffset != D3D11_APPEND_ALIGNED_ELEMENT )
+                 || position.InputSlot != 0 )
+                continue;
+
+            auto const& vertexData = readBuffer( part->vertexBuffer.Get() );
+            auto const& indexData = readBuffer( part->indexBuffer.Get() );
+
+            // Gather the part's full detail indices, widened to 32 bits.
+            bool shortIndices = ( part->indexFormat != DXGI_FORMAT_R32_UINT );
+            size_t indexSize = shortIndices ? sizeof(uint16_t) : sizeof(uint32_t);
+
+            if ( ( (size_t)part->startIndex + part->indexCount ) * indexSize > indexData.size() )
+                throw std::exception("Model mesh part indices out of range");
+
+            std::vector<uint32_t> indices( part->indexCount );
+            uint32_t maxIndex = 0;
+
+            for ( size_t j = 0; j < indices.size(); ++j )
+            {
+                if ( shortIndices )
+                    indices[ j ] = reinterpret_cast<uint16_t const*>( &indexData.front() )[ part->startIndex + j ];
+                else
+                    indices[ j ] = reinterpret_cast<uint32_t const*>( &indexData.front() )[ part->startIndex + j ];
+
+                maxIndex = std::max( maxIndex, indices[ j ] );
+            }
+
+            size_t vertexCount = (size_t)maxIndex + 1;
+
+            if ( ( (size_t)part->vertexOffset + vertexCount ) * part->vertexStride > vertexData.size() )
+                throw std::exception("Model mesh part vertices out of range");
+
+            std::vector<MeshLod::Level> levels;
+
+            MeshLod::GenerateLevels( indices, &vertexData[ (size_t)part->vertexOffset * part->vertexStride ], part->vertexStride, vertexCount, lodCount, 0.5f, levels );
+
+            if ( levels.size() < 2 )
+                continue;
+
+            // Give the part its own index buffer holding every level, in its original index format.
+            std::vector<uint16_t> narrowIndices;
+
+            D3D11_BUFFER_DESC desc = { 0 };
+            desc.Usage = D3D11_USAGE_DEFAULT;
+            desc.BindFlags = D3D11_BIND_INDEX_BUFFER;
+
+            D3D11_SUBRESOURCE_DATA initData = { 0 };
+
+            if ( shortIndices )
+            {
+                narrowIndices.reserve( indices.size() );
+
+                for ( auto iit = indices.cbegin(); iit != indices.cend(); ++iit )
+                {
+                    narrowIndices.push_back( static_cast<uint16_t>( *iit ) );
+                }
+
+                desc.ByteWidth = static_cast<UINT>( narrowIndices.size() * sizeof(uint16_t) );
+                initData.pSysMem = &narrowIndices.front();
+            }
+            else
+            {
+                desc.ByteWidth = static_cast<UINT>( indices.size() * sizeof(uint32_t) );
+                initData.pSysMem = &indices.front();
+            }
+
+            ComPtr<ID3D11Buffer> indexBuffer;
+            ThrowIfFailed(
+                device->CreateBuffer( &desc, &initData, &indexBuffer )
+            );
+
+            SetDebugObjectName( indexBuffer.Get(), "DirectXTK:Model" );
+
+            part->indexBuffer = indexBuffer;
+            part->startIndex = levels[ 0 ].startIndex;
+            part->indexCount = levels[ 0 ].indexCount;
+
+            part->lods.clear();
+
+            for ( auto lit = levels.cbegin() + 1; lit != levels.cend(); ++lit )
+            {
+                ModelMeshPart::Lod lod = { lit->indexCount, lit->startIndex, lit->error };
+
+                part->lods.push_back( lod );
+            }
+        }
+    }
+}
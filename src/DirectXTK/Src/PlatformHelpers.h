@@ -52,6 +52,10 @@ namespace DirectX
     typedef public std::unique_ptr<void, handle_closer> ScopedHandle;
 
     inline HANDLE safe_handle( HANDLE h ) { return (h == INVALID_HANDLE_VALUE) ? 0 : h; }
+
+    struct mapped_view_closer { void operator()(void const* p) { if (p) UnmapViewOfFile(p); } };
+
+    typedef public std::unique_ptr<uint8_t const, mapped_view_closer> ScopedMappedView;
 }
 
 
@@ -12,6 +12,9 @@
 //--------------------------------------------------------------------------------------
 
 #include "pch.h"
+
+#include <vector>
+
 #include "PrimitiveBatch.h"
 #include "DirectXHelpers.h"
 #include "PlatformHelpers.h"
@@ -25,14 +28,28 @@ using namespace Microsoft::WRL;
 class PrimitiveBatchBase::Impl
 {
 public:
-    Impl(_In_ ID3D11DeviceContext* deviceContext, size_t maxIndices, size_t maxVertices, size_t vertexSize);
+    Impl(_In_ ID3D11DeviceContext* deviceContext, size_t maxIndices, size_t maxVertices, size_t vertexSize, bool persistentMap);
 
     void Begin();
     void End();
 
-    void Draw(D3D11_PRIMITIVE_TOPOLOGY topology, bool isIndexed, _In_opt_count_(indexCount) uint16_t const* indices, size_t indexCount, size_t vertexCount, _Out_ void** pMappedVertices);
+    template<typename TIndex>
+    void Draw(D3D11_PRIMITIVE_TOPOLOGY topology, bool isIndexed, _In_opt_count_(indexCount) TIndex const* indices, size_t indexCount, size_t vertexCount, _Out_ void** pMappedVertices);
+
+    RenderStats mRenderStats;
 
 private:
+    // A draw call waiting for the buffers to be unmapped. Adjacent compatible primitives are merged into one.
+    struct PendingDraw
+    {
+        D3D11_PRIMITIVE_TOPOLOGY topology;
+        bool isIndexed;
+        size_t baseIndex;
+        size_t indexCount;
+        size_t baseVertex;
+        size_t vertexCount;
+    };
+
     void FlushBatch();
 
     ComPtr<ID3D11DeviceContext> mDeviceContext;
@@ -42,20 +59,24 @@ private:
     size_t mMaxIndices;
     size_t mMaxVertices;
     size_t mVertexSize;
+    DXGI_FORMAT mIndexFormat;
+
+    // In persistent mode the buffers stay mapped until End or a wrap, rather than being flushed
+    // every time the topology changes, so draws of different types are queued up in mPendingDraws.
+    bool mPersistentMap;
 
     bool mInBeginEndPair;
-    
-    D3D11_PRIMITIVE_TOPOLOGY mCurrentTopology;
-    bool mCurrentlyIndexed;
 
     size_t mCurrentIndex;
     size_t mCurrentVertex;
-    
-    size_t mBaseIndex;
-    size_t mBaseVertex;
+
+    bool mIndicesMapped;
+    bool mVerticesMapped;
 
     D3D11_MAPPED_SUBRESOURCE mMappedIndices;
     D3D11_MAPPED_SUBRESOURCE mMappedVertices;
+
+    std::vector<PendingDraw> mPendingDraws;
 };
 
 
@@ -78,19 +99,21 @@ static void CreateBuffer(_In_ ID3D11Device* device, size_t bufferSize, D3D11_BIN
 
 
 // Constructor.
-PrimitiveBatchBase::Impl::Impl(_In_ ID3D11DeviceContext* deviceContext, size_t maxIndices, size_t maxVertices, size_t vertexSize)
+PrimitiveBatchBase::Impl::Impl(_In_ ID3D11DeviceContext* deviceContext, size_t maxIndices, size_t maxVertices, size_t vertexSize, bool persistentMap)
   : mDeviceContext(deviceContext),
     mMaxIndices(maxIndices),
     mMaxVertices(maxVertices),
     mVertexSize(vertexSize),
+    mIndexFormat(DXGI_FORMAT_R16_UINT),
+    mPersistentMap(persistentMap),
     mInBeginEndPair(false),
-    mCurrentTopology(D3D11_PRIMITIVE_TOPOLOGY_UNDEFINED),
-    mCurrentlyIndexed(false),
     mCurrentIndex(0),
     mCurrentVertex(0),
-    mBaseIndex(0),
-    mBaseVertex(0)
+    mIndicesMapped(false),
+    mVerticesMapped(false)
 {
+    memset(&mRenderStats, 0, sizeof(mRenderStats));
+
     ComPtr<ID3D11Device> device;
     
     deviceContext->GetDevice(&device);
@@ -98,11 +121,24 @@ PrimitiveBatchBase::Impl::Impl(_In_ ID3D11DeviceContext* deviceContext, size_t m
     // If you only intend to draw non-indexed geometry, specify maxIndices = 0 to skip creating the index buffer.
     if (maxIndices > 0)
     {
-        CreateBuffer(device.Get(), maxIndices * sizeof(uint16_t), D3D11_BIND_INDEX_BUFFER, &mIndexBuffer);
+        // 16 bit indices can't address more than 64K vertices.
+        if (maxVertices > 0x10000)
+        {
+            if (device->GetFeatureLevel() < D3D_FEATURE_LEVEL_9_2)
+                throw std::exception("Too many vertices for 16-bit index buffer: 32-bit indices require Feature Level 9.2 or later");
+
+            mIndexFormat = DXGI_FORMAT_R32_UINT;
+        }
+
+        size_t indexSize = (mIndexFormat == DXGI_FORMAT_R32_UINT) ? sizeof(uint32_t) : sizeof(uint16_t);
+
+        CreateBuffer(device.Get(), maxIndices * indexSize, D3D11_BIND_INDEX_BUFFER, &mIndexBuffer);
     }
 
     // Create the vertex buffer.
     CreateBuffer(device.Get(), maxVertices * vertexSize, D3D11_BIND_VERTEX_BUFFER, &mVertexBuffer);
+
+    mPendingDraws.reserve(16);
 }
 
 
@@ -115,7 +151,7 @@ void PrimitiveBatchBase::Impl::Begin()
     // Bind the index buffer.
     if (mMaxIndices > 0)
     {
-        mDeviceContext->IASetIndexBuffer(mIndexBuffer.Get(), DXGI_FORMAT_R16_UINT, 0);
+        mDeviceContext->IASetIndexBuffer(mIndexBuffer.Get(), mIndexFormat, 0);
     }
 
     // Bind the vertex buffer.
@@ -170,28 +206,38 @@ static bool CanBatchPrimitives(D3D11_PRIMITIVE_TOPOLOGY topology)
 
 
 // Helper for locking a vertex or index buffer.
-static void LockBuffer(_In_ ID3D11DeviceContext* deviceContext, _In_ ID3D11Buffer* buffer, size_t currentPosition, _Out_ size_t* basePosition, _Out_ D3D11_MAPPED_SUBRESOURCE* mappedResource)
+static void LockBuffer(_In_ ID3D11DeviceContext* deviceContext, _In_ ID3D11Buffer* buffer, size_t currentPosition, _Out_ D3D11_MAPPED_SUBRESOURCE* mappedResource)
 {
     D3D11_MAP mapType = (currentPosition == 0) ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE;
 
     ThrowIfFailed(
         deviceContext->Map(buffer, 0, mapType, 0, mappedResource)
     );
+}
+
 
-    *basePosition = currentPosition;
+// Helper for copying indices into the mapped index buffer, offsetting them to where the vertices ended up.
+template<typename TOutput, typename TIndex>
+static void CopyIndices(_Out_writes_(indexCount) TOutput* outputIndices, _In_reads_(indexCount) TIndex const* indices, size_t indexCount, size_t vertexOffset)
+{
+    for (size_t i = 0; i < indexCount; i++)
+    {
+        outputIndices[i] = (TOutput)(indices[i] + vertexOffset);
+    }
 }
 
 
 // Adds new geometry to the batch.
-void PrimitiveBatchBase::Impl::Draw(D3D11_PRIMITIVE_TOPOLOGY topology, bool isIndexed, _In_opt_count_(indexCount) uint16_t const* indices, size_t indexCount, size_t vertexCount, _Out_ void** pMappedVertices)
+template<typename TIndex>
+void PrimitiveBatchBase::Impl::Draw(D3D11_PRIMITIVE_TOPOLOGY topology, bool isIndexed, _In_opt_count_(indexCount) TIndex const* indices, size_t indexCount, size_t vertexCount, _Out_ void** pMappedVertices)
 {
     if (isIndexed && !indices)
         throw std::exception("Indices cannot be null");
 
-    if (indexCount >= mMaxIndices)
+    if (indexCount > mMaxIndices)
         throw std::exception("Too many indices");
 
-    if (vertexCount >= mMaxVertices)
+    if (vertexCount > mMaxVertices)
         throw std::exception("Too many vertices");
 
     if (!mInBeginEndPair)
@@ -201,12 +247,16 @@ void PrimitiveBatchBase::Impl::Draw(D3D11_PRIMITIVE_TOPOLOGY topology, bool isIn
     bool wrapIndexBuffer = (mCurrentIndex + indexCount > mMaxIndices);
     bool wrapVertexBuffer = (mCurrentVertex + vertexCount > mMaxVertices);
 
-    if ((topology != mCurrentTopology) ||
-        (isIndexed != mCurrentlyIndexed) ||
-        !CanBatchPrimitives(topology) ||
-        wrapIndexBuffer || wrapVertexBuffer)
+    bool canMerge = !mPendingDraws.empty() &&
+                    (topology == mPendingDraws.back().topology) &&
+                    (isIndexed == mPendingDraws.back().isIndexed) &&
+                    CanBatchPrimitives(topology);
+
+    if (wrapIndexBuffer || wrapVertexBuffer || (!canMerge && !mPersistentMap))
     {
         FlushBatch();
+
+        canMerge = false;
     }
 
     if (wrapIndexBuffer)
@@ -215,28 +265,51 @@ void PrimitiveBatchBase::Impl::Draw(D3D11_PRIMITIVE_TOPOLOGY topology, bool isIn
     if (wrapVertexBuffer)
         mCurrentVertex = 0;
 
-    // If we are not already in a batch, lock the buffers.
-    if (mCurrentTopology == D3D11_PRIMITIVE_TOPOLOGY_UNDEFINED)
+    if (wrapIndexBuffer || wrapVertexBuffer)
+        mRenderStats.wraps++;
+
+    // Lock the buffers if they aren't already.
+    if (isIndexed && !mIndicesMapped)
     {
-        if (isIndexed)
-        {
-            LockBuffer(mDeviceContext.Get(), mIndexBuffer.Get(), mCurrentIndex, &mBaseIndex, &mMappedIndices);
-        }
+        LockBuffer(mDeviceContext.Get(), mIndexBuffer.Get(), mCurrentIndex, &mMappedIndices);
+
+        mIndicesMapped = true;
+        mRenderStats.maps++;
+    }
+
+    if (!mVerticesMapped)
+    {
+        LockBuffer(mDeviceContext.Get(), mVertexBuffer.Get(), mCurrentVertex, &mMappedVertices);
 
-        LockBuffer(mDeviceContext.Get(), mVertexBuffer.Get(), mCurrentVertex, &mBaseVertex, &mMappedVertices);
+        mVerticesMapped = true;
+        mRenderStats.maps++;
+    }
 
-        mCurrentTopology = topology;
-        mCurrentlyIndexed = isIndexed;
+    // Extend the previous draw, or start a new one.
+    if (canMerge)
+    {
+        mPendingDraws.back().indexCount += indexCount;
+        mPendingDraws.back().vertexCount += vertexCount;
     }
-    
+    else
+    {
+        PendingDraw draw = { topology, isIndexed, mCurrentIndex, indexCount, mCurrentVertex, vertexCount };
+
+        mPendingDraws.push_back(draw);
+    }
+
     // Copy over the index data.
     if (isIndexed)
     {
-        uint16_t* outputIndices = (uint16_t*)mMappedIndices.pData + mCurrentIndex;
-        
-        for (size_t i = 0; i < indexCount; i++)
+        size_t vertexOffset = mCurrentVertex - mPendingDraws.back().baseVertex;
+
+        if (mIndexFormat == DXGI_FORMAT_R32_UINT)
+        {
+            CopyIndices((uint32_t*)mMappedIndices.pData + mCurrentIndex, indices, indexCount, vertexOffset);
+        }
+        else
         {
-            outputIndices[i] = (uint16_t)(indices[i] + mCurrentVertex - mBaseVertex);
+            CopyIndices((uint16_t*)mMappedIndices.pData + mCurrentIndex, indices, indexCount, vertexOffset);
         }
  
         mCurrentIndex += indexCount;
@@ -246,6 +319,7 @@ void PrimitiveBatchBase::Impl::Draw(D3D11_PRIMITIVE_TOPOLOGY topology, bool isIn
     *pMappedVertices = (uint8_t*)mMappedVertices.pData + (mCurrentVertex * mVertexSize);
 
     mCurrentVertex += vertexCount;
+    mRenderStats.vertices += vertexCount;
 }
 
 
@@ -253,33 +327,55 @@ void PrimitiveBatchBase::Impl::Draw(D3D11_PRIMITIVE_TOPOLOGY topology, bool isIn
 void PrimitiveBatchBase::Impl::FlushBatch()
 {
     // Early out if there is nothing to flush.
-    if (mCurrentTopology == D3D11_PRIMITIVE_TOPOLOGY_UNDEFINED)
+    if (mPendingDraws.empty())
         return;
 
-    mDeviceContext->IASetPrimitiveTopology(mCurrentTopology);
+    if (mVerticesMapped)
+    {
+        mDeviceContext->Unmap(mVertexBuffer.Get(), 0);
 
-    mDeviceContext->Unmap(mVertexBuffer.Get(), 0);
+        mVerticesMapped = false;
+    }
 
-    if (mCurrentlyIndexed)
+    if (mIndicesMapped)
     {
-        // Draw indexed geometry.
         mDeviceContext->Unmap(mIndexBuffer.Get(), 0);
 
-        mDeviceContext->DrawIndexed((UINT)(mCurrentIndex - mBaseIndex), (UINT)mBaseIndex, (UINT)mBaseVertex);
+        mIndicesMapped = false;
     }
-    else
+
+    D3D11_PRIMITIVE_TOPOLOGY currentTopology = D3D11_PRIMITIVE_TOPOLOGY_UNDEFINED;
+
+    for (auto draw = mPendingDraws.begin(); draw != mPendingDraws.end(); ++draw)
     {
-        // Draw non-indexed geometry.
-        mDeviceContext->Draw((UINT)(mCurrentVertex - mBaseVertex), (UINT)mBaseVertex);
+        if (draw->topology != currentTopology)
+        {
+            mDeviceContext->IASetPrimitiveTopology(draw->topology);
+
+            currentTopology = draw->topology;
+        }
+
+        if (draw->isIndexed)
+        {
+            // Draw indexed geometry.
+            mDeviceContext->DrawIndexed((UINT)draw->indexCount, (UINT)draw->baseIndex, (INT)draw->baseVertex);
+        }
+        else
+        {
+            // Draw non-indexed geometry.
+            mDeviceContext->Draw((UINT)draw->vertexCount, (UINT)draw->baseVertex);
+        }
     }
 
-    mCurrentTopology = D3D11_PRIMITIVE_TOPOLOGY_UNDEFINED;
+    mRenderStats.draws += mPendingDraws.size();
+
+    mPendingDraws.clear();
 }
 
 
 // Public constructor.
-PrimitiveBatchBase::PrimitiveBatchBase(_In_ ID3D11DeviceContext* deviceContext, size_t maxIndices, size_t maxVertices, size_t vertexSize)
-  : pImpl(new Impl(deviceContext, maxIndices, maxVertices, vertexSize))
+PrimitiveBatchBase::PrimitiveBatchBase(_In_ ID3D11DeviceContext* deviceContext, size_t maxIndices, size_t maxVertices, size_t vertexSize, bool persistentMap)
+  : pImpl(new Impl(deviceContext, maxIndices, maxVertices, vertexSize, persistentMap))
 {
 }
 
@@ -321,3 +417,21 @@ void PrimitiveBatchBase::Draw(D3D11_PRIMITIVE_TOPOLOGY topology, bool isIndexed,
 {
     pImpl->Draw(topology, isIndexed, indices, indexCount, vertexCount, pMappedVertices);
 }
+
+
+void PrimitiveBatchBase::Draw(D3D11_PRIMITIVE_TOPOLOGY topology, _In_reads_(indexCount) uint32_t const* indices, size_t indexCount, size_t vertexCount, _Out_ void** pMappedVertices)
+{
+    pImpl->Draw(topology, true, indices, indexCount, vertexCount, pMappedVertices);
+}
+
+
+PrimitiveBatchBase::RenderStats PrimitiveBatchBase::GetRenderStats() const
+{
+    return pImpl->mRenderStats;
+}
+
+
+void PrimitiveBatchBase::ResetRenderStats()
+{
+    memset(&pImpl->mRenderStats, 0, sizeof(pImpl->mRenderStats));
+}
@@ -15,14 +15,18 @@
 
 #define NOMINMAX
 #include <algorithm>
+#include <ppl.h>
 #include <vector>
 
 #include "SpriteBatch.h"
+#include "TextureAtlas.h"
 #include "ConstantBuffer.h"
 #include "CommonStates.h"
 #include "VertexTypes.h"
 #include "SharedResourcePool.h"
 #include "AlignedNew.h"
+#include "DirtyRanges.h"
+#include "SpriteSort.h"
 
 using namespace DirectX;
 using namespace Microsoft::WRL;
@@ -32,12 +36,14 @@ using namespace Microsoft::WRL;
 __declspec(align(16)) class SpriteBatch::Impl : public AlignedNew<SpriteBatch::Impl>
 {
 public:
-    Impl(_In_ ID3D11DeviceContext* deviceContext);
+    Impl(_In_ ID3D11DeviceContext* deviceContext, size_t maxBatchSize);
 
     void XM_CALLCONV Begin(SpriteSortMode sortMode, _In_opt_ ID3D11BlendState* blendState, _In_opt_ ID3D11SamplerState* samplerState, _In_opt_ ID3D11DepthStencilState* depthStencilState, _In_opt_ ID3D11RasterizerState* rasterizerState, _In_opt_ std::function<void()> setCustomShaders, FXMMATRIX transformMatrix);
     void End();
 
     void XM_CALLCONV Draw(_In_ ID3D11ShaderResourceView* texture, FXMVECTOR destination, _In_opt_ RECT const* sourceRectangle, FXMVECTOR color, FXMVECTOR originRotationDepth, int flags);
+    void XM_CALLCONV DrawRun(_In_ ID3D11ShaderResourceView* texture, _In_reads_(count) SpriteRunItem const* items, size_t count, FXMVECTOR destination, FXMVECTOR color, FXMVECTOR originRotationDepth, int flags);
+    void DrawLayer(_In_ SpriteLayer::Impl* layer);
 
 
     // Info about a single sprite that is waiting to be drawn.
@@ -58,33 +64,82 @@ public:
         static_assert((SpriteEffects_FlipBoth & (SourceInTexels | DestSizeInPixels)) == 0, "Flag bits must not overlap");
     };
 
+    static const size_t VerticesPerSprite = 4;
+    static const size_t IndicesPerSprite = 6;
+
+    static void XM_CALLCONV StoreSpriteInfo(_Out_ SpriteInfo* sprite, _In_ ID3D11ShaderResourceView* texture, FXMVECTOR destination, _In_opt_ RECT const* sourceRectangle, FXMVECTOR color, FXMVECTOR originRotationDepth, int flags);
+
+    static XMVECTOR GetTextureSize(_In_ ID3D11ShaderResourceView* texture);
+
+    static void XM_CALLCONV RenderSprites(_In_reads_(count) SpriteInfo const* const* sprites, size_t count, _Out_writes_(count * VerticesPerSprite) VertexPositionColorTexture* vertices, FXMVECTOR textureSize, FXMVECTOR inverseTextureSize, bool streamStores);
+
     DXGI_MODE_ROTATION mRotation;
 
     bool mSetViewport;
     D3D11_VIEWPORT mViewPort;
 
+
+    // Small open-addressed cache of texture sizes, so RenderBatch can avoid the GetResource,
+    // QueryInterface and GetDesc calls each time the texture changes. Keyed on the view pointer,
+    // so it is emptied at End, after which the queued texture references have been released.
+    class TextureSizeCache
+    {
+    public:
+        TextureSizeCache();
+
+        XMVECTOR GetSize(_In_ ID3D11ShaderResourceView* texture);
+        void Remove(_In_ ID3D11ShaderResourceView* texture);
+        void Clear();
+
+        size_t hits;
+        size_t misses;
+
+    private:
+        static const size_t Capacity = 64;
+        static const size_t MaxEntries = Capacity * 3 / 4;
+
+        struct Entry
+        {
+            ID3D11ShaderResourceView* texture;
+            XMFLOAT2 size;
+        };
+
+        static size_t Hash(_In_ ID3D11ShaderResourceView* texture);
+
+        Entry mEntries[Capacity];
+        size_t mCount;
+    };
+
+    TextureSizeCache mTextureSizeCache;
+
+    RenderStats mRenderStats;
+
 private:
     // Implementation helper methods.
     void GrowSpriteQueue();
     void PrepareForRendering();
+    void SetBuffers(_In_ ID3D11Buffer* vertexBuffer, size_t spriteCount);
     void FlushBatch();
     void SortSprites();
     void GrowSortedSprites();
+    void FillSortKeys();
 
     void RenderBatch(_In_ ID3D11ShaderResourceView* texture, _In_reads_(count) SpriteInfo const* const* sprites, size_t count);
 
+    static void XM_CALLCONV GenerateVertices(_In_reads_(count) SpriteInfo const* const* sprites, size_t count, _Out_writes_(count * VerticesPerSprite) VertexPositionColorTexture* vertices, FXMVECTOR textureSize, FXMVECTOR inverseTextureSize);
+    static void XM_CALLCONV RenderFourSprites(_In_reads_(4) SpriteInfo const* const* sprites, _Out_writes_(4 * VerticesPerSprite) VertexPositionColorTexture* vertices, FXMVECTOR textureSize, FXMVECTOR inverseTextureSize, bool streamStores);
     static void XM_CALLCONV RenderSprite(_In_ SpriteInfo const* sprite, _Out_cap_c_(VerticesPerSprite) VertexPositionColorTexture* vertices, FXMVECTOR textureSize, FXMVECTOR inverseTextureSize);
 
-    static XMVECTOR GetTextureSize(_In_ ID3D11ShaderResourceView* texture);
     XMMATRIX GetViewportTransform(_In_ ID3D11DeviceContext* deviceContext, DXGI_MODE_ROTATION rotation );
 
 
     // Constants.
-    static const size_t MaxBatchSize = 2048;
     static const size_t MinBatchSize = 128;
+    static const size_t MaxBatchSizeLimit = 512 * 1024;
+    static const size_t MaxShortIndexBatchSize = 16384;
     static const size_t InitialQueueSize = 64;
-    static const size_t VerticesPerSprite = 4;
-    static const size_t IndicesPerSprite = 6;
+    static const size_t MinParallelBatchSize = 1024;
+    static const size_t SpritesPerParallelTask = 256;
 
 
     // Queue of sprites waiting to be drawn.
@@ -101,6 +156,24 @@ private:
     std::vector<SpriteInfo const*> mSortedSprites;
 
 
+    // Number of sprites this SpriteBatch wants to fit in the shared vertex buffer between wraps.
+    size_t mMaxBatchSize;
+
+
+    // Sorting works on a compact array of 64-bit keys (depth in the high 32 bits, texture ID in the low
+    // 32 bits) paired with sprite indices, rather than chasing SpriteInfo pointers in a comparison sort.
+    // Sprites at the same depth are grouped by texture, so they can share a draw call.
+    struct SortEntry
+    {
+        uint64_t key;
+        uint32_t index;
+    };
+
+    std::vector<SortEntry> mSortEntries;
+    std::vector<SortEntry> mSortScratch;
+    DenseIdTable mTextureSortIds;
+
+
     // If each SpriteInfo instance held a refcount on its texture, could end up with
     // many redundant AddRef/Release calls on the same object, so instead we use
     // this separate list to hold just a single refcount each time we change texture.
@@ -127,15 +200,24 @@ private:
         ComPtr<ID3D11VertexShader> vertexShader;
         ComPtr<ID3D11PixelShader> pixelShader;
         ComPtr<ID3D11InputLayout> inputLayout;
-        ComPtr<ID3D11Buffer> indexBuffer;
 
         CommonStates stateObjects;
 
+        // The index buffer is shared by every context, and grows to fit the largest vertex buffer. The caller
+        // gets its own reference, since another context may replace the buffer before it is bound.
+        ComPtr<ID3D11Buffer> DemandIndexBuffer(_In_ ID3D11DeviceContext* deviceContext, size_t spriteCount, _Out_ DXGI_FORMAT* format);
+
     private:
         void CreateShaders(_In_ ID3D11Device* device);
-        void CreateIndexBuffer(_In_ ID3D11Device* device);
+        void CreateIndexBuffer(_In_ ID3D11Device* device, size_t spriteCount);
+
+        template<typename T>
+        static std::vector<T> CreateIndexValues(size_t spriteCount);
 
-        static std::vector<short> CreateIndexValues();
+        ComPtr<ID3D11Buffer> indexBuffer;
+        size_t indexBufferSize;
+        DXGI_FORMAT indexFormat;
+        std::mutex mutex;
     };
 
 
@@ -149,12 +231,16 @@ private:
 
         ConstantBuffer<XMMATRIX> constantBuffer;
 
+        size_t vertexBufferSize;
         size_t vertexBufferPosition;
 
         bool inImmediateMode;
 
+        // Replaces the vertex buffer with a larger one if needed.
+        void DemandVertexBuffer(size_t spriteCount);
+
     private:
-        void CreateVertexBuffer();
+        void CreateVertexBuffer(size_t spriteCount);
     };
 
 
@@ -172,9 +258,48 @@ SharedResourcePool<ID3D11Device*, SpriteBatch::Impl::DeviceResources> SpriteBatc
 SharedResourcePool<ID3D11DeviceContext*, SpriteBatch::Impl::ContextResources> SpriteBatch::Impl::contextResourcesPool;
 
 
+// Internal SpriteLayer implementation class.
+class SpriteLayer::Impl
+{
+public:
+    Impl(_In_ ID3D11Device* device, _In_ ID3D11ShaderResourceView* texture, size_t capacity);
+
+    size_t XM_CALLCONV Add(FXMVECTOR destination, _In_opt_ RECT const* sourceRectangle, FXMVECTOR color, FXMVECTOR originRotationDepth, int flags);
+    void XM_CALLCONV Set(size_t index, FXMVECTOR destination, _In_opt_ RECT const* sourceRectangle, FXMVECTOR color, FXMVECTOR originRotationDepth, int flags);
+    void Clear();
+
+    void Update(_In_ ID3D11DeviceContext* deviceContext);
+
+    typedef SpriteBatch::Impl::SpriteInfo SpriteInfo;
+
+
+    // Fields.
+    ComPtr<ID3D11ShaderResourceView> texture;
+    ComPtr<ID3D11Buffer> vertexBuffer;
+    XMFLOAT2 textureSize;
+
+    std::unique_ptr<SpriteInfo[]> sprites;
+    size_t capacity;
+    size_t count;
+
+    DirtyRanges dirtyRanges;
+
+private:
+    // Scratch space for regenerating dirty ranges.
+    std::vector<SpriteInfo const*> mSpritePointers;
+    std::vector<VertexPositionColorTexture> mVertices;
+
+    static const size_t MaxCapacity = 512 * 1024;
+
+    // Clean sprites between two dirty ranges are uploaded again if that saves an UpdateSubresource call.
+    static const size_t MaxCoalesceGap = 16;
+};
+
+
 // Constants.
 const XMMATRIX SpriteBatch::MatrixIdentity = XMMatrixIdentity();
 const XMFLOAT2 SpriteBatch::Float2Zero(0, 0);
+const XMFLOAT2 SpriteLayer::Float2Zero(0, 0);
 
 
 namespace
@@ -212,15 +337,38 @@ namespace
 
         return v;
     }
+
+
+    // Helper writes 16 aligned bytes of vertex data, bypassing the cache where the platform allows.
+    // The mapped vertex buffer is write-combined memory that we never read back.
+    inline void XM_CALLCONV StreamFloat4(_Out_writes_(4) float* dest, FXMVECTOR value)
+    {
+    #if defined(_XM_SSE_INTRINSICS_)
+        _mm_stream_ps(dest, value);
+    #else
+        XMStoreFloat4A(reinterpret_cast<XMFLOAT4A*>(dest), value);
+    #endif
+    }
+
+
+    // Makes streamed stores visible before the buffer is unmapped.
+    inline void StreamFence()
+    {
+    #if defined(_XM_SSE_INTRINSICS_)
+        _mm_sfence();
+    #endif
+    }
 }
 
 
 // Per-device constructor.
 SpriteBatch::Impl::DeviceResources::DeviceResources(_In_ ID3D11Device* device)
-  : stateObjects(device)
+  : stateObjects(device),
+    indexBufferSize(0),
+    indexFormat(DXGI_FORMAT_R16_UINT)
 {
     CreateShaders(device);
-    CreateIndexBuffer(device);
+    CreateIndexBuffer(device, SpriteBatch::DefaultBatchSize);
 }
 
 
@@ -255,47 +403,91 @@ void SpriteBatch::Impl::DeviceResources::CreateShaders(_In_ ID3D11Device* device
 }
 
 
-// Creates the SpriteBatch index buffer.
-void SpriteBatch::Impl::DeviceResources::CreateIndexBuffer(_In_ ID3D11Device* device)
+// Returns an index buffer covering at least the specified number of sprites, growing it if necessary.
+ComPtr<ID3D11Buffer> SpriteBatch::Impl::DeviceResources::DemandIndexBuffer(_In_ ID3D11DeviceContext* deviceContext, size_t spriteCount, _Out_ DXGI_FORMAT* format)
 {
-    D3D11_BUFFER_DESC indexBufferDesc = { 0 };
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (indexBufferSize < spriteCount)
+    {
+        CreateIndexBuffer(GetDevice(deviceContext).Get(), spriteCount);
+    }
 
-    static_assert( ( MaxBatchSize * VerticesPerSprite ) < USHRT_MAX, "MaxBatchSize too large for 16-bit indices" );
+    *format = indexFormat;
+
+    return indexBuffer;
+}
+
+
+// Creates the SpriteBatch index buffer, switching to 32-bit indices once the vertices no longer fit in 16 bits.
+void SpriteBatch::Impl::DeviceResources::CreateIndexBuffer(_In_ ID3D11Device* device, size_t spriteCount)
+{
+    static_assert( ( MaxShortIndexBatchSize * VerticesPerSprite ) <= USHRT_MAX + 1, "MaxShortIndexBatchSize too large for 16-bit indices" );
+
+    bool useShortIndices = (spriteCount <= MaxShortIndexBatchSize);
+
+    if (!useShortIndices && device->GetFeatureLevel() < D3D_FEATURE_LEVEL_9_2)
+        throw std::exception("SpriteBatch batch size too large for 16-bit indices: 32-bit indices require Feature Level 9.2 or later");
+
+    std::vector<uint16_t> shortIndices;
+    std::vector<uint32_t> longIndices;
+
+    D3D11_BUFFER_DESC indexBufferDesc = { 0 };
 
-    indexBufferDesc.ByteWidth = sizeof(short) * MaxBatchSize * IndicesPerSprite;
     indexBufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
     indexBufferDesc.Usage = D3D11_USAGE_DEFAULT;
 
-    auto indexValues = CreateIndexValues();
-
     D3D11_SUBRESOURCE_DATA indexDataDesc = { 0 };
 
-    indexDataDesc.pSysMem = &indexValues.front();
+    if (useShortIndices)
+    {
+        shortIndices = CreateIndexValues<uint16_t>(spriteCount);
+
+        indexBufferDesc.ByteWidth = static_cast<UINT>(sizeof(uint16_t) * spriteCount * IndicesPerSprite);
+        indexDataDesc.pSysMem = &shortIndices.front();
+    }
+    else
+    {
+        longIndices = CreateIndexValues<uint32_t>(spriteCount);
+
+        indexBufferDesc.ByteWidth = static_cast<UINT>(sizeof(uint32_t) * spriteCount * IndicesPerSprite);
+        indexDataDesc.pSysMem = &longIndices.front();
+    }
+
+    ComPtr<ID3D11Buffer> newIndexBuffer;
 
     ThrowIfFailed(
-        device->CreateBuffer(&indexBufferDesc, &indexDataDesc, &indexBuffer)
+        device->CreateBuffer(&indexBufferDesc, &indexDataDesc, &newIndexBuffer)
     );
 
-    SetDebugObjectName(indexBuffer.Get(), "DirectXTK:SpriteBatch");
+    SetDebugObjectName(newIndexBuffer.Get(), "DirectXTK:SpriteBatch");
+
+    // Contexts that still have the previous buffer bound hold their own reference to it.
+    indexBuffer = newIndexBuffer;
+    indexBufferSize = spriteCount;
+    indexFormat = useShortIndices ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
 }
 
 
 // Helper for populating the SpriteBatch index buffer.
-std::vector<short> SpriteBatch::Impl::DeviceResources::CreateIndexValues()
+template<typename T>
+std::vector<T> SpriteBatch::Impl::DeviceResources::CreateIndexValues(size_t spriteCount)
 {
-    std::vector<short> indices;
+    std::vector<T> indices;
 
-    indices.reserve(MaxBatchSize * IndicesPerSprite);
+    indices.reserve(spriteCount * IndicesPerSprite);
 
-    for (short i = 0; i < MaxBatchSize * VerticesPerSprite; i += VerticesPerSprite)
+    for (size_t i = 0; i < spriteCount * VerticesPerSprite; i += VerticesPerSprite)
     {
-        indices.push_back(i);
-        indices.push_back(i + 1);
-        indices.push_back(i + 2);
+        T index = static_cast<T>(i);
 
-        indices.push_back(i + 1);
-        indices.push_back(i + 3);
-        indices.push_back(i + 2);
+        indices.push_back(index);
+        indices.push_back(index + 1);
+        indices.push_back(index + 2);
+
+        indices.push_back(index + 1);
+        indices.push_back(index + 3);
+        indices.push_back(index + 2);
     }
 
     return indices;
@@ -306,19 +498,30 @@ std::vector<short> SpriteBatch::Impl::DeviceResources::CreateIndexValues()
 SpriteBatch::Impl::ContextResources::ContextResources(_In_ ID3D11DeviceContext* deviceContext)
   : deviceContext(deviceContext),
     constantBuffer(GetDevice(deviceContext).Get()),
+    vertexBufferSize(0),
     vertexBufferPosition(0),
     inImmediateMode(false)
 {
-    CreateVertexBuffer();
+    CreateVertexBuffer(SpriteBatch::DefaultBatchSize);
+}
+
+
+// Grows the vertex buffer, for SpriteBatch instances that ask for a larger batch size than the others on this context.
+void SpriteBatch::Impl::ContextResources::DemandVertexBuffer(size_t spriteCount)
+{
+    if (vertexBufferSize < spriteCount)
+    {
+        CreateVertexBuffer(spriteCount);
+    }
 }
 
 
 // Creates the SpriteBatch vertex buffer.
-void SpriteBatch::Impl::ContextResources::CreateVertexBuffer()
+void SpriteBatch::Impl::ContextResources::CreateVertexBuffer(size_t spriteCount)
 {
     D3D11_BUFFER_DESC vertexBufferDesc = { 0 };
 
-    vertexBufferDesc.ByteWidth = sizeof(VertexPositionColorTexture) * MaxBatchSize * VerticesPerSprite;
+    vertexBufferDesc.ByteWidth = static_cast<UINT>(sizeof(VertexPositionColorTexture) * spriteCount * VerticesPerSprite);
     vertexBufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
     vertexBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
     vertexBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
@@ -328,21 +531,31 @@ void SpriteBatch::Impl::ContextResources::CreateVertexBuffer()
     );
 
     SetDebugObjectName(vertexBuffer.Get(), "DirectXTK:SpriteBatch");
+
+    vertexBufferSize = spriteCount;
+
+    // The new buffer is empty, so the next Map must discard.
+    vertexBufferPosition = 0;
 }
 
 
 // Per-SpriteBatch constructor.
-SpriteBatch::Impl::Impl(_In_ ID3D11DeviceContext* deviceContext)
+SpriteBatch::Impl::Impl(_In_ ID3D11DeviceContext* deviceContext, size_t maxBatchSize)
   : mRotation( DXGI_MODE_ROTATION_IDENTITY ),
     mSetViewport(false),
     mSpriteQueueCount(0),
     mSpriteQueueArraySize(0),
+    mMaxBatchSize(maxBatchSize),
     mInBeginEndPair(false),
     mSortMode(SpriteSortMode_Deferred),
     mTransformMatrix(MatrixIdentity),
     mDeviceResources(deviceResourcesPool.DemandCreate(GetDevice(deviceContext).Get())),
     mContextResources(contextResourcesPool.DemandCreate(deviceContext))
 {
+    if (maxBatchSize < MinBatchSize || maxBatchSize > MaxBatchSizeLimit)
+        throw std::exception("Invalid SpriteBatch batch size");
+
+    memset(&mRenderStats, 0, sizeof(mRenderStats));
 }
 
 
@@ -400,6 +613,9 @@ void SpriteBatch::Impl::End()
     // over an object that holds a reference to this SpriteBatch.
     mSetCustomShaders = nullptr;
 
+    // Texture pointers may be reused once the caller releases them.
+    mTextureSizeCache.Clear();
+
     mInBeginEndPair = false;
 }
 
@@ -421,6 +637,74 @@ void XM_CALLCONV SpriteBatch::Impl::Draw(_In_ ID3D11ShaderResourceView* texture,
 
     SpriteInfo* sprite = &mSpriteQueue[mSpriteQueueCount];
 
+    StoreSpriteInfo(sprite, texture, destination, sourceRectangle, color, originRotationDepth, flags);
+
+    if (mSortMode == SpriteSortMode_Immediate)
+    {
+        // If we are in immediate mode, draw this sprite straight away.
+        RenderBatch(texture, &sprite, 1);
+    }
+    else
+    {
+        // Queue this sprite for later sorting and batched rendering.
+        mSpriteQueueCount++;
+
+        // Make sure we hold a refcount on this texture until the sprite has been drawn. Only checking the
+        // back of the vector means we will add duplicate references if the caller switches back and forth
+        // between multiple repeated textures, but calling AddRef more times than strictly necessary hurts
+        // nothing, and is faster than scanning the whole list or using a map to detect all duplicates.
+        if (mSpriteTextureReferences.empty() || texture != mSpriteTextureReferences.back().Get())
+        {
+            mSpriteTextureReferences.emplace_back(texture);
+        }
+    }
+}
+
+
+// Adds a run of sprites to the queue in one go.
+void XM_CALLCONV SpriteBatch::Impl::DrawRun(_In_ ID3D11ShaderResourceView* texture, _In_reads_(count) SpriteRunItem const* items, size_t count, FXMVECTOR destination, FXMVECTOR color, FXMVECTOR originRotationDepth, int flags)
+{
+    if (!texture)
+        throw std::exception("Texture cannot be null");
+
+    if (!mInBeginEndPair)
+        throw std::exception("Begin must be called before Draw");
+
+    if (!count)
+        return;
+
+    if (mSortMode == SpriteSortMode_Immediate)
+    {
+        // Immediate mode draws each sprite as it arrives anyway.
+        for (size_t i = 0; i < count; i++)
+        {
+            Draw(texture, destination, &items[i].sourceRectangle, color, originRotationDepth + XMLoadFloat2(&items[i].origin), flags);
+        }
+
+        return;
+    }
+
+    // Make room for the whole run up front.
+    while (mSpriteQueueCount + count > mSpriteQueueArraySize)
+    {
+        GrowSpriteQueue();
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        StoreSpriteInfo(&mSpriteQueue[mSpriteQueueCount++], texture, destination, &items[i].sourceRectangle, color, originRotationDepth + XMLoadFloat2(&items[i].origin), flags);
+    }
+
+    if (mSpriteTextureReferences.empty() || texture != mSpriteTextureReferences.back().Get())
+    {
+        mSpriteTextureReferences.emplace_back(texture);
+    }
+}
+
+
+// Fills in the sprite info for a single sprite.
+void XM_CALLCONV SpriteBatch::Impl::StoreSpriteInfo(_Out_ SpriteInfo* sprite, _In_ ID3D11ShaderResourceView* texture, FXMVECTOR destination, _In_opt_ RECT const* sourceRectangle, FXMVECTOR color, FXMVECTOR originRotationDepth, int flags)
+{
     XMVECTOR dest = destination;
 
     if (sourceRectangle)
@@ -453,26 +737,6 @@ void XM_CALLCONV SpriteBatch::Impl::Draw(_In_ ID3D11ShaderResourceView* texture,
 
     sprite->texture = texture;
     sprite->flags = flags;
-
-    if (mSortMode == SpriteSortMode_Immediate)
-    {
-        // If we are in immediate mode, draw this sprite straight away.
-        RenderBatch(texture, &sprite, 1);
-    }
-    else
-    {
-        // Queue this sprite for later sorting and batched rendering.
-        mSpriteQueueCount++;
-
-        // Make sure we hold a refcount on this texture until the sprite has been drawn. Only checking the
-        // back of the vector means we will add duplicate references if the caller switches back and forth
-        // between multiple repeated textures, but calling AddRef more times than strictly necessary hurts
-        // nothing, and is faster than scanning the whole list or using a map to detect all duplicates.
-        if (mSpriteTextureReferences.empty() || texture != mSpriteTextureReferences.back().Get())
-        {
-            mSpriteTextureReferences.emplace_back(texture);
-        }
-    }
 }
 
 
@@ -522,14 +786,10 @@ void SpriteBatch::Impl::PrepareForRendering()
     deviceContext->VSSetShader(mDeviceResources->vertexShader.Get(), nullptr, 0);
     deviceContext->PSSetShader(mDeviceResources->pixelShader.Get(), nullptr, 0);
 
-    // Set the vertex and index buffer.
-    auto vertexBuffer = mContextResources->vertexBuffer.Get();
-    UINT vertexStride = sizeof(VertexPositionColorTexture);
-    UINT vertexOffset = 0;
-
-    deviceContext->IASetVertexBuffers(0, 1, &vertexBuffer, &vertexStride, &vertexOffset);
+    // Set the vertex and index buffer, first making sure they are as large as this SpriteBatch wants.
+    mContextResources->DemandVertexBuffer(mMaxBatchSize);
 
-    deviceContext->IASetIndexBuffer(mDeviceResources->indexBuffer.Get(), DXGI_FORMAT_R16_UINT, 0);
+    SetBuffers(mContextResources->vertexBuffer.Get(), mContextResources->vertexBufferSize);
 
     // Set the transform matrix.
     XMMATRIX transformMatrix = (mRotation == DXGI_MODE_ROTATION_UNSPECIFIED)
@@ -556,6 +816,63 @@ void SpriteBatch::Impl::PrepareForRendering()
 }
 
 
+// Binds a vertex buffer holding the specified number of sprites, along with an index buffer that covers it.
+void SpriteBatch::Impl::SetBuffers(_In_ ID3D11Buffer* vertexBuffer, size_t spriteCount)
+{
+    auto deviceContext = mContextResources->deviceContext.Get();
+
+    DXGI_FORMAT indexFormat;
+
+    auto indexBuffer = mDeviceResources->DemandIndexBuffer(deviceContext, spriteCount, &indexFormat);
+
+    UINT vertexStride = sizeof(VertexPositionColorTexture);
+    UINT vertexOffset = 0;
+
+    deviceContext->IASetVertexBuffers(0, 1, &vertexBuffer, &vertexStride, &vertexOffset);
+
+    deviceContext->IASetIndexBuffer(indexBuffer.Get(), indexFormat, 0);
+}
+
+
+// Draws a retained sprite layer, after any sprites queued before it.
+void SpriteBatch::Impl::DrawLayer(_In_ SpriteLayer::Impl* layer)
+{
+    if (!mInBeginEndPair)
+        throw std::exception("Begin must be called before Draw");
+
+    if (!layer->count)
+        return;
+
+    if (mSortMode != SpriteSortMode_Immediate)
+    {
+        // Preserve ordering by drawing what has been queued so far.
+        if (mContextResources->inImmediateMode)
+            throw std::exception("Cannot draw a SpriteLayer while another SpriteBatch is using SpriteSortMode_Immediate");
+
+        PrepareForRendering();
+        FlushBatch();
+    }
+
+    auto deviceContext = mContextResources->deviceContext.Get();
+
+    layer->Update(deviceContext);
+
+    auto texture = layer->texture.Get();
+
+    deviceContext->PSSetShaderResources(0, 1, &texture);
+
+    SetBuffers(layer->vertexBuffer.Get(), layer->capacity);
+
+    deviceContext->DrawIndexed(static_cast<UINT>(layer->count * IndicesPerSprite), 0, 0);
+
+    mRenderStats.draws++;
+    mRenderStats.sprites += layer->count;
+
+    // Put back the shared dynamic buffer for any sprites that follow.
+    SetBuffers(mContextResources->vertexBuffer.Get(), mContextResources->vertexBufferSize);
+}
+
+
 // Sends queued sprites to the graphics device.
 void SpriteBatch::Impl::FlushBatch()
 {
@@ -595,8 +912,8 @@ void SpriteBatch::Impl::FlushBatch()
     mSpriteTextureReferences.clear();
 
     // When sorting is disabled, we persist mSortedSprites data from one batch to the next, to avoid
-    // uneccessary work in GrowSortedSprites. But we never reuse these when sorting, because re-sorting
-    // previously sorted items gives unstable ordering if some sprites have identical sort keys.
+    // uneccessary work in GrowSortedSprites. But we never reuse these after sorting, because the sorted
+    // pointers are no longer in queue order.
     if (mSortMode != SpriteSortMode_Deferred)
     {
         mSortedSprites.clear();
@@ -613,31 +930,66 @@ void SpriteBatch::Impl::SortSprites()
         GrowSortedSprites();
     }
 
-    switch (mSortMode)
+    if (mSortMode == SpriteSortMode_Deferred)
+        return;
+
+    FillSortKeys();
+
+    SortEntry const* sorted = RadixSortByKey(mSortEntries.data(), mSortScratch.data(), mSpriteQueueCount);
+
+    for (size_t i = 0; i < mSpriteQueueCount; i++)
     {
-        case SpriteSortMode_Texture:
-            // Sort by texture.
-            std::sort(mSortedSprites.begin(), mSortedSprites.begin() + mSpriteQueueCount, [](SpriteInfo const* x, SpriteInfo const* y) -> bool
-            {
-                return x->texture < y->texture;
-            });
-            break;
+        mSortedSprites[i] = &mSpriteQueue[sorted[i].index];
+    }
+}
 
-        case SpriteSortMode_BackToFront:
-            // Sort back to front.
-            std::sort(mSortedSprites.begin(), mSortedSprites.begin() + mSpriteQueueCount, [](SpriteInfo const* x, SpriteInfo const* y) -> bool
-            {
-                return x->originRotationDepth.w > y->originRotationDepth.w;
-            });
-            break;
 
-        case SpriteSortMode_FrontToBack:
-            // Sort front to back.
-            std::sort(mSortedSprites.begin(), mSortedSprites.begin() + mSpriteQueueCount, [](SpriteInfo const* x, SpriteInfo const* y) -> bool
-            {
-                return x->originRotationDepth.w < y->originRotationDepth.w;
-            });
-            break;
+// Builds the radix sort keys for the queued sprites.
+void SpriteBatch::Impl::FillSortKeys()
+{
+    if (mSortEntries.size() < mSpriteQueueCount)
+    {
+        mSortEntries.resize(mSpriteQueueCount);
+        mSortScratch.resize(mSpriteQueueCount);
+    }
+
+    // Textures get small dense IDs, so that sorting by texture only needs a pass or two. The table
+    // is only consulted when the texture changes, which is rare in typical submission orders.
+    ID3D11ShaderResourceView* lastTexture = nullptr;
+    uint64_t textureId = 0;
+
+    mTextureSortIds.Reset();
+
+    for (size_t i = 0; i < mSpriteQueueCount; i++)
+    {
+        SpriteInfo const& sprite = mSpriteQueue[i];
+
+        if (sprite.texture != lastTexture)
+        {
+            textureId = mTextureSortIds.GetId(sprite.texture);
+            lastTexture = sprite.texture;
+        }
+
+        uint64_t key;
+
+        switch (mSortMode)
+        {
+            case SpriteSortMode_BackToFront:
+                // Complementing the depth bits reverses the order while keeping the sort stable.
+                key = (static_cast<uint64_t>(~SortableFloatBits(sprite.originRotationDepth.w)) << 32) | textureId;
+                break;
+
+            case SpriteSortMode_FrontToBack:
+                key = (static_cast<uint64_t>(SortableFloatBits(sprite.originRotationDepth.w)) << 32) | textureId;
+                break;
+
+            default:
+                key = textureId;
+                break;
+        }
+
+        mSortEntries[i].key = key;
+        mSortEntries[i].index = static_cast<uint32_t>(i);
     }
 }
 
@@ -664,7 +1016,7 @@ void SpriteBatch::Impl::RenderBatch(_In_ ID3D11ShaderResourceView* texture, _In_
     // Draw using the specified texture.
     deviceContext->PSSetShaderResources(0, 1, &texture);
 
-    XMVECTOR textureSize = GetTextureSize(texture);
+    XMVECTOR textureSize = mTextureSizeCache.GetSize(texture);
     XMVECTOR inverseTextureSize = XMVectorReciprocal(textureSize);
             
     while (count > 0)
@@ -673,7 +1025,8 @@ void SpriteBatch::Impl::RenderBatch(_In_ ID3D11ShaderResourceView* texture, _In_
         size_t batchSize = count;
 
         // How many sprites does the D3D vertex buffer have room for?
-        size_t remainingSpace = MaxBatchSize - mContextResources->vertexBufferPosition;
+        size_t bufferSize = mContextResources->vertexBufferSize;
+        size_t remainingSpace = bufferSize - mContextResources->vertexBufferPosition;
 
         if (batchSize > remainingSpace)
         {
@@ -682,7 +1035,9 @@ void SpriteBatch::Impl::RenderBatch(_In_ ID3D11ShaderResourceView* texture, _In_
                 // If we are out of room, or about to submit an excessively small batch, wrap back to the start of the vertex buffer.
                 mContextResources->vertexBufferPosition = 0;
 
-                batchSize = std::min(count, MaxBatchSize);
+                batchSize = std::min(count, bufferSize);
+
+                mRenderStats.wraps++;
             }
             else
             {
@@ -700,17 +1055,14 @@ void SpriteBatch::Impl::RenderBatch(_In_ ID3D11ShaderResourceView* texture, _In_
             deviceContext->Map(mContextResources->vertexBuffer.Get(), 0, mapType, 0, &mappedBuffer)
         );
 
+        mRenderStats.maps++;
+
         VertexPositionColorTexture* vertices = (VertexPositionColorTexture*)mappedBuffer.pData + mContextResources->vertexBufferPosition * VerticesPerSprite;
 
         // Generate sprite vertex data.
-        for (size_t i = 0; i < batchSize; i++)
-        {
-            assert(i < count);
-            _Analysis_assume_(i < count);
-            RenderSprite(sprites[i], vertices, textureSize, inverseTextureSize);
-
-            vertices += VerticesPerSprite;
-        }
+        assert(batchSize <= count);
+        _Analysis_assume_(batchSize <= count);
+        GenerateVertices(sprites, batchSize, vertices, textureSize, inverseTextureSize);
 
         deviceContext->Unmap(mContextResources->vertexBuffer.Get(), 0);
 
@@ -720,6 +1072,9 @@ void SpriteBatch::Impl::RenderBatch(_In_ ID3D11ShaderResourceView* texture, _In_
 
         deviceContext->DrawIndexed(indexCount, startIndex, 0);
 
+        mRenderStats.draws++;
+        mRenderStats.sprites += batchSize;
+
         // Advance the buffer position.
         mContextResources->vertexBufferPosition += batchSize;
 
@@ -729,19 +1084,239 @@ void SpriteBatch::Impl::RenderBatch(_In_ ID3D11ShaderResourceView* texture, _In_
 }
 
 
-// Generates vertex data for drawing a single sprite.
-void XM_CALLCONV SpriteBatch::Impl::RenderSprite(_In_ SpriteInfo const* sprite, _Out_cap_c_(VerticesPerSprite) VertexPositionColorTexture* vertices, FXMVECTOR textureSize, FXMVECTOR inverseTextureSize)
+// Generates vertex data for a run of sprites, splitting large runs across worker threads.
+void XM_CALLCONV SpriteBatch::Impl::GenerateVertices(_In_reads_(count) SpriteInfo const* const* sprites, size_t count, _Out_writes_(count * VerticesPerSprite) VertexPositionColorTexture* vertices, FXMVECTOR textureSize, FXMVECTOR inverseTextureSize)
 {
-    // Load sprite parameters into SIMD registers.
-    XMVECTOR source = XMLoadFloat4A(&sprite->source);
-    XMVECTOR destination = XMLoadFloat4A(&sprite->destination);
-    XMVECTOR color = XMLoadFloat4A(&sprite->color);
-    XMVECTOR originRotationDepth = XMLoadFloat4A(&sprite->originRotationDepth);
+    static_assert(SpritesPerParallelTask % 4 == 0, "Parallel tasks must start on a four sprite boundary");
 
-    float rotation = sprite->originRotationDepth.z;
-    int flags = sprite->flags;
-
-    // Extract the source and destination sizes into separate vectors.
+    if (count < MinParallelBatchSize)
+    {
+        RenderSprites(sprites, count, vertices, textureSize, inverseTextureSize, true);
+        return;
+    }
+
+    // Each task fills a disjoint range of the mapped buffer. Only the Map, Unmap and draw calls stay on this thread.
+    // Captured as XMFLOAT4, since lambdas holding aligned XMVECTOR members cannot be passed by value on x86.
+    XMFLOAT4 size;
+    XMFLOAT4 inverseSize;
+
+    XMStoreFloat4(&size, textureSize);
+    XMStoreFloat4(&inverseSize, inverseTextureSize);
+
+    size_t taskCount = (count + SpritesPerParallelTask - 1) / SpritesPerParallelTask;
+
+    Concurrency::parallel_for(size_t(0), taskCount, [=](size_t task)
+    {
+        size_t start = task * SpritesPerParallelTask;
+        size_t end = std::min(start + SpritesPerParallelTask, count);
+
+        RenderSprites(sprites + start, end - start, vertices + start * VerticesPerSprite, XMLoadFloat4(&size), XMLoadFloat4(&inverseSize), true);
+    });
+}
+
+
+// Generates vertex data for a run of sprites that share a texture. Streaming stores suit mapped
+// buffers, but not system memory that is read back soon after, such as the SpriteLayer scratch space.
+void XM_CALLCONV SpriteBatch::Impl::RenderSprites(_In_reads_(count) SpriteInfo const* const* sprites, size_t count, _Out_writes_(count * VerticesPerSprite) VertexPositionColorTexture* vertices, FXMVECTOR textureSize, FXMVECTOR inverseTextureSize, bool streamStores)
+{
+    static_assert((sizeof(VertexPositionColorTexture) * VerticesPerSprite) % 16 == 0, "Per-sprite vertex data must keep 16 byte alignment");
+
+    size_t i = 0;
+
+    // Mapped buffers are always suitably aligned, but fall back to the single sprite path if streaming to one that is not.
+    if (!streamStores || (reinterpret_cast<uintptr_t>(vertices) & 15) == 0)
+    {
+        for (; i + 4 <= count; i += 4)
+        {
+            RenderFourSprites(sprites + i, vertices + i * VerticesPerSprite, textureSize, inverseTextureSize, streamStores);
+        }
+
+        if (streamStores)
+        {
+            StreamFence();
+        }
+    }
+
+    // Any leftover sprites are handled one at a time.
+    for (; i < count; i++)
+    {
+        RenderSprite(sprites[i], vertices + i * VerticesPerSprite, textureSize, inverseTextureSize);
+    }
+}
+
+
+// Generates vertex data for four sprites at once. This is the same math as RenderSprite, but with the
+// sprites transposed into structure-of-arrays form, so that each SIMD lane works on a different sprite.
+void XM_CALLCONV SpriteBatch::Impl::RenderFourSprites(_In_reads_(4) SpriteInfo const* const* sprites, _Out_writes_(4 * VerticesPerSprite) VertexPositionColorTexture* vertices, FXMVECTOR textureSize, FXMVECTOR inverseTextureSize, bool streamStores)
+{
+    static const XMVECTORU32 sourceInTexelsBit   = { SpriteInfo::SourceInTexels, SpriteInfo::SourceInTexels, SpriteInfo::SourceInTexels, SpriteInfo::SourceInTexels };
+    static const XMVECTORU32 destSizeInPixelsBit = { SpriteInfo::DestSizeInPixels, SpriteInfo::DestSizeInPixels, SpriteInfo::DestSizeInPixels, SpriteInfo::DestSizeInPixels };
+    static const XMVECTORU32 flipHorizontallyBit = { SpriteEffects_FlipHorizontally, SpriteEffects_FlipHorizontally, SpriteEffects_FlipHorizontally, SpriteEffects_FlipHorizontally };
+    static const XMVECTORU32 flipVerticallyBit   = { SpriteEffects_FlipVertically, SpriteEffects_FlipVertically, SpriteEffects_FlipVertically, SpriteEffects_FlipVertically };
+
+    // Load sprite parameters, transposing so each vector holds one field of all four sprites.
+    XMMATRIX source = XMMatrixTranspose(XMMATRIX(XMLoadFloat4A(&sprites[0]->source),
+                                                 XMLoadFloat4A(&sprites[1]->source),
+                                                 XMLoadFloat4A(&sprites[2]->source),
+                                                 XMLoadFloat4A(&sprites[3]->source)));
+
+    XMMATRIX destination = XMMatrixTranspose(XMMATRIX(XMLoadFloat4A(&sprites[0]->destination),
+                                                      XMLoadFloat4A(&sprites[1]->destination),
+                                                      XMLoadFloat4A(&sprites[2]->destination),
+                                                      XMLoadFloat4A(&sprites[3]->destination)));
+
+    XMMATRIX color = XMMatrixTranspose(XMMATRIX(XMLoadFloat4A(&sprites[0]->color),
+                                                XMLoadFloat4A(&sprites[1]->color),
+                                                XMLoadFloat4A(&sprites[2]->color),
+                                                XMLoadFloat4A(&sprites[3]->color)));
+
+    XMMATRIX originRotationDepth = XMMatrixTranspose(XMMATRIX(XMLoadFloat4A(&sprites[0]->originRotationDepth),
+                                                              XMLoadFloat4A(&sprites[1]->originRotationDepth),
+                                                              XMLoadFloat4A(&sprites[2]->originRotationDepth),
+                                                              XMLoadFloat4A(&sprites[3]->originRotationDepth)));
+
+    XMVECTOR flags = XMVectorSetInt(static_cast<uint32_t>(sprites[0]->flags),
+                                    static_cast<uint32_t>(sprites[1]->flags),
+                                    static_cast<uint32_t>(sprites[2]->flags),
+                                    static_cast<uint32_t>(sprites[3]->flags));
+
+    XMVECTOR sourceInTexels   = XMVectorEqualInt(XMVectorAndInt(flags, sourceInTexelsBit), sourceInTexelsBit);
+    XMVECTOR destSizeInPixels = XMVectorEqualInt(XMVectorAndInt(flags, destSizeInPixelsBit), destSizeInPixelsBit);
+    XMVECTOR flipHorizontally = XMVectorEqualInt(XMVectorAndInt(flags, flipHorizontallyBit), flipHorizontallyBit);
+    XMVECTOR flipVertically   = XMVectorEqualInt(XMVectorAndInt(flags, flipVerticallyBit), flipVerticallyBit);
+
+    // All four sprites share a texture.
+    XMVECTOR textureWidth = XMVectorSplatX(textureSize);
+    XMVECTOR textureHeight = XMVectorSplatY(textureSize);
+    XMVECTOR inverseTextureWidth = XMVectorSplatX(inverseTextureSize);
+    XMVECTOR inverseTextureHeight = XMVectorSplatY(inverseTextureSize);
+
+    XMVECTOR sourceX = source.r[0];
+    XMVECTOR sourceY = source.r[1];
+    XMVECTOR sourceWidth = source.r[2];
+    XMVECTOR sourceHeight = source.r[3];
+
+    XMVECTOR destinationWidth = destination.r[2];
+    XMVECTOR destinationHeight = destination.r[3];
+
+    XMVECTOR rotation = originRotationDepth.r[2];
+    XMVECTOR depth = originRotationDepth.r[3];
+
+    // Scale the origin offset by source size, taking care to avoid overflow if the source region is zero.
+    XMVECTOR zero = XMVectorZero();
+
+    XMVECTOR originX = XMVectorDivide(originRotationDepth.r[0], XMVectorSelect(sourceWidth, g_XMEpsilon, XMVectorEqual(sourceWidth, zero)));
+    XMVECTOR originY = XMVectorDivide(originRotationDepth.r[1], XMVectorSelect(sourceHeight, g_XMEpsilon, XMVectorEqual(sourceHeight, zero)));
+
+    // Convert the source region from texels to mod-1 texture coordinate format.
+    sourceX      = XMVectorSelect(sourceX, sourceX * inverseTextureWidth, sourceInTexels);
+    sourceY      = XMVectorSelect(sourceY, sourceY * inverseTextureHeight, sourceInTexels);
+    sourceWidth  = XMVectorSelect(sourceWidth, sourceWidth * inverseTextureWidth, sourceInTexels);
+    sourceHeight = XMVectorSelect(sourceHeight, sourceHeight * inverseTextureHeight, sourceInTexels);
+
+    originX = XMVectorSelect(originX * inverseTextureWidth, originX, sourceInTexels);
+    originY = XMVectorSelect(originY * inverseTextureHeight, originY, sourceInTexels);
+
+    // If the destination size is relative to the source region, convert it to pixels.
+    destinationWidth  = XMVectorSelect(destinationWidth * textureWidth, destinationWidth, destSizeInPixels);
+    destinationHeight = XMVectorSelect(destinationHeight * textureHeight, destinationHeight, destSizeInPixels);
+
+    // Compute the rotation, keeping unrotated sprites exact.
+    XMVECTOR sin, cos;
+
+    XMVectorSinCos(&sin, &cos, rotation);
+
+    XMVECTOR isUnrotated = XMVectorEqual(rotation, zero);
+
+    sin = XMVectorSelect(sin, zero, isUnrotated);
+    cos = XMVectorSelect(cos, g_XMOne, isUnrotated);
+
+    // Corner offsets along each axis, for unit-square positions 0 and 1, with the 2x2 rotation applied.
+    XMVECTOR offsetX0 = XMVectorNegate(originX) * destinationWidth;
+    XMVECTOR offsetX1 = (g_XMOne - originX) * destinationWidth;
+    XMVECTOR offsetY0 = XMVectorNegate(originY) * destinationHeight;
+    XMVECTOR offsetY1 = (g_XMOne - originY) * destinationHeight;
+
+    XMVECTOR positionX[4];
+    XMVECTOR positionY[4];
+
+    positionX[0] = destination.r[0] + offsetX0 * cos - offsetY0 * sin;
+    positionY[0] = destination.r[1] + offsetX0 * sin + offsetY0 * cos;
+    positionX[1] = destination.r[0] + offsetX1 * cos - offsetY0 * sin;
+    positionY[1] = destination.r[1] + offsetX1 * sin + offsetY0 * cos;
+    positionX[2] = destination.r[0] + offsetX0 * cos - offsetY1 * sin;
+    positionY[2] = destination.r[1] + offsetX0 * sin + offsetY1 * cos;
+    positionX[3] = destination.r[0] + offsetX1 * cos - offsetY1 * sin;
+    positionY[3] = destination.r[1] + offsetX1 * sin + offsetY1 * cos;
+
+    // Texture coordinates, swapping the edges of mirrored sprites.
+    XMVECTOR left   = sourceX + XMVectorSelect(zero, sourceWidth, flipHorizontally);
+    XMVECTOR right  = sourceX + XMVectorSelect(sourceWidth, zero, flipHorizontally);
+    XMVECTOR top    = sourceY + XMVectorSelect(zero, sourceHeight, flipVertically);
+    XMVECTOR bottom = sourceY + XMVectorSelect(sourceHeight, zero, flipVertically);
+
+    XMVECTOR textureU[4] = { left, right, left, right };
+    XMVECTOR textureV[4] = { top, top, bottom, bottom };
+
+    // Lay out the fields in vertex order: each group of four rows transposes into 16 bytes of output per sprite.
+    static const size_t FloatsPerVertex = sizeof(VertexPositionColorTexture) / sizeof(float);
+    static const size_t RowCount = FloatsPerVertex * VerticesPerSprite;
+
+    static_assert(FloatsPerVertex == 9, "RenderFourSprites expects position, color and texture coordinate fields");
+
+    XMVECTOR rows[RowCount];
+
+    for (size_t i = 0; i < VerticesPerSprite; i++)
+    {
+        XMVECTOR* vertex = rows + i * FloatsPerVertex;
+
+        vertex[0] = positionX[i];
+        vertex[1] = positionY[i];
+        vertex[2] = depth;
+        vertex[3] = color.r[0];
+        vertex[4] = color.r[1];
+        vertex[5] = color.r[2];
+        vertex[6] = color.r[3];
+        vertex[7] = textureU[i];
+        vertex[8] = textureV[i];
+    }
+
+    float* output = reinterpret_cast<float*>(vertices);
+
+    for (size_t group = 0; group < RowCount; group += 4)
+    {
+        XMMATRIX block = XMMatrixTranspose(XMMATRIX(rows[group], rows[group + 1], rows[group + 2], rows[group + 3]));
+
+        for (size_t sprite = 0; sprite < 4; sprite++)
+        {
+            float* dest = output + sprite * RowCount + group;
+
+            if (streamStores)
+            {
+                StreamFloat4(dest, block.r[sprite]);
+            }
+            else
+            {
+                XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(dest), block.r[sprite]);
+            }
+        }
+    }
+}
+
+
+// Generates vertex data for drawing a single sprite.
+void XM_CALLCONV SpriteBatch::Impl::RenderSprite(_In_ SpriteInfo const* sprite, _Out_cap_c_(VerticesPerSprite) VertexPositionColorTexture* vertices, FXMVECTOR textureSize, FXMVECTOR inverseTextureSize)
+{
+    // Load sprite parameters into SIMD registers.
+    XMVECTOR source = XMLoadFloat4A(&sprite->source);
+    XMVECTOR destination = XMLoadFloat4A(&sprite->destination);
+    XMVECTOR color = XMLoadFloat4A(&sprite->color);
+    XMVECTOR originRotationDepth = XMLoadFloat4A(&sprite->originRotationDepth);
+
+    float rotation = sprite->originRotationDepth.z;
+    int flags = sprite->flags;
+
+    // Extract the source and destination sizes into separate vectors.
     XMVECTOR sourceSize = XMVectorSwizzle<2, 3, 2, 3>(source);
     XMVECTOR destinationSize = XMVectorSwizzle<2, 3, 2, 3>(destination);
 
@@ -869,6 +1444,114 @@ XMVECTOR SpriteBatch::Impl::GetTextureSize(_In_ ID3D11ShaderResourceView* textur
 }
 
 
+// Texture size cache constructor.
+SpriteBatch::Impl::TextureSizeCache::TextureSizeCache()
+  : hits(0),
+    misses(0)
+{
+    Clear();
+}
+
+
+// Looks up the size of a texture, querying the resource on a cache miss.
+XMVECTOR SpriteBatch::Impl::TextureSizeCache::GetSize(_In_ ID3D11ShaderResourceView* texture)
+{
+    size_t index = Hash(texture);
+
+    // Linear probing: stop at the matching entry, or at the first empty slot.
+    while (mEntries[index].texture)
+    {
+        if (mEntries[index].texture == texture)
+        {
+            hits++;
+            return XMLoadFloat2(&mEntries[index].size);
+        }
+
+        index = (index + 1) & (Capacity - 1);
+    }
+
+    misses++;
+
+    XMVECTOR size = GetTextureSize(texture);
+
+    // Rather than growing, start again when the table gets too full.
+    if (mCount >= MaxEntries)
+    {
+        Clear();
+
+        index = Hash(texture);
+    }
+
+    mEntries[index].texture = texture;
+    XMStoreFloat2(&mEntries[index].size, size);
+    mCount++;
+
+    return size;
+}
+
+
+// Forgets the cached size of a texture, eg. because it is about to be released.
+void SpriteBatch::Impl::TextureSizeCache::Remove(_In_ ID3D11ShaderResourceView* texture)
+{
+    size_t index = Hash(texture);
+
+    while (mEntries[index].texture != texture)
+    {
+        if (!mEntries[index].texture)
+            return;
+
+        index = (index + 1) & (Capacity - 1);
+    }
+
+    // Backward shift deletion: move later entries of the probe sequence into the hole, so lookups never need tombstones.
+    size_t hole = index;
+
+    for (;;)
+    {
+        index = (index + 1) & (Capacity - 1);
+
+        if (!mEntries[index].texture)
+            break;
+
+        size_t home = Hash(mEntries[index].texture);
+
+        // The entry can fill the hole unless its home slot lies cyclically between the hole and its current position.
+        if (((index - home) & (Capacity - 1)) >= ((index - hole) & (Capacity - 1)))
+        {
+            mEntries[hole] = mEntries[index];
+            hole = index;
+        }
+    }
+
+    mEntries[hole].texture = nullptr;
+    mCount--;
+}
+
+
+// Empties the cache.
+void SpriteBatch::Impl::TextureSizeCache::Clear()
+{
+    for (size_t i = 0; i < Capacity; i++)
+    {
+        mEntries[i].texture = nullptr;
+    }
+
+    mCount = 0;
+}
+
+
+// Helper hashes a view pointer to a table index.
+size_t SpriteBatch::Impl::TextureSizeCache::Hash(_In_ ID3D11ShaderResourceView* texture)
+{
+    static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+    // Fibonacci hashing spreads the aligned pointer values, whose low bits are always zero.
+    uint64_t value = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(texture)) * 0x9E3779B97F4A7C15ull;
+
+    return static_cast<size_t>(value >> 58);
+}
+
+
 // Generates a viewport transform matrix for rendering sprites using x-right y-down screen pixel coordinates.
 XMMATRIX SpriteBatch::Impl::GetViewportTransform(_In_ ID3D11DeviceContext* deviceContext, DXGI_MODE_ROTATION rotation )
 {
@@ -928,9 +1611,121 @@ XMMATRIX SpriteBatch::Impl::GetViewportTransform(_In_ ID3D11DeviceContext* devic
 }
 
 
+// SpriteLayer constructor.
+SpriteLayer::Impl::Impl(_In_ ID3D11Device* device, _In_ ID3D11ShaderResourceView* texture, size_t capacity)
+  : texture(texture),
+    capacity(capacity),
+    count(0)
+{
+    if (!texture)
+        throw std::exception("Texture cannot be null");
+
+    if (!capacity || capacity > MaxCapacity)
+        throw std::exception("Invalid SpriteLayer capacity");
+
+    XMStoreFloat2(&textureSize, SpriteBatch::Impl::GetTextureSize(texture));
+
+    sprites.reset(new SpriteInfo[capacity]);
+
+    // The vertices only change when sprites do, so they live in a default usage buffer updated with UpdateSubresource.
+    D3D11_BUFFER_DESC vertexBufferDesc = { 0 };
+
+    vertexBufferDesc.ByteWidth = static_cast<UINT>(sizeof(VertexPositionColorTexture) * capacity * SpriteBatch::Impl::VerticesPerSprite);
+    vertexBufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+    vertexBufferDesc.Usage = D3D11_USAGE_DEFAULT;
+
+    ThrowIfFailed(
+        device->CreateBuffer(&vertexBufferDesc, nullptr, &vertexBuffer)
+    );
+
+    SetDebugObjectName(vertexBuffer.Get(), "DirectXTK:SpriteLayer");
+}
+
+
+// Appends a sprite to the layer.
+size_t XM_CALLCONV SpriteLayer::Impl::Add(FXMVECTOR destination, _In_opt_ RECT const* sourceRectangle, FXMVECTOR color, FXMVECTOR originRotationDepth, int flags)
+{
+    if (count >= capacity)
+        throw std::exception("SpriteLayer is full");
+
+    count++;
+
+    Set(count - 1, destination, sourceRectangle, color, originRotationDepth, flags);
+
+    return count - 1;
+}
+
+
+// Replaces a sprite, marking it for upload on the next draw.
+void XM_CALLCONV SpriteLayer::Impl::Set(size_t index, FXMVECTOR destination, _In_opt_ RECT const* sourceRectangle, FXMVECTOR color, FXMVECTOR originRotationDepth, int flags)
+{
+    if (index >= count)
+        throw std::exception("Invalid SpriteLayer index");
+
+    SpriteBatch::Impl::StoreSpriteInfo(&sprites[index], texture.Get(), destination, sourceRectangle, color, originRotationDepth, flags);
+
+    dirtyRanges.Add(index, index + 1);
+}
+
+
+// Removes every sprite from the layer.
+void SpriteLayer::Impl::Clear()
+{
+    count = 0;
+
+    dirtyRanges.Clear();
+}
+
+
+// Regenerates and uploads the vertices of sprites that changed since the last draw.
+void SpriteLayer::Impl::Update(_In_ ID3D11DeviceContext* deviceContext)
+{
+    if (dirtyRanges.Empty())
+        return;
+
+    dirtyRanges.Truncate(count);
+    dirtyRanges.Coalesce(MaxCoalesceGap);
+
+    static const size_t VerticesPerSprite = SpriteBatch::Impl::VerticesPerSprite;
+    static const UINT BytesPerSprite = sizeof(VertexPositionColorTexture) * VerticesPerSprite;
+
+    XMVECTOR size = XMLoadFloat2(&textureSize);
+    XMVECTOR inverseSize = XMVectorReciprocal(size);
+
+    auto& ranges = dirtyRanges.Ranges();
+
+    for (auto range = ranges.begin(); range != ranges.end(); ++range)
+    {
+        size_t rangeCount = range->end - range->begin;
+
+        mSpritePointers.resize(rangeCount);
+        mVertices.resize(rangeCount * VerticesPerSprite);
+
+        for (size_t i = 0; i < rangeCount; i++)
+        {
+            mSpritePointers[i] = &sprites[range->begin + i];
+        }
+
+        // Normal stores, so the vertices are still in cache when UpdateSubresource copies them.
+        SpriteBatch::Impl::RenderSprites(mSpritePointers.data(), rangeCount, mVertices.data(), size, inverseSize, false);
+
+        D3D11_BOX box = { 0 };
+
+        box.left = static_cast<UINT>(range->begin) * BytesPerSprite;
+        box.right = static_cast<UINT>(range->end) * BytesPerSprite;
+        box.bottom = 1;
+        box.back = 1;
+
+        deviceContext->UpdateSubresource(vertexBuffer.Get(), 0, &box, mVertices.data(), 0, 0);
+    }
+
+    dirtyRanges.Clear();
+}
+
+
 // Public constructor.
-SpriteBatch::SpriteBatch(_In_ ID3D11DeviceContext* deviceContext)
-  : pImpl(new Impl(deviceContext))
+SpriteBatch::SpriteBatch(_In_ ID3D11DeviceContext* deviceContext, size_t maxBatchSize)
+  : pImpl(new Impl(deviceContext, maxBatchSize))
 {
 }
 
@@ -1046,6 +1841,71 @@ void XM_CALLCONV SpriteBatch::Draw(_In_ ID3D11ShaderResourceView* texture, RECT
 }
 
 
+void XM_CALLCONV SpriteBatch::Draw(TextureAtlas const& atlas, uint32_t handle, XMFLOAT2 const& position, FXMVECTOR color)
+{
+    Draw(atlas.GetTexture(handle), position, &atlas.GetSourceRectangle(handle), color);
+}
+
+
+void XM_CALLCONV SpriteBatch::Draw(TextureAtlas const& atlas, uint32_t handle, XMFLOAT2 const& position, FXMVECTOR color, float rotation, XMFLOAT2 const& origin, float scale, SpriteEffects effects, float layerDepth)
+{
+    Draw(atlas.GetTexture(handle), position, &atlas.GetSourceRectangle(handle), color, rotation, origin, scale, effects, layerDepth);
+}
+
+
+void XM_CALLCONV SpriteBatch::Draw(TextureAtlas const& atlas, uint32_t handle, RECT const& destinationRectangle, FXMVECTOR color, float rotation, XMFLOAT2 const& origin, SpriteEffects effects, float layerDepth)
+{
+    Draw(atlas.GetTexture(handle), destinationRectangle, &atlas.GetSourceRectangle(handle), color, rotation, origin, effects, layerDepth);
+}
+
+
+void XM_CALLCONV SpriteBatch::DrawRun(_In_ ID3D11ShaderResourceView* texture, _In_reads_(count) SpriteRunItem const* items, size_t count, FXMVECTOR position, FXMVECTOR color, float rotation, FXMVECTOR origin, GXMVECTOR scale, SpriteEffects effects, float layerDepth)
+{
+    XMVECTOR destination = XMVectorPermute<0, 1, 4, 5>(position, scale); // x, y, scale.x, scale.y
+
+    XMVECTOR rotationDepth = XMVectorMergeXY(XMVectorReplicate(rotation), XMVectorReplicate(layerDepth));
+
+    XMVECTOR originRotationDepth = XMVectorPermute<0, 1, 4, 5>(origin, rotationDepth);
+
+    pImpl->DrawRun(texture, items, count, destination, color, originRotationDepth, effects);
+}
+
+
+void SpriteBatch::Draw(SpriteLayer& layer)
+{
+    pImpl->DrawLayer(layer.pImpl.get());
+}
+
+
+void SpriteBatch::InvalidateTextureSize(_In_ ID3D11ShaderResourceView* texture)
+{
+    pImpl->mTextureSizeCache.Remove(texture);
+}
+
+
+SpriteBatch::TextureSizeCacheStats SpriteBatch::GetTextureSizeCacheStats() const
+{
+    TextureSizeCacheStats stats;
+
+    stats.hits = pImpl->mTextureSizeCache.hits;
+    stats.misses = pImpl->mTextureSizeCache.misses;
+
+    return stats;
+}
+
+
+SpriteBatch::RenderStats SpriteBatch::GetRenderStats() const
+{
+    return pImpl->mRenderStats;
+}
+
+
+void SpriteBatch::ResetRenderStats()
+{
+    memset(&pImpl->mRenderStats, 0, sizeof(pImpl->mRenderStats));
+}
+
+
 void SpriteBatch::SetRotation( DXGI_MODE_ROTATION mode )
 {
     pImpl->mRotation = mode;
@@ -1063,3 +1923,75 @@ void SpriteBatch::SetViewport( const D3D11_VIEWPORT& viewPort )
     pImpl->mSetViewport = true;
     pImpl->mViewPort = viewPort;
 }
+
+
+// Public SpriteLayer constructor.
+SpriteLayer::SpriteLayer(_In_ ID3D11Device* device, _In_ ID3D11ShaderResourceView* texture, size_t capacity)
+  : pImpl(new Impl(device, texture, capacity))
+{
+}
+
+
+// Move constructor.
+SpriteLayer::SpriteLayer(SpriteLayer&& moveFrom)
+  : pImpl(std::move(moveFrom.pImpl))
+{
+}
+
+
+// Move assignment.
+SpriteLayer& SpriteLayer::operator= (SpriteLayer&& moveFrom)
+{
+    pImpl = std::move(moveFrom.pImpl);
+    return *this;
+}
+
+
+// Public destructor.
+SpriteLayer::~SpriteLayer()
+{
+}
+
+
+size_t XM_CALLCONV SpriteLayer::Add(XMFLOAT2 const& position, _In_opt_ RECT const* sourceRectangle, FXMVECTOR color, float rotation, XMFLOAT2 const& origin, float scale, SpriteEffects effects, float layerDepth)
+{
+    XMVECTOR destination = XMVectorPermute<0, 1, 4, 4>(XMLoadFloat2(&position), XMLoadFloat(&scale)); // x, y, scale, scale
+
+    XMVECTOR originRotationDepth = XMVectorSet(origin.x, origin.y, rotation, layerDepth);
+
+    return pImpl->Add(destination, sourceRectangle, color, originRotationDepth, effects);
+}
+
+
+void XM_CALLCONV SpriteLayer::Set(size_t index, XMFLOAT2 const& position, _In_opt_ RECT const* sourceRectangle, FXMVECTOR color, float rotation, XMFLOAT2 const& origin, float scale, SpriteEffects effects, float layerDepth)
+{
+    XMVECTOR destination = XMVectorPermute<0, 1, 4, 4>(XMLoadFloat2(&position), XMLoadFloat(&scale)); // x, y, scale, scale
+
+    XMVECTOR originRotationDepth = XMVectorSet(origin.x, origin.y, rotation, layerDepth);
+
+    pImpl->Set(index, destination, sourceRectangle, color, originRotationDepth, effects);
+}
+
+
+void SpriteLayer::Clear()
+{
+    pImpl->Clear();
+}
+
+
+size_t SpriteLayer::GetCount() const
+{
+    return pImpl->count;
+}
+
+
+size_t SpriteLayer::GetCapacity() const
+{
+    return pImpl->capacity;
+}
+
+
+ID3D11ShaderResourceView* SpriteLayer::GetTexture() const
+{
+    return pImpl->texture.Get();
+}
@@ -15,6 +15,7 @@
 
 #define NOMINMAX
 #include <algorithm>
+#include <string>
 #include <vector>
 
 #include "SpriteFont.h"
@@ -29,22 +30,51 @@ using namespace Microsoft::WRL;
 class SpriteFont::Impl
 {
 public:
-    Impl(_In_ ID3D11Device* device, _In_ BinaryReader* reader);
+    Impl(_In_ ID3D11Device* device, std::unique_ptr<BinaryReader> reader);
     Impl(_In_ ID3D11ShaderResourceView* texture, _In_reads_(glyphCount) Glyph const* glyphs, _In_ size_t glyphCount, _In_ float lineSpacing);
 
-    Glyph const* FindGlyph(wchar_t character) const;
+    Glyph const* FindGlyph(uint32_t character) const;
+    Glyph const* LookupGlyph(uint32_t character) const;
+
+    void BuildGlyphTable();
 
     void SetDefaultCharacter(wchar_t character);
 
     template<typename TAction>
     void ForEachGlyph(_In_z_ wchar_t const* text, TAction action);
 
+    template<typename TAction>
+    void ForEachGlyph(_In_z_ char const* utf8Text, TAction action);
+
+    template<typename TNextCharacter, typename TAction>
+    void LayoutGlyphs(TNextCharacter nextCharacter, TAction action);
+
+    TextLine WrapLine(_In_z_ wchar_t const* text, size_t begin, float maxWidth, _Out_ size_t* nextLine);
+
 
     // Fields.
     ComPtr<ID3D11ShaderResourceView> texture;
-    std::vector<Glyph> glyphs;
+    Glyph const* glyphs;
+    size_t glyphCount;
     Glyph const* defaultGlyph;
     float lineSpacing;
+
+    // Bumped whenever a setting that affects layout changes, so TextLayout knows to redo its work.
+    uint32_t layoutGeneration;
+
+    // Glyphs always point into this copy, so nothing else needs to outlive the constructor. For fonts loaded
+    // from a file, that means the file is closed again (and unlocked) as soon as loading finishes.
+    std::vector<Glyph> ownedGlyphs;
+
+
+    // Direct lookup table covering the whole BMP, split into 256 pages of 256 characters. Pages with
+    // no glyphs share a single empty block, so typical fonts only pay for a few pages. Page 0 covers
+    // ASCII and Latin-1, so the common case is a dense array lookup.
+    static const size_t GlyphsPerPage = 256;
+    static const size_t PageCount = 65536 / GlyphsPerPage;
+
+    std::vector<Glyph const*> glyphTable;
+    uint32_t glyphPages[PageCount];
 };
 
 
@@ -54,28 +84,136 @@ const XMFLOAT2 SpriteFont::Float2Zero(0, 0);
 static const char spriteFontMagic[] = "DXTKfont";
 
 
-// Comparison operators make our sorted glyph vector work with std::binary_search and lower_bound.
-namespace DirectX
+namespace
 {
-    static inline bool operator< (SpriteFont::Glyph const& left, SpriteFont::Glyph const& right)
+    // Lookup table indicates which way to move along each axis per SpriteEffects enum value.
+    const XMVECTORF32 axisDirectionTable[4] =
     {
-        return left.Character < right.Character;
+        { -1, -1 },
+        {  1, -1 },
+        { -1,  1 },
+        {  1,  1 },
+    };
+
+    // Lookup table indicates which axes are mirrored for each SpriteEffects enum value.
+    const XMVECTORF32 axisIsMirroredTable[4] =
+    {
+        { 0, 0 },
+        { 1, 0 },
+        { 0, 1 },
+        { 1, 1 },
+    };
+
+
+    // Computes (a, a+b, a+b+c, a+b+c+d) with two shift and add steps.
+    inline XMVECTOR XM_CALLCONV PrefixSum(FXMVECTOR value)
+    {
+        XMVECTOR sum = value + XMVectorPermute<4, 0, 1, 2>(value, g_XMZero);
+
+        return sum + XMVectorPermute<4, 5, 0, 1>(sum, g_XMZero);
     }
 
-    static inline bool operator< (wchar_t left, SpriteFont::Glyph const& right)
+
+    inline float XM_CALLCONV HorizontalMax(FXMVECTOR value)
     {
-        return left < right.Character;
+        XMVECTOR result = XMVectorMax(value, XMVectorSwizzle<2, 3, 0, 1>(value));
+
+        result = XMVectorMax(result, XMVectorSwizzle<1, 0, 3, 2>(result));
+
+        return XMVectorGetX(result);
     }
 
-    static inline bool operator< (SpriteFont::Glyph const& left, wchar_t right)
+
+    // True for characters the word wrapping fast path leaves to the scalar code: terminators, line breaks and whitespace.
+    inline bool IsSpecialCharacter(wchar_t character)
     {
-        return left.Character < right;
+        return character <= L' ' || (character >= 0x80 && iswspace(character));
+    }
+
+
+    // Decodes one UTF-8 character, advancing the text pointer. Returns 0 at the end of the string,
+    // and U+FFFD for malformed sequences, so bad input is drawn with the default glyph.
+    inline uint32_t DecodeUtf8(_Inout_ char const*& text)
+    {
+        static const uint32_t ReplacementCharacter = 0xFFFD;
+
+        auto bytes = reinterpret_cast<uint8_t const*>(text);
+
+        uint32_t lead = bytes[0];
+
+        if (lead < 0x80)
+        {
+            if (lead)
+                text++;
+
+            return lead;
+        }
+
+        size_t length;
+        uint32_t character;
+        uint32_t minimum;
+
+        if ((lead & 0xE0) == 0xC0)
+        {
+            length = 2;
+            character = lead & 0x1F;
+            minimum = 0x80;
+        }
+        else if ((lead & 0xF0) == 0xE0)
+        {
+            length = 3;
+            character = lead & 0x0F;
+            minimum = 0x800;
+        }
+        else if ((lead & 0xF8) == 0xF0)
+        {
+            length = 4;
+            character = lead & 0x07;
+            minimum = 0x10000;
+        }
+        else
+        {
+            // Stray continuation byte or invalid lead byte.
+            text++;
+            return ReplacementCharacter;
+        }
+
+        for (size_t i = 1; i < length; i++)
+        {
+            if ((bytes[i] & 0xC0) != 0x80)
+            {
+                // Truncated sequence: resume at the offending byte, which may be a terminator or a new lead byte.
+                text += i;
+                return ReplacementCharacter;
+            }
+
+            character = (character << 6) | (bytes[i] & 0x3F);
+        }
+
+        text += length;
+
+        // Reject overlong encodings, surrogates and values past the end of Unicode.
+        if (character < minimum || character > 0x10FFFF || (character >= 0xD800 && character <= 0xDFFF))
+            return ReplacementCharacter;
+
+        return character;
+    }
+}
+
+
+// Comparison operator lets us validate that user specified glyphs are sorted.
+namespace DirectX
+{
+    static inline bool operator< (SpriteFont::Glyph const& left, SpriteFont::Glyph const& right)
+    {
+        return left.Character < right.Character;
     }
 }
 
 
 // Reads a SpriteFont from the binary format created by the MakeSpriteFont utility.
-SpriteFont::Impl::Impl(_In_ ID3D11Device* device, _In_ BinaryReader* reader)
+SpriteFont::Impl::Impl(_In_ ID3D11Device* device, std::unique_ptr<BinaryReader> reader)
+  : layoutGeneration(0)
 {
     // Validate the header.
     for (char const* magic = spriteFontMagic; *magic; magic++)
@@ -88,10 +226,14 @@ SpriteFont::Impl::Impl(_In_ ID3D11Device* device, _In_ BinaryReader* reader)
     }
 
     // Read the glyph data.
-    auto glyphCount = reader->Read<uint32_t>();
+    glyphCount = reader->Read<uint32_t>();
+
     auto glyphData = reader->ReadArray<Glyph>(glyphCount);
 
-    glyphs.assign(glyphData, glyphData + glyphCount);
+    ownedGlyphs.assign(glyphData, glyphData + glyphCount);
+    glyphs = ownedGlyphs.data();
+
+    BuildGlyphTable();
 
     // Read font properties.
     lineSpacing = reader->Read<float>();
@@ -106,7 +248,8 @@ SpriteFont::Impl::Impl(_In_ ID3D11Device* device, _In_ BinaryReader* reader)
     auto textureRows = reader->Read<uint32_t>();
     auto textureData = reader->ReadArray<uint8_t>(textureStride * textureRows);
 
-    // Create the D3D texture.
+    // Create the D3D texture, straight from the reader's memory. The reader, and with it any mapping of
+    // the file, is released when this constructor returns.
     CD3D11_TEXTURE2D_DESC textureDesc(textureFormat, textureWidth, textureHeight, 1, 1, D3D11_BIND_SHADER_RESOURCE, D3D11_USAGE_IMMUTABLE);
     CD3D11_SHADER_RESOURCE_VIEW_DESC viewDesc(D3D11_SRV_DIMENSION_TEXTURE2D, textureFormat);
     D3D11_SUBRESOURCE_DATA initData = { textureData, textureStride };
@@ -128,25 +271,84 @@ SpriteFont::Impl::Impl(_In_ ID3D11Device* device, _In_ BinaryReader* reader)
 // Constructs a SpriteFont from arbitrary user specified glyph data.
 SpriteFont::Impl::Impl(_In_ ID3D11ShaderResourceView* texture, _In_reads_(glyphCount) Glyph const* glyphs, _In_ size_t glyphCount, _In_ float lineSpacing)
   : texture(texture),
-    glyphs(glyphs, glyphs + glyphCount),
+    glyphs(nullptr),
+    glyphCount(glyphCount),
+    defaultGlyph(nullptr),
     lineSpacing(lineSpacing),
-    defaultGlyph(nullptr)
+    layoutGeneration(0),
+    ownedGlyphs(glyphs, glyphs + glyphCount)
 {
     if (!std::is_sorted(glyphs, glyphs + glyphCount))
     {
         throw std::exception("Glyphs must be in ascending codepoint order");
     }
+
+    this->glyphs = ownedGlyphs.data();
+
+    BuildGlyphTable();
+}
+
+
+// Builds the direct glyph lookup table.
+void SpriteFont::Impl::BuildGlyphTable()
+{
+    static_assert(sizeof(wchar_t) == 2, "The glyph table assumes wchar_t holds UTF-16 code units");
+
+    // Block 0 is the shared empty page, block 1 is always ASCII and Latin-1.
+    glyphTable.assign(GlyphsPerPage * 2, nullptr);
+
+    for (size_t page = 0; page < PageCount; page++)
+    {
+        glyphPages[page] = 0;
+    }
+
+    glyphPages[0] = GlyphsPerPage;
+
+    for (auto glyph = glyphs; glyph != glyphs + glyphCount; ++glyph)
+    {
+        // Characters outside the BMP cannot be passed in as a single wchar_t.
+        if (glyph->Character > 0xFFFF)
+            break;
+
+        size_t page = glyph->Character / GlyphsPerPage;
+
+        if (!glyphPages[page])
+        {
+            glyphPages[page] = static_cast<uint32_t>(glyphTable.size());
+
+            glyphTable.resize(glyphTable.size() + GlyphsPerPage, nullptr);
+        }
+
+        Glyph const*& entry = glyphTable[glyphPages[page] + glyph->Character % GlyphsPerPage];
+
+        // Keep the first of any duplicates, matching the old binary search.
+        if (!entry)
+        {
+            entry = glyph;
+        }
+    }
+}
+
+
+// Looks up the requested glyph, returning null if it is not in the font.
+inline SpriteFont::Glyph const* SpriteFont::Impl::LookupGlyph(uint32_t character) const
+{
+    // Only UTF-8 input can reach past the BMP.
+    if (character > 0xFFFF)
+        return nullptr;
+
+    return glyphTable[glyphPages[character / GlyphsPerPage] + character % GlyphsPerPage];
 }
 
 
 // Looks up the requested glyph, falling back to the default character if it is not in the font.
-SpriteFont::Glyph const* SpriteFont::Impl::FindGlyph(wchar_t character) const
+SpriteFont::Glyph const* SpriteFont::Impl::FindGlyph(uint32_t character) const
 {
-    auto glyph = std::lower_bound(glyphs.begin(), glyphs.end(), character);
+    auto glyph = LookupGlyph(character);
 
-    if (glyph != glyphs.end() && glyph->Character == character)
+    if (glyph)
     {
-        return &*glyph;
+        return glyph;
     }
 
     if (defaultGlyph)
@@ -154,7 +356,7 @@ SpriteFont::Glyph const* SpriteFont::Impl::FindGlyph(wchar_t character) const
         return defaultGlyph;
     }
 
-    DebugTrace( "SpriteFont encountered a character not in the font (%u, %C), and no default glyph was provided\n", character, character );
+    DebugTrace( "SpriteFont encountered a character not in the font (%u, %C), and no default glyph was provided\n", character, (wchar_t)character );
     throw std::exception("Character not in font");
 }
 
@@ -171,17 +373,37 @@ void SpriteFont::Impl::SetDefaultCharacter(wchar_t character)
 }
 
 
-// The core glyph layout algorithm, shared between DrawString and MeasureString.
+// Lays out a wide string.
 template<typename TAction>
 void SpriteFont::Impl::ForEachGlyph(_In_z_ wchar_t const* text, TAction action)
+{
+    LayoutGlyphs([&]() -> uint32_t
+    {
+        return *text ? *text++ : 0;
+    }, action);
+}
+
+
+// Lays out a UTF-8 string, decoding as we go rather than converting to a wide string first.
+template<typename TAction>
+void SpriteFont::Impl::ForEachGlyph(_In_z_ char const* utf8Text, TAction action)
+{
+    LayoutGlyphs([&]() -> uint32_t
+    {
+        return DecodeUtf8(utf8Text);
+    }, action);
+}
+
+
+// The core glyph layout algorithm, shared between DrawString, MeasureString and TextLayout.
+template<typename TNextCharacter, typename TAction>
+void SpriteFont::Impl::LayoutGlyphs(TNextCharacter nextCharacter, TAction action)
 {
     float x = 0;
     float y = 0;
 
-    for (; *text; text++)
+    for (uint32_t character = nextCharacter(); character; character = nextCharacter())
     {
-        wchar_t character = *text;
-
         switch (character)
         {
             case '\r':
@@ -203,7 +425,9 @@ void SpriteFont::Impl::ForEachGlyph(_In_z_ wchar_t const* text, TAction action)
                 if (x < 0)
                     x = 0;
 
-                if ( !iswspace(character)
+                bool isSpace = (character <= 0xFFFF) && iswspace(static_cast<wchar_t>(character));
+
+                if ( !isSpace
                      || ( ( glyph->Subrect.right - glyph->Subrect.left ) > 1 )
                      || ( ( glyph->Subrect.bottom - glyph->Subrect.top ) > 1 ) )
                 {
@@ -217,21 +441,156 @@ void SpriteFont::Impl::ForEachGlyph(_In_z_ wchar_t const* text, TAction action)
 }
 
 
+// Finds the extent of a single line of word wrapped text, starting at the specified character.
+// Matches the positioning logic of LayoutGlyphs, so the wrapped lines can be drawn with it.
+SpriteFont::TextLine SpriteFont::Impl::WrapLine(_In_z_ wchar_t const* text, size_t begin, float maxWidth, _Out_ size_t* nextLine)
+{
+    float x = 0;
+    float inkRight = 0;
+    bool hasInk = false;
+
+    // Where to end the line if the next word doesn't fit.
+    size_t breakEnd = 0;
+    float breakWidth = 0;
+    bool canBreak = false;
+    bool inWhitespace = false;
+
+    XMVECTOR limit = XMVectorReplicate(maxWidth);
+
+    size_t i = begin;
+
+    for (;;)
+    {
+        // Fast path measures four ordinary characters at a time, using a vectorized prefix sum of their advances.
+        // If any glyph would overflow the line or hit the clamp at x = 0, we fall through to the scalar code.
+        // The prefix sum adds in a different order, so with fractional glyph metrics the line width can differ
+        // from LayoutGlyphs in the last bit. Whole number metrics always add up exactly.
+        if (!IsSpecialCharacter(text[i]) &&
+            !IsSpecialCharacter(text[i + 1]) &&
+            !IsSpecialCharacter(text[i + 2]) &&
+            !IsSpecialCharacter(text[i + 3]))
+        {
+            Glyph const* glyph0 = FindGlyph(text[i]);
+            Glyph const* glyph1 = FindGlyph(text[i + 1]);
+            Glyph const* glyph2 = FindGlyph(text[i + 2]);
+            Glyph const* glyph3 = FindGlyph(text[i + 3]);
+
+            XMVECTOR offsets = XMVectorSet(glyph0->XOffset, glyph1->XOffset, glyph2->XOffset, glyph3->XOffset);
+
+            XMVECTOR widths = XMVectorSet((float)(glyph0->Subrect.right - glyph0->Subrect.left),
+                                          (float)(glyph1->Subrect.right - glyph1->Subrect.left),
+                                          (float)(glyph2->Subrect.right - glyph2->Subrect.left),
+                                          (float)(glyph3->Subrect.right - glyph3->Subrect.left));
+
+            XMVECTOR advances = offsets + widths + XMVectorSet(glyph0->XAdvance, glyph1->XAdvance, glyph2->XAdvance, glyph3->XAdvance);
+
+            XMVECTOR penAfter = PrefixSum(advances) + XMVectorReplicate(x);
+            XMVECTOR glyphX = penAfter - advances + offsets;
+            XMVECTOR rights = glyphX + widths;
+
+            if (!XMComparisonAnyTrue(XMVector4GreaterR(g_XMZero, glyphX)) &&
+                !XMComparisonAnyTrue(XMVector4GreaterR(rights, limit)))
+            {
+                x = XMVectorGetW(penAfter);
+                inkRight = std::max(inkRight, HorizontalMax(rights));
+                hasInk = true;
+                inWhitespace = false;
+                i += 4;
+                continue;
+            }
+        }
+
+        wchar_t character = text[i];
+
+        if (!character || character == '\n')
+        {
+            *nextLine = character ? i + 1 : i;
+
+            TextLine line = { begin, i, inkRight };
+            return line;
+        }
+
+        if (character == '\r')
+        {
+            i++;
+            continue;
+        }
+
+        auto glyph = FindGlyph(character);
+
+        float glyphX = std::max(x + glyph->XOffset, 0.f);
+        float width = (float)(glyph->Subrect.right - glyph->Subrect.left);
+
+        if (iswspace(character))
+        {
+            // The start of each run of whitespace is a potential break point.
+            if (hasInk && !inWhitespace)
+            {
+                breakEnd = i;
+                breakWidth = inkRight;
+                canBreak = true;
+            }
+
+            inWhitespace = true;
+        }
+        else
+        {
+            float right = glyphX + width;
+
+            // Always keep at least one glyph per line, so a single overlong word still makes progress.
+            if (right > maxWidth && hasInk)
+            {
+                if (canBreak)
+                {
+                    // Wrap at the last whitespace, which is dropped.
+                    size_t next = breakEnd;
+
+                    while (iswspace(text[next]))
+                    {
+                        next++;
+                    }
+
+                    *nextLine = next;
+
+                    TextLine line = { begin, breakEnd, breakWidth };
+                    return line;
+                }
+                else
+                {
+                    // No whitespace on this line, so break the word.
+                    *nextLine = i;
+
+                    TextLine line = { begin, i, inkRight };
+                    return line;
+                }
+            }
+
+            inkRight = std::max(inkRight, right);
+            hasInk = true;
+            inWhitespace = false;
+        }
+
+        x = glyphX + width + glyph->XAdvance;
+        i++;
+    }
+}
+
+
 // Construct from a binary file created by the MakeSpriteFont utility.
 SpriteFont::SpriteFont(_In_ ID3D11Device* device, _In_z_ wchar_t const* fileName)
 {
-    BinaryReader reader(fileName);
+    std::unique_ptr<BinaryReader> reader(new BinaryReader(fileName));
 
-    pImpl.reset(new Impl(device, &reader));
+    pImpl.reset(new Impl(device, std::move(reader)));
 }
 
 
 // Construct from a binary blob created by the MakeSpriteFont utility and already loaded into memory.
 SpriteFont::SpriteFont(_In_ ID3D11Device* device, _In_reads_bytes_(dataSize) uint8_t const* dataBlob, _In_ size_t dataSize)
 {
-    BinaryReader reader(dataBlob, dataSize);
+    std::unique_ptr<BinaryReader> reader(new BinaryReader(dataBlob, dataSize));
 
-    pImpl.reset(new Impl(device, &reader));
+    pImpl.reset(new Impl(device, std::move(reader)));
 }
 
 
@@ -284,25 +643,7 @@ void XM_CALLCONV SpriteFont::DrawString(_In_ SpriteBatch* spriteBatch, _In_z_ wc
 void XM_CALLCONV SpriteFont::DrawString(_In_ SpriteBatch* spriteBatch, _In_z_ wchar_t const* text, FXMVECTOR position, FXMVECTOR color, float rotation, FXMVECTOR origin, GXMVECTOR scale, SpriteEffects effects, float layerDepth)
 {
     static_assert(SpriteEffects_FlipHorizontally == 1 &&
-                  SpriteEffects_FlipVertically == 2, "If you change these enum values, the following tables must be updated to match");
-
-    // Lookup table indicates which way to move along each axis per SpriteEffects enum value.
-    static XMVECTORF32 axisDirectionTable[4] =
-    {
-        { -1, -1 },
-        {  1, -1 },
-        { -1,  1 },
-        {  1,  1 },
-    };
-
-    // Lookup table indicates which axes are mirrored for each SpriteEffects enum value.
-    static XMVECTORF32 axisIsMirroredTable[4] =
-    {
-        { 0, 0 },
-        { 1, 0 },
-        { 0, 1 },
-        { 1, 1 },
-    };
+                  SpriteEffects_FlipVertically == 2, "If you change these enum values, the axis tables must be updated to match");
 
     XMVECTOR baseOffset = origin;
 
@@ -351,6 +692,85 @@ XMVECTOR XM_CALLCONV SpriteFont::MeasureString(_In_z_ wchar_t const* text) const
 }
 
 
+size_t SpriteFont::WrapString(_In_z_ wchar_t const* text, float maxWidth, _Out_writes_opt_(maxLines) TextLine* lines, size_t maxLines) const
+{
+    size_t lineCount = 0;
+
+    for (size_t position = 0; text[position]; lineCount++)
+    {
+        size_t nextLine;
+
+        TextLine line = pImpl->WrapLine(text, position, maxWidth, &nextLine);
+
+        if (lines && lineCount < maxLines)
+        {
+            lines[lineCount] = line;
+        }
+
+        position = nextLine;
+    }
+
+    return lineCount;
+}
+
+
+void XM_CALLCONV SpriteFont::DrawWrappedString(_In_ SpriteBatch* spriteBatch, _In_z_ wchar_t const* text, FXMVECTOR position, float maxWidth, TextAlignment alignment, FXMVECTOR color, float layerDepth)
+{
+    static const float alignmentTable[3] = { 0, 0.5f, 1 };
+
+    if (alignment < TextAlignment_Left || alignment > TextAlignment_Right)
+        throw std::exception("Invalid text alignment");
+
+    float lineY = 0;
+
+    // Lines are drawn as they are found, so no storage is needed for them.
+    for (size_t lineStart = 0; text[lineStart]; )
+    {
+        size_t nextLine;
+
+        TextLine line = pImpl->WrapLine(text, lineStart, maxWidth, &nextLine);
+
+        XMVECTOR lineOffset = XMVectorSet((maxWidth - line.Width) * alignmentTable[alignment], lineY, 0, 0);
+
+        wchar_t const* current = text + line.Begin;
+        wchar_t const* end = text + line.End;
+
+        pImpl->LayoutGlyphs([&]() -> uint32_t
+        {
+            return (current < end) ? *current++ : 0;
+        },
+        [&](Glyph const* glyph, float x, float y)
+        {
+            XMVECTOR offset = lineOffset + XMVectorSet(x, y + glyph->YOffset, 0, 0);
+
+            spriteBatch->Draw(pImpl->texture.Get(), position + offset, &glyph->Subrect, color, 0, g_XMZero, 1, SpriteEffects_None, layerDepth);
+        });
+
+        lineY += pImpl->lineSpacing;
+        lineStart = nextLine;
+    }
+}
+
+
+XMVECTOR XM_CALLCONV SpriteFont::MeasureWrappedString(_In_z_ wchar_t const* text, float maxWidth) const
+{
+    float width = 0;
+    size_t lineCount = 0;
+
+    for (size_t position = 0; text[position]; lineCount++)
+    {
+        size_t nextLine;
+
+        TextLine line = pImpl->WrapLine(text, position, maxWidth, &nextLine);
+
+        width = std::max(width, line.Width);
+        position = nextLine;
+    }
+
+    return XMVectorSet(width, (float)lineCount * pImpl->lineSpacing, 0, 0);
+}
+
+
 float SpriteFont::GetLineSpacing() const
 {
     return pImpl->lineSpacing;
@@ -360,6 +780,7 @@ float SpriteFont::GetLineSpacing() const
 void SpriteFont::SetLineSpacing(float spacing)
 {
     pImpl->lineSpacing = spacing;
+    pImpl->layoutGeneration++;
 }
 
 
@@ -372,10 +793,217 @@ wchar_t SpriteFont::GetDefaultCharacter() const
 void SpriteFont::SetDefaultCharacter(wchar_t character)
 {
     pImpl->SetDefaultCharacter(character);
+    pImpl->layoutGeneration++;
 }
 
 
 bool SpriteFont::ContainsCharacter(wchar_t character) const
 {
-    return std::binary_search(pImpl->glyphs.begin(), pImpl->glyphs.end(), character);
+    return pImpl->LookupGlyph(character) != nullptr;
+}
+
+
+// Internal TextLayout implementation class.
+class TextLayout::Impl
+{
+public:
+    Impl();
+
+    template<typename TChar>
+    bool SetText(_In_ SpriteFont const* newFont, _In_z_ TChar const* text, std::basic_string<TChar>& storedText);
+
+    void XM_CALLCONV Draw(_In_ SpriteBatch* spriteBatch, FXMVECTOR position, FXMVECTOR color, float rotation, FXMVECTOR origin, GXMVECTOR scale, SpriteEffects effects, float layerDepth);
+
+
+    // A glyph placed by the layout, in unscaled font units.
+    struct PlacedGlyph
+    {
+        XMFLOAT2 position;
+        XMFLOAT2 size;
+        RECT subrect;
+    };
+
+    SpriteFont const* font;
+    uint32_t fontGeneration;
+
+    // Only one of these holds the current text, depending on which SetText overload was used last,
+    // as recorded by isUtf8. The other is left empty.
+    std::wstring wideText;
+    std::string utf8Text;
+    bool isUtf8;
+
+    std::vector<PlacedGlyph> glyphs;
+    XMFLOAT2 size;
+
+    // Glyph origins for the SpriteEffects value used most recently, rebuilt only when that changes.
+    std::vector<SpriteBatch::SpriteRunItem> items;
+    int itemEffects;
+
+private:
+    void BuildItems(SpriteEffects effects);
+};
+
+
+TextLayout::Impl::Impl()
+  : font(nullptr),
+    fontGeneration(0),
+    isUtf8(false),
+    size(0, 0),
+    itemEffects(-1)
+{
+}
+
+
+// Lays out the text if anything it depends on has changed.
+template<typename TChar>
+bool TextLayout::Impl::SetText(_In_ SpriteFont const* newFont, _In_z_ TChar const* text, std::basic_string<TChar>& storedText)
+{
+    if (!newFont)
+        throw std::exception("TextLayout needs a font");
+
+    auto fontImpl = newFont->pImpl.get();
+
+    // Switching overloads always lays out again: the string for this overload was cleared, so it would
+    // wrongly match an empty text.
+    bool utf8 = (sizeof(TChar) == sizeof(char));
+
+    if (newFont == font && fontImpl->layoutGeneration == fontGeneration && utf8 == isUtf8 && storedText == text)
+        return false;
+
+    // Lay out into locals first, so if a character has no glyph the previous layout is left intact.
+    std::vector<PlacedGlyph> newGlyphs;
+
+    XMVECTOR result = XMVectorZero();
+
+    fontImpl->ForEachGlyph(text, [&](SpriteFont::Glyph const* glyph, float x, float y)
+    {
+        float w = (float)(glyph->Subrect.right - glyph->Subrect.left);
+        float h = (float)(glyph->Subrect.bottom - glyph->Subrect.top);
+
+        PlacedGlyph placed;
+
+        placed.position = XMFLOAT2(x, y + glyph->YOffset);
+        placed.size = XMFLOAT2(w, h);
+        placed.subrect = glyph->Subrect;
+
+        newGlyphs.push_back(placed);
+
+        // Measure exactly as MeasureString does.
+        h = std::max(h + glyph->YOffset, fontImpl->lineSpacing);
+
+        result = XMVectorMax(result, XMVectorSet(x + w, y + h, 0, 0));
+    });
+
+    font = newFont;
+    fontGeneration = fontImpl->layoutGeneration;
+
+    wideText.clear();
+    utf8Text.clear();
+    storedText = text;
+    isUtf8 = utf8;
+
+    glyphs.swap(newGlyphs);
+    itemEffects = -1;
+
+    XMStoreFloat2(&size, result);
+
+    return true;
+}
+
+
+// Converts the placed glyphs into sprite origins, following the same math as SpriteFont::DrawString.
+void TextLayout::Impl::BuildItems(SpriteEffects effects)
+{
+    XMVECTOR axisDirection = axisDirectionTable[effects & 3];
+    XMVECTOR axisIsMirrored = axisIsMirroredTable[effects & 3];
+    XMVECTOR measure = XMLoadFloat2(&size);
+
+    items.resize(glyphs.size());
+
+    for (size_t i = 0; i < glyphs.size(); i++)
+    {
+        auto& glyph = glyphs[i];
+
+        XMVECTOR offset = XMLoadFloat2(&glyph.position) * axisDirection;
+
+        // For mirrored text, glyphs are placed by their bottom and/or right edges, relative to the far side of the string.
+        offset = XMVectorMultiplyAdd(XMLoadFloat2(&glyph.size) - measure, axisIsMirrored, offset);
+
+        XMStoreFloat2(&items[i].origin, offset);
+        items[i].sourceRectangle = glyph.subrect;
+    }
+
+    itemEffects = effects;
+}
+
+
+void XM_CALLCONV TextLayout::Impl::Draw(_In_ SpriteBatch* spriteBatch, FXMVECTOR position, FXMVECTOR color, float rotation, FXMVECTOR origin, GXMVECTOR scale, SpriteEffects effects, float layerDepth)
+{
+    if (glyphs.empty())
+        return;
+
+    if (effects != itemEffects)
+    {
+        BuildItems(effects);
+    }
+
+    spriteBatch->DrawRun(font->pImpl->texture.Get(), items.data(), items.size(), position, color, rotation, origin, scale, effects, layerDepth);
+}
+
+
+// Public constructors.
+TextLayout::TextLayout()
+  : pImpl(new Impl())
+{
+}
+
+
+// Move constructor.
+TextLayout::TextLayout(TextLayout&& moveFrom)
+  : pImpl(std::move(moveFrom.pImpl))
+{
+}
+
+
+// Move assignment.
+TextLayout& TextLayout::operator= (TextLayout&& moveFrom)
+{
+    pImpl = std::move(moveFrom.pImpl);
+    return *this;
+}
+
+
+// Public destructor.
+TextLayout::~TextLayout()
+{
+}
+
+
+bool TextLayout::SetText(_In_ SpriteFont const* font, _In_z_ wchar_t const* text)
+{
+    return pImpl->SetText(font, text, pImpl->wideText);
+}
+
+
+bool TextLayout::SetText(_In_ SpriteFont const* font, _In_z_ char const* utf8Text)
+{
+    return pImpl->SetText(font, utf8Text, pImpl->utf8Text);
+}
+
+
+void XM_CALLCONV TextLayout::Draw(_In_ SpriteBatch* spriteBatch, FXMVECTOR position, FXMVECTOR color, float rotation, FXMVECTOR origin, GXMVECTOR scale, SpriteEffects effects, float layerDepth)
+{
+    pImpl->Draw(spriteBatch, position, color, rotation, origin, scale, effects, layerDepth);
+}
+
+
+XMVECTOR XM_CALLCONV TextLayout::GetSize() const
+{
+    return XMLoadFloat2(&pImpl->size);
+}
+
+
+size_t TextLayout::GetGlyphCount() const
+{
+    return pImpl->glyphs.size();
 }
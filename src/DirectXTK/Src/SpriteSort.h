@@ -0,0 +1,239 @@
+//--------------------------------------------------------------------------------------
+// File: SpriteSort.h
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// http://go.microsoft.com/fwlink/?LinkId=248929
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <utility>
+#include <vector>
+
+
+namespace DirectX
+{
+    // Helper converts a float to an unsigned integer with the same ordering.
+    inline uint32_t SortableFloatBits(float value)
+    {
+        // Fold -0 into +0, so both compare equal as they did with float comparisons.
+        if (value == 0)
+            value = 0;
+
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+
+        return (bits & 0x80000000) ? ~bits : (bits | 0x80000000);
+    }
+
+
+    // Stable LSD radix sort of (key, index) entries, eight bits per pass. Passes where every
+    // key has the same digit are skipped, so small key ranges only cost one or two passes.
+    template<typename T>
+    T* RadixSortByKey(_Inout_updates_(count) T* entries, _Out_writes_(count) T* scratch, size_t count)
+    {
+        static const size_t SmallSortSize = 32;
+
+        if (count <= SmallSortSize)
+        {
+            // Insertion sort is cheaper than building histograms for tiny batches.
+            for (size_t i = 1; i < count; i++)
+            {
+                T entry = entries[i];
+                size_t j = i;
+
+                while (j > 0 && entries[j - 1].key > entry.key)
+                {
+                    entries[j] = entries[j - 1];
+                    j--;
+                }
+
+                entries[j] = entry;
+            }
+
+            return entries;
+        }
+
+        // Build the histograms for all eight digits in a single pass over the keys.
+        uint32_t histograms[8][256] = {};
+
+        for (size_t i = 0; i < count; i++)
+        {
+            uint64_t key = entries[i].key;
+
+            for (int digit = 0; digit < 8; digit++)
+            {
+                histograms[digit][(key >> (digit * 8)) & 0xFF]++;
+            }
+        }
+
+        T* source = entries;
+        T* dest = scratch;
+
+        for (int digit = 0; digit < 8; digit++)
+        {
+            uint32_t* histogram = histograms[digit];
+
+            // Skip passes that would not reorder anything.
+            if (histogram[(source[0].key >> (digit * 8)) & 0xFF] == count)
+                continue;
+
+            // Convert counts to starting offsets.
+            uint32_t offset = 0;
+
+            for (int bucket = 0; bucket < 256; bucket++)
+            {
+                uint32_t bucketCount = histogram[bucket];
+                histogram[bucket] = offset;
+                offset += bucketCount;
+            }
+
+            for (size_t i = 0; i < count; i++)
+            {
+                dest[histogram[(source[i].key >> (digit * 8)) & 0xFF]++] = source[i];
+            }
+
+            std::swap(source, dest);
+        }
+
+        return source;
+    }
+
+
+    // Hands out small dense IDs to pointers, in order of first appearance, so they can be packed into
+    // radix sort keys. Open-addressed with linear probing; the storage is kept across Reset calls, and
+    // entries from earlier generations count as empty, so resetting costs nothing per flush.
+    class DenseIdTable
+    {
+    public:
+        DenseIdTable()
+          : mCount(0),
+            mGeneration(1),
+            mShift(64 - InitialCapacityLog2)
+        {
+            Entry empty = { nullptr, 0, 0 };
+
+            mEntries.assign(size_t(1) << InitialCapacityLog2, empty);
+        }
+
+
+        // Returns the ID of a pointer, assigning the next one if it has not been seen since the last Reset.
+        uint32_t GetId(_In_ void const* pointer)
+        {
+            size_t mask = mEntries.size() - 1;
+            size_t index = Hash(pointer);
+
+            while (mEntries[index].generation == mGeneration)
+            {
+                if (mEntries[index].pointer == pointer)
+                    return mEntries[index].id;
+
+                index = (index + 1) & mask;
+            }
+
+            // Keep the table under half full, so probe sequences stay short.
+            if ((mCount + 1) * 2 > mEntries.size())
+            {
+                Grow();
+
+                return GetId(pointer);
+            }
+
+            Entry& entry = mEntries[index];
+
+            entry.pointer = pointer;
+            entry.id = static_cast<uint32_t>(mCount++);
+            entry.generation = mGeneration;
+
+            return entry.id;
+        }
+
+
+        // Forgets every pointer, so IDs start again from zero.
+        void Reset()
+        {
+            mCount = 0;
+
+            if (++mGeneration == 0)
+            {
+                // The generation counter wrapped, so stale entries could look current: clear them for real.
+                for (auto it = mEntries.begin(); it != mEntries.end(); ++it)
+                {
+                    it->generation = 0;
+                }
+
+                mGeneration = 1;
+            }
+        }
+
+
+        size_t Count() const { return mCount; }
+
+
+    private:
+        static const int InitialCapacityLog2 = 6;
+
+        struct Entry
+        {
+            void const* pointer;
+            uint32_t id;
+            uint32_t generation;
+        };
+
+
+        // Helper hashes a pointer to a table index.
+        size_t Hash(_In_ void const* pointer) const
+        {
+            // Fibonacci hashing spreads the aligned pointer values, whose low bits are always zero.
+            uint64_t value = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(pointer)) * 0x9E3779B97F4A7C15ull;
+
+            return static_cast<size_t>(value >> mShift);
+        }
+
+
+        // Doubles the capacity, rehashing the entries of the current generation.
+        void Grow()
+        {
+            std::vector<Entry> previous;
+
+            previous.swap(mEntries);
+
+            Entry empty = { nullptr, 0, 0 };
+
+            mEntries.assign(previous.size() * 2, empty);
+            mShift--;
+
+            size_t mask = mEntries.size() - 1;
+
+            for (auto it = previous.begin(); it != previous.end(); ++it)
+            {
+                if (it->generation != mGeneration)
+                    continue;
+
+                size_t index = Hash(it->pointer);
+
+                while (mEntries[index].generation == mGeneration)
+                {
+                    index = (index + 1) & mask;
+                }
+
+                mEntries[index] = *it;
+            }
+        }
+
+
+        std::vector<Entry> mEntries;
+        size_t mCount;
+        uint32_t mGeneration;
+        int mShift;
+    };
+}
@@ -0,0 +1,482 @@
+//--------------------------------------------------------------------------------------
+// File: TextureAtlas.cpp
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// http://go.microsoft.com/fwlink/?LinkId=248929
+//--------------------------------------------------------------------------------------
+
+#include "pch.h"
+
+#define NOMINMAX
+#include <algorithm>
+#include <vector>
+
+#include "TextureAtlas.h"
+#include "DirectXHelpers.h"
+#include "PlatformHelpers.h"
+
+using namespace DirectX;
+using namespace Microsoft::WRL;
+
+
+// Internal TextureAtlas implementation class.
+class TextureAtlas::Impl
+{
+public:
+    Impl(UINT pageWidth, UINT pageHeight, UINT padding);
+
+    Handle AddImage(UINT width, UINT height, _In_reads_bytes_(height * rowPitch) void const* pixels, size_t rowPitch);
+    void Pack();
+    void CreateTextures(_In_ ID3D11Device* device);
+
+    float GetOccupancy() const;
+
+
+    // An image waiting to be, or already, packed.
+    struct Image
+    {
+        UINT width;
+        UINT height;
+        std::vector<uint8_t> pixels;
+        size_t page;
+        RECT sourceRectangle;
+    };
+
+
+    // The skyline is the upper outline of the packed area, stored as horizontal segments ordered by x.
+    struct SkylineSegment
+    {
+        int x;
+        int y;
+        int width;
+    };
+
+
+    struct Page
+    {
+        std::vector<SkylineSegment> skyline;
+        ComPtr<ID3D11ShaderResourceView> texture;
+    };
+
+
+    // Fields.
+    UINT pageWidth;
+    UINT pageHeight;
+    UINT padding;
+
+    std::vector<Image> images;
+    std::vector<Page> pages;
+
+    bool isPacked;
+    bool hasTextures;
+
+
+private:
+    void AddPage();
+    bool FindPosition(Page const& page, int width, int height, _Out_ size_t* segmentIndex, _Out_ int* x, _Out_ int* y) const;
+    static void AddSkylineLevel(Page& page, size_t segmentIndex, int x, int y, int width, int height);
+
+    static const UINT BytesPerPixel = 4;
+};
+
+
+// Constructor.
+TextureAtlas::Impl::Impl(UINT pageWidth, UINT pageHeight, UINT padding)
+  : pageWidth(pageWidth),
+    pageHeight(pageHeight),
+    padding(padding),
+    isPacked(true),
+    hasTextures(false)
+{
+    if (!pageWidth || !pageHeight || pageWidth > D3D11_REQ_TEXTURE2D_U_OR_V_DIMENSION || pageHeight > D3D11_REQ_TEXTURE2D_U_OR_V_DIMENSION)
+        throw std::exception("Invalid atlas page size");
+}
+
+
+// Copies an image into the atlas, ready to be packed.
+TextureAtlas::Handle TextureAtlas::Impl::AddImage(UINT width, UINT height, _In_reads_bytes_(height * rowPitch) void const* pixels, size_t rowPitch)
+{
+    if (!width || !height || !pixels)
+        throw std::exception("Invalid atlas image");
+
+    if (width > pageWidth || height > pageHeight)
+        throw std::exception("Image is larger than the atlas page size");
+
+    if (rowPitch < width * BytesPerPixel)
+        throw std::exception("Image row pitch is too small");
+
+    Image image;
+
+    image.width = width;
+    image.height = height;
+    image.page = 0;
+    image.sourceRectangle.left = image.sourceRectangle.top = image.sourceRectangle.right = image.sourceRectangle.bottom = 0;
+
+    // Store the pixels tightly packed.
+    size_t rowSize = width * BytesPerPixel;
+
+    image.pixels.resize(rowSize * height);
+
+    for (UINT y = 0; y < height; y++)
+    {
+        memcpy(&image.pixels[y * rowSize], static_cast<uint8_t const*>(pixels) + y * rowPitch, rowSize);
+    }
+
+    images.push_back(std::move(image));
+
+    isPacked = false;
+
+    return static_cast<Handle>(images.size() - 1);
+}
+
+
+// Places every image using a skyline bottom-left packer.
+void TextureAtlas::Impl::Pack()
+{
+    pages.clear();
+    hasTextures = false;
+
+    // Tallest first, then widest, then in the order images were added, so the result is deterministic.
+    std::vector<size_t> order(images.size());
+
+    for (size_t i = 0; i < order.size(); i++)
+    {
+        order[i] = i;
+    }
+
+    std::sort(order.begin(), order.end(), [&](size_t x, size_t y) -> bool
+    {
+        if (images[x].height != images[y].height)
+            return images[x].height > images[y].height;
+
+        if (images[x].width != images[y].width)
+            return images[x].width > images[y].width;
+
+        return x < y;
+    });
+
+    for (auto it = order.begin(); it != order.end(); ++it)
+    {
+        Image& image = images[*it];
+
+        // Padding goes on the right and bottom of each image. The bin is padded by the same amount,
+        // so an image can still touch the far edges of the page.
+        int width = static_cast<int>(image.width + padding);
+        int height = static_cast<int>(image.height + padding);
+
+        size_t segmentIndex;
+        int x, y;
+        size_t pageIndex;
+
+        // Try the existing pages in order, before starting a new one.
+        for (pageIndex = 0; pageIndex < pages.size(); pageIndex++)
+        {
+            if (FindPosition(pages[pageIndex], width, height, &segmentIndex, &x, &y))
+                break;
+        }
+
+        if (pageIndex == pages.size())
+        {
+            AddPage();
+
+            if (!FindPosition(pages[pageIndex], width, height, &segmentIndex, &x, &y))
+                throw std::exception("Image is larger than the atlas page size");
+        }
+
+        AddSkylineLevel(pages[pageIndex], segmentIndex, x, y, width, height);
+
+        image.page = pageIndex;
+        image.sourceRectangle.left = x;
+        image.sourceRectangle.top = y;
+        image.sourceRectangle.right = x + image.width;
+        image.sourceRectangle.bottom = y + image.height;
+    }
+
+    isPacked = true;
+}
+
+
+// Starts a new, empty page.
+void TextureAtlas::Impl::AddPage()
+{
+    Page page;
+
+    SkylineSegment floor = { 0, 0, static_cast<int>(pageWidth + padding) };
+
+    page.skyline.push_back(floor);
+
+    pages.push_back(std::move(page));
+}
+
+
+// Finds the lowest position on the skyline where a rectangle fits, preferring the leftmost on ties.
+bool TextureAtlas::Impl::FindPosition(Page const& page, int width, int height, _Out_ size_t* segmentIndex, _Out_ int* x, _Out_ int* y) const
+{
+    int binWidth = static_cast<int>(pageWidth + padding);
+    int binHeight = static_cast<int>(pageHeight + padding);
+
+    auto& skyline = page.skyline;
+
+    bool found = false;
+    int bestTop = binHeight + 1;
+
+    *segmentIndex = 0;
+    *x = 0;
+    *y = 0;
+
+    for (size_t i = 0; i < skyline.size(); i++)
+    {
+        int left = skyline[i].x;
+
+        if (left + width > binWidth)
+            break;
+
+        // The rectangle rests on the highest segment underneath it.
+        int top = 0;
+        int widthLeft = width;
+
+        for (size_t j = i; widthLeft > 0; j++)
+        {
+            top = std::max(top, skyline[j].y);
+            widthLeft -= skyline[j].width;
+        }
+
+        if (top + height <= binHeight && top + height < bestTop)
+        {
+            found = true;
+            bestTop = top + height;
+
+            *segmentIndex = i;
+            *x = left;
+            *y = top;
+        }
+    }
+
+    return found;
+}
+
+
+// Raises the skyline over a newly placed rectangle.
+void TextureAtlas::Impl::AddSkylineLevel(Page& page, size_t segmentIndex, int x, int y, int width, int height)
+{
+    auto& skyline = page.skyline;
+
+    SkylineSegment segment = { x, y + height, width };
+
+    skyline.insert(skyline.begin() + segmentIndex, segment);
+
+    // Trim or remove the segments now covered by the new one.
+    for (size_t i = segmentIndex + 1; i < skyline.size(); )
+    {
+        int coveredUntil = skyline[i - 1].x + skyline[i - 1].width;
+
+        if (skyline[i].x >= coveredUntil)
+            break;
+
+        int shrink = coveredUntil - skyline[i].x;
+
+        if (skyline[i].width <= shrink)
+        {
+            skyline.erase(skyline.begin() + i);
+        }
+        else
+        {
+            skyline[i].x += shrink;
+            skyline[i].width -= shrink;
+            break;
+        }
+    }
+
+    // Merge neighbours at the same height.
+    for (size_t i = 0; i + 1 < skyline.size(); )
+    {
+        if (skyline[i].y == skyline[i + 1].y)
+        {
+            skyline[i].width += skyline[i + 1].width;
+            skyline.erase(skyline.begin() + i + 1);
+        }
+        else
+        {
+            i++;
+        }
+    }
+}
+
+
+// Copies the packed images into page textures.
+void TextureAtlas::Impl::CreateTextures(_In_ ID3D11Device* device)
+{
+    if (!isPacked)
+    {
+        Pack();
+    }
+
+    size_t pagePitch = pageWidth * BytesPerPixel;
+
+    std::vector<uint8_t> pixels;
+
+    for (size_t pageIndex = 0; pageIndex < pages.size(); pageIndex++)
+    {
+        // Unused areas and padding are left transparent.
+        pixels.assign(pagePitch * pageHeight, 0);
+
+        for (auto it = images.begin(); it != images.end(); ++it)
+        {
+            if (it->page != pageIndex)
+                continue;
+
+            size_t rowSize = it->width * BytesPerPixel;
+
+            for (UINT y = 0; y < it->height; y++)
+            {
+                memcpy(&pixels[(it->sourceRectangle.top + y) * pagePitch + it->sourceRectangle.left * BytesPerPixel],
+                       &it->pixels[y * rowSize],
+                       rowSize);
+            }
+        }
+
+        D3D11_TEXTURE2D_DESC desc = { 0 };
+
+        desc.Width = pageWidth;
+        desc.Height = pageHeight;
+        desc.MipLevels = 1;
+        desc.ArraySize = 1;
+        desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+        desc.SampleDesc.Count = 1;
+        desc.Usage = D3D11_USAGE_IMMUTABLE;
+        desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+        D3D11_SUBRESOURCE_DATA initData = { 0 };
+
+        initData.pSysMem = pixels.data();
+        initData.SysMemPitch = static_cast<UINT>(pagePitch);
+
+        ComPtr<ID3D11Texture2D> texture;
+
+        ThrowIfFailed(
+            device->CreateTexture2D(&desc, &initData, &texture)
+        );
+
+        ThrowIfFailed(
+            device->CreateShaderResourceView(texture.Get(), nullptr, &pages[pageIndex].texture)
+        );
+
+        SetDebugObjectName(texture.Get(), "DirectXTK:TextureAtlas");
+        SetDebugObjectName(pages[pageIndex].texture.Get(), "DirectXTK:TextureAtlas");
+    }
+
+    hasTextures = true;
+}
+
+
+// Computes how much of the page area is covered by images.
+float TextureAtlas::Impl::GetOccupancy() const
+{
+    if (pages.empty())
+        return 0;
+
+    double usedArea = 0;
+
+    for (auto it = images.begin(); it != images.end(); ++it)
+    {
+        usedArea += double(it->width) * double(it->height);
+    }
+
+    double pageArea = double(pageWidth) * double(pageHeight) * double(pages.size());
+
+    return static_cast<float>(usedArea / pageArea);
+}
+
+
+// Public constructor.
+TextureAtlas::TextureAtlas(UINT pageWidth, UINT pageHeight, UINT padding)
+  : pImpl(new Impl(pageWidth, pageHeight, padding))
+{
+}
+
+
+// Move constructor.
+TextureAtlas::TextureAtlas(TextureAtlas&& moveFrom)
+  : pImpl(std::move(moveFrom.pImpl))
+{
+}
+
+
+// Move assignment.
+TextureAtlas& TextureAtlas::operator= (TextureAtlas&& moveFrom)
+{
+    pImpl = std::move(moveFrom.pImpl);
+    return *this;
+}
+
+
+// Public destructor.
+TextureAtlas::~TextureAtlas()
+{
+}
+
+
+TextureAtlas::Handle TextureAtlas::AddImage(UINT width, UINT height, _In_reads_bytes_(height * rowPitch) void const* pixels, size_t rowPitch)
+{
+    return pImpl->AddImage(width, height, pixels, rowPitch);
+}
+
+
+void TextureAtlas::Pack()
+{
+    pImpl->Pack();
+}
+
+
+void TextureAtlas::CreateTextures(_In_ ID3D11Device* device)
+{
+    pImpl->CreateTextures(device);
+}
+
+
+ID3D11ShaderResourceView* TextureAtlas::GetTexture(Handle handle) const
+{
+    if (handle >= pImpl->images.size())
+        throw std::exception("Invalid atlas handle");
+
+    if (!pImpl->isPacked || !pImpl->hasTextures)
+        throw std::exception("CreateTextures must be called before drawing from a TextureAtlas");
+
+    return pImpl->pages[pImpl->images[handle].page].texture.Get();
+}
+
+
+RECT const& TextureAtlas::GetSourceRectangle(Handle handle) const
+{
+    if (handle >= pImpl->images.size())
+        throw std::exception("Invalid atlas handle");
+
+    if (!pImpl->isPacked)
+        throw std::exception("Pack must be called before looking up atlas regions");
+
+    return pImpl->images[handle].sourceRectangle;
+}
+
+
+size_t TextureAtlas::GetImageCount() const
+{
+    return pImpl->images.size();
+}
+
+
+size_t TextureAtlas::GetPageCount() const
+{
+    return pImpl->pages.size();
+}
+
+
+float TextureAtlas::GetOccupancy() const
+{
+    return pImpl->GetOccupancy();
+}
@@ -0,0 +1,257 @@
+//--------------------------------------------------------------------------------------
+// File: VertexCache.h
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// http://go.microsoft.com/fwlink/?LinkId=248929
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include <stdint.h>
+
+
+namespace VertexCache
+{
+    // Average cache miss ratio: the number of vertices the GPU has to transform per triangle,
+    // simulating a FIFO post-transform cache of the specified size. Ranges from 0.5 (ideal) to 3.
+    inline float ComputeACMR(std::vector<uint32_t> const& indices, size_t cacheSize)
+    {
+        if (indices.size() < 3 || !cacheSize)
+            return 0;
+
+        std::vector<uint32_t> cache(cacheSize, UINT32_MAX);
+
+        size_t head = 0;
+        size_t misses = 0;
+
+        for (auto it = indices.begin(); it != indices.end(); ++it)
+        {
+            if (std::find(cache.begin(), cache.end(), *it) == cache.end())
+            {
+                cache[head] = *it;
+                head = (head + 1) % cacheSize;
+                misses++;
+            }
+        }
+
+        return (float)misses / (float)(indices.size() / 3);
+    }
+
+
+    // Reorders triangles to make good use of the post-transform vertex cache, using Tom Forsyth's
+    // "Linear-Speed Vertex Cache Optimisation". Triangles keep their winding, and the result does
+    // not depend on the exact size of the hardware cache.
+    inline void OptimizeFaces(std::vector<uint32_t>& indices, size_t vertexCount)
+    {
+        const size_t CacheSize = 32;
+
+        const size_t triangleCount = indices.size() / 3;
+
+        if (triangleCount < 2)
+            return;
+
+        // Score of a vertex, from its position in the simulated LRU cache and how many triangles still use it.
+        auto scoreVertex = [=](int cachePosition, size_t remainingTriangles) -> float
+        {
+            if (!remainingTriangles)
+                return -1;
+
+            float score = 0;
+
+            if (cachePosition >= 0)
+            {
+                if (cachePosition < 3)
+                {
+                    // The last triangle's vertices get a fixed score, so we don't favour reusing them in any particular order.
+                    score = 0.75f;
+                }
+                else
+                {
+                    float scale = 1.0f / (CacheSize - 3);
+
+                    score = powf(1.0f - (cachePosition - 3) * scale, 1.5f);
+                }
+            }
+
+            // Boost vertices with few triangles left, so we finish off isolated pieces instead of leaving them until later.
+            return score + 2.0f / sqrtf((float)remainingTriangles);
+        };
+
+        // Build vertex to triangle adjacency, as offsets into a single list.
+        std::vector<uint32_t> remaining(vertexCount);
+
+        for (auto it = indices.begin(); it != indices.end(); ++it)
+        {
+            remaining[*it]++;
+        }
+
+        std::vector<uint32_t> firstTriangle(vertexCount + 1);
+
+        for (size_t i = 0; i < vertexCount; i++)
+        {
+            firstTriangle[i + 1] = firstTriangle[i] + remaining[i];
+        }
+
+        std::vector<uint32_t> adjacency(indices.size());
+        std::vector<uint32_t> fill(firstTriangle.begin(), firstTriangle.end() - 1);
+
+        for (size_t i = 0; i < indices.size(); i++)
+        {
+            adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+        }
+
+        // Per-vertex and per-triangle state.
+        std::vector<int> cachePosition(vertexCount, -1);
+        std::vector<float> vertexScore(vertexCount);
+        std::vector<float> triangleScore(triangleCount);
+        std::vector<bool> emitted(triangleCount);
+
+        for (size_t i = 0; i < vertexCount; i++)
+        {
+            vertexScore[i] = scoreVertex(-1, remaining[i]);
+        }
+
+        for (size_t i = 0; i < triangleCount; i++)
+        {
+            triangleScore[i] = vertexScore[indices[i * 3]] + vertexScore[indices[i * 3 + 1]] + vertexScore[indices[i * 3 + 2]];
+        }
+
+        std::vector<uint32_t> cache;
+        std::vector<uint32_t> newCache;
+
+        cache.reserve(CacheSize + 3);
+        newCache.reserve(CacheSize + 3);
+
+        std::vector<uint32_t> result;
+        result.reserve(indices.size());
+
+        size_t bestTriangle = 0;
+        size_t scanPosition = 0;
+
+        for (;;)
+        {
+            // Emit the best triangle.
+            uint32_t const* tri = &indices[bestTriangle * 3];
+
+            result.insert(result.end(), tri, tri + 3);
+            emitted[bestTriangle] = true;
+
+            // Remove it from the adjacency of its vertices.
+            for (size_t i = 0; i < 3; i++)
+            {
+                uint32_t v = tri[i];
+
+                uint32_t* begin = &adjacency[firstTriangle[v]];
+                uint32_t* end = begin + remaining[v];
+
+                *std::find(begin, end, static_cast<uint32_t>(bestTriangle)) = *(end - 1);
+
+                remaining[v]--;
+            }
+
+            // Move its vertices to the front of the cache. The cache temporarily grows by up to three entries.
+            newCache.assign(tri, tri + 3);
+
+            for (auto it = cache.begin(); it != cache.end(); ++it)
+            {
+                if (*it != tri[0] && *it != tri[1] && *it != tri[2])
+                    newCache.push_back(*it);
+            }
+
+            std::swap(cache, newCache);
+
+            // Rescore everything in the cache, along with the triangles that use it.
+            for (size_t i = 0; i < cache.size(); i++)
+            {
+                uint32_t v = cache[i];
+
+                cachePosition[v] = (i < CacheSize) ? static_cast<int>(i) : -1;
+
+                float delta = scoreVertex(cachePosition[v], remaining[v]) - vertexScore[v];
+
+                vertexScore[v] += delta;
+
+                for (uint32_t j = firstTriangle[v]; j < firstTriangle[v] + remaining[v]; j++)
+                {
+                    triangleScore[adjacency[j]] += delta;
+                }
+            }
+
+            if (cache.size() > CacheSize)
+                cache.resize(CacheSize);
+
+            // The next triangle is usually one that uses a cached vertex.
+            float bestScore = -1;
+
+            for (auto it = cache.begin(); it != cache.end(); ++it)
+            {
+                for (uint32_t j = firstTriangle[*it]; j < firstTriangle[*it] + remaining[*it]; j++)
+                {
+                    uint32_t t = adjacency[j];
+
+                    if (triangleScore[t] > bestScore)
+                    {
+                        bestScore = triangleScore[t];
+                        bestTriangle = t;
+                    }
+                }
+            }
+
+            if (bestScore < 0)
+            {
+                // Nothing in the cache is left to draw, so start on the next unvisited part of the mesh.
+                while (scanPosition < triangleCount && emitted[scanPosition])
+                {
+                    scanPosition++;
+                }
+
+                if (scanPosition == triangleCount)
+                    break;
+
+                bestTriangle = scanPosition;
+            }
+        }
+
+        indices.swap(result);
+    }
+
+
+    // Reorders vertices into the order the index buffer first uses them, so the GPU reads the vertex
+    // buffer roughly sequentially. Unreferenced vertices are kept, at the end of the buffer.
+    template<typename TVertex>
+    void OptimizeVertices(std::vector<TVertex>& vertices, std::vector<uint32_t>& indices)
+    {
+        std::vector<uint32_t> remap(vertices.size(), UINT32_MAX);
+
+        uint32_t nextVertex = 0;
+
+        for (auto it = indices.begin(); it != indices.end(); ++it)
+        {
+            if (remap[*it] == UINT32_MAX)
+                remap[*it] = nextVertex++;
+
+            *it = remap[*it];
+        }
+
+        std::vector<TVertex> result(vertices.size());
+
+        for (size_t i = 0; i < vertices.size(); i++)
+        {
+            if (remap[i] == UINT32_MAX)
+                remap[i] = nextVertex++;
+
+            result[remap[i]] = vertices[i];
+        }
+
+        vertices.swap(result);
+    }
+}
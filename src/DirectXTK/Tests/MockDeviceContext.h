@@ -0,0 +1,295 @@
+//--------------------------------------------------------------------------------------
+// File: MockDeviceContext.h
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// http://go.microsoft.com/fwlink/?LinkId=248929
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <d3d11_1.h>
+#include <wrl/client.h>
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <map>
+#include <vector>
+
+
+namespace DirectX
+{
+    namespace Tests
+    {
+        // Device context that records the calls the batching code makes, instead of sending them to a driver.
+        // Resources are created on a real device (eg. WARP), which GetDevice hands out, but Map returns CPU
+        // memory owned by the mock, so the tests can inspect exactly what was written.
+        class MockDeviceContext : public ID3D11DeviceContext
+        {
+        public:
+            struct MapCall
+            {
+                ID3D11Resource* resource;
+                D3D11_MAP mapType;
+            };
+
+            struct DrawCall
+            {
+                bool isIndexed;
+                UINT count;
+                UINT start;
+                INT baseVertex;
+                D3D11_PRIMITIVE_TOPOLOGY topology;
+            };
+
+            explicit MockDeviceContext(_In_ ID3D11Device* device, D3D11_DEVICE_CONTEXT_TYPE type = D3D11_DEVICE_CONTEXT_IMMEDIATE)
+              : mIndexBuffer(nullptr),
+                mIndexFormat(DXGI_FORMAT_UNKNOWN),
+                mVertexBuffer(nullptr),
+                mTopology(D3D11_PRIMITIVE_TOPOLOGY_UNDEFINED),
+                mUnmaps(0),
+                mTopologyChanges(0),
+                mDevice(device),
+                mType(type),
+                mRefCount(1)
+            {
+            }
+
+            // Recorded calls.
+            std::vector<MapCall> mMaps;
+            std::vector<DrawCall> mDraws;
+
+            ID3D11Buffer* mIndexBuffer;
+            DXGI_FORMAT mIndexFormat;
+            ID3D11Buffer* mVertexBuffer;
+            D3D11_PRIMITIVE_TOPOLOGY mTopology;
+            size_t mUnmaps;
+            size_t mTopologyChanges;
+
+            void ClearCalls()
+            {
+                mMaps.clear();
+                mDraws.clear();
+                mUnmaps = 0;
+                mTopologyChanges = 0;
+            }
+
+            size_t CountMaps(_In_ ID3D11Resource* resource, D3D11_MAP mapType) const
+            {
+                size_t count = 0;
+
+                for (auto it = mMaps.begin(); it != mMaps.end(); ++it)
+                {
+                    if (it->resource == resource && it->mapType == mapType)
+                        count++;
+                }
+
+                return count;
+            }
+
+            // The CPU copy of a buffer's contents, as last written through Map.
+            template<typename T>
+            T const* Contents(_In_ ID3D11Resource* resource)
+            {
+                return reinterpret_cast<T const*>(mContents[resource].data());
+            }
+
+            // IUnknown. The mock lives on the stack, so the reference count is only tracked, never acted on.
+            HRESULT STDMETHODCALLTYPE QueryInterface(REFIID, void** ppvObject) override { *ppvObject = nullptr; return E_NOINTERFACE; }
+            ULONG STDMETHODCALLTYPE AddRef() override { return ++mRefCount; }
+            ULONG STDMETHODCALLTYPE Release() override { return --mRefCount; }
+
+            // ID3D11DeviceChild.
+            void STDMETHODCALLTYPE GetDevice(ID3D11Device** ppDevice) override { mDevice.CopyTo(ppDevice); }
+            HRESULT STDMETHODCALLTYPE GetPrivateData(REFGUID, UINT*, void*) override { return E_NOTIMPL; }
+            HRESULT STDMETHODCALLTYPE SetPrivateData(REFGUID, UINT, const void*) override { return S_OK; }
+            HRESULT STDMETHODCALLTYPE SetPrivateDataInterface(REFGUID, const IUnknown*) override { return S_OK; }
+
+            // The calls PrimitiveBatch makes.
+            HRESULT STDMETHODCALLTYPE Map(ID3D11Resource* pResource, UINT, D3D11_MAP MapType, UINT, D3D11_MAPPED_SUBRESOURCE* pMappedResource) override
+            {
+                MapCall call = { pResource, MapType };
+
+                mMaps.push_back(call);
+
+                auto& contents = mContents[pResource];
+
+                if (contents.empty())
+                {
+                    Microsoft::WRL::ComPtr<ID3D11Buffer> buffer;
+
+                    if (FAILED(pResource->QueryInterface(IID_PPV_ARGS(&buffer))))
+                        return E_INVALIDARG;
+
+                    D3D11_BUFFER_DESC desc;
+
+                    buffer->GetDesc(&desc);
+                    contents.resize(desc.ByteWidth);
+                }
+
+                // Like the driver, a discard hands back undefined contents.
+                if (MapType == D3D11_MAP_WRITE_DISCARD)
+                    std::fill(contents.begin(), contents.end(), static_cast<uint8_t>(0xCD));
+
+                pMappedResource->pData = contents.data();
+                pMappedResource->RowPitch = static_cast<UINT>(contents.size());
+                pMappedResource->DepthPitch = static_cast<UINT>(contents.size());
+
+                return S_OK;
+            }
+
+            void STDMETHODCALLTYPE Unmap(ID3D11Resource*, UINT) override { mUnmaps++; }
+
+            void STDMETHODCALLTYPE IASetIndexBuffer(ID3D11Buffer* pIndexBuffer, DXGI_FORMAT Format, UINT) override
+            {
+                mIndexBuffer = pIndexBuffer;
+                mIndexFormat = Format;
+            }
+
+            void STDMETHODCALLTYPE IASetVertexBuffers(UINT, UINT NumBuffers, ID3D11Buffer* const* ppVertexBuffers, const UINT*, const UINT*) override
+            {
+                mVertexBuffer = (NumBuffers > 0) ? ppVertexBuffers[0] : nullptr;
+            }
+
+            void STDMETHODCALLTYPE IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY Topology) override
+            {
+                mTopology = Topology;
+                mTopologyChanges++;
+            }
+
+            void STDMETHODCALLTYPE DrawIndexed(UINT IndexCount, UINT StartIndexLocation, INT BaseVertexLocation) override
+            {
+                DrawCall call = { true, IndexCount, StartIndexLocation, BaseVertexLocation, mTopology };
+
+                mDraws.push_back(call);
+            }
+
+            void STDMETHODCALLTYPE Draw(UINT VertexCount, UINT StartVertexLocation) override
+            {
+                DrawCall call = { false, VertexCount, StartVertexLocation, 0, mTopology };
+
+                mDraws.push_back(call);
+            }
+
+            D3D11_DEVICE_CONTEXT_TYPE STDMETHODCALLTYPE GetType() override { return mType; }
+
+            // Everything else is not used by the code under test.
+            void STDMETHODCALLTYPE VSSetConstantBuffers(UINT, UINT, ID3D11Buffer* const*) override {}
+            void STDMETHODCALLTYPE PSSetShaderResources(UINT, UINT, ID3D11ShaderResourceView* const*) override {}
+            void STDMETHODCALLTYPE PSSetShader(ID3D11PixelShader*, ID3D11ClassInstance* const*, UINT) override {}
+            void STDMETHODCALLTYPE PSSetSamplers(UINT, UINT, ID3D11SamplerState* const*) override {}
+            void STDMETHODCALLTYPE VSSetShader(ID3D11VertexShader*, ID3D11ClassInstance* const*, UINT) override {}
+            void STDMETHODCALLTYPE PSSetConstantBuffers(UINT, UINT, ID3D11Buffer* const*) override {}
+            void STDMETHODCALLTYPE IASetInputLayout(ID3D11InputLayout*) override {}
+            void STDMETHODCALLTYPE DrawIndexedInstanced(UINT, UINT, UINT, INT, UINT) override {}
+            void STDMETHODCALLTYPE DrawInstanced(UINT, UINT, UINT, UINT) override {}
+            void STDMETHODCALLTYPE GSSetConstantBuffers(UINT, UINT, ID3D11Buffer* const*) override {}
+            void STDMETHODCALLTYPE GSSetShader(ID3D11GeometryShader*, ID3D11ClassInstance* const*, UINT) override {}
+            void STDMETHODCALLTYPE VSSetShaderResources(UINT, UINT, ID3D11ShaderResourceView* const*) override {}
+            void STDMETHODCALLTYPE VSSetSamplers(UINT, UINT, ID3D11SamplerState* const*) override {}
+            void STDMETHODCALLTYPE Begin(ID3D11Asynchronous*) override {}
+            void STDMETHODCALLTYPE End(ID3D11Asynchronous*) override {}
+            HRESULT STDMETHODCALLTYPE GetData(ID3D11Asynchronous*, void*, UINT, UINT) override { return E_NOTIMPL; }
+            void STDMETHODCALLTYPE SetPredication(ID3D11Predicate*, BOOL) override {}
+            void STDMETHODCALLTYPE GSSetShaderResources(UINT, UINT, ID3D11ShaderResourceView* const*) override {}
+            void STDMETHODCALLTYPE GSSetSamplers(UINT, UINT, ID3D11SamplerState* const*) override {}
+            void STDMETHODCALLTYPE OMSetRenderTargets(UINT, ID3D11RenderTargetView* const*, ID3D11DepthStencilView*) override {}
+            void STDMETHODCALLTYPE OMSetRenderTargetsAndUnorderedAccessViews(UINT, ID3D11RenderTargetView* const*, ID3D11DepthStencilView*, UINT, UINT, ID3D11UnorderedAccessView* const*, const UINT*) override {}
+            void STDMETHODCALLTYPE OMSetBlendState(ID3D11BlendState*, const FLOAT[4], UINT) override {}
+            void STDMETHODCALLTYPE OMSetDepthStencilState(ID3D11DepthStencilState*, UINT) override {}
+            void STDMETHODCALLTYPE SOSetTargets(UINT, ID3D11Buffer* const*, const UINT*) override {}
+            void STDMETHODCALLTYPE DrawAuto() override {}
+            void STDMETHODCALLTYPE DrawIndexedInstancedIndirect(ID3D11Buffer*, UINT) override {}
+            void STDMETHODCALLTYPE DrawInstancedIndirect(ID3D11Buffer*, UINT) override {}
+            void STDMETHODCALLTYPE Dispatch(UINT, UINT, UINT) override {}
+            void STDMETHODCALLTYPE DispatchIndirect(ID3D11Buffer*, UINT) override {}
+            void STDMETHODCALLTYPE RSSetState(ID3D11RasterizerState*) override {}
+            void STDMETHODCALLTYPE RSSetViewports(UINT, const D3D11_VIEWPORT*) override {}
+            void STDMETHODCALLTYPE RSSetScissorRects(UINT, const D3D11_RECT*) override {}
+            void STDMETHODCALLTYPE CopySubresourceRegion(ID3D11Resource*, UINT, UINT, UINT, UINT, ID3D11Resource*, UINT, const D3D11_BOX*) override {}
+            void STDMETHODCALLTYPE CopyResource(ID3D11Resource*, ID3D11Resource*) override {}
+            void STDMETHODCALLTYPE UpdateSubresource(ID3D11Resource*, UINT, const D3D11_BOX*, const void*, UINT, UINT) override {}
+            void STDMETHODCALLTYPE CopyStructureCount(ID3D11Buffer*, UINT, ID3D11UnorderedAccessView*) override {}
+            void STDMETHODCALLTYPE ClearRenderTargetView(ID3D11RenderTargetView*, const FLOAT[4]) override {}
+            void STDMETHODCALLTYPE ClearUnorderedAccessViewUint(ID3D11UnorderedAccessView*, const UINT[4]) override {}
+            void STDMETHODCALLTYPE ClearUnorderedAccessViewFloat(ID3D11UnorderedAccessView*, const FLOAT[4]) override {}
+            void STDMETHODCALLTYPE ClearDepthStencilView(ID3D11DepthStencilView*, UINT, FLOAT, UINT8) override {}
+            void STDMETHODCALLTYPE GenerateMips(ID3D11ShaderResourceView*) override {}
+            void STDMETHODCALLTYPE SetResourceMinLOD(ID3D11Resource*, FLOAT) override {}
+            FLOAT STDMETHODCALLTYPE GetResourceMinLOD(ID3D11Resource*) override { return 0; }
+            void STDMETHODCALLTYPE ResolveSubresource(ID3D11Resource*, UINT, ID3D11Resource*, UINT, DXGI_FORMAT) override {}
+            void STDMETHODCALLTYPE ExecuteCommandList(ID3D11CommandList*, BOOL) override {}
+            void STDMETHODCALLTYPE HSSetShaderResources(UINT, UINT, ID3D11ShaderResourceView* const*) override {}
+            void STDMETHODCALLTYPE HSSetShader(ID3D11HullShader*, ID3D11ClassInstance* const*, UINT) override {}
+            void STDMETHODCALLTYPE HSSetSamplers(UINT, UINT, ID3D11SamplerState* const*) override {}
+            void STDMETHODCALLTYPE HSSetConstantBuffers(UINT, UINT, ID3D11Buffer* const*) override {}
+            void STDMETHODCALLTYPE DSSetShaderResources(UINT, UINT, ID3D11ShaderResourceView* const*) override {}
+            void STDMETHODCALLTYPE DSSetShader(ID3D11DomainShader*, ID3D11ClassInstance* const*, UINT) override {}
+            void STDMETHODCALLTYPE DSSetSamplers(UINT, UINT, ID3D11SamplerState* const*) override {}
+            void STDMETHODCALLTYPE DSSetConstantBuffers(UINT, UINT, ID3D11Buffer* const*) override {}
+            void STDMETHODCALLTYPE CSSetShaderResources(UINT, UINT, ID3D11ShaderResourceView* const*) override {}
+            void STDMETHODCALLTYPE CSSetUnorderedAccessViews(UINT, UINT, ID3D11UnorderedAccessView* const*, const UINT*) override {}
+            void STDMETHODCALLTYPE CSSetShader(ID3D11ComputeShader*, ID3D11ClassInstance* const*, UINT) override {}
+            void STDMETHODCALLTYPE CSSetSamplers(UINT, UINT, ID3D11SamplerState* const*) override {}
+            void STDMETHODCALLTYPE CSSetConstantBuffers(UINT, UINT, ID3D11Buffer* const*) override {}
+            void STDMETHODCALLTYPE VSGetConstantBuffers(UINT, UINT, ID3D11Buffer**) override {}
+            void STDMETHODCALLTYPE PSGetShaderResources(UINT, UINT, ID3D11ShaderResourceView**) override {}
+            void STDMETHODCALLTYPE PSGetShader(ID3D11PixelShader**, ID3D11ClassInstance**, UINT*) override {}
+            void STDMETHODCALLTYPE PSGetSamplers(UINT, UINT, ID3D11SamplerState**) override {}
+            void STDMETHODCALLTYPE VSGetShader(ID3D11VertexShader**, ID3D11ClassInstance**, UINT*) override {}
+            void STDMETHODCALLTYPE PSGetConstantBuffers(UINT, UINT, ID3D11Buffer**) override {}
+            void STDMETHODCALLTYPE IAGetInputLayout(ID3D11InputLayout**) override {}
+            void STDMETHODCALLTYPE IAGetVertexBuffers(UINT, UINT, ID3D11Buffer**, UINT*, UINT*) override {}
+            void STDMETHODCALLTYPE IAGetIndexBuffer(ID3D11Buffer**, DXGI_FORMAT*, UINT*) override {}
+            void STDMETHODCALLTYPE GSGetConstantBuffers(UINT, UINT, ID3D11Buffer**) override {}
+            void STDMETHODCALLTYPE GSGetShader(ID3D11GeometryShader**, ID3D11ClassInstance**, UINT*) override {}
+            void STDMETHODCALLTYPE IAGetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY*) override {}
+            void STDMETHODCALLTYPE VSGetShaderResources(UINT, UINT, ID3D11ShaderResourceView**) override {}
+            void STDMETHODCALLTYPE VSGetSamplers(UINT, UINT, ID3D11SamplerState**) override {}
+            void STDMETHODCALLTYPE GetPredication(ID3D11Predicate**, BOOL*) override {}
+            void STDMETHODCALLTYPE GSGetShaderResources(UINT, UINT, ID3D11ShaderResourceView**) override {}
+            void STDMETHODCALLTYPE GSGetSamplers(UINT, UINT, ID3D11SamplerState**) override {}
+            void STDMETHODCALLTYPE OMGetRenderTargets(UINT, ID3D11RenderTargetView**, ID3D11DepthStencilView**) override {}
+            void STDMETHODCALLTYPE OMGetRenderTargetsAndUnorderedAccessViews(UINT, ID3D11RenderTargetView**, ID3D11DepthStencilView**, UINT, UINT, ID3D11UnorderedAccessView**) override {}
+            void STDMETHODCALLTYPE OMGetBlendState(ID3D11BlendState**, FLOAT[4], UINT*) override {}
+            void STDMETHODCALLTYPE OMGetDepthStencilState(ID3D11DepthStencilState**, UINT*) override {}
+            void STDMETHODCALLTYPE SOGetTargets(UINT, ID3D11Buffer**) override {}
+            void STDMETHODCALLTYPE RSGetState(ID3D11RasterizerState**) override {}
+            void STDMETHODCALLTYPE RSGetViewports(UINT*, D3D11_VIEWPORT*) override {}
+            void STDMETHODCALLTYPE RSGetScissorRects(UINT*, D3D11_RECT*) override {}
+            void STDMETHODCALLTYPE HSGetShaderResources(UINT, UINT, ID3D11ShaderResourceView**) override {}
+            void STDMETHODCALLTYPE HSGetShader(ID3D11HullShader**, ID3D11ClassInstance**, UINT*) override {}
+            void STDMETHODCALLTYPE HSGetSamplers(UINT, UINT, ID3D11SamplerState**) override {}
+            void STDMETHODCALLTYPE HSGetConstantBuffers(UINT, UINT, ID3D11Buffer**) override {}
+            void STDMETHODCALLTYPE DSGetShaderResources(UINT, UINT, ID3D11ShaderResourceView**) override {}
+            void STDMETHODCALLTYPE DSGetShader(ID3D11DomainShader**, ID3D11ClassInstance**, UINT*) override {}
+            void STDMETHODCALLTYPE DSGetSamplers(UINT, UINT, ID3D11SamplerState**) override {}
+            void STDMETHODCALLTYPE DSGetConstantBuffers(UINT, UINT, ID3D11Buffer**) override {}
+            void STDMETHODCALLTYPE CSGetShaderResources(UINT, UINT, ID3D11ShaderResourceView**) override {}
+            void STDMETHODCALLTYPE CSGetUnorderedAccessViews(UINT, UINT, ID3D11UnorderedAccessView**) override {}
+            void STDMETHODCALLTYPE CSGetShader(ID3D11ComputeShader**, ID3D11ClassInstance**, UINT*) override {}
+            void STDMETHODCALLTYPE CSGetSamplers(UINT, UINT, ID3D11SamplerState**) override {}
+            void STDMETHODCALLTYPE CSGetConstantBuffers(UINT, UINT, ID3D11Buffer**) override {}
+            void STDMETHODCALLTYPE ClearState() override {}
+            void STDMETHODCALLTYPE Flush() override {}
+            UINT STDMETHODCALLTYPE GetContextFlags() override { return 0; }
+            HRESULT STDMETHODCALLTYPE FinishCommandList(BOOL, ID3D11CommandList**) override { return E_NOTIMPL; }
+
+        private:
+            Microsoft::WRL::ComPtr<ID3D11Device> mDevice;
+            D3D11_DEVICE_CONTEXT_TYPE mType;
+            ULONG mRefCount;
+
+            std::map<ID3D11Resource*, std::vector<uint8_t>> mContents;
+
+            MockDeviceContext(MockDeviceContext const&);
+            MockDeviceContext& operator= (MockDeviceContext const&);
+        };
+    }
+}
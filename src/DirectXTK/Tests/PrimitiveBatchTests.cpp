@@ -0,0 +1,379 @@
+//--------------------------------------------------------------------------------------
+// File: PrimitiveBatchTests.cpp
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// http://go.microsoft.com/fwlink/?LinkId=248929
+//--------------------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "PrimitiveBatch.h"
+#include "MockDeviceContext.h"
+
+using namespace DirectX;
+using namespace DirectX::Tests;
+using Microsoft::WRL::ComPtr;
+
+
+namespace
+{
+    int failures = 0;
+
+    void Check(bool condition, _In_z_ const char* expression, int line)
+    {
+        if (!condition)
+        {
+            printf("PrimitiveBatchTests.cpp(%d): check failed: %s\n", line, expression);
+            failures++;
+        }
+    }
+
+    #define CHECK(condition) Check((condition), #condition, __LINE__)
+
+
+    // Only the size matters to PrimitiveBatch.
+    struct TestVertex
+    {
+        uint32_t id;
+        float padding[3];
+    };
+
+    typedef PrimitiveBatch<TestVertex> TestBatch;
+
+    const TestVertex vertices[4] = {};
+
+    const uint16_t quadIndices[] = { 0, 1, 2, 0, 2, 3 };
+
+
+    bool CheckDraw(MockDeviceContext::DrawCall const& draw, bool isIndexed, UINT count, UINT start, INT baseVertex, D3D11_PRIMITIVE_TOPOLOGY topology)
+    {
+        return draw.isIndexed == isIndexed &&
+               draw.count == count &&
+               draw.start == start &&
+               draw.baseVertex == baseVertex &&
+               draw.topology == topology;
+    }
+
+
+    // Without persistent mapping, every change of topology flushes, and the next map appends with no overwrite.
+    void MapCountsInDefaultMode(_In_ ID3D11Device* device)
+    {
+        MockDeviceContext context(device);
+        TestBatch batch(&context, 60, 20, false);
+
+        batch.Begin();
+        batch.DrawLine(vertices[0], vertices[1]);
+        batch.DrawLine(vertices[0], vertices[1]);
+        batch.DrawLine(vertices[0], vertices[1]);
+        batch.DrawTriangle(vertices[0], vertices[1], vertices[2]);
+        batch.End();
+
+        auto vertexBuffer = context.mVertexBuffer;
+
+        CHECK(context.mMaps.size() == 2);
+        CHECK(context.CountMaps(vertexBuffer, D3D11_MAP_WRITE_DISCARD) == 1);
+        CHECK(context.CountMaps(vertexBuffer, D3D11_MAP_WRITE_NO_OVERWRITE) == 1);
+        CHECK(context.mUnmaps == 2);
+
+        CHECK(context.mDraws.size() == 2);
+        CHECK(CheckDraw(context.mDraws[0], false, 6, 0, 0, D3D11_PRIMITIVE_TOPOLOGY_LINELIST));
+        CHECK(CheckDraw(context.mDraws[1], false, 3, 6, 0, D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST));
+
+        auto stats = batch.GetRenderStats();
+
+        CHECK(stats.maps == 2);
+        CHECK(stats.draws == 2);
+        CHECK(stats.wraps == 0);
+        CHECK(stats.vertices == 9);
+
+        // On an immediate context the next batch keeps appending after the previous one.
+        context.ClearCalls();
+
+        batch.Begin();
+        batch.DrawLine(vertices[0], vertices[1]);
+        batch.End();
+
+        CHECK(context.CountMaps(vertexBuffer, D3D11_MAP_WRITE_NO_OVERWRITE) == 1);
+        CHECK(context.mDraws.size() == 1 && CheckDraw(context.mDraws[0], false, 2, 9, 0, D3D11_PRIMITIVE_TOPOLOGY_LINELIST));
+    }
+
+
+    // With persistent mapping, the buffer stays mapped across topology changes and the draws are issued at End.
+    void MapCountsInPersistentMode(_In_ ID3D11Device* device)
+    {
+        MockDeviceContext context(device);
+        TestBatch batch(&context, 60, 20, true);
+
+        batch.Begin();
+        batch.DrawLine(vertices[0], vertices[1]);
+        batch.DrawLine(vertices[0], vertices[1]);
+        batch.DrawLine(vertices[0], vertices[1]);
+        batch.DrawTriangle(vertices[0], vertices[1], vertices[2]);
+        batch.DrawLine(vertices[0], vertices[1]);
+        batch.End();
+
+        CHECK(context.mMaps.size() == 1);
+        CHECK(context.CountMaps(context.mVertexBuffer, D3D11_MAP_WRITE_DISCARD) == 1);
+        CHECK(context.mUnmaps == 1);
+        CHECK(context.mTopologyChanges == 3);
+
+        CHECK(context.mDraws.size() == 3);
+        CHECK(CheckDraw(context.mDraws[0], false, 6, 0, 0, D3D11_PRIMITIVE_TOPOLOGY_LINELIST));
+        CHECK(CheckDraw(context.mDraws[1], false, 3, 6, 0, D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST));
+        CHECK(CheckDraw(context.mDraws[2], false, 2, 9, 0, D3D11_PRIMITIVE_TOPOLOGY_LINELIST));
+
+        auto stats = batch.GetRenderStats();
+
+        CHECK(stats.maps == 1);
+        CHECK(stats.draws == 3);
+    }
+
+
+    // Adjacent list primitives become a single draw; strips never merge.
+    void AdjacentListDrawsAreMerged(_In_ ID3D11Device* device)
+    {
+        MockDeviceContext context(device);
+        TestBatch batch(&context, 600, 400, false);
+
+        batch.Begin();
+
+        for (int i = 0; i < 10; i++)
+        {
+            batch.DrawQuad(vertices[0], vertices[1], vertices[2], vertices[3]);
+        }
+
+        batch.Draw(D3D11_PRIMITIVE_TOPOLOGY_LINESTRIP, vertices, 3);
+        batch.Draw(D3D11_PRIMITIVE_TOPOLOGY_LINESTRIP, vertices, 3);
+        batch.End();
+
+        CHECK(context.mDraws.size() == 3);
+        CHECK(CheckDraw(context.mDraws[0], true, 60, 0, 0, D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST));
+        CHECK(CheckDraw(context.mDraws[1], false, 3, 40, 0, D3D11_PRIMITIVE_TOPOLOGY_LINESTRIP));
+        CHECK(CheckDraw(context.mDraws[2], false, 3, 43, 0, D3D11_PRIMITIVE_TOPOLOGY_LINESTRIP));
+
+        // Each quad's indices are offset to where its vertices went within the merged draw.
+        auto indices = context.Contents<uint16_t>(context.mIndexBuffer);
+
+        bool indicesMatch = true;
+
+        for (int quad = 0; quad < 10; quad++)
+        {
+            for (int i = 0; i < 6; i++)
+            {
+                if (indices[quad * 6 + i] != quadIndices[i] + quad * 4)
+                    indicesMatch = false;
+            }
+        }
+
+        CHECK(indicesMatch);
+        CHECK(context.CountMaps(context.mIndexBuffer, D3D11_MAP_WRITE_DISCARD) == 1);
+        CHECK(context.CountMaps(context.mVertexBuffer, D3D11_MAP_WRITE_DISCARD) == 1);
+        CHECK(context.CountMaps(context.mVertexBuffer, D3D11_MAP_WRITE_NO_OVERWRITE) == 2);
+    }
+
+
+    // When only the index buffer is full, only it is discarded: the vertices keep appending.
+    void IndexOnlyWrap(_In_ ID3D11Device* device)
+    {
+        MockDeviceContext context(device);
+        TestBatch batch(&context, 12, 100, false);
+
+        batch.Begin();
+        batch.DrawQuad(vertices[0], vertices[1], vertices[2], vertices[3]);
+        batch.DrawQuad(vertices[0], vertices[1], vertices[2], vertices[3]);
+        batch.DrawQuad(vertices[0], vertices[1], vertices[2], vertices[3]);
+        batch.End();
+
+        CHECK(context.CountMaps(context.mIndexBuffer, D3D11_MAP_WRITE_DISCARD) == 2);
+        CHECK(context.CountMaps(context.mIndexBuffer, D3D11_MAP_WRITE_NO_OVERWRITE) == 0);
+        CHECK(context.CountMaps(context.mVertexBuffer, D3D11_MAP_WRITE_DISCARD) == 1);
+        CHECK(context.CountMaps(context.mVertexBuffer, D3D11_MAP_WRITE_NO_OVERWRITE) == 1);
+
+        CHECK(context.mDraws.size() == 2);
+        CHECK(CheckDraw(context.mDraws[0], true, 12, 0, 0, D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST));
+        CHECK(CheckDraw(context.mDraws[1], true, 6, 0, 8, D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST));
+
+        // The new draw has its own base vertex, so its indices start from zero again.
+        auto indices = context.Contents<uint16_t>(context.mIndexBuffer);
+
+        CHECK(indices[0] == 0 && indices[3] == 0 && indices[5] == 3);
+        CHECK(batch.GetRenderStats().wraps == 1);
+    }
+
+
+    // When only the vertex buffer is full, only it is discarded: the indices keep appending.
+    void VertexOnlyWrap(_In_ ID3D11Device* device)
+    {
+        MockDeviceContext context(device);
+        TestBatch batch(&context, 100, 8, false);
+
+        batch.Begin();
+        batch.DrawQuad(vertices[0], vertices[1], vertices[2], vertices[3]);
+        batch.DrawQuad(vertices[0], vertices[1], vertices[2], vertices[3]);
+        batch.DrawQuad(vertices[0], vertices[1], vertices[2], vertices[3]);
+        batch.End();
+
+        CHECK(context.CountMaps(context.mIndexBuffer, D3D11_MAP_WRITE_DISCARD) == 1);
+        CHECK(context.CountMaps(context.mIndexBuffer, D3D11_MAP_WRITE_NO_OVERWRITE) == 1);
+        CHECK(context.CountMaps(context.mVertexBuffer, D3D11_MAP_WRITE_DISCARD) == 2);
+        CHECK(context.CountMaps(context.mVertexBuffer, D3D11_MAP_WRITE_NO_OVERWRITE) == 0);
+
+        CHECK(context.mDraws.size() == 2);
+        CHECK(CheckDraw(context.mDraws[0], true, 12, 0, 0, D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST));
+        CHECK(CheckDraw(context.mDraws[1], true, 6, 12, 0, D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST));
+
+        // The indices written before the wrap were not overwritten.
+        auto indices = context.Contents<uint16_t>(context.mIndexBuffer);
+
+        CHECK(indices[6] == 4 && indices[11] == 7);
+        CHECK(indices[12] == 0 && indices[17] == 3);
+        CHECK(batch.GetRenderStats().wraps == 1);
+    }
+
+
+    // Indices are relative to the base vertex of the pending draw they are merged into.
+    void VertexOffsetsWith16BitIndices(_In_ ID3D11Device* device)
+    {
+        MockDeviceContext context(device);
+        TestBatch batch(&context, 60, 0x10000, true);
+
+        batch.Begin();
+        batch.DrawQuad(vertices[0], vertices[1], vertices[2], vertices[3]);
+        batch.DrawLine(vertices[0], vertices[1]);
+        batch.DrawQuad(vertices[0], vertices[1], vertices[2], vertices[3]);
+        batch.DrawQuad(vertices[0], vertices[1], vertices[2], vertices[3]);
+        batch.End();
+
+        CHECK(context.mIndexFormat == DXGI_FORMAT_R16_UINT);
+
+        CHECK(context.mDraws.size() == 3);
+        CHECK(CheckDraw(context.mDraws[0], true, 6, 0, 0, D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST));
+        CHECK(CheckDraw(context.mDraws[1], false, 2, 4, 0, D3D11_PRIMITIVE_TOPOLOGY_LINELIST));
+        CHECK(CheckDraw(context.mDraws[2], true, 12, 6, 6, D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST));
+
+        auto indices = context.Contents<uint16_t>(context.mIndexBuffer);
+
+        const uint16_t expected[] = { 0, 1, 2, 0, 2, 3,   0, 1, 2, 0, 2, 3,   4, 5, 6, 4, 6, 7 };
+
+        CHECK(memcmp(indices, expected, sizeof(expected)) == 0);
+
+        // Offsets near the top of the 16-bit range still fit.
+        std::vector<TestVertex> many(65000);
+        const uint16_t triangle[] = { 0, 1, 2 };
+
+        context.ClearCalls();
+
+        batch.Begin();
+        batch.DrawIndexed(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST, triangle, 3, many.data(), many.size());
+        batch.DrawQuad(vertices[0], vertices[1], vertices[2], vertices[3]);
+        batch.End();
+
+        CHECK(context.mDraws.size() == 1 && context.mDraws[0].count == 9);
+
+        if (context.mDraws.size() == 1)
+        {
+            indices = context.Contents<uint16_t>(context.mIndexBuffer) + context.mDraws[0].start;
+
+            CHECK(indices[2] == 2 && indices[3] == 65000 && indices[4] == 65001 && indices[8] == 65003);
+        }
+    }
+
+
+    // With more than 64K vertices the batch switches to 32-bit indices, and offsets are not truncated.
+    void VertexOffsetsWith32BitIndices(_In_ ID3D11Device* device)
+    {
+        MockDeviceContext context(device);
+        TestBatch batch(&context, 60, 0x20000, true);
+
+        std::vector<TestVertex> many(70000);
+        const uint32_t triangle[] = { 0, 1, 2 };
+        const uint32_t reversed[] = { 2, 1, 0 };
+
+        batch.Begin();
+        batch.DrawIndexed(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST, triangle, 3, many.data(), many.size());
+        batch.DrawQuad(vertices[0], vertices[1], vertices[2], vertices[3]);
+        batch.DrawLine(vertices[0], vertices[1]);
+        batch.DrawIndexed(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST, reversed, 3, vertices, 3);
+        batch.End();
+
+        CHECK(context.mIndexFormat == DXGI_FORMAT_R32_UINT);
+
+        CHECK(context.mDraws.size() == 3);
+        CHECK(CheckDraw(context.mDraws[0], true, 9, 0, 0, D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST));
+        CHECK(CheckDraw(context.mDraws[1], false, 2, 70004, 0, D3D11_PRIMITIVE_TOPOLOGY_LINELIST));
+        CHECK(CheckDraw(context.mDraws[2], true, 3, 9, 70006, D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST));
+
+        auto indices = context.Contents<uint32_t>(context.mIndexBuffer);
+
+        const uint32_t expected[] = { 0, 1, 2,   70000, 70001, 70002, 70000, 70002, 70003,   2, 1, 0 };
+
+        CHECK(memcmp(indices, expected, sizeof(expected)) == 0);
+    }
+
+
+    // A deferred context starts every batch with a discard, since it cannot rely on the previous contents.
+    void DeferredContextDiscardsEachBatch(_In_ ID3D11Device* device)
+    {
+        MockDeviceContext context(device, D3D11_DEVICE_CONTEXT_DEFERRED);
+        TestBatch batch(&context, 60, 20, false);
+
+        for (int i = 0; i < 2; i++)
+        {
+            batch.Begin();
+            batch.DrawLine(vertices[0], vertices[1]);
+            batch.End();
+        }
+
+        CHECK(context.CountMaps(context.mVertexBuffer, D3D11_MAP_WRITE_DISCARD) == 2);
+        CHECK(context.CountMaps(context.mVertexBuffer, D3D11_MAP_WRITE_NO_OVERWRITE) == 0);
+    }
+}
+
+
+int wmain()
+{
+    // The buffers are created on WARP, so the tests do not need a GPU.
+    ComPtr<ID3D11Device> device;
+
+    HRESULT hr = D3D11CreateDevice(nullptr, D3D_DRIVER_TYPE_WARP, nullptr, 0, nullptr, 0, D3D11_SDK_VERSION, &device, nullptr, nullptr);
+
+    if (FAILED(hr))
+    {
+        printf("Failed to create a WARP device (%08X)\n", static_cast<unsigned int>(hr));
+        return 1;
+    }
+
+    try
+    {
+        MapCountsInDefaultMode(device.Get());
+        MapCountsInPersistentMode(device.Get());
+        AdjacentListDrawsAreMerged(device.Get());
+        IndexOnlyWrap(device.Get());
+        VertexOnlyWrap(device.Get());
+        VertexOffsetsWith16BitIndices(device.Get());
+        VertexOffsetsWith32BitIndices(device.Get());
+        DeferredContextDiscardsEachBatch(device.Get());
+    }
+    catch (std::exception const& e)
+    {
+        printf("Unexpected exception: %s\n", e.what());
+        failures++;
+    }
+
+    if (failures)
+    {
+        printf("PrimitiveBatchTests: %d check(s) failed\n", failures);
+        return 1;
+    }
+
+    printf("PrimitiveBatchTests: passed\n");
+    return 0;
+}